@@ -1412,6 +1412,11 @@ bool CAICallback::GetValue(int id, void *data)
 			*(const char**) data = gameSetup ? gameSetup->gameSetupText.c_str() : "";
 			return true;
 		}
+		case AIVAL_PATH_CACHE_STATS: {
+			unsigned int* stats = (unsigned int*) data;
+			pathManager->GetPathCacheStats(&stats[0], &stats[1], &stats[2], &stats[3]);
+			return true;
+		}
 		default:
 			return false;
 	}
@@ -35,6 +35,7 @@ struct WeaponDef;
 #define AIVAL_LOCATE_FILE_W				16 // char*
 #define AIVAL_UNIT_LIMIT				17 // int
 #define AIVAL_SCRIPT					18 // const char* - buffer for pointer to char
+#define AIVAL_PATH_CACHE_STATS			19 // unsigned int[4] - hits, partial hits, misses, evictions
 
 struct UnitResourceInfo
 {
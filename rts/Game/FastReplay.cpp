@@ -0,0 +1,121 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StdAfx.h"
+#include <stdexcept>
+#include <SDL_timer.h>
+#include "mmgr.h"
+
+#include "FastReplay.h"
+
+#include "FileSystem/FileSystem.h"
+#include "LoadSave/DemoReader.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/Team.h"
+#include "Sim/Misc/TeamHandler.h"
+#include "Sim/Misc/TeamStatistics.h"
+#include "LogOutput.h"
+
+CFastReplay::CFastReplay(const std::string& demoName)
+	: demoFrames(0)
+	, lastStatsFrame(0)
+	, statsSimTime(0)
+	, statsMaxSimTime(0)
+	, totalSimTime(0)
+{
+	try {
+		CDemoReader reader(demoName, 0.0f);
+		demoFrames = reader.GetFileHeader().gameTime * GAME_SPEED;
+	} catch (const std::runtime_error&) {
+		// the server already played it, so this can't really happen
+	}
+
+	if (filesystem.CreateDirectory("demos")) {
+		const std::string statsName = "demos/" + filesystem.GetBasename(demoName) + ".json";
+		file.open(filesystem.LocateFile(statsName, FileSystem::WRITE).c_str());
+		logOutput.Print("Fast replay, writing stats to %s", statsName.c_str());
+	}
+
+	startTime = SDL_GetTicks();
+	lastStatsTime = startTime;
+}
+
+CFastReplay::~CFastReplay()
+{
+}
+
+void CFastReplay::SimFrame(int frameNum, unsigned simTime)
+{
+	statsSimTime += simTime;
+	statsMaxSimTime = std::max(statsMaxSimTime, simTime);
+
+	if ((frameNum - lastStatsFrame) >= TeamStatistics::statsPeriod * GAME_SPEED)
+		WriteStats(frameNum);
+}
+
+void CFastReplay::WriteStats(int frameNum)
+{
+	const unsigned curTime = SDL_GetTicks();
+	const int frames = frameNum - lastStatsFrame;
+
+	if (file.is_open() && frames > 0) {
+		file << "{\"frame\": " << frameNum
+		     << ", \"framesPerSecond\": " << (frames * 1000.0f / std::max(curTime - lastStatsTime, 1u))
+		     << ", \"simTimeAvg\": " << (statsSimTime / float(frames))
+		     << ", \"simTimeMax\": " << statsMaxSimTime
+		     << ", \"teams\": [";
+
+		for (int a = 0; a < teamHandler->ActiveTeams(); ++a) {
+			const TeamStatistics& stats = *teamHandler->Team(a)->currentStats;
+
+			file << ((a == 0) ? "" : ", ")
+			     << "{\"team\": " << a
+			     << ", \"metalUsed\": " << stats.metalUsed
+			     << ", \"energyUsed\": " << stats.energyUsed
+			     << ", \"metalProduced\": " << stats.metalProduced
+			     << ", \"energyProduced\": " << stats.energyProduced
+			     << ", \"metalExcess\": " << stats.metalExcess
+			     << ", \"energyExcess\": " << stats.energyExcess
+			     << ", \"metalReceived\": " << stats.metalReceived
+			     << ", \"energyReceived\": " << stats.energyReceived
+			     << ", \"metalSent\": " << stats.metalSent
+			     << ", \"energySent\": " << stats.energySent
+			     << ", \"damageDealt\": " << stats.damageDealt
+			     << ", \"damageReceived\": " << stats.damageReceived
+			     << ", \"unitsProduced\": " << stats.unitsProduced
+			     << ", \"unitsDied\": " << stats.unitsDied
+			     << ", \"unitsReceived\": " << stats.unitsReceived
+			     << ", \"unitsSent\": " << stats.unitsSent
+			     << ", \"unitsCaptured\": " << stats.unitsCaptured
+			     << ", \"unitsOutCaptured\": " << stats.unitsOutCaptured
+			     << ", \"unitsKilled\": " << stats.unitsKilled
+			     << "}";
+		}
+
+		file << "]}" << std::endl;
+	}
+
+	totalSimTime += statsSimTime;
+	statsSimTime = 0;
+	statsMaxSimTime = 0;
+	lastStatsFrame = frameNum;
+	lastStatsTime = curTime;
+}
+
+void CFastReplay::Finish(int frameNum)
+{
+	WriteStats(frameNum);
+
+	const float wallTime = std::max(SDL_GetTicks() - startTime, 1u) * 0.001f;
+	const float framesPerSecond = frameNum / wallTime;
+
+	if (file.is_open()) {
+		file << "{\"frames\": " << frameNum
+		     << ", \"wallTime\": " << wallTime
+		     << ", \"simTime\": " << (totalSimTime * 0.001f)
+		     << ", \"framesPerSecond\": " << framesPerSecond
+		     << "}" << std::endl;
+	}
+
+	logOutput.Print("Fast replay: %d frames in %.1f seconds (%.1f in sim), %.1f frames/s",
+		frameNum, wallTime, totalSimTime * 0.001f, framesPerSecond);
+}
@@ -0,0 +1,49 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef FAST_REPLAY_H
+#define FAST_REPLAY_H
+
+#include <fstream>
+#include <string>
+
+/**
+ * @brief Statistics of a demo replayed as fast as possible
+ *
+ * Used when a demo is started with --fast-replay: the server feeds the demo
+ * as soon as the local client has simulated it and the client skips all
+ * unsynced work (see CGame::StartSkip). Every TeamStatistics::statsPeriod
+ * game seconds a line holding a JSON object with the sim time per frame and
+ * the current team statistics is written to demos/<demo>.json, the last line
+ * holds the frames per second of the whole replay.
+ */
+class CFastReplay
+{
+public:
+	CFastReplay(const std::string& demoName);
+	~CFastReplay();
+
+	/// number of frames in the demo, 0 if unknown (crashed recording)
+	int GetDemoFrames() const { return demoFrames; }
+
+	/// call after each sim frame, simTime in milliseconds
+	void SimFrame(int frameNum, unsigned simTime);
+	/// write the summary, call once the whole demo has been simulated
+	void Finish(int frameNum);
+
+private:
+	void WriteStats(int frameNum);
+
+	std::ofstream file;
+	int demoFrames;
+
+	unsigned startTime;
+	unsigned lastStatsTime;
+	int lastStatsFrame;
+
+	/// sim time of the frames since the last stats line
+	unsigned statsSimTime;
+	unsigned statsMaxSimTime;
+	unsigned totalSimTime;
+};
+
+#endif // FAST_REPLAY_H
@@ -22,12 +22,14 @@
 #include "ChatMessage.h"
 #include "ClientSetup.h"
 #include "ConsoleHistory.h"
+#include "FastReplay.h"
 #include "GameHelper.h"
 #include "GameServer.h"
 #include "GameVersion.h"
 #include "CommandMessage.h"
 #include "GameSetup.h"
 #include "LoadScreen.h"
+#include "LoadTaskGraph.h"
 #include "SelectedUnits.h"
 #include "PlayerHandler.h"
 #include "PlayerRoster.h"
@@ -140,10 +142,12 @@
 #include "System/Util.h"
 #include "System/Input/KeyInput.h"
 #include "System/FileSystem/ArchiveScanner.h"
+#include "System/FileSystem/CRC.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/VFSHandler.h"
 #include "System/FileSystem/SimpleParser.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/Net/PackPacket.h"
 #include "System/Platform/CrashHandler.h"
@@ -249,7 +253,8 @@ CGame::CGame(const std::string& mapname, const std::string& modName, ILoadSaveHa
 	consumeSpeed(1.0f),
 	luaDrawTime(0),
 
-	saveFile(saveFile)
+	saveFile(saveFile),
+	fastReplay(NULL)
 {
 	game = this;
 
@@ -272,6 +277,7 @@ CGame::CGame(const std::string& mapname, const std::string& modName, ILoadSaveHa
 	showMTInfo = !!configHandler->Get("ShowMTInfo", 1);
 
 	speedControl = configHandler->Get("SpeedControl", 0);
+	demoKeyframeInterval = configHandler->Get("DemoKeyframeInterval", 0);
 
 	playerRoster.SetSortTypeByCode((PlayerRoster::SortType)configHandler->Get("ShowPlayerInfo", 1));
 
@@ -303,6 +309,8 @@ CGame::~CGame()
 	tracefile << "[" << __FUNCTION__ << "]";
 #endif
 
+	SafeDelete(fastReplay);
+
 	CLoadScreen::DeleteInstance();
 	IVideoCapturing::FreeInstance();
 	ISound::Shutdown();
@@ -383,6 +391,7 @@ CGame::~CGame()
 	}
 	grouphandlers.clear();
 
+	CCregLoadSaveHandler::WaitForSave();
 	SafeDelete(saveFile); // ILoadSaveHandler, depends on vfsHandler via ~CArchiveBase
 	SafeDelete(vfsHandler);
 	SafeDelete(archiveScanner);
@@ -397,13 +406,42 @@ CGame::~CGame()
 void CGame::LoadGame(const std::string& mapname)
 {
 	Watchdog::RegisterThread("loadscreen");
+	loadscreen->SetLoadThread();
 
-	if (!gu->globalQuit) LoadDefs();
-	if (!gu->globalQuit) LoadSimulation(mapname);
-	if (!gu->globalQuit) LoadRendering();
-	if (!gu->globalQuit) LoadInterface();
-	if (!gu->globalQuit) LoadLua();
-	if (!gu->globalQuit) LoadFinalize();
+	{
+		//! sound definitions (and the samples they preload) and the path costs
+		//! do not need GL, so they are loaded alongside the other stages
+		CLoadTaskGraph loader;
+
+		const int defs       = loader.AddTask("Definitions", boost::bind(&CGame::LoadDefs, this));
+		const int sounds     = loader.AddTask("Sounds", boost::bind(&CGame::LoadSounds, this), true);
+		const int map        = loader.AddTask("Map", boost::bind(&CGame::LoadMap, this, mapname));
+		const int simulation = loader.AddTask("Simulation", boost::bind(&CGame::LoadSimulation, this));
+		const int pathing    = loader.AddTask("Path Costs", boost::bind(&CGame::LoadPathing, this), true);
+		const int rendering  = loader.AddTask("Rendering", boost::bind(&CGame::LoadRendering, this));
+		const int ui         = loader.AddTask("Interface", boost::bind(&CGame::LoadInterface, this));
+		const int lua        = loader.AddTask("Lua", boost::bind(&CGame::LoadLua, this));
+		const int finalize   = loader.AddTask("Finalize", boost::bind(&CGame::LoadFinalize, this));
+
+		//! unit and weapon sounds are looked up by the unit and weapon defs
+		loader.AddDependency(simulation, defs);
+		loader.AddDependency(simulation, sounds);
+		loader.AddDependency(simulation, map);
+		//! path costs depend on the map features, and nothing may change the
+		//! blocking map before they are done (gadgets can create features)
+		loader.AddDependency(pathing, simulation);
+		loader.AddDependency(rendering, simulation);
+		loader.AddDependency(ui, rendering);
+		loader.AddDependency(lua, ui);
+		loader.AddDependency(lua, pathing);
+		loader.AddDependency(finalize, lua);
+
+		loader.Run(&gu->globalQuit);
+
+		if (!gu->globalQuit) {
+			loader.WriteProfile("loadprofile.json");
+		}
+	}
 
 	if (!gu->globalQuit && saveFile) {
 		loadscreen->SetLoadMessage("Loading game");
@@ -414,6 +452,52 @@ void CGame::LoadGame(const std::string& mapname)
 }
 
 
+/**
+ * Identifies everything the gamedata definitions are made from.
+ * Returns false if they should not be cached, which is the case for
+ * directory archives: their checksums miss edits to their files.
+ */
+static bool GetDefsCacheKey(unsigned int* key)
+{
+	// the defs are parsed with the map archives in the VFS as well (maps
+	// may ship their own features/ and gamedata/), so both count
+	const std::string modArchive = archiveScanner->ArchiveFromName(gameSetup->modName);
+	const std::string mapArchive = archiveScanner->ArchiveFromName(gameSetup->mapName);
+	const std::string rootArchives[2] = { modArchive, mapArchive };
+
+	CRC crc;
+
+	for (int i = 0; i < 2; ++i) {
+		const std::vector<std::string> archives = archiveScanner->GetArchives(rootArchives[i]);
+
+		for (std::vector<std::string>::const_iterator it = archives.begin(); it != archives.end(); ++it) {
+			if (filesystem.GetExtension(*it) == "sdd") {
+				return false;
+			}
+		}
+
+		// includes the checksums of all dependencies
+		crc << archiveScanner->GetArchiveCompleteChecksum(rootArchives[i]);
+	}
+
+	const std::string version = SpringVersion::GetFull();
+	crc.Update(version.data(), version.size());
+
+	const std::map<std::string, std::string>* options[2] = { &gameSetup->modOptions, &gameSetup->mapOptions };
+	for (int i = 0; i < 2; ++i) {
+		std::map<std::string, std::string>::const_iterator it;
+		for (it = options[i]->begin(); it != options[i]->end(); ++it) {
+			crc.Update(it->first.c_str(), it->first.size() + 1);
+			crc.Update(it->second.c_str(), it->second.size() + 1);
+		}
+		crc << i;
+	}
+
+	*key = crc.GetDigest();
+	return true;
+}
+
+
 void CGame::LoadDefs()
 {
 	{
@@ -432,8 +516,20 @@ void CGame::LoadDefs()
 		defsParser->AddFunc("GetMapOptions", LuaSyncedRead::GetMapOptions);
 		defsParser->EndTable();
 
-		// run the parser
-		if (!defsParser->Execute()) {
+		// run the parser, or restore its result if this mod was
+		// loaded with the same options before
+		unsigned int cacheKey = 0;
+		bool executed = false;
+
+		if (GetDefsCacheKey(&cacheKey)) {
+			char cacheFile[64];
+			SNPRINTF(cacheFile, sizeof(cacheFile), "cache/defs/%08x.bin", cacheKey);
+			executed = defsParser->ExecuteCached(cacheFile, cacheKey);
+		} else {
+			executed = defsParser->Execute();
+		}
+
+		if (!executed) {
 			throw content_error("Defs-Parser: " + defsParser->GetErrorLog());
 		}
 		const LuaTable root = defsParser->GetRoot();
@@ -458,17 +554,18 @@ void CGame::LoadDefs()
 			throw content_error("Error loading MoveDefs");
 		}
 	}
+}
 
-	{
-		ScopedOnceTimer timer("Loading Sound Definitions");
-		loadscreen->SetLoadMessage("Loading Sound Definitions");
+void CGame::LoadSounds()
+{
+	ScopedOnceTimer timer("Loading Sound Definitions");
+	loadscreen->SetLoadMessage("Loading Sound Definitions");
 
-		sound->LoadSoundDefs("gamedata/sounds.lua");
-		chatSound = sound->GetSoundId("IncomingChat", false);
-	}
+	sound->LoadSoundDefs("gamedata/sounds.lua");
+	chatSound = sound->GetSoundId("IncomingChat", false);
 }
 
-void CGame::LoadSimulation(const std::string& mapname)
+void CGame::LoadMap(const std::string& mapname)
 {
 	// simulation components
 	helper = new CGameHelper();
@@ -477,13 +574,14 @@ void CGame::LoadSimulation(const std::string& mapname)
 	loadscreen->SetLoadMessage("Parsing Map Information");
 
 	readmap = CReadMap::LoadMap(mapname);
-	groundBlockingObjectMap = new CGroundBlockingObjectMap(gs->mapSquares);
 
 	loadscreen->SetLoadMessage("Creating Smooth Height Mesh");
 	smoothGround = new SmoothHeightMesh(ground, float3::maxxpos, float3::maxzpos, SQUARE_SIZE * 2, SQUARE_SIZE * 40);
 
 	loadscreen->SetLoadMessage("Creating QuadField & CEGs");
 	moveinfo = new CMoveInfo();
+	// sizes its per-MoveData bitmaps from moveinfo
+	groundBlockingObjectMap = new CGroundBlockingObjectMap(gs->mapSquares);
 	qf = new CQuadField();
 	damageArrayHandler = new CDamageArrayHandler();
 	explGenHandler = new CExplosionGeneratorHandler();
@@ -501,7 +599,10 @@ void CGame::LoadSimulation(const std::string& mapname)
 		farTextureHandler = new CFarTextureHandler();
 		featureDrawer = new CFeatureDrawer();
 	}
+}
 
+void CGame::LoadSimulation()
+{
 	loadscreen->SetLoadMessage("Loading Weapon Definitions");
 	weaponDefHandler = new CWeaponDefHandler();
 	loadscreen->SetLoadMessage("Loading Unit Definitions");
@@ -522,14 +623,18 @@ void CGame::LoadSimulation(const std::string& mapname)
 	loshandler = new CLosHandler();
 	radarhandler = new CRadarHandler(false);
 
-	pathManager = IPathManager::GetInstance();
-
 	wind.LoadWind(mapInfo->atmosphere.minWind, mapInfo->atmosphere.maxWind);
 
 	CCobInstance::InitVars(teamHandler->ActiveTeams(), teamHandler->ActiveAllyTeams());
 	CEngineOutHandler::Initialize();
 }
 
+void CGame::LoadPathing()
+{
+	pathManager = IPathManager::GetInstance();
+	pathDrawer = IPathDrawer::GetInstance();
+}
+
 void CGame::LoadRendering()
 {
 	// rendering components
@@ -550,7 +655,6 @@ void CGame::LoadRendering()
 	inMapDrawerModel = new CInMapDrawModel();
 	inMapDrawer = new CInMapDraw();
 	inMapDrawerView = new CInMapDrawView();
-	pathDrawer = IPathDrawer::GetInstance();
 
 	geometricObjects = new CGeometricObjects();
 
@@ -655,8 +759,11 @@ void CGame::LoadLua()
 		CLuaGaia::LoadHandler();
 	}
 
-	loadscreen->SetLoadMessage("Loading LuaUI");
-	CLuaUI::LoadHandler();
+	// a fast replay has no use for widgets
+	if (!gameSetup->fastReplay) {
+		loadscreen->SetLoadMessage("Loading LuaUI");
+		CLuaUI::LoadHandler();
+	}
 
 	// last in, first served
 	luaInputReceiver = new LuaInputReceiver();
@@ -825,6 +932,9 @@ bool CGame::Update()
 
 	lastModGameTimeMeasure = timeNow;
 
+	// report a failed background save as soon as it is known
+	CCregLoadSaveHandler::CheckSaveDone();
+
 	time(&fpstimer);
 
 	if (difftime(fpstimer, starttime) != 0) { // do once every second
@@ -852,6 +962,13 @@ bool CGame::Update()
 
 	net->Update();
 
+	if (fastReplay && gameServer && gameServer->HasDemoEnded() && !net->Peek(0)) {
+		// the whole demo has been simulated
+		fastReplay->Finish(gs->frameNum);
+		SafeDelete(fastReplay);
+		gu->globalQuit = true;
+	}
+
 	if (videoCapturing->IsCapturing() && playing && gameServer) {
 		gameServer->CreateNewFrame(false, true);
 	}
@@ -1589,6 +1706,12 @@ void CGame::StartPlaying()
 
 	eventHandler.GameStart();
 	net->Send(CBaseNetProtocol::Get().SendSpeedControl(gu->myPlayerNum, speedControl));
+
+	if (gameSetup->hostDemo && gameSetup->fastReplay) {
+		fastReplay = new CFastReplay(gameSetup->demoName);
+		// skip mode turns off sound, drawing and the other unsynced work
+		StartSkip(std::max(fastReplay->GetDemoFrames(), gs->frameNum + 1));
+	}
 #if defined(USE_GML) && GML_ENABLE_SIM
 	if(showMTInfo) {
 		CKeyBindings::HotkeyList lslist = keyBindings->GetHotkeys("luaui selector");
@@ -1662,7 +1785,15 @@ void CGame::SimFrame() {
 	teamHandler->GameFrame(gs->frameNum);
 	playerHandler->GameFrame(gs->frameNum);
 
+	if (demoKeyframeInterval > 0 && (gs->frameNum % (demoKeyframeInterval * GAME_SPEED)) == 0) {
+		SaveDemoKeyframe();
+	}
+
 	lastUpdate = SDL_GetTicks();
+
+	if (fastReplay) {
+		fastReplay->SimFrame(gs->frameNum, lastUpdate - lastFrameTime);
+	}
 }
 
 
@@ -2222,6 +2353,31 @@ bool CGame::HasLag() const
 }
 
 
+void CGame::SaveDemoKeyframe()
+{
+	CDemoRecorder* record = net->GetDemoRecorder();
+
+	if (record == NULL)
+		return;
+
+	try {
+		std::ostringstream state(std::ios::out | std::ios::binary);
+		CCregLoadSaveHandler ls;
+		ls.mapName = gameSetup->mapName;
+		ls.modName = modInfo.filename;
+		ls.SaveGame(state);
+
+		// same clock as CNetProtocol::GetData uses for the demo stream
+		const float demoTime = gu->startTime + (float)gs->frameNum / (float)GAME_SPEED;
+
+		GML_STDMUTEX_LOCK(net); // SaveDemoKeyframe
+		record->SaveKeyframe(state.str(), demoTime);
+	} catch (std::exception& e) {
+		logOutput.Print("Demo keyframe failed: %s", e.what());
+	}
+}
+
+
 void CGame::SaveGame(const std::string& filename, bool overwrite)
 {
 	if (filesystem.CreateDirectory("Saves")) {
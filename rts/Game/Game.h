@@ -24,6 +24,7 @@ class ILoadSaveHandler;
 class Action;
 class ChatMessage;
 class SkirmishAIData;
+class CFastReplay;
 
 
 class CGame : public CGameController
@@ -37,7 +38,10 @@ public:
 
 private:
 	void LoadDefs();
-	void LoadSimulation(const std::string& mapname);
+	void LoadSounds();
+	void LoadMap(const std::string& mapname);
+	void LoadSimulation();
+	void LoadPathing();
 	void LoadRendering();
 	void LoadInterface();
 	void LoadLua();
@@ -137,6 +141,8 @@ private:
 	void SaveGame(const std::string& filename, bool overwrite);
 	/// Re-load the game.
 	void ReloadGame();
+	/// Store the game state as a keyframe in the demo being recorded.
+	void SaveDemoKeyframe();
 	/// Send a message to other players (allows prefixed messages with e.g. "a:...")
 	void SendNetChat(std::string message, int destination = -1);
 	/// Format and display a chat message received over network
@@ -210,11 +216,16 @@ private:
 	unsigned skipLastDraw;
 
 	int speedControl;
+	/// Seconds of game time between demo keyframes, 0 to disable
+	int demoKeyframeInterval;
 	int luaDrawTime;
 
 
 	/// for reloading the savefile
 	ILoadSaveHandler* saveFile;
+
+	/// set while replaying a demo as fast as possible (GameSetup::fastReplay)
+	CFastReplay* fastReplay;
 };
 
 
@@ -1,6 +1,8 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "mmgr.h"
 
 #include "Camera.h"
@@ -37,6 +39,8 @@
 #include "System/GlobalUnsynced.h"
 #include "System/EventHandler.h"
 #include "System/myMath.h"
+#include "System/LogOutput.h"
+#include "System/TimeProfiler.h"
 #include "System/Sync/SyncTracer.h"
 
 //////////////////////////////////////////////////////////////////////
@@ -46,6 +50,8 @@
 CGameHelper* helper;
 
 
+static CLogSubsystem LOG_TARGETCACHE("WeaponTargetCache");
+
 CGameHelper::CGameHelper()
 {
 	stdExplosionGenerator = new CStdExplosionGenerator();
@@ -332,9 +338,9 @@ static inline void QueryUnits(TFilter filter, TQuery& query)
 			if (!filter.Team(t)) {
 				continue;
 			}
-			std::list<CUnit*>::const_iterator ui;
-			const std::list<CUnit*>& allyTeamUnits = quad.teamUnits[t];
-			for (ui = allyTeamUnits.begin(); ui != allyTeamUnits.end(); ++ui) {
+			std::vector<CUnit*>::const_reverse_iterator ui;
+			const std::vector<CUnit*>& allyTeamUnits = quad.teamUnits[t];
+			for (ui = allyTeamUnits.rbegin(); ui != allyTeamUnits.rend(); ++ui) {
 				if ((*ui)->tempNum != tempNum) {
 					(*ui)->tempNum = tempNum;
 					if (filter.Unit(*ui)) {
@@ -592,7 +598,7 @@ public:
 
 
 
-void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::multimap<float, CUnit*>& targets)
+void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets)
 {
 	GML_RECMUTEX_LOCK(qnum); // GenerateTargets
 
@@ -602,114 +608,281 @@ void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* last
 	const float heightMod = weapon->heightMod;
 	const float aHeight   = weapon->weaponPos.y;
 
-	// how much damage the weapon deals over 1 second
-	const float secDamage = weapon->weaponDef->damages[0] * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
-	const bool paralyzer  = !!weapon->weaponDef->damages.paralyzeDamageTime;
+	const float radarErrorSize = radarhandler->radarErrorSize[attacker->allyteam];
+	const bool luaTargets = (luaRules && luaRules->HaveAllowWeaponTarget());
 
-	const std::vector<int>& quads = qf->GetQuads(pos, radius + (aHeight - std::max(0.f, readmap->minheight)) * heightMod);
+	if (targetQuads.empty()) {
+		targetQuads.resize(std::max(1000, qf->GetNumQuadsX() * qf->GetNumQuadsZ()));
+	}
 
-	const int tempNum = gs->tempNum++;
+	int* endQuad = &targetQuads[0];
+	qf->GetQuads(pos, radius + (aHeight - std::max(0.f, readmap->minheight)) * heightMod, endQuad);
 
-	typedef std::vector<int>::const_iterator VectorIt;
-	typedef std::list<CUnit*>::const_iterator ListIt;
-	
-	for (VectorIt qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
-			if (teamHandler->Ally(attacker->allyteam, t)) {
-				continue;
-			}
+	const int tempNum = gs->tempNum++;
+	int order = 0;
 
-			const std::list<CUnit*>& allyTeamUnits = qf->GetQuad(*qi).teamUnits[t];
+	targetCandidates.clear();
+	targets.clear();
 
-			for (ListIt ui = allyTeamUnits.begin(); ui != allyTeamUnits.end(); ++ui) {
-				CUnit* targetUnit = *ui;
-				float targetPriority = 1.0f;
+	typedef std::vector<CUnit*>::const_reverse_iterator UnitIt;
+	typedef std::vector<CachedTarget>::const_iterator CachedIt;
 
-				if (luaRules && luaRules->AllowWeaponTarget(attacker->id, targetUnit->id, weapon->weaponNum, weapon->weaponDef->id, &targetPriority)) {
-					targets.insert(std::pair<float, CUnit*>(targetPriority, targetUnit));
-					continue;
-				}
+	if (!luaTargets) {
+		// same candidates as below, but the LOS and radar state of the
+		// enemy units is evaluated once per frame for the whole allyteam
+		for (const int* qi = &targetQuads[0]; qi != endQuad; ++qi) {
+			const std::vector<CachedTarget>& quadTargets = GetQuadTargets(attacker->allyteam, *qi);
 
+			for (CachedIt ti = quadTargets.begin(); ti != quadTargets.end(); ++ti) {
+				CUnit* targetUnit = ti->unit;
 
-				if (targetUnit->tempNum != tempNum && (targetUnit->category & weapon->onlyTargetCategory)) {
+				if (targetUnit->tempNum != tempNum && (ti->category & weapon->onlyTargetCategory)) {
 					targetUnit->tempNum = tempNum;
 
-					if (targetUnit->isUnderWater && !weapon->weaponDef->waterweapon) {
-						continue;
-					}
-					if (targetUnit->isDead) {
-						continue;
-					}
-
-					float3 targPos;
-					const unsigned short targetLOSState = targetUnit->losStatus[attacker->allyteam];
-
-					if (targetLOSState & LOS_INLOS) {
-						targPos = targetUnit->midPos;
-					} else if (targetLOSState & LOS_INRADAR) {
-						targPos = targetUnit->midPos + (targetUnit->posErrorVector * radarhandler->radarErrorSize[attacker->allyteam]);
-						targetPriority *= 10.0f;
-					} else {
+					if (ti->isUnderWater && !weapon->weaponDef->waterweapon) {
 						continue;
 					}
 
-					const float modRange = radius + (aHeight - targPos.y) * heightMod;
+					const float targetPriority = (ti->losState & LOS_INLOS)? 1.0f: 10.0f;
+					AddTargetCandidate(weapon, targetUnit, order++, targetPriority, ti->pos, ti->losState);
+				}
+			}
+		}
+	} else {
+		for (const int* qi = &targetQuads[0]; qi != endQuad; ++qi) {
+			for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+				if (teamHandler->Ally(attacker->allyteam, t)) {
+					continue;
+				}
 
-					if ((pos - targPos).SqLength2D() <= modRange * modRange) {
-						const float dist2D = (pos - targPos).Length2D();
-						const float rangeMul = (dist2D * weapon->weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-						const float damageMul = weapon->weaponDef->damages[targetUnit->armorType] * targetUnit->curArmorMultiple;
+				const std::vector<CUnit*>& allyTeamUnits = qf->GetQuad(*qi).teamUnits[t];
 
-						targetPriority *= rangeMul;
+				for (UnitIt ui = allyTeamUnits.rbegin(); ui != allyTeamUnits.rend(); ++ui) {
+					CUnit* targetUnit = *ui;
+					float targetPriority = 1.0f;
 
-						if (targetLOSState & LOS_INLOS) {
-							targetPriority *= (secDamage + targetUnit->health);
+					// the call-in can use synced random numbers just like the
+					// scoring does, so keep the calls in their original order
+					ScoreWeaponTargets(weapon, lastTargetUnit, targets);
 
-							if (targetUnit == lastTargetUnit) {
-								targetPriority *= weapon->avoidTarget ? 10.0f : 0.4f;
-							}
+					if (luaRules->AllowWeaponTarget(attacker->id, targetUnit->id, weapon->weaponNum, weapon->weaponDef->id, &targetPriority)) {
+						targets.push_back(WeaponTarget(targetPriority, order++, targetUnit));
+						continue;
+					}
 
-							if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health)) {
-								targetPriority *= 4.0f;
-							}
+					if (targetUnit->tempNum != tempNum && (targetUnit->category & weapon->onlyTargetCategory)) {
+						targetUnit->tempNum = tempNum;
 
-							if (weapon->hasTargetWeight) {
-								targetPriority *= weapon->TargetWeight(targetUnit);
-							}
-						} else {
-							targetPriority *= (secDamage + 10000.0f);
+						if (targetUnit->isUnderWater && !weapon->weaponDef->waterweapon) {
+							continue;
+						}
+						if (targetUnit->isDead) {
+							continue;
 						}
 
-						if (targetLOSState & LOS_PREVLOS) {
-							targetPriority /= (damageMul * targetUnit->power * (0.7f + gs->randFloat() * 0.6f));
+						float3 targPos;
+						const unsigned short targetLOSState = targetUnit->losStatus[attacker->allyteam];
 
-							if (targetUnit->category & weapon->badTargetCategory) {
-								targetPriority *= 100.0f;
-							}
-							if (targetUnit->crashing) {
-								targetPriority *= 1000.0f;
-							}
+						if (targetLOSState & LOS_INLOS) {
+							targPos = targetUnit->midPos;
+						} else if (targetLOSState & LOS_INRADAR) {
+							targPos = targetUnit->midPos + (targetUnit->posErrorVector * radarErrorSize);
+							targetPriority *= 10.0f;
+						} else {
+							continue;
 						}
 
-						targets.insert(std::pair<float, CUnit*>(targetPriority, targetUnit));
+						AddTargetCandidate(weapon, targetUnit, order++, targetPriority, targPos, targetLOSState);
 					}
 				}
 			}
 		}
 	}
 
+	ScoreWeaponTargets(weapon, lastTargetUnit, targets);
+
 #ifdef TRACE_SYNC
 	{
 		tracefile << "[GenerateWeaponTargets] attackerID, attackRadius: " << attacker->id << ", " << radius << " ";
 
-		for (std::multimap<float, CUnit*>::const_iterator ti = targets.begin(); ti != targets.end(); ++ti)
-			tracefile << "\tpriority: " << (ti->first) <<  ", targetID: " << (ti->second)->id <<  " ";
+		std::vector<WeaponTarget> sortedTargets(targets);
+		std::sort(sortedTargets.begin(), sortedTargets.end());
+
+		for (std::vector<WeaponTarget>::const_iterator ti = sortedTargets.begin(); ti != sortedTargets.end(); ++ti)
+			tracefile << "\tpriority: " << (ti->priority) <<  ", targetID: " << (ti->unit)->id <<  " ";
 
 		tracefile << "\n";
 	}
 #endif
 }
 
+void CGameHelper::AddTargetCandidate(const CWeapon* weapon, CUnit* unit, int order, float priority, const float3& pos, unsigned short losState)
+{
+	WeaponTargetCandidates& cands = targetCandidates;
+
+	cands.units.push_back(unit);
+	cands.orders.push_back(order);
+	cands.priorities.push_back(priority);
+	cands.posX.push_back(pos.x);
+	cands.posY.push_back(pos.y);
+	cands.posZ.push_back(pos.z);
+	cands.losStates.push_back(losState);
+	cands.damageMuls.push_back(weapon->weaponDef->damages[unit->armorType] * unit->curArmorMultiple);
+	cands.powers.push_back(unit->power);
+}
+
+const std::vector<CGameHelper::CachedTarget>& CGameHelper::GetQuadTargets(int allyTeam, int quad)
+{
+	const int numQuads = qf->GetNumQuadsX() * qf->GetNumQuadsZ();
+
+	if (quadVersions.empty()) {
+		quadVersions.resize(numQuads, 0);
+		quadTargets.resize(numQuads * teamHandler->ActiveAllyTeams());
+	}
+
+	QuadTargets& qt = quadTargets[allyTeam * numQuads + quad];
+	const float radarErrorSize = radarhandler->radarErrorSize[allyTeam];
+
+	if (qt.frameNum == gs->frameNum && qt.version == quadVersions[quad] && qt.radarErrorSize == radarErrorSize) {
+		++targetCacheStats.hits;
+		++targetCacheStats.frameHits;
+		return qt.targets;
+	}
+
+	const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+	qt.frameNum = gs->frameNum;
+	qt.version = quadVersions[quad];
+	qt.radarErrorSize = radarErrorSize;
+	qt.targets.clear();
+
+	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+		if (teamHandler->Ally(allyTeam, t)) {
+			continue;
+		}
+
+		const std::vector<CUnit*>& allyTeamUnits = qf->GetQuad(quad).teamUnits[t];
+
+		for (std::vector<CUnit*>::const_reverse_iterator ui = allyTeamUnits.rbegin(); ui != allyTeamUnits.rend(); ++ui) {
+			CUnit* unit = *ui;
+			const unsigned short losState = unit->losStatus[allyTeam];
+
+			if (unit->isDead || !(losState & (LOS_INLOS | LOS_INRADAR))) {
+				continue;
+			}
+
+			CachedTarget ct;
+			ct.unit = unit;
+			ct.losState = losState;
+			ct.category = unit->category;
+			ct.isUnderWater = unit->isUnderWater;
+
+			if (losState & LOS_INLOS) {
+				ct.pos = unit->midPos;
+			} else {
+				ct.pos = unit->midPos + (unit->posErrorVector * radarErrorSize);
+			}
+
+			qt.targets.push_back(ct);
+		}
+	}
+
+	const boost::posix_time::time_duration fillTime = boost::posix_time::microsec_clock::universal_time() - startTime;
+
+	++targetCacheStats.misses;
+	targetCacheStats.fillTime += fillTime.total_microseconds() * 0.001f;
+	targetCacheStats.fillTimeLeft += fillTime.total_microseconds() * 0.001f;
+
+	return qt.targets;
+}
+
+void CGameHelper::InvalidateTargetCache(const CUnit* unit)
+{
+	for (std::vector<int>::const_iterator qi = unit->quads.begin(); qi != unit->quads.end(); ++qi) {
+		if (!quadVersions.empty()) {
+			++quadVersions[*qi];
+		}
+	}
+}
+
+void CGameHelper::ScoreWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets)
+{
+	WeaponTargetCandidates& cands = targetCandidates;
+	const int numCands = cands.units.size();
+
+	if (numCands == 0) {
+		return;
+	}
+
+	const float radius    = weapon->range;
+	const float3& pos     = weapon->owner->pos;
+	const float heightMod = weapon->heightMod;
+	const float aHeight   = weapon->weaponPos.y;
+	const float proximityPriority = weapon->weaponDef->proximityPriority;
+
+	// how much damage the weapon deals over 1 second
+	const float secDamage = weapon->weaponDef->damages[0] * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
+	const bool paralyzer  = !!weapon->weaponDef->damages.paralyzeDamageTime;
+
+	cands.rangeMuls.resize(numCands);
+	cands.inRange.resize(numCands);
+
+	// range test, without side effects or branches
+	for (int i = 0; i < numCands; ++i) {
+		const float modRange = radius + (aHeight - cands.posY[i]) * heightMod;
+		const float dx = pos.x - cands.posX[i];
+		const float dz = pos.z - cands.posZ[i];
+		const float sqDist2D = dx * dx + dz * dz;
+
+		cands.inRange[i] = (sqDist2D <= modRange * modRange);
+		cands.rangeMuls[i] = (math::sqrt(sqDist2D) * proximityPriority + modRange * 0.4f + 100.0f);
+	}
+
+	// everything else, in the original order (this uses synced random numbers)
+	for (int i = 0; i < numCands; ++i) {
+		if (!cands.inRange[i]) {
+			continue;
+		}
+
+		CUnit* targetUnit = cands.units[i];
+		const unsigned short targetLOSState = cands.losStates[i];
+		float targetPriority = cands.priorities[i] * cands.rangeMuls[i];
+
+		if (targetLOSState & LOS_INLOS) {
+			targetPriority *= (secDamage + targetUnit->health);
+
+			if (targetUnit == lastTargetUnit) {
+				targetPriority *= weapon->avoidTarget ? 10.0f : 0.4f;
+			}
+
+			if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health)) {
+				targetPriority *= 4.0f;
+			}
+
+			if (weapon->hasTargetWeight) {
+				targetPriority *= weapon->TargetWeight(targetUnit);
+			}
+		} else {
+			targetPriority *= (secDamage + 10000.0f);
+		}
+
+		if (targetLOSState & LOS_PREVLOS) {
+			targetPriority /= (cands.damageMuls[i] * cands.powers[i] * (0.7f + gs->randFloat() * 0.6f));
+
+			if (targetUnit->category & weapon->badTargetCategory) {
+				targetPriority *= 100.0f;
+			}
+			if (targetUnit->crashing) {
+				targetPriority *= 1000.0f;
+			}
+		}
+
+		targets.push_back(WeaponTarget(targetPriority, cands.orders[i], targetUnit));
+	}
+
+	cands.clear();
+}
+
 CUnit* CGameHelper::GetClosestUnit(const float3 &pos, float searchRadius)
 {
 	Query::ClosestUnit_ErrorPos_NOT_SYNCED q(pos, searchRadius);
@@ -949,6 +1122,33 @@ float3 CGameHelper::ClosestBuildSite(int team, const UnitDef* unitDef, float3 po
 
 void CGameHelper::Update()
 {
+	{
+		TargetCacheStats& stats = targetCacheStats;
+
+		if (stats.misses > 0) {
+			// a hit saves about as much as the average miss costs
+			stats.savedTimeLeft += stats.frameHits * (stats.fillTime / stats.misses);
+		}
+		stats.frameHits = 0;
+
+		const unsigned int fillTime = (unsigned int) stats.fillTimeLeft;
+		const unsigned int savedTime = (unsigned int) stats.savedTimeLeft;
+		profiler.AddTime("Weapon target cache fill", fillTime);
+		profiler.AddTime("Weapon target cache saved (est.)", savedTime);
+		stats.fillTimeLeft -= fillTime;
+		stats.savedTimeLeft -= savedTime;
+
+		if ((gs->frameNum % (GAME_SPEED * 60)) == 0 && stats.misses > 0) {
+			logOutput.Print(LOG_TARGETCACHE, "hit rate %.1f%% (%u hits, %u misses, %.1f ms filling)",
+					(100.0f * stats.hits) / (stats.hits + stats.misses),
+					stats.hits, stats.misses, stats.fillTime);
+
+			stats.hits = 0;
+			stats.misses = 0;
+			stats.fillTime = 0.0f;
+		}
+	}
+
 	std::list<WaitingDamage*>* wd = &waitingDamages[gs->frameNum&127];
 	while (!wd->empty()) {
 		WaitingDamage* w = wd->back();
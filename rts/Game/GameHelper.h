@@ -50,8 +50,27 @@ public:
 	 */
 	float3 ClosestBuildSite(int team, const UnitDef* unitDef, float3 pos, float searchRadius, int minDist, int facing = 0);
 
+	struct WeaponTarget {
+		WeaponTarget(float priority, int order, CUnit* unit): priority(priority), order(order), unit(unit) {}
+
+		/// lower priority values are better targets
+		bool operator < (const WeaponTarget& t) const {
+			return (priority < t.priority) || (priority == t.priority && order < t.order);
+		}
+
+		float priority;
+		int order; ///< breaks ties between equal priorities, in the order the targets were found
+		CUnit* unit;
+	};
+
 	void Update();
-	void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::multimap<float, CUnit*>& targets);
+	/**
+	 * Fills @c targets with the units @c weapon could auto-target, unsorted;
+	 * sorting them with WeaponTarget::operator< puts the best ones first.
+	 */
+	void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets);
+	/// call when anything GenerateWeaponTargets caches about @c unit changes
+	void InvalidateTargetCache(const CUnit* unit);
 	void DoExplosionDamage(CUnit* unit, const float3& expPos, float expRad, float expSpeed, bool ignoreOwner, CUnit* owner, float edgeEffectiveness, const DamageArray& damages, int weaponId);
 	void DoExplosionDamage(CFeature* feature, const float3& expPos, float expRad, const DamageArray& damages);
 	void Explosion(float3 pos, const DamageArray& damages, float radius, float edgeEffectiveness, float explosionSpeed, CUnit* owner, bool damageGround, float gfxMod, bool ignoreOwner, bool impactOnly, IExplosionGenerator* explosionGraphics, CUnit* hit, const float3& impactDir, int weaponId, CFeature* hitfeature = NULL);
@@ -62,8 +81,86 @@ public:
 	};
 
 private:
+	/// scores targetCandidates, appends those in range to @c targets and clears them
+	void ScoreWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets);
+	void AddTargetCandidate(const CWeapon* weapon, CUnit* unit, int order, float priority, const float3& pos, unsigned short losState);
+
+	/// an enemy unit in a quad that can be seen by an allyteam
+	struct CachedTarget {
+		CUnit* unit;
+		float3 pos; ///< including radar error
+		unsigned short losState;
+		unsigned int category;
+		bool isUnderWater;
+	};
+
+	struct QuadTargets {
+		QuadTargets(): frameNum(-1), version(0), radarErrorSize(0.0f) {}
+
+		int frameNum;
+		unsigned int version;
+		float radarErrorSize;
+		std::vector<CachedTarget> targets;
+	};
+
+	/**
+	 * Returns the enemy units in a quad that are visible to an allyteam,
+	 * in the order GenerateWeaponTargets would find them. The lists are
+	 * shared by all weapons of the allyteam during a frame, until one of
+	 * the units in the quad moves, dies or changes its LOS state.
+	 */
+	const std::vector<CachedTarget>& GetQuadTargets(int allyTeam, int quad);
+
 	CStdExplosionGenerator* stdExplosionGenerator;
 
+	/**
+	 * Units GenerateWeaponTargets found, before the range test and scoring.
+	 * Kept as separate arrays, so the range test is a tight loop, and
+	 * between calls, so they are not reallocated for every weapon.
+	 */
+	struct WeaponTargetCandidates {
+		void clear() {
+			units.clear(); orders.clear(); priorities.clear();
+			posX.clear(); posY.clear(); posZ.clear();
+			losStates.clear(); damageMuls.clear(); powers.clear();
+		}
+
+		std::vector<CUnit*> units;
+		std::vector<int> orders;
+		std::vector<float> priorities; ///< before range and damage factors
+		std::vector<float> posX, posY, posZ; ///< including radar error
+		std::vector<unsigned short> losStates;
+		std::vector<float> damageMuls; ///< weapon damage times armor multiplier
+		std::vector<float> powers;
+
+		/// results of the range test
+		std::vector<float> rangeMuls;
+		std::vector<unsigned char> inRange;
+	};
+
+	WeaponTargetCandidates targetCandidates;
+	std::vector<int> targetQuads; ///< GetQuads() output buffer, sized for the whole map
+
+	std::vector<QuadTargets> quadTargets; ///< per allyteam and quad
+	std::vector<unsigned int> quadVersions; ///< per quad, increased on each invalidation
+
+	/// reported by Update(), times are in ms
+	struct TargetCacheStats {
+		TargetCacheStats(): hits(0), misses(0), fillTime(0.0f), frameHits(0), fillTimeLeft(0.0f), savedTimeLeft(0.0f) {}
+
+		/// since the last hit rate message
+		unsigned int hits;
+		unsigned int misses;
+		float fillTime;
+
+		unsigned int frameHits;
+		/// not reported to the profiler yet, it only takes whole ms
+		float fillTimeLeft;
+		float savedTimeLeft;
+	};
+
+	TargetCacheStats targetCacheStats;
+
 	struct WaitingDamage{
 #if !defined(SYNCIFY) && !defined(USE_MMGR)
 		inline void* operator new(size_t size) {
@@ -123,6 +123,7 @@ CGameServer::CGameServer(const std::string& hostIP, int hostPort, const GameData
 	quitServer=false;
 	hasLocalClient = false;
 	localClientNumber = 0;
+	fastReplay = false;
 	isPaused = false;
 	userSpeedFactor = 1.0f;
 	internalSpeed = 1.0f;
@@ -195,6 +196,7 @@ CGameServer::CGameServer(const std::string& hostIP, int hostPort, const GameData
 	if (setup->hostDemo) {
 		Message(str(format(PlayingDemo) %setup->demoName));
 		demoReader.reset(new CDemoReader(setup->demoName, modGameTime + 0.1f));
+		fastReplay = setup->fastReplay;
 	}
 
 	players.resize(setup->playerStartingData.size());
@@ -694,7 +696,12 @@ void CGameServer::Update()
 	float tdif = float(spring_tomsecs(spring_gettime() - lastUpdate)) * 0.001f;
 	gameTime += tdif;
 	if (!isPaused && gameHasStarted) {
-		if (!demoReader || !hasLocalClient || (serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED)
+		if (fastReplay && demoReader && hasLocalClient) {
+			// no wall-clock pacing, just stay a second ahead of the local client
+			if ((serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED)
+				modGameTime = std::max(modGameTime, demoReader->GetNextDemoReadTime() + 0.001f);
+		}
+		else if (!demoReader || !hasLocalClient || (serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED)
 			modGameTime += tdif * internalSpeed;
 	}
 	lastUpdate = spring_gettime();
@@ -1952,6 +1959,12 @@ bool CGameServer::HasFinished() const
 	return quitServer;
 }
 
+bool CGameServer::HasDemoEnded() const
+{
+	boost::recursive_mutex::scoped_lock scoped_lock(gameServerMutex);
+	return (setup->hostDemo && !demoReader);
+}
+
 void CGameServer::CreateNewFrame(bool fromServerThread, bool fixedFrameTime)
 {
 	if (!demoReader) {
@@ -2045,7 +2058,9 @@ void CGameServer::UpdateSpeedControl(int speedCtrl) {
 void CGameServer::UpdateLoop()
 {
 	while (!quitServer) {
-		spring_sleep(spring_msecs(10));
+		// the local client paces a fast replay, keep the latency low
+		// there, but never spin: every pass takes gameServerMutex
+		spring_sleep(spring_msecs(fastReplay ? 1 : 10));
 
 		if (UDPNet)
 			UDPNet->Update();
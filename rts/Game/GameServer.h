@@ -84,6 +84,8 @@ public:
 	bool HasGameID() const { return generatedGameID; }
 	/// Is the server still running?
 	bool HasFinished() const;
+	/// Has the demo we are playing been sent completely?
+	bool HasDemoEnded() const;
 
 	void UpdateSpeedControl(int speedCtrl);
 
@@ -214,6 +216,9 @@ private:
 	bool hasLocalClient;
 	unsigned localClientNumber;
 
+	/// Feed the demo as fast as the local client can simulate it (GameSetup::fastReplay)
+	bool fastReplay;
+
 	/// If the server receives a command, it will forward it to clients if it is not in this set
 	std::set<std::string> commandBlacklist;
 
@@ -38,6 +38,7 @@ CGameSetup::CGameSetup()
 	, minSpeed(0.0f)
 	, onlyLocal(false)
 	, hostDemo(false)
+	, fastReplay(false)
 	, numDemoPlayers(0)
 	, gameStartDelay(0)
 	, noHelperAIs(0)
@@ -392,6 +393,7 @@ bool CGameSetup::Init(const std::string& buf)
 	file.GetTDef(gameStartDelay, (unsigned int) 4, "GAME\\GameStartDelay");
 
 	file.GetDef(onlyLocal,        "0", "GAME\\OnlyLocal");
+	file.GetDef(fastReplay,       "0", "GAME\\FastReplay");
 	file.GetDef(useLuaGaia,       "1", "GAME\\ModOptions\\LuaGaia");
 	file.GetDef(noHelperAIs,      "0", "GAME\\ModOptions\\NoHelperAIs");
 	file.GetDef(maxUnits,       "1500", "GAME\\ModOptions\\MaxUnits");
@@ -80,6 +80,8 @@ public:
 
 	bool hostDemo;
 	std::string demoName;
+	/** if true (and hostDemo), replay the demo as fast as possible, see CFastReplay */
+	bool fastReplay;
 	int numDemoPlayers;
 
 	std::string saveName;
@@ -27,6 +27,7 @@
 #include "System/LogOutput.h"
 #include "System/NetProtocol.h"
 #include "System/FileSystem/FileHandler.h"
+#include "System/Platform/Threading.h"
 #include "System/Platform/Watchdog.h"
 #include "System/Sound/ISound.h"
 #include "System/Sound/SoundChannels.h"
@@ -286,6 +287,23 @@ bool CLoadScreen::Draw()
 		font->glPrint(0.1f,0.9f - posy * globalRendering->pixelY,   globalRendering->viewSizeY / 35.0f, FONT_NORM,
 			curLoadMessage);
 
+		if (!workerLoadMessages.empty()) {
+			std::string workerMessages;
+			std::map<boost::thread::id, std::string>::const_iterator wi;
+			for (wi = workerLoadMessages.begin(); wi != workerLoadMessages.end(); ++wi) {
+				workerMessages += "\n" + wi->second;
+			}
+
+			posy += font->GetTextNumLines(curLoadMessage) * font->GetLineHeight() * globalRendering->viewSizeY / 35.0f;
+			font->glPrint(0.1f,0.9f - posy * globalRendering->pixelY,   globalRendering->viewSizeY / 35.0f, FONT_NORM,
+				workerMessages.substr(1));
+		}
+
+
+		font->SetTextColor(0.5f,0.5f,0.5f,0.9f);
+		font->glPrint(0.9f,0.9f,   globalRendering->viewSizeY / 50.0f, FONT_RIGHT | FONT_NORM,
+			stageTimes);
+
 
 		font->SetOutlineColor(0.0f,0.0f,0.0f,0.65f);
 		font->SetTextColor(1.0f,1.0f,1.0f,1.0f);
@@ -316,14 +334,27 @@ void CLoadScreen::SetLoadMessage(const std::string& text, bool replace_lastline)
 
 	boost::recursive_mutex::scoped_lock lck(mutex);
 
-	if (!replace_lastline) {
-		if (oldLoadMessages.empty()) {
-			oldLoadMessages = curLoadMessage;
-		} else {
-			oldLoadMessages += "\n" + curLoadMessage;
+	if (loadThread != boost::thread::id() && boost::this_thread::get_id() != loadThread) {
+		//! a threaded stage must not replace the line of the loading thread
+		std::string& workerMessage = workerLoadMessages[boost::this_thread::get_id()];
+
+		if (!replace_lastline && !workerMessage.empty()) {
+			if (!oldLoadMessages.empty()) {
+				oldLoadMessages += "\n";
+			}
+			oldLoadMessages += workerMessage;
 		}
+		workerMessage = text;
+	} else {
+		if (!replace_lastline) {
+			if (oldLoadMessages.empty()) {
+				oldLoadMessages = curLoadMessage;
+			} else {
+				oldLoadMessages += "\n" + curLoadMessage;
+			}
+		}
+		curLoadMessage = text;
 	}
-	curLoadMessage = text;
 
 	logOutput.Print(text);
 	logOutput.Flush();
@@ -333,11 +364,45 @@ void CLoadScreen::SetLoadMessage(const std::string& text, bool replace_lastline)
 	//! Here it is done for the loading thread, for the mainthread it is done in CLoadScreen::Update()
 	good_fpu_control_registers(curLoadMessage.c_str());
 
-	if (!mt_loading)
+	//! threaded loading stages must not draw
+	if (!mt_loading && Threading::IsMainThread())
 		Draw();
 }
 
 
+void CLoadScreen::SetLoadThread()
+{
+	boost::recursive_mutex::scoped_lock lck(mutex);
+	loadThread = boost::this_thread::get_id();
+}
+
+
+void CLoadScreen::Refresh()
+{
+	//! with mt_loading the main thread is drawing already
+	if (mt_loading || !Threading::IsMainThread())
+		return;
+
+	//! keep the window responsive, the events are handled once loading is done
+	SDL_PumpEvents();
+	Draw();
+}
+
+
+void CLoadScreen::AddStageTime(const std::string& stage, float seconds)
+{
+	boost::recursive_mutex::scoped_lock lck(mutex);
+
+	char buf[32];
+	SNPRINTF(buf, sizeof(buf), ": %.2fs", seconds);
+
+	if (!stageTimes.empty()) {
+		stageTimes += "\n";
+	}
+	stageTimes += stage + buf;
+}
+
+
 /******************************************************************************/
 
 static void AppendStringVec(vector<string>& dst, const vector<string>& src)
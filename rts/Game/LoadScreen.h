@@ -3,6 +3,7 @@
 #ifndef __LOADSCREEN_H__
 #define __LOADSCREEN_H__
 
+#include <map>
 #include <string>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/recursive_mutex.hpp>
@@ -18,6 +19,15 @@ class CLoadScreen : public CGameController
 {
 public:
 	void SetLoadMessage(const std::string& text, bool replace_lastline = false);
+	/// Show how long a loading stage took, can be called from any thread.
+	void AddStageTime(const std::string& stage, float seconds);
+	/**
+	 * Marks the calling thread as the one running the non-threaded loading
+	 * stages; messages of all other threads get a line of their own.
+	 */
+	void SetLoadThread();
+	/// Redraws the screen if loading is single-threaded and this is the main thread.
+	void Refresh();
 
 	CLoadScreen(const std::string& mapName, const std::string& modName, ILoadSaveHandler* saveFile);
 	virtual ~CLoadScreen();
@@ -53,6 +63,11 @@ private:
 
 	std::string oldLoadMessages;
 	std::string curLoadMessage;
+	std::string stageTimes;
+
+	boost::thread::id loadThread;
+	/// last message of each thread running a threaded loading stage
+	std::map<boost::thread::id, std::string> workerLoadMessages;
 
 	std::string mapName;
 	std::string modName;
@@ -0,0 +1,231 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StdAfx.h"
+#include <fstream>
+#include <stdexcept>
+#include <SDL_timer.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "mmgr.h"
+
+#include "LoadTaskGraph.h"
+
+#include "LoadScreen.h"
+#include "FileSystem/FileSystem.h"
+#include "Platform/Watchdog.h"
+#include "Exceptions.h"
+#include "LogOutput.h"
+#include "lib/streflop/streflop_cond.h"
+
+CLoadTaskGraph::CLoadTaskGraph()
+	: numDone(0)
+	, numRunning(0)
+	, stopping(false)
+	, startTime(0)
+	, endTime(0)
+	, errorType(ERROR_NONE)
+{
+}
+
+CLoadTaskGraph::~CLoadTaskGraph()
+{
+}
+
+int CLoadTaskGraph::AddTask(const std::string& name, const boost::function<void()>& func, bool threaded)
+{
+	tasks.push_back(Task());
+	tasks.back().name = name;
+	tasks.back().func = func;
+	tasks.back().threaded = threaded;
+	return tasks.size() - 1;
+}
+
+void CLoadTaskGraph::AddDependency(int task, int dependency)
+{
+	assert(dependency < task); // keeps the graph acyclic
+	tasks[task].deps.push_back(dependency);
+}
+
+int CLoadTaskGraph::GetReadyTask(bool threaded) const
+{
+	for (unsigned int t = 0; t < tasks.size(); ++t) {
+		const Task& task = tasks[t];
+
+		if (task.started || task.threaded != threaded)
+			continue;
+
+		bool ready = true;
+		for (std::vector<int>::const_iterator d = task.deps.begin(); d != task.deps.end() && ready; ++d)
+			ready = tasks[*d].done;
+
+		if (ready)
+			return t;
+	}
+
+	return -1;
+}
+
+void CLoadTaskGraph::RunTask(int taskIdx)
+{
+	Task& task = tasks[taskIdx];
+
+	ErrorType error = ERROR_NONE;
+	std::string what;
+
+	task.startTime = SDL_GetTicks();
+
+	try {
+		task.func();
+	} catch (const content_error& e) {
+		error = ERROR_CONTENT; what = e.what();
+	} catch (const opengl_error& e) {
+		error = ERROR_OPENGL; what = e.what();
+	} catch (const std::exception& e) {
+		error = ERROR_RUNTIME; what = e.what();
+	}
+
+	task.endTime = SDL_GetTicks();
+
+	if (error == ERROR_NONE)
+		loadscreen->AddStageTime(task.name, (task.endTime - task.startTime) * 0.001f);
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	if (error != ERROR_NONE) {
+		if (errorType == ERROR_NONE) {
+			errorType = error;
+			errorMsg = what;
+		}
+		stopping = true;
+	}
+
+	task.done = true;
+	++numDone;
+	--numRunning;
+	cond.notify_all();
+}
+
+void CLoadTaskGraph::WorkerThread()
+{
+#ifdef STREFLOP_H
+	//! threaded stages may do synced computations too
+	streflop_init<streflop::Simple>();
+#endif
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	while (!stopping) {
+		const int taskIdx = GetReadyTask(true);
+
+		if (taskIdx < 0) {
+			cond.wait(lock);
+			continue;
+		}
+
+		tasks[taskIdx].started = true;
+		++numRunning;
+
+		lock.unlock();
+		RunTask(taskIdx);
+		lock.lock();
+	}
+}
+
+void CLoadTaskGraph::Run(const volatile bool* abort)
+{
+	startTime = SDL_GetTicks();
+
+	unsigned int numThreaded = 0;
+	for (std::vector<Task>::const_iterator t = tasks.begin(); t != tasks.end(); ++t)
+		numThreaded += t->threaded;
+
+	boost::thread_group workers;
+	for (unsigned int i = 0; i < numThreaded; ++i)
+		workers.create_thread(boost::bind(&CLoadTaskGraph::WorkerThread, this));
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while (numDone < tasks.size()) {
+			if (abort != NULL && *abort)
+				stopping = true;
+
+			if (stopping) {
+				if (numRunning == 0)
+					break;
+			} else {
+				const int taskIdx = GetReadyTask(false);
+
+				if (taskIdx >= 0) {
+					tasks[taskIdx].started = true;
+					++numRunning;
+
+					lock.unlock();
+					RunTask(taskIdx);
+					lock.lock();
+					continue;
+				}
+			}
+
+			//! waiting for a threaded stage, which might take a while;
+			//! with single-threaded loading nobody else draws the screen
+			cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+
+			lock.unlock();
+			loadscreen->Refresh();
+			lock.lock();
+
+			Watchdog::ClearTimer();
+		}
+
+		stopping = true;
+		cond.notify_all();
+	}
+
+	workers.join_all();
+
+	endTime = SDL_GetTicks();
+
+	switch (errorType) {
+		case ERROR_NONE:    break;
+		case ERROR_CONTENT: throw content_error(errorMsg);
+		case ERROR_OPENGL:  throw opengl_error(errorMsg);
+		case ERROR_RUNTIME: throw std::runtime_error(errorMsg);
+	}
+}
+
+void CLoadTaskGraph::WriteProfile(const std::string& fileName) const
+{
+	std::ofstream file(filesystem.LocateFile(fileName, FileSystem::WRITE).c_str());
+
+	if (!file.is_open()) {
+		logOutput.Print("Could not write load profile to %s", fileName.c_str());
+		return;
+	}
+
+	file << "{\"wallTime\": " << ((endTime - startTime) * 0.001f)
+	     << ", \"stages\": [";
+
+	bool first = true;
+	for (unsigned int t = 0; t < tasks.size(); ++t) {
+		const Task& task = tasks[t];
+
+		if (!task.done)
+			continue;
+
+		file << (first ? "" : ", ")
+		     << "{\"name\": \"" << task.name << "\""
+		     << ", \"threaded\": " << (task.threaded ? "true" : "false")
+		     << ", \"start\": " << ((task.startTime - startTime) * 0.001f)
+		     << ", \"time\": " << ((task.endTime - task.startTime) * 0.001f)
+		     << ", \"deps\": [";
+
+		for (unsigned int d = 0; d < task.deps.size(); ++d)
+			file << ((d == 0) ? "" : ", ") << "\"" << tasks[task.deps[d]].name << "\"";
+
+		file << "]}";
+		first = false;
+	}
+
+	file << "]}" << std::endl;
+}
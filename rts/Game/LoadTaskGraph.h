@@ -0,0 +1,86 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef __LOAD_TASK_GRAPH_H__
+#define __LOAD_TASK_GRAPH_H__
+
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+ * Runs the stages of game loading as a dependency graph.
+ *
+ * Threaded stages run on worker threads as soon as all stages they depend
+ * on are done. All other stages run, in the order they were added, on the
+ * thread calling Run(), which owns the GL context (if there is one).
+ * A stage may only be threaded if it does not touch GL and does not race
+ * with any stage it does not depend on.
+ */
+class CLoadTaskGraph
+{
+public:
+	CLoadTaskGraph();
+	~CLoadTaskGraph();
+
+	/// returns the id of the new stage, for AddDependency()
+	int AddTask(const std::string& name, const boost::function<void()>& func, bool threaded = false);
+	/// <task> will not be started before <dependency> is done
+	void AddDependency(int task, int dependency);
+
+	/**
+	 * Runs all stages and waits for them to finish.
+	 * No new stages are started once a stage failed or <*abort> is set;
+	 * the error of the first failed stage is re-thrown.
+	 * While waiting for threaded stages, CLoadScreen::Refresh() is called
+	 * regularly.
+	 */
+	void Run(const volatile bool* abort = NULL);
+
+	/// write the stage timings of the last Run() as a JSON object
+	void WriteProfile(const std::string& fileName) const;
+
+private:
+	struct Task {
+		Task(): threaded(false), started(false), done(false), startTime(0), endTime(0) {}
+
+		std::string name;
+		boost::function<void()> func;
+		std::vector<int> deps;
+		bool threaded;
+		bool started;
+		bool done;
+		unsigned startTime;
+		unsigned endTime;
+	};
+
+	enum ErrorType {
+		ERROR_NONE,
+		ERROR_CONTENT,
+		ERROR_OPENGL,
+		ERROR_RUNTIME
+	};
+
+	/// returns -1 if no stage of the given kind can be started now
+	int GetReadyTask(bool threaded) const;
+	void RunTask(int taskIdx);
+	void WorkerThread();
+
+	std::vector<Task> tasks;
+
+	unsigned int numDone;
+	unsigned int numRunning;
+	bool stopping;
+
+	unsigned startTime;
+	unsigned endTime;
+
+	ErrorType errorType;
+	std::string errorMsg;
+
+	boost::mutex mutex;
+	boost::condition_variable cond;
+};
+
+#endif // __LOAD_TASK_GRAPH_H__
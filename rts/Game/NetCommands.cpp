@@ -84,6 +84,10 @@ void CGame::ClientReadNet()
 		// make sure ClientReadNet returns at least every 15 game frames
 		// so CGame can process keyboard input, and render etc.
 		timeLeft = GAME_SPEED/float(gu->minFPS) * gs->userSpeedFactor;
+
+		// a fast replay only returns for the 500ms limit below
+		if (fastReplay)
+			timeLeft = GAME_SPEED * 500;
 	}
 
 	// always render at least 2FPS (will otherwise be highly unresponsive when catching up after a reconnection)
@@ -81,12 +81,12 @@ void CPreGame::LoadSetupscript(const std::string& script)
 	StartServer(script);
 }
 
-void CPreGame::LoadDemo(const std::string& demo)
+void CPreGame::LoadDemo(const std::string& demo, bool fastReplay)
 {
 	assert(settings->isHost);
 	if (!configHandler->Get("DemoFromDemo", false))
 		net->DisableDemoRecording();
-	ReadDataFromDemo(demo);
+	ReadDataFromDemo(demo, fastReplay);
 }
 
 void CPreGame::LoadSavefile(const std::string& save)
@@ -289,7 +289,7 @@ void CPreGame::UpdateClientNet()
 	}
 }
 
-void CPreGame::ReadDataFromDemo(const std::string& demoName)
+void CPreGame::ReadDataFromDemo(const std::string& demoName, bool fastReplay)
 {
 	ScopedOnceTimer startserver("Reading demo data");
 	assert(!gameServer);
@@ -322,6 +322,8 @@ void CPreGame::ReadDataFromDemo(const std::string& demoName)
 			tgame->AddPair("Gametype", demoScript->modName);
 			tgame->AddPair("Demofile", demoName);
 			tgame->AddPair("OnlyLocal", 1);
+			if (fastReplay)
+				tgame->AddPair("FastReplay", 1);
 
 			for (std::map<std::string, TdfParser::TdfSection*>::iterator it = tgame->sections.begin(); it != tgame->sections.end(); ++it)
 			{
@@ -39,7 +39,8 @@ public:
 	virtual ~CPreGame();
 	
 	void LoadSetupscript(const std::string& script);
-	void LoadDemo(const std::string& demo);
+	/// @param fastReplay replay as fast as possible instead of in real time
+	void LoadDemo(const std::string& demo, bool fastReplay = false);
 	void LoadSavefile(const std::string& save);
 
 	bool Draw();
@@ -50,7 +51,7 @@ private:
 	void StartServer(const std::string& setupscript);
 	
 	/// reads out map, mod and script from demos (with or without a gameSetupScript)
-	void ReadDataFromDemo(const std::string& demoName);
+	void ReadDataFromDemo(const std::string& demoName, bool fastReplay);
 
 	/// receive network traffic
 	void UpdateClientNet();
@@ -132,7 +132,7 @@ float TraceRay(const float3& start, const float3& dir, float length, int collisi
 			for (vector<int>::const_iterator qi = quads.begin(); qi != quads.end(); ++qi) {
 				const CQuadField::Quad& quad = qf->GetQuad(*qi);
 
-				for (std::list<CFeature*>::const_iterator ui = quad.features.begin(); ui != quad.features.end(); ++ui) {
+				for (std::vector<CFeature*>::const_reverse_iterator ui = quad.features.rbegin(); ui != quad.features.rend(); ++ui) {
 					CFeature* f = *ui;
 
 					if (!f->blocking || !f->collisionVolume) {
@@ -159,7 +159,7 @@ float TraceRay(const float3& start, const float3& dir, float length, int collisi
 			for (vector<int>::const_iterator qi = quads.begin(); qi != quads.end(); ++qi) {
 				const CQuadField::Quad& quad = qf->GetQuad(*qi);
 
-				for (std::list<CUnit*>::const_iterator ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+				for (std::vector<CUnit*>::const_reverse_iterator ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 					CUnit* u = *ui;
 
 					if (u == owner)
@@ -218,14 +218,14 @@ float GuiTraceRay(const float3 &start, const float3 &dir, float length, bool use
 		GML_RECMUTEX_LOCK(quad); //! GuiTraceRay
 
 		const vector<int> &quads = qf->GetQuadsOnRay(start, dir, length);
-		std::list<CUnit*>::const_iterator ui;
-		std::list<CFeature*>::const_iterator fi;
+		std::vector<CUnit*>::const_reverse_iterator ui;
+		std::vector<CFeature*>::const_reverse_iterator fi;
 
 		for (vector<int>::const_iterator qi = quads.begin(); qi != quads.end(); ++qi) {
 			const CQuadField::Quad& quad = qf->GetQuad(*qi);
 
 			//! Unit Intersection
-			for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+			for (ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 				CUnit* unit = *ui;
 				if (unit == exclude) {
 					continue;
@@ -271,7 +271,7 @@ float GuiTraceRay(const float3 &start, const float3 &dir, float length, bool use
 			//! Feature Intersection
 			// NOTE: switch this to custom volumes fully?
 			// (not used for any LOF checks, maybe wasteful)
-			for (fi = quad.features.begin(); fi != quad.features.end(); ++fi) {
+			for (fi = quad.features.rbegin(); fi != quad.features.rend(); ++fi) {
 				CFeature* f = *fi;
 
 				if (!f->collisionVolume) {
@@ -335,7 +335,7 @@ bool LineFeatureCol(const float3& start, const float3& dir, float length)
 	for (std::vector<int>::const_iterator qi = quads.begin(); qi != quads.end(); ++qi) {
 		const CQuadField::Quad& quad = qf->GetQuad(*qi);
 
-		for (std::list<CFeature*>::const_iterator ui = quad.features.begin(); ui != quad.features.end(); ++ui) {
+		for (std::vector<CFeature*>::const_reverse_iterator ui = quad.features.rbegin(); ui != quad.features.rend(); ++ui) {
 			CFeature* f = *ui;
 			CollisionVolume* cv = f->collisionVolume;
 
@@ -363,7 +363,7 @@ bool TestAllyCone(const float3& from, const float3& weaponDir, float length, flo
 
 	for (int* qi = quads; qi != endQuad; ++qi) {
 		const CQuadField::Quad& quad = qf->GetQuad(*qi);
-		for (std::list<CUnit*>::const_iterator ui = quad.teamUnits[allyteam].begin(); ui != quad.teamUnits[allyteam].end(); ++ui) {
+		for (std::vector<CUnit*>::const_reverse_iterator ui = quad.teamUnits[allyteam].rbegin(); ui != quad.teamUnits[allyteam].rend(); ++ui) {
 			CUnit* u = *ui;
 
 			if (u == owner)
@@ -386,7 +386,7 @@ bool TestNeutralCone(const float3& from, const float3& weaponDir, float length,
 	for (int* qi = quads; qi != endQuad; ++qi) {
 		const CQuadField::Quad& quad = qf->GetQuad(*qi);
 
-		for (std::list<CUnit*>::const_iterator ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+		for (std::vector<CUnit*>::const_reverse_iterator ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 			CUnit* u = *ui;
 
 			if (u == owner)
@@ -412,7 +412,7 @@ bool TestTrajectoryAllyCone(const float3& from, const float3& flatdir, float len
 
 	for (int* qi = quads; qi != endQuad; ++qi) {
 		const CQuadField::Quad& quad = qf->GetQuad(*qi);
-		for (std::list<CUnit*>::const_iterator ui = quad.teamUnits[allyteam].begin(); ui != quad.teamUnits[allyteam].end(); ++ui) {
+		for (std::vector<CUnit*>::const_reverse_iterator ui = quad.teamUnits[allyteam].rbegin(); ui != quad.teamUnits[allyteam].rend(); ++ui) {
 			CUnit* u = *ui;
 
 			if (u == owner)
@@ -434,7 +434,7 @@ bool TestTrajectoryNeutralCone(const float3& from, const float3& flatdir, float
 
 	for (int* qi = quads; qi != endQuad; ++qi) {
 		const CQuadField::Quad& quad = qf->GetQuad(*qi);
-		for (std::list<CUnit*>::const_iterator ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+		for (std::vector<CUnit*>::const_reverse_iterator ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 			CUnit* u = *ui;
 
 			if (u == owner)
@@ -43,6 +43,7 @@
 #include "Sim/Units/Scripts/UnitScript.h"
 #include "Sim/Units/Groups/GroupHandler.h"
 #include "Sim/Misc/SmoothHeightMesh.h"
+#include "Sim/Path/IPathManager.h"
 #include "UI/CommandColors.h"
 #include "UI/EndGameBox.h"
 #include "UI/GameInfo.h"
@@ -60,6 +61,7 @@
 #include "UI/ProfileDrawer.h"
 #include "System/ConfigHandler.h"
 #include "System/EventHandler.h"
+#include "System/MemPool.h"
 #include "System/NetProtocol.h"
 #include "System/Input/KeyInput.h"
 #include "System/FileSystem/SimpleParser.h"
@@ -1613,6 +1615,10 @@ bool CGame::ActionPressed(unsigned int key, const Action& action, bool isRepeat)
 			sound->PrintDebugInfo();
 		} else if (action.extra == "profiling") {
 			profiler.PrintProfilingInfo();
+		} else if (action.extra == "pathing") {
+			pathManager->PrintDebugInfo();
+		} else if (action.extra == "mempool") {
+			mempool.PrintDebugInfo();
 		}
 	}
 	else if (cmd == "benchmark-script") {
@@ -42,6 +42,8 @@ void CWordCompletion::Reset()
 	words["/debugdrawai"] = sl;
 	words["/debuginfo sound"] = sl;
 	words["/debuginfo profiling"] = sl;
+	words["/debuginfo pathing"] = sl;
+	words["/debuginfo mempool"] = sl;
 	words["/incguiopacity "] = sl;
 	words["/decguiopacity "] = sl;
 	words["/echo "] = sl;
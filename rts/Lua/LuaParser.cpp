@@ -5,8 +5,12 @@
 #include "LuaParser.h"
 
 #include <algorithm>
+#include <fstream>
+#include <iterator>
 #include <limits.h>
+#include <boost/cstdint.hpp>
 #include <boost/regex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 
 #include "mmgr.h"
 
@@ -18,6 +22,7 @@
 #include "LuaUtils.h"
 
 #include "LogOutput.h"
+#include "FileSystem/CRC.h"
 #include "FileSystem/FileHandler.h"
 #include "FileSystem/VFSHandler.h"
 #include "FileSystem/FileSystem.h"
@@ -27,6 +32,15 @@
 
 LuaParser* LuaParser::currentParser = NULL;
 
+//! loading stages may run parsers on several threads at once,
+//! but the callbacks below only know of one <currentParser>
+static boost::recursive_mutex executeMutex;
+
+//! bump this when changing the serialized format
+static const unsigned int LUAPARSER_CACHE_MAGIC = 0x4C504331; // "LPC1"
+//! deeper tables are most likely cyclic
+static const int LUAPARSER_CACHE_MAX_DEPTH = 64;
+
 
 /******************************************************************************/
 /******************************************************************************/
@@ -183,11 +197,13 @@ bool LuaParser::Execute()
 		return false;
 	}
 
-	currentParser = this;
+	{
+		boost::recursive_mutex::scoped_lock lock(executeMutex);
 
-	error = lua_pcall(L, 0, 1, 0);
-
-	currentParser = NULL;
+		currentParser = this;
+		error = lua_pcall(L, 0, 1, 0);
+		currentParser = NULL;
+	}
 
 	if (error != 0) {
 		errorLog = lua_tostring(L, -1);
@@ -220,6 +236,204 @@ bool LuaParser::Execute()
 }
 
 
+/******************************************************************************/
+//
+//  Root table cache
+//
+//  value: 'n' lua_Number | 's' length chars | 'b' 0/1 | 't' (key value)* 'e'
+//
+
+static bool SerializeValue(lua_State* L, int index, string& data, int depth)
+{
+	switch (lua_type(L, index)) {
+		case LUA_TNUMBER: {
+			const lua_Number n = lua_tonumber(L, index);
+			data += 'n';
+			data.append((const char*) &n, sizeof(n));
+			return true;
+		}
+		case LUA_TSTRING: {
+			size_t len = 0;
+			const char* str = lua_tolstring(L, index, &len);
+			const boost::uint32_t len32 = len;
+			data += 's';
+			data.append((const char*) &len32, sizeof(len32));
+			data.append(str, len);
+			return true;
+		}
+		case LUA_TBOOLEAN: {
+			data += 'b';
+			data += (char) lua_toboolean(L, index);
+			return true;
+		}
+		case LUA_TTABLE: {
+			if ((depth >= LUAPARSER_CACHE_MAX_DEPTH) || !lua_checkstack(L, 3)) {
+				return false;
+			}
+			data += 't';
+			for (lua_pushnil(L); lua_next(L, index) != 0; lua_pop(L, 1)) {
+				const int top = lua_gettop(L);
+				if (lua_type(L, top - 1) == LUA_TTABLE ||
+				    !SerializeValue(L, top - 1, data, depth + 1) ||
+				    !SerializeValue(L, top, data, depth + 1)) {
+					lua_pop(L, 2);
+					return false;
+				}
+			}
+			data += 'e';
+			return true;
+		}
+		default: {
+			// functions, userdata, ...
+			return false;
+		}
+	}
+}
+
+
+static bool DeserializeValue(lua_State* L, const string& data, size_t& pos, int depth)
+{
+	if ((pos >= data.size()) || !lua_checkstack(L, 3)) {
+		return false;
+	}
+
+	switch (data[pos++]) {
+		case 'n': {
+			lua_Number n;
+			if ((data.size() - pos) < sizeof(n)) { return false; }
+			memcpy(&n, &data[pos], sizeof(n));
+			pos += sizeof(n);
+			lua_pushnumber(L, n);
+			return true;
+		}
+		case 's': {
+			boost::uint32_t len;
+			if ((data.size() - pos) < sizeof(len)) { return false; }
+			memcpy(&len, &data[pos], sizeof(len));
+			pos += sizeof(len);
+			if ((data.size() - pos) < len) { return false; }
+			lua_pushlstring(L, &data[pos], len);
+			pos += len;
+			return true;
+		}
+		case 'b': {
+			if (pos >= data.size()) { return false; }
+			lua_pushboolean(L, data[pos++]);
+			return true;
+		}
+		case 't': {
+			if (depth >= LUAPARSER_CACHE_MAX_DEPTH) { return false; }
+			lua_newtable(L);
+			while ((pos < data.size()) && (data[pos] != 'e')) {
+				if (!DeserializeValue(L, data, pos, depth + 1) ||
+				    !DeserializeValue(L, data, pos, depth + 1)) {
+					return false;
+				}
+				lua_rawset(L, -3);
+			}
+			if (pos >= data.size()) { return false; }
+			pos++; // 'e'
+			return true;
+		}
+		default: {
+			return false;
+		}
+	}
+}
+
+
+bool LuaParser::ExecuteCached(const string& cacheFile, unsigned int key)
+{
+	if (L == NULL) {
+		errorLog = "could not initialize LUA library";
+		return false;
+	}
+
+	string data;
+
+	if (ReadCache(cacheFile, key, data)) {
+		size_t pos = 0;
+
+		if (DeserializeValue(L, data, pos, 0) && (pos == data.size()) && lua_istable(L, -1)) {
+			initDepth = -1;
+			rootRef = luaL_ref(L, LUA_REGISTRYINDEX);
+			lua_settop(L, 0);
+			valid = true;
+			return true;
+		}
+
+		logOutput.Print("LuaParser: ignoring invalid cache %s", cacheFile.c_str());
+		lua_settop(L, 0);
+	}
+
+	if (!Execute()) {
+		return false;
+	}
+
+	data.clear();
+	lua_rawgeti(L, LUA_REGISTRYINDEX, rootRef);
+
+	if (SerializeValue(L, lua_gettop(L), data, 0)) {
+		WriteCache(cacheFile, key, data);
+	} else {
+		logOutput.Print("LuaParser: %s can not be cached", fileName.c_str());
+	}
+
+	lua_settop(L, 0);
+	return true;
+}
+
+
+/**
+ * The cache is only valid for this build (lua_Number type, byte order),
+ * so it is stored raw: magic, number size, key, data checksum, data.
+ */
+bool LuaParser::ReadCache(const string& cacheFile, unsigned int key, string& data) const
+{
+	if (!filesystem.FileExists(cacheFile)) {
+		return false;
+	}
+
+	std::ifstream ifs(filesystem.LocateFile(cacheFile).c_str(), std::ios::in | std::ios::binary);
+	if (!ifs.is_open()) {
+		return false;
+	}
+
+	boost::uint32_t header[4];
+	ifs.read((char*) header, sizeof(header));
+
+	if (!ifs || (header[0] != LUAPARSER_CACHE_MAGIC) || (header[1] != sizeof(lua_Number)) || (header[2] != key)) {
+		return false;
+	}
+
+	data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+
+	return (CRC().Update(data.data(), data.size()).GetDigest() == header[3]);
+}
+
+
+void LuaParser::WriteCache(const string& cacheFile, unsigned int key, const string& data) const
+{
+	if (!filesystem.CreateDirectory(filesystem.GetDirectory(cacheFile))) {
+		return;
+	}
+
+	std::ofstream ofs(filesystem.LocateFile(cacheFile, FileSystem::WRITE).c_str(), std::ios::out | std::ios::binary);
+	if (!ofs.is_open()) {
+		return;
+	}
+
+	boost::uint32_t header[4];
+	header[0] = LUAPARSER_CACHE_MAGIC;
+	header[1] = sizeof(lua_Number);
+	header[2] = key;
+	header[3] = CRC().Update(data.data(), data.size()).GetDigest();
+
+	ofs.write((const char*) header, sizeof(header));
+	ofs.write(data.data(), data.size());
+}
+
+
 void LuaParser::AddTable(LuaTable* tbl)
 {
 	tables.insert(tbl);
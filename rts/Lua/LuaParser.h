@@ -113,6 +113,13 @@ class LuaParser {
 		~LuaParser();
 
 		bool Execute();
+		/**
+		 * Like Execute(), but the root table is restored from <cacheFile>
+		 * if that was written for the same <key>. On a miss the file is
+		 * executed, and its root table cached if it only holds tables,
+		 * numbers, strings and booleans.
+		 */
+		bool ExecuteCached(const string& cacheFile, unsigned int key);
 
 		bool IsValid() const { return (L != NULL); }
 
@@ -155,6 +162,9 @@ class LuaParser {
 
 		void PushParam();
 
+		bool ReadCache(const string& cacheFile, unsigned int key, string& data) const;
+		void WriteCache(const string& cacheFile, unsigned int key, const string& data) const;
+
 		void AddTable(LuaTable* tbl);
 		void RemoveTable(LuaTable* tbl);
 
@@ -42,6 +42,7 @@ bool LuaPathFinder::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetPathNodeCosts);
 	REGISTER_LUA_CFUNC(SetPathNodeCost);
 	REGISTER_LUA_CFUNC(GetPathNodeCost);
+	REGISTER_LUA_CFUNC(GetPathCacheStats);
 
 	return true;	
 }
@@ -347,5 +348,17 @@ int LuaPathFinder::GetPathNodeCost(lua_State* L)
 	return 1;
 }
 
+int LuaPathFinder::GetPathCacheStats(lua_State* L)
+{
+	unsigned int numHits, numPartialHits, numMisses, numEvictions;
+	pathManager->GetPathCacheStats(&numHits, &numPartialHits, &numMisses, &numEvictions);
+
+	lua_pushnumber(L, numHits);
+	lua_pushnumber(L, numPartialHits);
+	lua_pushnumber(L, numMisses);
+	lua_pushnumber(L, numEvictions);
+	return 4;
+}
+
 /******************************************************************************/
 /******************************************************************************/
@@ -68,6 +68,8 @@ class CLuaRules : public CLuaHandleSynced
 			unsigned int attackerWeaponNum,
 			unsigned int attackerWeaponDefID,
 			float* targetPriority);
+		/// if false, AllowWeaponTarget() returns false without calling Lua
+		bool HaveAllowWeaponTarget() const { return haveAllowWeaponTarget; }
 
 		bool UnitPreDamaged(const CUnit* unit, const CUnit* attacker,
                              float damage, int weaponID, bool paralyzer,
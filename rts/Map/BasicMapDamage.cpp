@@ -17,6 +17,7 @@
 #include "Sim/Units/Unit.h"
 #include "Sim/Units/UnitHandler.h"
 #include "LogOutput.h"
+#include "Sim/MoveTypes/MoveInfo.h"
 #include "Sim/Path/IPathManager.h"
 #include "Sim/Features/FeatureHandler.h"
 #include "Sim/Units/UnitTypes/Building.h"
@@ -196,8 +197,10 @@ void CBasicMapDamage::RecalcArea(int x1, int x2, int y1, int y2)
 	}
 
 	readmap->HeightmapUpdated(x1, y1, x2, y2);
+	moveinfo->TerrainChange(x1, y1, x2, y2);
 	pathManager->TerrainChange(x1, y1, x2, y2);
 	featureHandler->TerrainChanged(x1, y1, x2, y2);
+	loshandler->TerrainChanged(x1, y1, x2, y2);
 	CBaseWater::PushHeightmapChange(x1, y1, x2, y2);
 	heightMapTexture.UpdateArea(x1, y1, x2, y2);
 }
@@ -268,9 +271,9 @@ void CBasicMapDamage::UpdateLos(void)
 			return;
 
 		RelosSquare* rs = &relosQue.front();
-		const std::list<CUnit*>& units = qf->GetQuadAt(rs->x, rs->y).units;
+		const std::vector<CUnit*>& units = qf->GetQuadAt(rs->x, rs->y).units;
 
-		for (std::list<CUnit*>::const_iterator ui = units.begin(); ui != units.end(); ++ui) {
+		for (std::vector<CUnit*>::const_reverse_iterator ui = units.rbegin(); ui != units.rend(); ++ui) {
 			relosUnits.push_back((*ui)->id);
 		}
 		relosSize -= rs->numUnits;
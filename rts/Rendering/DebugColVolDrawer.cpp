@@ -175,11 +175,11 @@ public:
 	{
 		const CQuadField::Quad& q = qf->GetQuadAt(x,y);
 
-		for (std::list<CFeature*>::const_iterator fi = q.features.begin(); fi != q.features.end(); ++fi) {
+		for (std::vector<CFeature*>::const_iterator fi = q.features.begin(); fi != q.features.end(); ++fi) {
 			DrawFeatureColVol(*fi);
 		}
 
-		for (std::list<CUnit*>::const_iterator ui = q.units.begin(); ui != q.units.end(); ++ui) {
+		for (std::vector<CUnit*>::const_iterator ui = q.units.begin(); ui != q.units.end(); ++ui) {
 			DrawUnitColVol(*ui);
 		}
 
@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
 #include "mmgr.h"
 
 #include "CollisionHandler.h"
@@ -125,8 +126,8 @@ bool CCollisionHandler::CollisionFootprint(const CSolidObject* o, const float3&
 		const int square = int(p.x * invSquareSize) + int(p.z * invSquareSize) * gs->mapx;
 
 		if (square >= 0 && square < gs->mapSquares) {
-			const BlockingMapCell& cell = groundBlockingObjectMap->GetCell(square);
-			return cell.find(o->GetBlockingMapID()) != cell.end();
+			const BlockingMapCell cell = groundBlockingObjectMap->GetCell(square);
+			return std::find(cell.begin(), cell.end(), o) != cell.end();
 		}
 	}
 	// If the object isn't marked on blocking map, or it is flying,
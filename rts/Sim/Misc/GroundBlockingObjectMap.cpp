@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
 #include <assert.h>
 #include "mmgr.h"
 
@@ -8,19 +9,40 @@
 
 #include "GlobalSynced.h"
 #include "GlobalConstants.h"
+#include "Sim/Features/Feature.h"
+#include "Sim/MoveTypes/MoveInfo.h"
 #include "Sim/Objects/SolidObject.h"
 #include "Sim/Path/IPathManager.h"
-#include "creg/STL_Map.h"
 
 CGroundBlockingObjectMap* groundBlockingObjectMap;
 
 CR_BIND(CGroundBlockingObjectMap, (1))
 CR_REG_METADATA(CGroundBlockingObjectMap, (
-	CR_MEMBER(groundBlockingMap)
+	CR_MEMBER(cells),
+	CR_MEMBER(overflowCells),
+	CR_MEMBER(freeOverflowCells)
+));
+
+CR_BIND(CGroundBlockingObjectMap::Cell, )
+CR_REG_METADATA_SUB(CGroundBlockingObjectMap, Cell, (
+	CR_MEMBER(object),
+	CR_MEMBER(overflow)
 ));
 
 
 
+CGroundBlockingObjectMap::CGroundBlockingObjectMap(int numSquares)
+{
+	const int numWords = (numSquares + 31) >> 5;
+	const int numMoveDatas = (moveinfo != NULL)? moveinfo->moveData.size(): 0;
+
+	cells.resize(numSquares);
+	mobileBits.resize(numWords, 0);
+	structureBits.resize(numMoveDatas, std::vector<unsigned int>(numWords, 0));
+}
+
+
+
 inline static const int GetObjectID(CSolidObject* obj)
 {
 	const int id = obj->GetBlockingMapID();
@@ -31,6 +53,82 @@ inline static const int GetObjectID(CSolidObject* obj)
 
 
 
+bool CGroundBlockingObjectMap::InsertObject(int mapSquare, CSolidObject* object, int objID)
+{
+	Cell& cell = cells[mapSquare];
+
+	if (cell.overflow < 0) {
+		if (cell.object == NULL) {
+			cell.object = object;
+			return true;
+		}
+		if (cell.object == object) {
+			return false;
+		}
+
+		// second object on this square, move both to the overflow pool
+		if (freeOverflowCells.empty()) {
+			cell.overflow = overflowCells.size();
+			overflowCells.push_back(std::vector<CSolidObject*>());
+		} else {
+			cell.overflow = freeOverflowCells.back();
+			freeOverflowCells.pop_back();
+		}
+
+		overflowCells[cell.overflow].push_back(cell.object);
+		cell.object = NULL;
+	}
+
+	std::vector<CSolidObject*>& objects = overflowCells[cell.overflow];
+	std::vector<CSolidObject*>::iterator it = objects.begin();
+
+	while (it != objects.end() && GetObjectID(*it) < objID) {
+		++it;
+	}
+
+	if (it != objects.end() && *it == object) {
+		return false;
+	}
+
+	objects.insert(it, object);
+	return true;
+}
+
+bool CGroundBlockingObjectMap::EraseObject(int mapSquare, CSolidObject* object)
+{
+	Cell& cell = cells[mapSquare];
+
+	if (cell.overflow < 0) {
+		if (cell.object != object) {
+			return false;
+		}
+
+		cell.object = NULL;
+		return true;
+	}
+
+	std::vector<CSolidObject*>& objects = overflowCells[cell.overflow];
+	std::vector<CSolidObject*>::iterator it = std::find(objects.begin(), objects.end(), object);
+
+	if (it == objects.end()) {
+		return false;
+	}
+
+	objects.erase(it);
+
+	if (objects.size() == 1) {
+		// back to a single inline object; the pool entry keeps its capacity
+		cell.object = objects[0];
+		objects.clear();
+		freeOverflowCells.push_back(cell.overflow);
+		cell.overflow = -1;
+	}
+
+	return true;
+}
+
+
+
 void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
 {
 	const int objID = GetObjectID(object);
@@ -52,11 +150,8 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
 		for (int xSqr = minXSqr; xSqr < maxXSqr; xSqr++) {
 			const int idx = xSqr + zSqr * gs->mapx;
 
-			BlockingMapCell& cell = groundBlockingMap[idx];
-			BlockingMapCellIt it = cell.find(objID);
-
-			if (it == cell.end()) {
-				cell[objID] = object;
+			if (InsertObject(idx, object, objID)) {
+				UpdateCellBits(idx, object->immobile);
 			}
 		}
 	}
@@ -92,11 +187,8 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object, con
 			const int idx = minXSqr + x + (minZSqr + z) * gs->mapx;
 			const int off = x + z * sx;
 
-			BlockingMapCell& cell = groundBlockingMap[idx];
-			BlockingMapCellIt it = cell.find(objID);
-
-			if ((it == cell.end()) && (yardMap[off] & mask)) {
-				cell[objID] = object;
+			if ((yardMap[off] & mask) && InsertObject(idx, object, objID)) {
+				UpdateCellBits(idx, object->immobile);
 			}
 		}
 	}
@@ -110,8 +202,6 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object, con
 
 void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 {
-	const int objID = GetObjectID(object);
-
 	const int bx = object->mapPos.x;
 	const int bz = object->mapPos.y;
 	const int sx = object->xsize;
@@ -121,12 +211,10 @@ void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 
 	for (int z = bz; z < bz + sz; ++z) {
 		for (int x = bx; x < bx + sx; ++x) {
-			int idx = x + z * gs->mapx;
-			BlockingMapCell& cell = groundBlockingMap[idx];
-			BlockingMapCellIt it = cell.find(objID);
+			const int idx = x + z * gs->mapx;
 
-			if (it != cell.end()) {
-				cell.erase(objID);
+			if (EraseObject(idx, object)) {
+				UpdateCellBits(idx, object->immobile);
 			}
 		}
 	}
@@ -151,24 +239,78 @@ void CGroundBlockingObjectMap::MoveGroundBlockingObject(CSolidObject* object, fl
 
 
 
+bool CGroundBlockingObjectMap::CanBlock(const MoveData& moveData, int mapSquare) const
+{
+	const unsigned int word = mapSquare >> 5;
+	const unsigned int bit = 1u << (mapSquare & 31);
+
+	return (((mobileBits[word] | structureBits[moveData.pathType][word]) & bit) != 0);
+}
+
+void CGroundBlockingObjectMap::UpdateCellBits(int mapSquare, bool immobileChanged)
+{
+	const BlockingMapCell cell = GetCell(mapSquare);
+	const unsigned int word = mapSquare >> 5;
+	const unsigned int bit = 1u << (mapSquare & 31);
+
+	bool haveMobile = false;
+	bool haveStructure = false;
+	float maxFeatureMass = -1.0f;
+
+	for (BlockingMapCellIt it = cell.begin(); it != cell.end(); ++it) {
+		const CSolidObject* obj = *it;
+
+		if (!obj->immobile) {
+			haveMobile = true;
+		} else if (dynamic_cast<const CFeature*>(obj) == NULL) {
+			haveStructure = true;
+		} else {
+			maxFeatureMass = std::max(maxFeatureMass, obj->mass);
+		}
+	}
+
+	if (haveMobile) {
+		mobileBits[word] |= bit;
+	} else {
+		mobileBits[word] &= ~bit;
+	}
+
+	if (!immobileChanged) {
+		return;
+	}
+
+	// same test as CMoveMath::CrushResistant, minus the blocking flag
+	// (which may change while the object stays on the map)
+	for (unsigned int i = 0; i < structureBits.size(); ++i) {
+		if (haveStructure || maxFeatureMass > moveinfo->moveData[i]->crushStrength) {
+			structureBits[i][word] |= bit;
+		} else {
+			structureBits[i][word] &= ~bit;
+		}
+	}
+}
+
+
+
 /**
   * Checks if a ground-square is blocked.
   * If it's not blocked (empty), then NULL is returned. Otherwise, a
   * pointer to the top-most / bottom-most blocking object is returned.
   */
 CSolidObject* CGroundBlockingObjectMap::GroundBlockedUnsafe(int mapSquare, bool topMost) {
-	if (groundBlockingMap[mapSquare].empty()) {
-		return NULL;
+	if (cells[mapSquare].overflow < 0) {
+		// zero or one object
+		return cells[mapSquare].object;
 	}
 
-	const BlockingMapCell& cell = groundBlockingMap[mapSquare];
+	const BlockingMapCell cell = GetCell(mapSquare);
 	BlockingMapCellIt it = cell.begin();
-	CSolidObject* p = it->second;
-	CSolidObject* q = it->second;
+	CSolidObject* p = *it;
+	CSolidObject* q = *it;
 	++it;
 
 	for (; it != cell.end(); ++it) {
-		CSolidObject* obj = it->second;
+		CSolidObject* obj = *it;
 		if (obj->pos.y > p->pos.y) { p = obj; }
 		if (obj->pos.y < q->pos.y) { q = obj; }
 	}
@@ -215,14 +357,12 @@ void CGroundBlockingObjectMap::CloseBlockingYard(CSolidObject* yard, const unsig
 
 bool CGroundBlockingObjectMap::CanCloseYard(CSolidObject* yard)
 {
-	const int objID = GetObjectID(yard);
-
 	for (int z = yard->mapPos.y; z < yard->mapPos.y + yard->zsize; ++z) {
 		for (int x = yard->mapPos.x; x < yard->mapPos.x + yard->xsize; ++x) {
 			const int idx = z * gs->mapx + x;
 
-			BlockingMapCell& cell = groundBlockingMap[idx];
-			BlockingMapCellIt it = cell.find(objID);
+			const BlockingMapCell cell = GetCell(idx);
+			const BlockingMapCellIt it = std::find(cell.begin(), cell.end(), yard);
 
 			if (it == cell.end()) {
 				// we are non-blocking in this part of
@@ -3,22 +3,39 @@
 #ifndef GROUNDBLOCKINGOBJECTMAP_H
 #define GROUNDBLOCKINGOBJECTMAP_H
 
-#include <map>
+#include <vector>
 
 #include "creg/creg_cond.h"
 #include "float3.h"
 
 class CSolidObject;
-typedef std::map<int, CSolidObject*> BlockingMapCell;
-typedef BlockingMapCell::const_iterator BlockingMapCellIt;
-typedef std::vector<BlockingMapCell> BlockingMap;
+struct MoveData;
+
+typedef CSolidObject* const* BlockingMapCellIt;
+
+/// the objects on one map square, in blocking-map id order
+class BlockingMapCell
+{
+public:
+	BlockingMapCell(BlockingMapCellIt b, BlockingMapCellIt e): first(b), last(e) {}
+
+	BlockingMapCellIt begin() const { return first; }
+	BlockingMapCellIt end() const { return last; }
+	unsigned int size() const { return (last - first); }
+	bool empty() const { return (first == last); }
+
+private:
+	BlockingMapCellIt first;
+	BlockingMapCellIt last;
+};
 
 class CGroundBlockingObjectMap
 {
 	CR_DECLARE(CGroundBlockingObjectMap);
+	CR_DECLARE_SUB(Cell);
 
 public:
-	CGroundBlockingObjectMap(int numSquares) { groundBlockingMap.resize(numSquares); }
+	CGroundBlockingObjectMap(int numSquares);
 
 	void AddGroundBlockingObject(CSolidObject* object);
 	void AddGroundBlockingObject(CSolidObject* object, const unsigned char* yardMap, unsigned char mask);
@@ -35,10 +52,55 @@ public:
 	// same as GroundBlocked(), but does not bounds-check mapSquare
 	CSolidObject* GroundBlockedUnsafe(int mapSquare, bool topMost = true);
 
-	const BlockingMapCell& GetCell(int mapSquare) const { return groundBlockingMap[mapSquare]; }
+	/// only valid until the next change of the map
+	BlockingMapCell GetCell(int mapSquare) const {
+		const Cell& cell = cells[mapSquare];
+
+		if (cell.overflow >= 0) {
+			const std::vector<CSolidObject*>& objects = overflowCells[cell.overflow];
+			return BlockingMapCell(&objects[0], &objects[0] + objects.size());
+		}
+
+		return BlockingMapCell(&cell.object, &cell.object + (cell.object != NULL));
+	}
+
+	/**
+	 * False if nothing in the cell of <mapSquare> can block <moveData>
+	 * (the cell holds no mobile object and no immobile object that is
+	 * crush-resistant for it), in which case CMoveMath::SquareIsBlocked
+	 * does not need to look at the cell.
+	 */
+	bool CanBlock(const MoveData& moveData, int mapSquare) const;
 
 private:
-	BlockingMap groundBlockingMap;
+	/**
+	 * Most squares hold at most one object, which is stored inline.
+	 * Squares with more objects keep all of them (sorted by id) in an
+	 * entry of overflowCells instead, and object is NULL then.
+	 */
+	struct Cell {
+		CR_DECLARE_STRUCT(Cell);
+
+		Cell(): object(NULL), overflow(-1) {}
+
+		CSolidObject* object;
+		int overflow;
+	};
+
+	bool InsertObject(int mapSquare, CSolidObject* object, int objID);
+	bool EraseObject(int mapSquare, CSolidObject* object);
+	void UpdateCellBits(int mapSquare, bool immobileChanged);
+
+	std::vector<Cell> cells;
+	std::vector< std::vector<CSolidObject*> > overflowCells;
+	/// entries of overflowCells not used by any square
+	std::vector<int> freeOverflowCells;
+
+	/// one bit per cell: set if the cell holds a mobile object
+	std::vector<unsigned int> mobileBits;
+	/// per MoveData (indexed by pathType), one bit per cell: set if an
+	/// immobile object in the cell is crush-resistant for the MoveData
+	std::vector< std::vector<unsigned int> > structureBits;
 };
 
 extern CGroundBlockingObjectMap* groundBlockingObjectMap;
@@ -6,6 +6,7 @@
 #include <list>
 #include <cstdlib>
 #include <cstring>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "LosHandler.h"
 #include "ModInfo.h"
@@ -21,12 +22,14 @@
 using std::min;
 using std::max;
 
+static CLogSubsystem LOG_LOSCACHE("LosInstanceCache");
+
 CR_BIND(LosInstance, );
 CR_BIND(CLosHandler, );
 CR_BIND(CLosHandler::DelayedInstance, );
 
 CR_REG_METADATA(LosInstance,(
-//		CR_MEMBER(losSquares),
+//		CR_MEMBER(losSpans),
 		CR_MEMBER(losSize),
 		CR_MEMBER(airLosSize),
 		CR_MEMBER(refCount),
@@ -37,6 +40,8 @@ CR_REG_METADATA(LosInstance,(
 		CR_MEMBER(hashNum),
 		CR_MEMBER(baseHeight),
 		CR_MEMBER(toBeDeleted),
+		CR_MEMBER(needsRecalc),
+		CR_MEMBER(revived),
 		CR_RESERVED(16)
 		));
 
@@ -44,6 +49,9 @@ void CLosHandler::PostLoad()
 {
 	for (int a = 0; a < LOSHANDLER_MAGIC_PRIME; ++a) {
 		for (std::list<LosInstance*>::iterator li = instanceHash[a].begin(); li != instanceHash[a].end(); ++li) {
+			// spans are not saved
+			(*li)->needsRecalc = true;
+
 			if ((*li)->refCount) {
 				LosAdd(*li);
 			}
@@ -141,7 +149,7 @@ void CLosHandler::MoveUnit(CUnit* unit, bool redoCurrent)
 		}
 		instance = unit->los;
 		CleanupInstance(instance);
-		instance->losSquares.clear();
+		instance->needsRecalc = true;
 		instance->basePos.x = baseX;
 		instance->basePos.y = baseY;
 		instance->baseSquare = baseSquare; //this could be a problem if several units are sharing the same instance
@@ -191,9 +199,25 @@ void CLosHandler::LosAdd(LosInstance* instance)
 	assert(instance);
 	assert(teamHandler->IsValidAllyTeam(instance->allyteam));
 
-	losAlgo.LosAdd(instance->basePos, instance->losSize, instance->baseHeight, instance->losSquares);
+	if (instance->needsRecalc) {
+		SCOPED_TIMER("LOSHandler::LosAdd");
+
+		const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+		losAlgo.LosAdd(instance->basePos, instance->losSize, instance->baseHeight, instance->losSpans);
+		instance->needsRecalc = false;
+
+		const boost::posix_time::time_duration recalcTime = boost::posix_time::microsec_clock::universal_time() - startTime;
+
+		++cacheStats.recalcs;
+		cacheStats.recalcTime += recalcTime.total_microseconds() * 0.001f;
+		cacheStats.recalcTimeLeft += recalcTime.total_microseconds() * 0.001f;
+	} else {
+		++cacheStats.hits;
+		++cacheStats.frameHits;
+	}
 
-	if (instance->losSize > 0) { losMap[instance->allyteam].AddMapSquares(instance->losSquares, 1); }
+	if (instance->losSize > 0) { losMap[instance->allyteam].AddMapSpans(instance->losSpans, 1); }
 	if (instance->airLosSize > 0) { airLosMap[instance->allyteam].AddMapArea(instance->baseAirPos, instance->airLosSize, 1); }
 }
 
@@ -217,16 +241,26 @@ void CLosHandler::FreeInstance(LosInstance* instance)
 			logOutput.Print("[LosHandler::FreeInstance][1] bad LOS-instance hash (%d)", instance->hashNum);
 		}
 
-		if (toBeDeleted.size() > 500) {
+		// revived entries are only re-queued (with their flag cleared),
+		// so keep going until the queue is back at its limit
+		while (toBeDeleted.size() > 500) {
 			LosInstance* i = toBeDeleted.front();
 			toBeDeleted.pop_front();
 
 			if (i->hashNum >= LOSHANDLER_MAGIC_PRIME || i->hashNum < 0) {
 				logOutput.Print("[LosHandler::FreeInstance][2] bad LOS-instance hash (%d)", i->hashNum);
-				return;
+				continue;
+			}
+
+			if (i->refCount == 0 && i->revived) {
+				// used again since it was queued, keep it around a bit longer
+				i->revived = false;
+				toBeDeleted.push_back(i);
+				continue;
 			}
 
 			i->toBeDeleted = false;
+			i->revived = false;
 
 			if (i->refCount == 0) {
 				std::list<LosInstance*>::iterator lii;
@@ -245,6 +279,31 @@ void CLosHandler::FreeInstance(LosInstance* instance)
 }
 
 
+void CLosHandler::TerrainChanged(int x1, int y1, int x2, int y2)
+{
+	// changed area in LOS-map squares
+	const int minX = x1 >> losMipLevel;
+	const int minY = y1 >> losMipLevel;
+	const int maxX = x2 >> losMipLevel;
+	const int maxY = y2 >> losMipLevel;
+
+	for (int a = 0; a < LOSHANDLER_MAGIC_PRIME; ++a) {
+		for (std::list<LosInstance*>::iterator li = instanceHash[a].begin(); li != instanceHash[a].end(); ++li) {
+			LosInstance* i = *li;
+
+			if ((i->basePos.x + i->losSize) < minX || (i->basePos.x - i->losSize) > maxX)
+				continue;
+			if ((i->basePos.y + i->losSize) < minY || (i->basePos.y - i->losSize) > maxY)
+				continue;
+
+			// the spans of active instances are still needed to remove them
+			// from the LOS map, units in the area are re-LOS'ed by mapDamage
+			i->needsRecalc = true;
+		}
+	}
+}
+
+
 int CLosHandler::GetHashNum(CUnit* unit)
 {
 	const unsigned int t =
@@ -258,6 +317,7 @@ int CLosHandler::GetHashNum(CUnit* unit)
 void CLosHandler::AllocInstance(LosInstance* instance)
 {
 	if (instance->refCount == 0) {
+		instance->revived = instance->toBeDeleted;
 		LosAdd(instance);
 	}
 	instance->refCount++;
@@ -266,13 +326,40 @@ void CLosHandler::AllocInstance(LosInstance* instance)
 
 void CLosHandler::CleanupInstance(LosInstance* instance)
 {
-	if (instance->losSize > 0) { losMap[instance->allyteam].AddMapSquares(instance->losSquares, -1); }
+	if (instance->losSize > 0) { losMap[instance->allyteam].AddMapSpans(instance->losSpans, -1); }
 	if (instance->airLosSize > 0) { airLosMap[instance->allyteam].AddMapArea(instance->baseAirPos, instance->airLosSize, -1); }
 }
 
 
 void CLosHandler::Update(void)
 {
+	{
+		CacheStats& stats = cacheStats;
+
+		if (stats.recalcs > 0) {
+			// a reuse saves about as much as the average ray-cast costs
+			stats.savedTimeLeft += stats.frameHits * (stats.recalcTime / stats.recalcs);
+		}
+		stats.frameHits = 0;
+
+		const unsigned int recalcTime = (unsigned int) stats.recalcTimeLeft;
+		const unsigned int savedTime = (unsigned int) stats.savedTimeLeft;
+		profiler.AddTime("LOS instance ray-cast", recalcTime);
+		profiler.AddTime("LOS instance reuse saved (est.)", savedTime);
+		stats.recalcTimeLeft -= recalcTime;
+		stats.savedTimeLeft -= savedTime;
+
+		if ((gs->frameNum % (GAME_SPEED * 60)) == 0 && (stats.hits + stats.recalcs) > 0) {
+			logOutput.Print(LOG_LOSCACHE, "reuse rate %.1f%% (%u reused, %u ray-cast, %.1f ms ray-casting)",
+					(100.0f * stats.hits) / (stats.hits + stats.recalcs),
+					stats.hits, stats.recalcs, stats.recalcTime);
+
+			stats.hits = 0;
+			stats.recalcs = 0;
+			stats.recalcTime = 0.0f;
+		}
+	}
+
 	while (!delayQue.empty() && delayQue.front().timeoutTime < gs->frameNum) {
 		FreeInstance(delayQue.front().instance);
 		delayQue.pop_front();
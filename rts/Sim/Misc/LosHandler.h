@@ -20,7 +20,7 @@
  *
  * The main goal of this object is to store the squares on the LOS map that
  * have been incremented (CLosHandler::LosAdd) when the unit last moved.
- * (CLosHandler::MoveUnit)
+ * (CLosHandler::MoveUnit) They are kept as row spans, see CLosAlgorithm.
  *
  * These squares must be remembered because 1) ray-casting against the terrain
  * is not particularly fast and more importantly 2) the terrain may have changed
@@ -32,6 +32,10 @@
  * An instance will be shared iff the other unit is in the same square
  * (basePos, baseSquare) on the LOS map, has the same LOS and air LOS
  * radius, is in the same ally-team and has the same base-height.
+ *
+ * Unused instances keep their spans, so a unit moving back to a square it
+ * just left reuses them without ray-casting again, unless the terrain in
+ * their range changed meanwhile (needsRecalc).
  */
 struct LosInstance : public boost::noncopyable
 {
@@ -48,6 +52,8 @@ private:
 		, hashNum(-1)
 		, baseHeight(0.0f)
 		, toBeDeleted(false)
+		, needsRecalc(true)
+		, revived(false)
 	{}
 
 public:
@@ -63,9 +69,11 @@ public:
 		, hashNum(hashNum)
 		, baseHeight(baseHeight)
 		, toBeDeleted(false)
+		, needsRecalc(true)
+		, revived(false)
 	{}
 
- 	std::vector<int> losSquares;
+ 	std::vector<int> losSpans;
 	int losSize;
 	int airLosSize;
 	int refCount;
@@ -76,6 +84,10 @@ public:
 	int hashNum;
 	float baseHeight;
 	bool toBeDeleted;
+	/// true if <losSpans> is out of date (terrain changed, or never calculated)
+	bool needsRecalc;
+	/// reused while waiting in CLosHandler::toBeDeleted, gets a second chance
+	bool revived;
 };
 
 /**
@@ -93,7 +105,8 @@ public:
  * To quickly find LosInstances that can be shared CLosHandler implements a
  * hash table (instanceHash). Additionally, LosInstances that reach a refCount
  * of 0 are not immediately deleted, but up to 500 of those are stored, in case
- * they can be reused for a future unit.
+ * they can be reused for a future unit. Instances that were reused while
+ * stored get a second chance before being deleted (approximating LRU).
  *
  * LOS is not removed immediately when a unit gets killed. Instead,
  * DelayedFreeInstance is called. This keeps the LosInstance (including the
@@ -108,6 +121,8 @@ class CLosHandler : public boost::noncopyable
 public:
 	void MoveUnit(CUnit* unit, bool redoCurrent);
 	void FreeInstance(LosInstance* instance);
+	/// marks instances in range of the changed heightmap area for recalculation
+	void TerrainChanged(int x1, int y1, int x2, int y2);
 
 	inline bool InLos(const CWorldObject* object, int allyTeam) {
 		if (object->alwaysVisible || gs->globalLOS) {
@@ -195,6 +210,23 @@ private:
 
 	std::deque<DelayedInstance> delayQue;
 
+	struct CacheStats {
+		CacheStats(): hits(0), recalcs(0), recalcTime(0.0f), frameHits(0), recalcTimeLeft(0.0f), savedTimeLeft(0.0f) {}
+
+		/// instances reused without ray-casting, and ray-cast ones,
+		/// since the last hit rate message
+		unsigned int hits;
+		unsigned int recalcs;
+		float recalcTime;
+
+		unsigned int frameHits;
+		/// not reported to the profiler yet, it only takes whole ms
+		float recalcTimeLeft;
+		float savedTimeLeft;
+	};
+
+	CacheStats cacheStats;
+
 public:
 	void Update();
 	void DelayedFreeInstance(LosInstance* instance);
@@ -43,11 +43,17 @@ void CLosMap::AddMapArea(int2 pos, int radius, int amount)
 }
 
 
-void CLosMap::AddMapSquares(const std::vector<int>& squares, int amount)
+void CLosMap::AddMapSpans(const std::vector<int>& spans, int amount)
 {
-	std::vector<int>::const_iterator lsi;
-	for (lsi = squares.begin(); lsi != squares.end(); ++lsi) {
-		map[*lsi] += amount;
+	for (size_t n = 0; n < spans.size(); n += 3) {
+		unsigned short* square = &map[spans[n]];
+		const int numSquares = spans[n + 1];
+		const unsigned short delta = spans[n + 2] * amount;
+
+		// contiguous, lets the compiler vectorize this
+		for (int i = 0; i < numSquares; ++i) {
+			square[i] += delta;
+		}
 	}
 }
 
@@ -230,52 +236,89 @@ void CLosTables::DrawLine(char* PaintTable, int x, int y, int Size)
 //////////////////////////////////////////////////////////////////////
 
 
-void CLosAlgorithm::LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
+void CLosAlgorithm::LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& spans)
 {
+	spans.clear();
+
 	if (radius <= 0) { return; }
 
 	pos.x = Clamp(size.x - 1, 0, pos.x);
 	pos.y = Clamp(size.y - 1, 0, pos.y);
 
+	// the rays never go further than the largest table
+	losBoxRadius = std::min(MAX_LOS_TABLE, radius);
+	losBoxSize = losBoxRadius * 2 + 1;
+	losBox.resize(losBoxSize * losBoxSize);
+
 	if ((pos.x - radius < radius) || (pos.x + radius >= size.x - radius) || // FIXME: This additional margin is due to a suspect bug in losalgorithm
 	    (pos.y - radius < radius) || (pos.y + radius >= size.y - radius)) { // causing rare crash with big units such as arm Colossus
-		SafeLosAdd(pos, radius, baseHeight, squares);
+		SafeLosAdd(pos, radius, baseHeight);
 	} else {
-		UnsafeLosAdd(pos, radius, baseHeight, squares);
+		UnsafeLosAdd(pos, radius, baseHeight);
+	}
+
+	OutputSpans(pos, spans);
+}
+
+
+/**
+ * Converts the counts in the LOS box to spans and clears the box
+ */
+void CLosAlgorithm::OutputSpans(int2 pos, std::vector<int>& spans)
+{
+	for (int y = 0; y < losBoxSize; ++y) {
+		unsigned short* row = &losBox[y * losBoxSize];
+		const int rowSquare = (pos.y + y - losBoxRadius) * size.x + (pos.x - losBoxRadius);
+
+		for (int x = 0; x < losBoxSize; ) {
+			const unsigned short count = row[x];
+
+			if (count == 0) {
+				++x;
+				continue;
+			}
+
+			const int first = x;
+
+			for (; x < losBoxSize && row[x] == count; ++x) {
+				row[x] = 0;
+			}
+
+			spans.push_back(rowSquare + first);
+			spans.push_back(x - first);
+			spans.push_back(count);
+		}
 	}
 }
 
 
-#define MAP_SQUARE(pos) \
-	((pos).y * size.x + (pos).x)
+// square relative to the LOS position, and its index in the LOS box
+#define MAP_SQUARE(dx, dy) \
+	(mapSquare + (dx) + (dy) * size.x)
+#define BOX_SQUARE(dx, dy) \
+	(boxSquare + (dx) + (dy) * losBoxSize)
 
-#define LOS_ADD(_square, _maxAng) \
+#define LOS_ADD(_dx, _dy, _maxAng) \
 	{ \
-		const int square = _square; \
-		const float dh = heightmap[square] - baseHeight; \
+		const float dh = heightmap[MAP_SQUARE(_dx, _dy)] - baseHeight; \
 		float ang = (dh + extraHeight) * invR; \
 		if(ang > _maxAng) { \
-			squares.push_back(square); \
+			losBox[BOX_SQUARE(_dx, _dy)]++; \
 			ang = dh * invR; \
 			if(ang > _maxAng) _maxAng = ang; \
 		} \
 	}
 
 
-void CLosAlgorithm::UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
+void CLosAlgorithm::UnsafeLosAdd(int2 pos, int radius, float baseHeight)
 {
-	const int mapSquare = MAP_SQUARE(pos);
+	const int mapSquare = pos.y * size.x + pos.x;
+	const int boxSquare = losBoxRadius * losBoxSize + losBoxRadius;
 	const LosTable& table = CLosTables::GetForLosSize(radius);
 
 	baseHeight += heightmap[mapSquare];
 
-	size_t neededSpace = squares.size() + 1;
-	for(LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
-		neededSpace += li->size() * 4;
-	}
-	squares.reserve(neededSpace);
-
-	squares.push_back(mapSquare);
+	losBox[boxSquare]++;
 
 	for(LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
 		const LosLine& line = *li;
@@ -288,10 +331,10 @@ void CLosAlgorithm::UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::ve
 		for(LosLine::const_iterator linei = line.begin(); linei != line.end(); ++linei) {
 			const float invR = 1.0f / r;
 
-			LOS_ADD(mapSquare + linei->x + linei->y * size.x, maxAng1);
-			LOS_ADD(mapSquare - linei->x - linei->y * size.x, maxAng2);
-			LOS_ADD(mapSquare - linei->x * size.x + linei->y, maxAng3);
-			LOS_ADD(mapSquare + linei->x * size.x - linei->y, maxAng4);
+			LOS_ADD( linei->x,  linei->y, maxAng1);
+			LOS_ADD(-linei->x, -linei->y, maxAng2);
+			LOS_ADD( linei->y, -linei->x, maxAng3);
+			LOS_ADD(-linei->y,  linei->x, maxAng4);
 
 			r++;
 		}
@@ -299,14 +342,15 @@ void CLosAlgorithm::UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::ve
 }
 
 
-void CLosAlgorithm::SafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
+void CLosAlgorithm::SafeLosAdd(int2 pos, int radius, float baseHeight)
 {
-	const int mapSquare = MAP_SQUARE(pos);
+	const int mapSquare = pos.y * size.x + pos.x;
+	const int boxSquare = losBoxRadius * losBoxSize + losBoxRadius;
 	const LosTable& table = CLosTables::GetForLosSize(radius);
 
 	baseHeight += heightmap[mapSquare];
 
-	squares.push_back(mapSquare);
+	losBox[boxSquare]++;
 
 	for (LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
 		const LosLine& line = *li;
@@ -320,16 +364,16 @@ void CLosAlgorithm::SafeLosAdd(int2 pos, int radius, float baseHeight, std::vect
 			const float invR = 1.0f / r;
 
 			if ((pos.x + linei->x < size.x) && (pos.y + linei->y < size.y)) {
-				LOS_ADD(mapSquare + linei->x + linei->y * size.x, maxAng1);
+				LOS_ADD( linei->x,  linei->y, maxAng1);
 			}
 			if ((pos.x - linei->x >= 0) && (pos.y - linei->y >= 0)) {
-				LOS_ADD(mapSquare - linei->x - linei->y * size.x, maxAng2);
+				LOS_ADD(-linei->x, -linei->y, maxAng2);
 			}
 			if ((pos.x + linei->y < size.x) && (pos.y - linei->x >= 0)) {
-				LOS_ADD(mapSquare - linei->x * size.x + linei->y, maxAng3);
+				LOS_ADD( linei->y, -linei->x, maxAng3);
 			}
 			if ((pos.x - linei->y >= 0) && (pos.y + linei->x < size.y)) {
-				LOS_ADD(mapSquare + linei->x * size.x - linei->y, maxAng4);
+				LOS_ADD(-linei->y,  linei->x, maxAng4);
 			}
 
 			r++;
@@ -21,7 +21,8 @@ public:
 	void AddMapArea(int2 pos, int radius, int amount);
 
 	/// arbitrary area, for losMap, non-circular radar maps, ...
-	void AddMapSquares(const std::vector<int>& squares, int amount);
+	/// (<spans> as generated by CLosAlgorithm::LosAdd)
+	void AddMapSpans(const std::vector<int>& spans, int amount);
 
 	int operator[] (int square) const { return map[square]; }
 
@@ -41,23 +42,37 @@ protected:
 };
 
 
-/// algorithm to calculate LOS squares using raycasting, taking terrain into account
+/**
+ * algorithm to calculate LOS squares using raycasting, taking terrain into account
+ *
+ * Every ray adds the squares it sees once, so squares close to the
+ * center are usually seen several times. The result is stored as spans
+ * of consecutive squares on a row which were seen equally often, each
+ * span taking three ints: first square, number of squares, count.
+ */
 class CLosAlgorithm
 {
 public:
 	CLosAlgorithm(int2 size, float minMaxAng, float extraHeight, const float* heightmap)
-	: size(size), minMaxAng(minMaxAng), extraHeight(extraHeight), heightmap(heightmap) {}
+	: size(size), minMaxAng(minMaxAng), extraHeight(extraHeight), heightmap(heightmap), losBoxRadius(0), losBoxSize(0) {}
 
-	void LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
+	/// replaces the contents of <spans> with the LOS footprint at <pos>
+	void LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& spans);
 
 private:
-	void UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
-	void SafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
+	void UnsafeLosAdd(int2 pos, int radius, float baseHeight);
+	void SafeLosAdd(int2 pos, int radius, float baseHeight);
+	void OutputSpans(int2 pos, std::vector<int>& spans);
 
 	const int2 size;
 	const float minMaxAng;
 	const float extraHeight;
 	const float* const heightmap;
+
+	/// per-square counts of the box around the current position
+	std::vector<unsigned short> losBox;
+	int losBoxRadius;
+	int losBoxSize;
 };
 
 #endif // LOS_MAP_H
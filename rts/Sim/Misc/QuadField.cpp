@@ -1,16 +1,17 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
 #include "mmgr.h"
 
 #include "lib/gml/gml.h"
 #include "QuadField.h"
+#include "Game/GameHelper.h"
 #include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/Features/Feature.h"
 #include "Sim/Units/Unit.h"
-#include "System/creg/STL_List.h"
 
 CR_BIND(CQuadField, );
 CR_REG_METADATA(CQuadField, (
@@ -48,6 +49,28 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 ));
 
 
+/**
+ * Quad contents are appended and read back to front, which gives the order
+ * the old std::list containers had (newest object first); quadfield queries
+ * return objects in that order and several synced callers depend on it.
+ */
+template<typename T>
+static inline void QuadPush(std::vector<T>& v, const T& e)
+{
+	v.push_back(e);
+}
+
+template<typename T>
+static inline void QuadErase(std::vector<T>& v, const T& e)
+{
+	typename std::vector<T>::iterator it = std::find(v.begin(), v.end(), e);
+
+	if (it != v.end()) {
+		v.erase(it);
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -135,11 +158,11 @@ std::vector<CUnit*> CQuadField::GetUnits(const float3& pos, float radius)
 	GetQuads(pos, radius, endQuad);
 	const int tempNum = gs->tempNum++;
 
-	std::list<CUnit*>::iterator ui;
+	std::vector<CUnit*>::reverse_iterator ui;
 	for (int* a = tempQuads; a != endQuad; ++a) {
 		Quad& quad = baseQuads[*a];
 
-		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+		for (ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 			if ((*ui)->tempNum != tempNum) {
 				(*ui)->tempNum = tempNum;
 				units.push_back(*ui);
@@ -151,20 +174,27 @@ std::vector<CUnit*> CQuadField::GetUnits(const float3& pos, float radius)
 }
 
 std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& pos, float radius, bool spherical)
+{
+	std::vector<CUnit*> units;
+	GetUnitsExact(pos, radius, units, spherical);
+	return units;
+}
+
+void CQuadField::GetUnitsExact(const float3& pos, float radius, std::vector<CUnit*>& units, bool spherical)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetUnitsExact
 
-	std::vector<CUnit*> units;
+	units.clear();
 
 	int* endQuad = tempQuads;
 	GetQuads(pos, radius, endQuad);
 	const int tempNum = gs->tempNum++;
 
-	std::list<CUnit*>::iterator ui;
+	std::vector<CUnit*>::reverse_iterator ui;
 	for (int* a = tempQuads; a != endQuad; ++a) {
 		Quad& quad = baseQuads[*a];
 
-		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+		for (ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 			if ((*ui)->tempNum != tempNum) {
 				const float totRad       = radius + (*ui)->radius;
 				const float totRadSq     = totRad * totRad;
@@ -179,8 +209,6 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& pos, float radius, b
 			}
 		}
 	}
-
-	return units;
 }
 
 std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3& maxs)
@@ -194,9 +222,9 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3&
 
 	std::vector<int>::const_iterator qi;
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CUnit*>& quadUnits = baseQuads[*qi].units;
-		std::list<CUnit*>::iterator ui;
-		for (ui = quadUnits.begin(); ui != quadUnits.end(); ++ui) {
+		std::vector<CUnit*>& quadUnits = baseQuads[*qi].units;
+		std::vector<CUnit*>::reverse_iterator ui;
+		for (ui = quadUnits.rbegin(); ui != quadUnits.rend(); ++ui) {
 			CUnit* unit = *ui;
 			const float3& pos = unit->midPos;
 			if ((unit->tempNum != tempNum)
@@ -213,11 +241,18 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3&
 }
 
 std::vector<int> CQuadField::GetQuadsOnRay(const float3& start, float3 dir, float length)
+{
+	std::vector<int> quads;
+	GetQuadsOnRay(start, dir, length, quads);
+	return quads;
+}
+
+void CQuadField::GetQuadsOnRay(const float3& start, float3 dir, float length, std::vector<int>& dst)
 {
 	int* end = tempQuads;
 	GetQuadsOnRay(start, dir, length, end);
 
-	return std::vector<int>(tempQuads, end);
+	dst.assign(tempQuads, end);
 }
 
 void CQuadField::GetQuadsOnRay(float3 start, float3 dir, float length, int*& dst)
@@ -361,6 +396,11 @@ void CQuadField::GetQuadsOnRay(float3 start, float3 dir, float length, int*& dst
 
 void CQuadField::MovedUnit(CUnit* unit)
 {
+	if (helper != NULL) {
+		// the unit position is cached even if its quads do not change
+		helper->InvalidateTargetCache(unit);
+	}
+
 	const std::vector<int>& newQuads = GetQuads(unit->pos,unit->radius);
 
 	//! compare if the quads have changed, if not stop here
@@ -382,46 +422,32 @@ void CQuadField::MovedUnit(CUnit* unit)
 
 	std::vector<int>::const_iterator qi;
 	for (qi = unit->quads.begin(); qi != unit->quads.end(); ++qi) {
-		std::list<CUnit*>::iterator ui;
-		for (ui = baseQuads[*qi].units.begin(); ui != baseQuads[*qi].units.end(); ++ui) {
-			if (*ui == unit) {
-				baseQuads[*qi].units.erase(ui);
-				break;
-			}
-		}
-		for (ui = baseQuads[*qi].teamUnits[unit->allyteam].begin(); ui != baseQuads[*qi].teamUnits[unit->allyteam].end(); ++ui) {
-			if (*ui == unit) {
-				baseQuads[*qi].teamUnits[unit->allyteam].erase(ui);
-				break;
-			}
-		}
+		QuadErase(baseQuads[*qi].units, unit);
+		QuadErase(baseQuads[*qi].teamUnits[unit->allyteam], unit);
 	}
 	for (qi = newQuads.begin(); qi != newQuads.end(); ++qi) {
-		baseQuads[*qi].units.push_front(unit);
-		baseQuads[*qi].teamUnits[unit->allyteam].push_front(unit);
+		QuadPush(baseQuads[*qi].units, unit);
+		QuadPush(baseQuads[*qi].teamUnits[unit->allyteam], unit);
 	}
 	unit->quads = newQuads;
+
+	if (helper != NULL) {
+		helper->InvalidateTargetCache(unit);
+	}
 }
 
 void CQuadField::RemoveUnit(CUnit* unit)
 {
 	GML_RECMUTEX_LOCK(quad); // RemoveUnit
 
+	if (helper != NULL) {
+		helper->InvalidateTargetCache(unit);
+	}
+
 	std::vector<int>::const_iterator qi;
 	for (qi = unit->quads.begin(); qi != unit->quads.end(); ++qi) {
-		std::list<CUnit*>::iterator ui;
-		for (ui = baseQuads[*qi].units.begin(); ui != baseQuads[*qi].units.end(); ++ui) {
-			if (*ui == unit) {
-				baseQuads[*qi].units.erase(ui);
-				break;
-			}
-		}
-		for (ui = baseQuads[*qi].teamUnits[unit->allyteam].begin(); ui != baseQuads[*qi].teamUnits[unit->allyteam].end(); ++ui) {
-			if (*ui == unit) {
-				baseQuads[*qi].teamUnits[unit->allyteam].erase(ui);
-				break;
-			}
-		}
+		QuadErase(baseQuads[*qi].units, unit);
+		QuadErase(baseQuads[*qi].teamUnits[unit->allyteam], unit);
 	}
 	unit->quads.clear();
 }
@@ -434,7 +460,7 @@ void CQuadField::AddFeature(CFeature* feature)
 
 	std::vector<int>::const_iterator qi;
 	for (qi = newQuads.begin(); qi != newQuads.end(); ++qi) {
-		baseQuads[*qi].features.push_front(feature);
+		QuadPush(baseQuads[*qi].features, feature);
 	}
 }
 
@@ -446,23 +472,30 @@ void CQuadField::RemoveFeature(CFeature* feature)
 
 	std::vector<int>::const_iterator qi;
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		baseQuads[*qi].features.remove(feature);
+		QuadErase(baseQuads[*qi].features, feature);
 	}
 }
 
 std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float radius)
+{
+	std::vector<CFeature*> features;
+	GetFeaturesExact(pos, radius, features);
+	return features;
+}
+
+void CQuadField::GetFeaturesExact(const float3& pos, float radius, std::vector<CFeature*>& features)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetFeaturesExact
 
-	std::vector<CFeature*> features;
+	features.clear();
 
-	const std::vector<int>& quads = GetQuads(pos, radius);
+	int* endQuad = tempQuads;
+	GetQuads(pos, radius, endQuad);
 	const int tempNum = gs->tempNum++;
 
-	std::vector<int>::const_iterator qi;
-	std::list<CFeature*>::iterator fi;
-	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (fi = baseQuads[*qi].features.begin(); fi != baseQuads[*qi].features.end(); ++fi) {
+	std::vector<CFeature*>::reverse_iterator fi;
+	for (int* qi = tempQuads; qi != endQuad; ++qi) {
+		for (fi = baseQuads[*qi].features.rbegin(); fi != baseQuads[*qi].features.rend(); ++fi) {
 			const float totRad = radius + (*fi)->radius;
 			if ((*fi)->tempNum != tempNum
 					&& ((pos - (*fi)->midPos).SqLength() < (totRad * totRad)))
@@ -472,8 +505,6 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float rad
 			}
 		}
 	}
-
-	return features;
 }
 
 std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& mins, const float3& maxs)
@@ -486,10 +517,10 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& mins, const fl
 	const int tempNum = gs->tempNum++;
 
 	std::vector<int>::const_iterator qi;
-	std::list<CFeature*>::iterator fi;
+	std::vector<CFeature*>::reverse_iterator fi;
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CFeature*>& quadFeatures = baseQuads[*qi].features;
-		for (fi = quadFeatures.begin(); fi != quadFeatures.end(); ++fi) {
+		std::vector<CFeature*>& quadFeatures = baseQuads[*qi].features;
+		for (fi = quadFeatures.rbegin(); fi != quadFeatures.rend(); ++fi) {
 			CFeature* feature = *fi;
 			const float3& pos = feature->midPos;
 			if ((feature->tempNum != tempNum)
@@ -506,18 +537,25 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& mins, const fl
 }
 
 std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float radius)
+{
+	std::vector<CSolidObject*> solids;
+	GetSolidsExact(pos, radius, solids);
+	return solids;
+}
+
+void CQuadField::GetSolidsExact(const float3& pos, float radius, std::vector<CSolidObject*>& solids)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetSolidsExact
 
-	std::vector<CSolidObject*> solids;
+	solids.clear();
 
-	const std::vector<int>& quads = GetQuads(pos, radius);
+	int* endQuad = tempQuads;
+	GetQuads(pos, radius, endQuad);
 	const int tempNum = gs->tempNum++;
 
-	std::vector<int>::const_iterator qi;
-	std::list<CUnit*>::iterator ui;
-	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (ui = baseQuads[*qi].units.begin(); ui != baseQuads[*qi].units.end(); ++ui) {
+	std::vector<CUnit*>::reverse_iterator ui;
+	for (int* qi = tempQuads; qi != endQuad; ++qi) {
+		for (ui = baseQuads[*qi].units.rbegin(); ui != baseQuads[*qi].units.rend(); ++ui) {
 			if (!(*ui)->blocking) {
 				continue;
 			}
@@ -531,8 +569,8 @@ std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float r
 			}
 		}
 
-		std::list<CFeature*>::iterator fi;
-		for (fi = baseQuads[*qi].features.begin(); fi != baseQuads[*qi].features.end(); ++fi) {
+		std::vector<CFeature*>::reverse_iterator fi;
+		for (fi = baseQuads[*qi].features.rbegin(); fi != baseQuads[*qi].features.rend(); ++fi) {
 			if (!(*fi)->blocking) {
 				continue;
 			}
@@ -545,8 +583,6 @@ std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float r
 			}
 		}
 	}
-
-	return solids;
 }
 
 std::vector<int> CQuadField::GetQuadsRectangle(const float3& pos,const float3& pos2) const
@@ -581,11 +617,11 @@ void CQuadField::GetUnitsAndFeaturesExact(const float3& pos, float radius, CUnit
 	GetQuads(pos, radius, endQuad);
 	const int tempNum = gs->tempNum++;
 
-	std::list<CUnit*>::iterator ui;
-	std::list<CFeature*>::iterator fi;
+	std::vector<CUnit*>::reverse_iterator ui;
+	std::vector<CFeature*>::reverse_iterator fi;
 	for (int* a = tempQuads; a != endQuad; ++a) {
 		Quad& quad = baseQuads[*a];
-		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+		for (ui = quad.units.rbegin(); ui != quad.units.rend(); ++ui) {
 			if ((*ui)->tempNum != tempNum) {
 				(*ui)->tempNum = tempNum;
 				*dstUnit = *ui;
@@ -593,7 +629,7 @@ void CQuadField::GetUnitsAndFeaturesExact(const float3& pos, float radius, CUnit
 			}
 		}
 
-		for (fi = quad.features.begin(); fi != quad.features.end(); ++fi) {
+		for (fi = quad.features.rbegin(); fi != quad.features.rend(); ++fi) {
 			const float totRad = radius + (*fi)->radius;
 			if ((*fi)->tempNum != tempNum
 					&& (pos - (*fi)->midPos).SqLength() < (totRad * totRad))
@@ -5,7 +5,6 @@
 
 #include <set>
 #include <vector>
-#include <list>
 #include <boost/noncopyable.hpp>
 
 #include "creg/creg_cond.h"
@@ -36,6 +35,16 @@ public:
 	void GetQuadsOnRay(float3 start, float3 dir, float length, int*& dst);
 	void GetUnitsAndFeaturesExact(const float3& pos, float radius, CUnit**& dstUnit, CFeature**& dstFeature);
 
+	/**
+	 * Allocation-free variants of the queries below: @c dst is cleared
+	 * first and filled with the results, so a caller that keeps the
+	 * vector around between calls only pays for it once.
+	 */
+	void GetQuadsOnRay(const float3& start, float3 dir, float length, std::vector<int>& dst);
+	void GetUnitsExact(const float3& pos, float radius, std::vector<CUnit*>& dst, bool spherical = true);
+	void GetFeaturesExact(const float3& pos, float radius, std::vector<CFeature*>& dst);
+	void GetSolidsExact(const float3& pos, float radius, std::vector<CSolidObject*>& dst);
+
 	/**
 	 * Returns all units within @c radius of @c pos,
 	 * and treats each unit as a 3D point object
@@ -61,12 +70,17 @@ public:
 	void AddFeature(CFeature* feature);
 	void RemoveFeature(CFeature* feature);
 
+	/**
+	 * Objects are stored in contiguous vectors, oldest first: new objects
+	 * are appended and removal keeps the order of the rest. Iterate back
+	 * to front to visit them in query order (newest first).
+	 */
 	struct Quad {
 		CR_DECLARE_STRUCT(Quad);
 		Quad();
-		std::list<CUnit*> units;
-		std::vector< std::list<CUnit*> > teamUnits;
-		std::list<CFeature*> features;
+		std::vector<CUnit*> units;
+		std::vector< std::vector<CUnit*> > teamUnits;
+		std::vector<CFeature*> features;
 	};
 
 	const Quad& GetQuad(int i) const {
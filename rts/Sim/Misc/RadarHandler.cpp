@@ -116,8 +116,8 @@ void CRadarHandler::MoveUnit(CUnit* unit)
 		if (unit->radarRadius) {
 			airRadarMaps[unit->allyteam].AddMapArea(newPos, unit->radarRadius, 1);
 			if (!circularRadar) {
-				radarAlgo.LosAdd(newPos, unit->radarRadius, unit->height, unit->radarSquares);
-				radarMaps[unit->allyteam].AddMapSquares(unit->radarSquares, 1);
+				radarAlgo.LosAdd(newPos, unit->radarRadius, unit->height, unit->radarSpans);
+				radarMaps[unit->allyteam].AddMapSpans(unit->radarSpans, 1);
 			}
 		}
 		if (unit->sonarRadius) {
@@ -154,8 +154,8 @@ void CRadarHandler::RemoveUnit(CUnit* unit)
 		if (unit->radarRadius) {
 			airRadarMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, unit->radarRadius, -1);
 			if (!circularRadar) {
-				radarMaps[unit->allyteam].AddMapSquares(unit->radarSquares, -1);
-				unit->radarSquares.clear();
+				radarMaps[unit->allyteam].AddMapSpans(unit->radarSpans, -1);
+				unit->radarSpans.clear();
 			}
 		}
 		if (unit->sonarRadius) {
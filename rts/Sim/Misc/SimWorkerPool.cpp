@@ -0,0 +1,132 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StdAfx.h"
+#include <algorithm>
+#include <boost/bind.hpp>
+#include "mmgr.h"
+
+#include "SimWorkerPool.h"
+#include "lib/gml/gml.h"
+#include "System/ConfigHandler.h"
+
+
+CSimWorkerPool::CSimWorkerPool()
+	: numWorkers(0)
+	, func(NULL)
+	, count(0)
+	, chunkSize(1)
+	, nextBegin(0)
+	, numDone(0)
+	, jobNum(0)
+	, stopping(false)
+{
+	int numThreads = configHandler->Get("HardwareThreadCount", 0);
+
+	if (numThreads <= 0) {
+		#if (BOOST_VERSION >= 103500)
+		numThreads = boost::thread::hardware_concurrency();
+		#elif defined(USE_GML)
+		numThreads = gmlCPUCount();
+		#else
+		numThreads = 1;
+		#endif
+	}
+
+	// the sim thread does its share of every job
+	numWorkers = std::max(0, std::min(numThreads, 16) - 1);
+
+	for (int i = 0; i < numWorkers; ++i) {
+		workers.create_thread(boost::bind(&CSimWorkerPool::WorkerThread, this));
+	}
+}
+
+CSimWorkerPool::~CSimWorkerPool()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		stopping = true;
+		jobCond.notify_all();
+	}
+
+	workers.join_all();
+}
+
+
+void CSimWorkerPool::WorkerThread()
+{
+#ifdef STREFLOP_H
+	//! the results feed into synced state
+	streflop_init<streflop::Simple>();
+#endif
+
+	boost::mutex::scoped_lock lock(mutex);
+	unsigned int lastJob = jobNum;
+
+	while (true) {
+		while (!stopping && jobNum == lastJob) {
+			jobCond.wait(lock);
+		}
+
+		if (stopping) {
+			break;
+		}
+
+		// a worker that wakes up late finds no chunks left
+		lastJob = jobNum;
+		RunChunks(lock);
+	}
+}
+
+void CSimWorkerPool::RunChunks(boost::mutex::scoped_lock& lock)
+{
+	while (nextBegin < count) {
+		const int begin = nextBegin;
+		const int end = std::min(begin + chunkSize, count);
+
+		nextBegin = end;
+
+		lock.unlock();
+		(*func)(begin, end);
+		lock.lock();
+
+		numDone += (end - begin);
+
+		if (numDone == count) {
+			doneCond.notify_all();
+		}
+	}
+}
+
+
+void CSimWorkerPool::Run(const RangeFunc& f, int n, int chunk)
+{
+	if (n <= 0) {
+		return;
+	}
+
+	// not worth waking anybody up for
+	if (numWorkers == 0 || n <= chunk) {
+		f(0, n);
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	func = &f;
+	count = n;
+	chunkSize = chunk;
+	nextBegin = 0;
+	numDone = 0;
+
+	++jobNum;
+	jobCond.notify_all();
+
+	RunChunks(lock);
+
+	while (numDone < count) {
+		doneCond.wait(lock);
+	}
+
+	func = NULL;
+	count = 0;
+}
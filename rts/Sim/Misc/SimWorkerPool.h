@@ -0,0 +1,54 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SIM_WORKER_POOL_H
+#define SIM_WORKER_POOL_H
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+ * Runs the read-only stages of a sim frame on a set of persistent threads.
+ *
+ * Run() splits [0, count) into chunks and hands them to the workers and the
+ * calling thread, then returns once every chunk is done. The function may
+ * only read sim state and write the output slots of its own range; all side
+ * effects have to be applied afterwards, serially and in a fixed order, by
+ * the caller. Which thread computes a slot thus never shows in the result.
+ */
+class CSimWorkerPool : boost::noncopyable
+{
+public:
+	/// called with a range [begin, end)
+	typedef boost::function<void(int, int)> RangeFunc;
+
+	CSimWorkerPool();
+	~CSimWorkerPool();
+
+	void Run(const RangeFunc& func, int count, int chunkSize);
+
+	int GetNumThreads() const { return numWorkers + 1; }
+
+private:
+	void WorkerThread();
+	void RunChunks(boost::mutex::scoped_lock& lock);
+
+	boost::thread_group workers;
+	int numWorkers;
+
+	boost::mutex mutex;
+	boost::condition_variable jobCond;
+	boost::condition_variable doneCond;
+
+	const RangeFunc* func;
+	int count;
+	int chunkSize;
+	int nextBegin;
+	int numDone;
+	unsigned int jobNum;
+	bool stopping;
+};
+
+#endif // SIM_WORKER_POOL_H
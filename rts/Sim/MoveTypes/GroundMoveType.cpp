@@ -12,6 +12,7 @@
 #include "Map/Ground.h"
 #include "Map/MapInfo.h"
 #include "Map/ReadMap.h"
+#include "MoveCollisionGrid.h"
 #include "MoveMath/MoveMath.h"
 #include "Sim/Features/Feature.h"
 #include "Sim/Features/FeatureHandler.h"
@@ -56,6 +57,7 @@ CR_REG_METADATA(CGroundMoveType, (
 
 	CR_MEMBER(pathId),
 	CR_MEMBER(goalRadius),
+	CR_MEMBER(pathPending),
 
 	CR_MEMBER(waypoint),
 	CR_MEMBER(nextWaypoint),
@@ -121,6 +123,7 @@ CGroundMoveType::CGroundMoveType(CUnit* owner):
 	nextWaypoint(ZeroVector),
 	atGoal(false),
 	haveFinalWaypoint(false),
+	pathPending(false),
 	currentDistanceToWaypoint(0),
 
 	skidding(false),
@@ -211,6 +214,10 @@ bool CGroundMoveType::Update()
 			if (pathId == 0) {
 				SetDeltaSpeed(0.0f, false);
 				SetMainHeading();
+			} else if (!ReceivePath()) {
+				// the path search has not been done yet (or found nothing)
+				SetDeltaSpeed(0.0f, false);
+				SetMainHeading();
 			} else {
 				// TODO: Stop the unit from moving as a reaction on collision/explosion physics.
 				ASSERT_SYNCED_FLOAT3(waypoint);
@@ -291,15 +298,16 @@ bool CGroundMoveType::Update()
 
 	if (owner->pos != oldPos) {
 		TestNewTerrainSquare();
-		HandleObjectCollisions();
 
-		owner->speed = owner->pos - oldPos;
-		owner->UpdateMidPos();
+		if (uh->collisionGrid.IsBuilt()) {
+			// resolved after all units have moved this frame
+			owner->UpdateMidPos();
+			uh->collisionGrid.AddMovedUnit(this);
+		} else {
+			HandleObjectCollisions();
+			UpdateOwnerSpeed();
+		}
 
-		// HandleObjectCollisions() may have negated the position set by
-		// UpdateOwnerPos() (so that owner->pos is again equal to oldPos)
-		idling = (owner->speed.SqLength() < (accRate * accRate));
-		oldPos = owner->pos;
 		hasMoved = true;
 	} else {
 		owner->speed = ZeroVector;
@@ -309,6 +317,17 @@ bool CGroundMoveType::Update()
 	return hasMoved;
 }
 
+void CGroundMoveType::UpdateOwnerSpeed()
+{
+	owner->speed = owner->pos - oldPos;
+	owner->UpdateMidPos();
+
+	// HandleObjectCollisions() may have negated the position set by
+	// UpdateOwnerPos() (so that owner->pos is again equal to oldPos)
+	idling = (owner->speed.SqLength() < (accRate * accRate));
+	oldPos = owner->pos;
+}
+
 void CGroundMoveType::SlowUpdate()
 {
 	if (owner->transporter) {
@@ -949,7 +968,26 @@ float3 CGroundMoveType::ObstacleAvoidance(const float3& desiredDir) {
 			CMoveMath* moveMath = moveData->moveMath;
 			moveData->tempOwner = owner;
 
-			const vector<CSolidObject*> &nearbyObjects = qf->GetSolidsExact(owner->pos, speedf * 35 + 30 + owner->xsize / 2);
+			static vector<CSolidObject*> nearbyObjects;
+			static vector<CFeature*> nearbyFeatures;
+
+			const float searchRadius = speedf * 35 + 30 + owner->xsize / 2;
+
+			if (uh->collisionGrid.IsBuilt()) {
+				// units come from this frame's collision grid, only
+				// the features still need a quadfield query
+				uh->collisionGrid.GetSolidsExact(owner->pos, searchRadius, nearbyObjects);
+				qf->GetFeaturesExact(owner->pos, searchRadius, nearbyFeatures);
+
+				for (vector<CFeature*>::const_iterator fi = nearbyFeatures.begin(); fi != nearbyFeatures.end(); ++fi) {
+					if ((*fi)->blocking) {
+						nearbyObjects.push_back(*fi);
+					}
+				}
+			} else {
+				qf->GetSolidsExact(owner->pos, searchRadius, nearbyObjects);
+			}
+
 			vector<CSolidObject*> objectsOnPath;
 
 			for (vector<CSolidObject*>::const_iterator oi = nearbyObjects.begin(); oi != nearbyObjects.end(); ++oi) {
@@ -1082,19 +1120,20 @@ float CGroundMoveType::Distance2D(CSolidObject* object1, CSolidObject* object2,
 	return dist2D;
 }
 
-// Creates a path to the goal.
+// Requests a path to the goal, see ReceivePath.
 void CGroundMoveType::GetNewPath()
 {
 	pathManager->DeletePath(pathId);
-	pathId = pathManager->RequestPath(owner->mobility, owner->pos, goalPos, goalRadius, owner);
+	pathId = pathManager->RequestPathDeferred(owner->mobility, owner->pos, goalPos, goalRadius, owner);
 
-	// if new path received, can't be at waypoint
+	// if new path requested, can't be at waypoint
 	if (pathId != 0) {
 		atGoal = false;
 		haveFinalWaypoint = false;
+		pathPending = true;
 
 		waypoint = owner->pos;
-		nextWaypoint = pathManager->NextWaypoint(pathId, waypoint, 1.25f * SQUARE_SIZE, 0, owner->id);
+		nextWaypoint = owner->pos;
 	} else {
 		Fail();
 	}
@@ -1103,6 +1142,37 @@ void CGroundMoveType::GetNewPath()
 	pathRequestDelay = gs->frameNum + (UNIT_SLOWUPDATE_RATE << 1);
 }
 
+/*
+The search for a requested path is done by the path manager a few
+frames later; returns true once the path can be followed. Fails the
+move if the search found no path.
+*/
+bool CGroundMoveType::ReceivePath()
+{
+	if (!pathPending) {
+		return true;
+	}
+
+	switch (pathManager->GetPathState(pathId)) {
+		case IPathManager::PATH_PENDING: {
+			return false;
+		}
+		case IPathManager::PATH_READY: {
+			pathPending = false;
+
+			waypoint = owner->pos;
+			nextWaypoint = pathManager->NextWaypoint(pathId, waypoint, 1.25f * SQUARE_SIZE, 0, owner->id);
+			return true;
+		}
+		default: {
+			pathPending = false;
+
+			Fail();
+			return false;
+		}
+	}
+}
+
 
 /*
 Sets waypoint to next in path.
@@ -1110,7 +1180,7 @@ Sets waypoint to next in path.
 void CGroundMoveType::GetNextWaypoint()
 {
 
-	if (pathId == 0) {
+	if (pathId == 0 || pathPending) {
 		return;
 	}
 
@@ -1208,6 +1278,7 @@ void CGroundMoveType::StopEngine() {
 	if (pathId != 0) {
 		pathManager->DeletePath(pathId);
 		pathId = 0;
+		pathPending = false;
 
 		if (!atGoal) {
 			waypoint = Here();
@@ -1280,7 +1351,12 @@ void CGroundMoveType::Fail()
 
 void CGroundMoveType::HandleObjectCollisions()
 {
-	//FIXME move this to a global space to optimize the check (atm unit collision checks are done twice for the collider & collidee!)
+	static std::vector<CUnit*> nearUnits;
+	static std::vector<CFeature*> nearFeatures;
+
+	// set during the movetype update phase; a pair of units is then only
+	// resolved by whichever of the two gets here first
+	CMoveCollisionGrid* collisionGrid = uh->collisionGrid.IsBuilt()? &uh->collisionGrid: NULL;
 
 	CUnit* collider = owner;
 	collider->mobility->tempOwner = collider;
@@ -1299,8 +1375,13 @@ void CGroundMoveType::HandleObjectCollisions()
 			FOOTPRINT_RADIUS(colliderMD->xsize, colliderMD->zsize):
 			FOOTPRINT_RADIUS(colliderUD->xsize, colliderUD->zsize);
 
-		const std::vector<CUnit*>& nearUnits = qf->GetUnitsExact(colliderCurPos, colliderRadius * 2.0f);
-		const std::vector<CFeature*>& nearFeatures = qf->GetFeaturesExact(colliderCurPos, colliderRadius * 2.0f);
+		if (collisionGrid != NULL) {
+			collisionGrid->GetUnitsExact(colliderCurPos, colliderRadius * 2.0f, nearUnits);
+		} else {
+			qf->GetUnitsExact(colliderCurPos, colliderRadius * 2.0f, nearUnits);
+		}
+
+		qf->GetFeaturesExact(colliderCurPos, colliderRadius * 2.0f, nearFeatures);
 
 		std::vector<CUnit*>::const_iterator uit;
 		std::vector<CFeature*>::const_iterator fit;
@@ -1311,14 +1392,19 @@ void CGroundMoveType::HandleObjectCollisions()
 			if (collidee == collider) {
 				continue;
 			}
+			if (collisionGrid != NULL && collisionGrid->IsPairResolved(collider, collidee)) {
+				continue;
+			}
 
 			const UnitDef*   collideeUD = collidee->unitDef;
 			const MoveData*  collideeMD = collidee->mobility;
 			const CMoveMath* collideeMM = (collideeMD != NULL)? collideeMD->moveMath: NULL;
 
 			const float3& collideeCurPos = collidee->pos;
-			const float3& collideeOldPos = collidee->moveType->oldPos;
- 
+			const float3& collideeOldPos = (collisionGrid != NULL)?
+				collisionGrid->GetResetPos(collidee):
+				collidee->moveType->oldPos;
+
 			const bool collideeMobile = (collideeMD != NULL);
 			const float collideeSpeed = collidee->speed.Length();
 			const float collideeRadius = collideeMobile?
@@ -1343,6 +1429,12 @@ void CGroundMoveType::HandleObjectCollisions()
 			if (colliderMM->IsNonBlocking(*colliderMD, collidee)) { continue; }
 			if (!collideeMobile && (colliderMM->IsBlocked(*colliderMD, colliderCurPos) & CMoveMath::BLOCK_STRUCTURE) == 0) { continue; }
 
+			// when the collidee is not pushed it still has to
+			// resolve the pair from its own side (if it moved)
+			if (collisionGrid != NULL && pushCollidee) {
+				collisionGrid->SetPairResolved(collider, collidee);
+			}
+
 			eventHandler.UnitUnitCollision(collider, collidee);
 
 			const float  sepDistance    = (separationVector.Length() + 0.01f);
@@ -1401,6 +1493,10 @@ void CGroundMoveType::HandleObjectCollisions()
 			collider->UpdateMidPos();
 			collidee->UpdateMidPos();
 
+			if (collisionGrid != NULL) {
+				collisionGrid->MovedUnit(collidee);
+			}
+
 			if (!((gs->frameNum + collider->id) & 31) && !collider->commandAI->unimportantMove) {
 				// if we do not have an internal move order, tell units around us to bugger off
 				helper->BuggerOff(colliderCurPos + collider->frontdir * colliderRadius, colliderRadius, true, false, collider->team, collider);
@@ -1478,6 +1574,10 @@ void CGroundMoveType::HandleObjectCollisions()
 		#undef FOOTPRINT_RADIUS
 	}
 
+	if (collisionGrid != NULL) {
+		collisionGrid->MovedUnit(collider);
+	}
+
 	collider->mobility->tempOwner = NULL;
 	collider->Block();
 }
@@ -1660,7 +1760,7 @@ void CGroundMoveType::TestNewTerrainSquare()
 				CMoveMath::BLOCK_MOBILE |
 				CMoveMath::BLOCK_MOBILE_BUSY;
 
-			while ((nwsx * nwsx + nwsy * nwsy) < LINETABLE_SIZE && !haveFinalWaypoint && pathId != 0) {
+			while ((nwsx * nwsx + nwsy * nwsy) < LINETABLE_SIZE && !haveFinalWaypoint && pathId != 0 && !pathPending) {
 				const int ltx = nwsx + LINETABLE_SIZE / 2;
 				const int lty = nwsy + LINETABLE_SIZE / 2;
 				bool wpOk = true;
@@ -46,6 +46,10 @@ public:
 	bool IsFlying() const { return flying; }
 	bool IsReversing() const { return reversing; }
 
+	/// run by CMoveCollisionGrid::ResolveCollisions when Update() deferred them
+	void HandleObjectCollisions();
+	void UpdateOwnerSpeed();
+
 	static void CreateLineTable();
 	static void DeleteLineTable();
 
@@ -72,6 +76,7 @@ protected:
 	float Distance2D(CSolidObject* object1, CSolidObject* object2, float marginal = 0.0f);
 
 	void GetNewPath();
+	bool ReceivePath();
 	void GetNextWaypoint();
 
 	float BreakingDistance(float speed) const;
@@ -82,7 +87,6 @@ protected:
 
 	void Arrived();
 	void Fail();
-	void HandleObjectCollisions();
 
 	void SetMainHeading();
 	void ChangeHeading(short wantedHeading);
@@ -101,6 +105,7 @@ protected:
 
 	bool atGoal;
 	bool haveFinalWaypoint;
+	bool pathPending; ///< pathId was requested deferred and not received yet
 	float currentDistanceToWaypoint;
 
 	bool skidding;
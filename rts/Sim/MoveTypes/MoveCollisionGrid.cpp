@@ -0,0 +1,291 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StdAfx.h"
+#include <algorithm>
+#include <boost/bind.hpp>
+#include "mmgr.h"
+
+#include "MoveCollisionGrid.h"
+#include "GroundMoveType.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/SimWorkerPool.h"
+#include "Sim/Units/Unit.h"
+#include "Sim/Units/UnitHandler.h"
+
+/**
+ * Transported units are taken out of the quadfield (CTransportUnit::AttachUnit)
+ * but stay blocking, the grid must not return them either.
+ */
+static inline bool InQuadField(const CUnit* unit)
+{
+	return (unit->transporter == NULL && !unit->quads.empty());
+}
+
+
+CMoveCollisionGrid::CMoveCollisionGrid()
+	: numCellsX(0)
+	, numCellsZ(0)
+	, buildNum(0)
+	, built(false)
+{
+}
+
+
+CMoveCollisionGrid::CellRect CMoveCollisionGrid::GetCellRect(const float3& pos, float radius) const
+{
+	CellRect r;
+	r.x1 = std::max(0, std::min(int((pos.x - radius) / CELL_SIZE), numCellsX - 1));
+	r.z1 = std::max(0, std::min(int((pos.z - radius) / CELL_SIZE), numCellsZ - 1));
+	r.x2 = std::max(0, std::min(int((pos.x + radius) / CELL_SIZE), numCellsX - 1));
+	r.z2 = std::max(0, std::min(int((pos.z + radius) / CELL_SIZE), numCellsZ - 1));
+	return r;
+}
+
+
+void CMoveCollisionGrid::CalcBuildRects(const std::vector<CUnit*>* units, int begin, int end)
+{
+	for (int i = begin; i < end; ++i) {
+		const CUnit* unit = (*units)[i];
+
+		if (!InQuadField(unit)) {
+			buildRects[i].x1 = -1;
+			continue;
+		}
+
+		// a unit covers every cell it can reach before the end of the
+		// phase, so a query never has to look wider than its own radius
+		const AMoveType* moveType = unit->moveType;
+		const float reach = std::max(moveType->maxSpeed, unit->speed.Length()) * 2.0f + SQUARE_SIZE;
+
+		buildRects[i] = GetCellRect(unit->midPos, unit->radius + reach);
+	}
+}
+
+
+void CMoveCollisionGrid::Build(const std::vector<CUnit*>& units, CSimWorkerPool& workers)
+{
+	numCellsX = std::max(1, (gs->mapx * SQUARE_SIZE + CELL_SIZE - 1) / CELL_SIZE);
+	numCellsZ = std::max(1, (gs->mapy * SQUARE_SIZE + CELL_SIZE - 1) / CELL_SIZE);
+
+	const int numCells = numCellsX * numCellsZ;
+	const int numUnits = units.size();
+
+	cellStarts.assign(numCells + 1, 0);
+
+	if (resolvedPairs.size() < uh->MaxUnits()) {
+		resolvedPairs.resize(uh->MaxUnits());
+		unitRects.resize(uh->MaxUnits());
+		unitBuildNums.resize(uh->MaxUnits(), 0);
+		looseBuildNums.resize(uh->MaxUnits(), 0);
+		movedPositions.resize(uh->MaxUnits());
+		movedBuildNums.resize(uh->MaxUnits(), 0);
+	}
+
+	// invalidates all per-unit state of the previous frame
+	++buildNum;
+
+	buildRects.resize(numUnits);
+	workers.Run(boost::bind(&CMoveCollisionGrid::CalcBuildRects, this, &units, _1, _2), numUnits, 256);
+
+	// count the units per cell
+	for (int i = 0; i < numUnits; ++i) {
+		const CellRect& r = buildRects[i];
+
+		if (r.x1 < 0) {
+			continue;
+		}
+
+		unitRects[units[i]->id] = r;
+		unitBuildNums[units[i]->id] = buildNum;
+
+		for (int z = r.z1; z <= r.z2; ++z) {
+			for (int x = r.x1; x <= r.x2; ++x) {
+				++cellStarts[z * numCellsX + x];
+			}
+		}
+	}
+
+	// turn the counts into end offsets, then fill every cell back
+	// to front; going over the units in reverse keeps each cell in
+	// update order and leaves cellStarts at the start offsets
+	for (int c = 1; c < numCells; ++c) {
+		cellStarts[c] += cellStarts[c - 1];
+	}
+	cellStarts[numCells] = cellStarts[numCells - 1];
+	cellUnits.resize(cellStarts[numCells]);
+
+	for (int i = numUnits - 1; i >= 0; --i) {
+		const CellRect& r = buildRects[i];
+
+		if (r.x1 < 0) {
+			continue;
+		}
+
+		for (int z = r.z1; z <= r.z2; ++z) {
+			for (int x = r.x1; x <= r.x2; ++x) {
+				cellUnits[--cellStarts[z * numCellsX + x]] = units[i];
+			}
+		}
+	}
+
+	built = true;
+}
+
+
+void CMoveCollisionGrid::Clear()
+{
+	for (std::vector<int>::const_iterator ui = resolvedUnits.begin(); ui != resolvedUnits.end(); ++ui) {
+		resolvedPairs[*ui].clear();
+	}
+
+	resolvedUnits.clear();
+	looseUnits.clear();
+	movedUnits.clear();
+
+	built = false;
+}
+
+
+void CMoveCollisionGrid::MovedUnit(CUnit* unit)
+{
+	if (!built || looseBuildNums[unit->id] == buildNum) {
+		return;
+	}
+	if (unit->transporter != NULL) {
+		return;
+	}
+
+	if (unitBuildNums[unit->id] == buildNum) {
+		// a query finds the unit as long as its footprint stays
+		// inside the cells it was binned into
+		const CellRect& b = unitRects[unit->id];
+		const CellRect r = GetCellRect(unit->midPos, unit->radius);
+
+		if (r.x1 >= b.x1 && r.x2 <= b.x2 && r.z1 >= b.z1 && r.z2 <= b.z2) {
+			return;
+		}
+	}
+
+	looseBuildNums[unit->id] = buildNum;
+	looseUnits.push_back(unit);
+}
+
+
+void CMoveCollisionGrid::GetUnitsExact(const float3& pos, float radius, std::vector<CUnit*>& dst) const
+{
+	dst.clear();
+
+	const CellRect r = GetCellRect(pos, radius);
+	const int tempNum = gs->tempNum++;
+
+	for (int z = r.z1; z <= r.z2; ++z) {
+		for (int x = r.x1; x <= r.x2; ++x) {
+			const int cell = z * numCellsX + x;
+
+			for (int i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i) {
+				CUnit* unit = cellUnits[i];
+
+				if (unit->tempNum == tempNum || unit->transporter != NULL) {
+					continue;
+				}
+
+				unit->tempNum = tempNum;
+
+				const float totRad = radius + unit->radius;
+
+				if ((pos - unit->midPos).SqLength() < (totRad * totRad)) {
+					dst.push_back(unit);
+				}
+			}
+		}
+	}
+
+	for (std::vector<CUnit*>::const_iterator ui = looseUnits.begin(); ui != looseUnits.end(); ++ui) {
+		CUnit* unit = *ui;
+
+		if (unit->tempNum == tempNum || unit->transporter != NULL) {
+			continue;
+		}
+
+		unit->tempNum = tempNum;
+
+		const float totRad = radius + unit->radius;
+
+		if ((pos - unit->midPos).SqLength() < (totRad * totRad)) {
+			dst.push_back(unit);
+		}
+	}
+}
+
+void CMoveCollisionGrid::GetSolidsExact(const float3& pos, float radius, std::vector<CSolidObject*>& dst) const
+{
+	static std::vector<CUnit*> units;
+
+	GetUnitsExact(pos, radius, units);
+	dst.clear();
+
+	for (std::vector<CUnit*>::const_iterator ui = units.begin(); ui != units.end(); ++ui) {
+		if ((*ui)->blocking) {
+			dst.push_back(*ui);
+		}
+	}
+}
+
+
+void CMoveCollisionGrid::ResolveCollisions()
+{
+	std::vector<CGroundMoveType*>::const_iterator mi;
+
+	// every unit has moved by now; give the mass scaling this frame's
+	// speeds and remember where each unit got to on its own
+	for (mi = movedUnits.begin(); mi != movedUnits.end(); ++mi) {
+		CUnit* owner = (*mi)->owner;
+
+		owner->speed = owner->pos - (*mi)->oldPos;
+		movedPositions[owner->id] = owner->pos;
+		movedBuildNums[owner->id] = buildNum;
+	}
+
+	// a unit's oldPos is its resolved position from here on, exactly
+	// as if it had resolved its collisions in its own Update()
+	for (mi = movedUnits.begin(); mi != movedUnits.end(); ++mi) {
+		(*mi)->HandleObjectCollisions();
+		(*mi)->UpdateOwnerSpeed();
+
+		movedBuildNums[(*mi)->owner->id] = 0;
+	}
+
+	movedUnits.clear();
+}
+
+
+bool CMoveCollisionGrid::IsPairResolved(const CUnit* a, const CUnit* b) const
+{
+	const std::vector<int>& pairsA = resolvedPairs[a->id];
+	const std::vector<int>& pairsB = resolvedPairs[b->id];
+
+	return
+		(std::find(pairsA.begin(), pairsA.end(), b->id) != pairsA.end()) ||
+		(std::find(pairsB.begin(), pairsB.end(), a->id) != pairsB.end());
+}
+
+const float3& CMoveCollisionGrid::GetResetPos(const CUnit* unit) const
+{
+	if (built && movedBuildNums[unit->id] == buildNum) {
+		return movedPositions[unit->id];
+	}
+
+	return unit->moveType->oldPos;
+}
+
+void CMoveCollisionGrid::SetPairResolved(const CUnit* a, const CUnit* b)
+{
+	std::vector<int>& pairsA = resolvedPairs[a->id];
+
+	if (pairsA.empty()) {
+		resolvedUnits.push_back(a->id);
+	}
+
+	pairsA.push_back(b->id);
+}
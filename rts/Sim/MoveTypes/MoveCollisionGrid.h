@@ -0,0 +1,109 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef MOVE_COLLISION_GRID_H
+#define MOVE_COLLISION_GRID_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+#include "float3.h"
+
+class CUnit;
+class CSolidObject;
+class CGroundMoveType;
+class CSimWorkerPool;
+
+/**
+ * Broadphase for the unit-unit collisions of ground units.
+ *
+ * Built once per frame at the start of the movetype update phase: every
+ * active unit is binned into the cells covered by its radius plus the
+ * distance it can normally travel during that phase. The cells of each
+ * unit are computed in parallel over the contiguous unit array; binning
+ * them is done serially in update order. Units that leave those cells
+ * anyway (pushed several times, teleported by Lua) or that are created
+ * during the phase are reported through MovedUnit() and kept in a list
+ * every query also checks, so a query always sees each unit at its live
+ * position.
+ * Transported units are not in the quadfield and are skipped here too.
+ *
+ * Ground units that moved do not resolve their collisions right away but
+ * register with AddMovedUnit(); ResolveCollisions() then handles all of
+ * them in update order. A pair in which both units were pushed is not
+ * resolved again by the second unit.
+ */
+class CMoveCollisionGrid : boost::noncopyable
+{
+public:
+	CMoveCollisionGrid();
+
+	void Build(const std::vector<CUnit*>& units, CSimWorkerPool& workers);
+	void Clear();
+	bool IsBuilt() const { return built; }
+
+	/// unit may have left the cells it was binned into, or was not binned yet
+	void MovedUnit(CUnit* unit);
+
+	/// same units as CQuadField::GetUnitsExact(pos, radius, dst, true)
+	void GetUnitsExact(const float3& pos, float radius, std::vector<CUnit*>& dst) const;
+	/// the blocking units CQuadField::GetSolidsExact would return, features are not binned
+	void GetSolidsExact(const float3& pos, float radius, std::vector<CSolidObject*>& dst) const;
+
+	void AddMovedUnit(CGroundMoveType* moveType) { movedUnits.push_back(moveType); }
+	void ResolveCollisions();
+
+	bool IsPairResolved(const CUnit* a, const CUnit* b) const;
+	void SetPairResolved(const CUnit* a, const CUnit* b);
+
+	/**
+	 * Where a collidee that may not be pushed is put back to: for a unit
+	 * still waiting in ResolveCollisions() that is its position after its
+	 * own move, otherwise its moveType's oldPos.
+	 */
+	const float3& GetResetPos(const CUnit* unit) const;
+
+private:
+	static const int CELL_SIZE = 64;
+
+	struct CellRect {
+		int x1, z1;
+		int x2, z2;
+	};
+
+	CellRect GetCellRect(const float3& pos, float radius) const;
+	/// read-only apart from buildRects[begin, end)
+	void CalcBuildRects(const std::vector<CUnit*>* units, int begin, int end);
+
+	int numCellsX;
+	int numCellsZ;
+
+	/// units of cell c are cellUnits[cellStarts[c] .. cellStarts[c + 1]]
+	std::vector<int> cellStarts;
+	std::vector<CUnit*> cellUnits;
+
+	/// per index into the unit array passed to Build, x1 < 0 if not binned
+	std::vector<CellRect> buildRects;
+
+	/// per unit id; the rect is valid if unitBuildNums[id] == buildNum
+	std::vector<CellRect> unitRects;
+	std::vector<int> unitBuildNums;
+
+	/// units outside their cells, see MovedUnit()
+	std::vector<CUnit*> looseUnits;
+	std::vector<int> looseBuildNums;
+
+	std::vector<CGroundMoveType*> movedUnits;
+
+	/// per unit id, valid while movedBuildNums[id] == buildNum
+	std::vector<float3> movedPositions;
+	std::vector<int> movedBuildNums;
+
+	/// ids of the units each unit resolved a collision with this frame
+	std::vector< std::vector<int> > resolvedPairs;
+	std::vector<int> resolvedUnits;
+
+	int buildNum;
+	bool built;
+};
+
+#endif // MOVE_COLLISION_GRID_H
@@ -210,6 +210,10 @@ CMoveInfo::CMoveInfo()
 	crc << CHoverMoveMath::noWaterMove;
 
 	moveInfoChecksum = crc.GetDigest();
+
+	for (std::vector<MoveData*>::iterator mi = moveData.begin(); mi != moveData.end(); ++mi) {
+		InitSpeedModMap(*mi);
+	}
 }
 
 
@@ -226,6 +230,84 @@ CMoveInfo::~CMoveInfo()
 }
 
 
+/// the movetypes treat squares with speedMod <= 0.01f as impassable
+static const float SPEEDMOD_MIN_PASSABLE = 0.01f;
+
+static unsigned char QuantizeSpeedMod(float speedMod, float step)
+{
+	if (speedMod <= 0.0f) {
+		return 0;
+	}
+	if (speedMod <= SPEEDMOD_MIN_PASSABLE) {
+		return 1;
+	}
+
+	// never round a square across either threshold
+	return std::max(2, std::min(int((speedMod - SPEEDMOD_MIN_PASSABLE) / step + 0.5f) + 1, 255));
+}
+
+void CMoveInfo::InitSpeedModMap(MoveData* md)
+{
+	std::vector<float> speedMods(gs->hmapx * gs->hmapy);
+	float maxSpeedMod = 0.0f;
+
+	for (int hz = 0; hz < gs->hmapy; ++hz) {
+		for (int hx = 0; hx < gs->hmapx; ++hx) {
+			const float speedMod = md->moveMath->CalcPosSpeedMod(*md, hx << 1, hz << 1);
+
+			speedMods[hx + hz * gs->hmapx] = speedMod;
+			maxSpeedMod = std::max(maxSpeedMod, speedMod);
+		}
+	}
+
+	// levels 2 to 255 cover (0.01, maxSpeedMod]
+	md->speedModStep = std::max((maxSpeedMod - SPEEDMOD_MIN_PASSABLE) / 254.0f, 0.0001f);
+	md->speedModLevels.resize(256);
+	md->speedModLevels[0] = 0.0f;
+	md->speedModLevels[1] = SPEEDMOD_MIN_PASSABLE;
+
+	for (int q = 2; q < 256; ++q) {
+		md->speedModLevels[q] = SPEEDMOD_MIN_PASSABLE + (q - 1) * md->speedModStep;
+	}
+
+	md->speedModMap.resize(speedMods.size());
+
+	for (unsigned int i = 0; i < speedMods.size(); ++i) {
+		md->speedModMap[i] = QuantizeSpeedMod(speedMods[i], md->speedModStep);
+	}
+}
+
+void CMoveInfo::UpdateSpeedModMap(MoveData* md, int hx1, int hz1, int hx2, int hz2)
+{
+	for (int hz = hz1; hz <= hz2; ++hz) {
+		for (int hx = hx1; hx <= hx2; ++hx) {
+			const float speedMod = md->moveMath->CalcPosSpeedMod(*md, hx << 1, hz << 1);
+
+			if (speedMod > (md->speedModLevels[255] + md->speedModStep)) {
+				// out of the quantized range (eg. after SetTerrainTypeData),
+				// choose a new step for the whole map
+				InitSpeedModMap(md);
+				return;
+			}
+
+			md->speedModMap[hx + hz * gs->hmapx] = QuantizeSpeedMod(speedMod, md->speedModStep);
+		}
+	}
+}
+
+void CMoveInfo::TerrainChange(int x1, int z1, int x2, int z2)
+{
+	// one square of slack on each side, the slope of a
+	// square depends on the heights around it
+	const int hx1 = std::max(0, (x1 >> 1) - 1), hx2 = std::min(gs->hmapx - 1, (x2 >> 1) + 1);
+	const int hz1 = std::max(0, (z1 >> 1) - 1), hz2 = std::min(gs->hmapy - 1, (z2 >> 1) + 1);
+
+	for (std::vector<MoveData*>::iterator mi = moveData.begin(); mi != moveData.end(); ++mi) {
+		UpdateSpeedModMap(*mi, hx1, hz1, hx2, hz2);
+	}
+}
+
+
 MoveData* CMoveInfo::GetMoveDataFromName(const std::string& name)
 {
 	map<string, int>::const_iterator it = name2moveData.find(name);
@@ -42,6 +42,8 @@ struct MoveData {
 
 		moveMath        = unitDefMD? unitDefMD->moveMath:        NULL;
 		tempOwner       = NULL;
+
+		speedModStep    = 0.0f;
 	}
 
 	enum MoveType {
@@ -99,6 +101,17 @@ struct MoveData {
 
 	CMoveMath* moveMath;
 	CSolidObject* tempOwner;
+
+	/**
+	 * CMoveMath::CalcPosSpeedMod for every square of the half-resolution
+	 * heightmap as an index into speedModLevels (level 0 is exactly 0,
+	 * level 1 stands for (0, 0.01], the rest are speedModStep apart). Only
+	 * the MoveData's owned by CMoveInfo have these, and they are not saved:
+	 * they are rebuilt from the map.
+	 */
+	std::vector<unsigned char> speedModMap;
+	std::vector<float> speedModLevels;
+	float speedModStep;
 };
 
 
@@ -115,7 +128,13 @@ public:
 	MoveData* GetMoveDataFromName(const std::string& name);
 	unsigned int moveInfoChecksum;
 
+	/// updates the speed-mod maps after the terrain in the given (heightmap-square) area changed
+	void TerrainChange(int x1, int z1, int x2, int z2);
+
 private:
+	void InitSpeedModMap(MoveData* md);
+	void UpdateSpeedModMap(MoveData* md, int hx1, int hz1, int hx2, int hz2);
+
 	CMoveMath* groundMoveMath;
 	CMoveMath* hoverMoveMath;
 	CMoveMath* seaMoveMath;
@@ -20,13 +20,27 @@ float CMoveMath::yLevel(const float3& pos) const
 }
 
 
-/* calculate the local speed-modifier for this movedata */
+/* look up the local speed-modifier for this movedata */
 float CMoveMath::GetPosSpeedMod(const MoveData& moveData, int xSquare, int zSquare) const
 {
 	if (xSquare < 0 || zSquare < 0 || xSquare >= gs->mapx || zSquare >= gs->mapy) {
 		return 0.0f;
 	}
 
+	// unit mobility copies share the maps of the MoveData they were made from
+	const MoveData& mapMoveData = *moveinfo->moveData[moveData.pathType];
+	const int square = (xSquare >> 1) + ((zSquare >> 1) * gs->hmapx);
+
+	return mapMoveData.speedModLevels[mapMoveData.speedModMap[square]];
+}
+
+/* calculate the local speed-modifier for this movedata */
+float CMoveMath::CalcPosSpeedMod(const MoveData& moveData, int xSquare, int zSquare) const
+{
+	if (xSquare < 0 || zSquare < 0 || xSquare >= gs->mapx || zSquare >= gs->mapy) {
+		return 0.0f;
+	}
+
 	const int square = (xSquare >> 1) + ((zSquare >> 1) * gs->hmapx);
 	const int squareTerrType = readmap->typemap[square];
 
@@ -223,11 +237,18 @@ int CMoveMath::SquareIsBlocked(const MoveData& moveData, int xSquare, int zSquar
 		return 1;
 	}
 
+	const int square = xSquare + zSquare * gs->mapx;
+
+	// nothing on this square that could block <moveData>
+	if (!groundBlockingObjectMap->CanBlock(moveData, square)) {
+		return 0;
+	}
+
 	int r = 0;
-	const BlockingMapCell& c = groundBlockingObjectMap->GetCell(xSquare + zSquare * gs->mapx);
+	const BlockingMapCell c = groundBlockingObjectMap->GetCell(square);
 
 	for (BlockingMapCellIt it = c.begin(); it != c.end(); it++) {
-		CSolidObject* obstacle = it->second;
+		CSolidObject* obstacle = *it;
 
 		if (IsNonBlocking(moveData, obstacle)) {
 			continue;
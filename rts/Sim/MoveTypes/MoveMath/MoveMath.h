@@ -22,7 +22,10 @@ public:
 	const static int BLOCK_STRUCTURE = 8;
 
 	// returns a speed-multiplier for given position or data
+	// (read from the quantized map of CMoveInfo::UpdateSpeedModMap)
 	float GetPosSpeedMod(const MoveData& moveData, int xSquare, int zSquare) const;
+	// the unquantized value GetPosSpeedMod(moveData, xSquare, zSquare) is based on
+	float CalcPosSpeedMod(const MoveData& moveData, int xSquare, int zSquare) const;
 	float GetPosSpeedMod(const MoveData& moveData, int xSquare, int zSquare, const float3& moveDir) const;
 	float GetPosSpeedMod(const MoveData& moveData, const float3& pos) const
 	{
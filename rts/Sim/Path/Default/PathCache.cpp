@@ -11,71 +11,248 @@
 
 using namespace std;
 
+// maximum number of paths kept per cache, the
+// table is twice as large to keep probes short
+static const int MAX_CACHED_PATHS = 128;
+static const int CACHE_TABLE_SIZE = MAX_CACHED_PATHS * 2;
+static const int CACHE_TABLE_MASK = CACHE_TABLE_SIZE - 1;
+
+// number of frames a cached path stays valid
+static const int CACHE_ITEM_LIFETIME = 200;
+
 CPathCache::CPathCache(int blocksX,int blocksZ)
-: blocksX(blocksX),
+: lruHead(-1),
+	lruTail(-1),
+	blocksX(blocksX),
 	blocksZ(blocksZ)
 {
-	numCacheHits=0;
-	numCacheMisses=0;
+	items.resize(MAX_CACHED_PATHS);
+	table.resize(CACHE_TABLE_SIZE, -1);
+	freeItems.reserve(MAX_CACHED_PATHS);
+
+	for (int i = MAX_CACHED_PATHS - 1; i >= 0; --i)
+		freeItems.push_back(i);
 }
 
 CPathCache::~CPathCache(void)
 {
-	logOutput.Print("Path cache hits %i %.0f%%",numCacheHits,(numCacheHits+numCacheMisses)!=0 ? float(numCacheHits)/float(numCacheHits+numCacheMisses)*100.0f : 0.0f);
-	for(std::map<unsigned int,CacheItem*>::iterator ci=cachedPaths.begin();ci!=cachedPaths.end();++ci)
-		delete ci->second;
+	const unsigned int numHits = stats.numHits + stats.numPartialHits;
+	const unsigned int numRequests = numHits + stats.numMisses;
+
+	logOutput.Print("Path cache hits %u (%u partial) %.0f%%, evictions %u",
+		numHits, stats.numPartialHits,
+		(numRequests != 0)? float(numHits) / float(numRequests) * 100.0f: 0.0f,
+		stats.numEvictions);
+}
+
+unsigned int CPathCache::GetHash(int2 startBlock, int2 goalBlock, float goalRadius, int pathType) const
+{
+	unsigned int hash = (startBlock.y * blocksX + startBlock.x);
+	hash = hash * 2654435761u + (goalBlock.y * blocksX + goalBlock.x);
+	hash = hash * 2654435761u + (unsigned int) max(0.0f, goalRadius);
+	hash = hash * 2654435761u + pathType;
+	return (hash ^ (hash >> 16));
 }
 
-void CPathCache::AddPath(IPath::Path* path, IPath::SearchResult result, int2 startBlock,int2 goalBlock,float goalRadius,int pathType)
+int CPathCache::FindItem(int2 startBlock, int2 goalBlock, float goalRadius, int pathType, unsigned int hash) const
 {
-	if(cacheQue.size()>100)
-		RemoveFrontQueItem();
+	for (int slot = hash & CACHE_TABLE_MASK; table[slot] != -1; slot = (slot + 1) & CACHE_TABLE_MASK) {
+		const CacheItem& ci = items[table[slot]];
+
+		if (ci.hash != hash)
+			continue;
+		if (ci.startBlock.x != startBlock.x || ci.startBlock.y != startBlock.y)
+			continue;
+		if (ci.goalBlock.x != goalBlock.x || ci.goalBlock.y != goalBlock.y)
+			continue;
+		if (ci.goalRadius != goalRadius || ci.pathType != pathType)
+			continue;
+
+		return table[slot];
+	}
 
-	unsigned int hash=(unsigned int)(((((goalBlock.y)*blocksX+goalBlock.x)*blocksZ+startBlock.y)*blocksX)+startBlock.x*(pathType+1)*max(1.0f,goalRadius));
+	return -1;
+}
 
-	if(cachedPaths.find(hash)!=cachedPaths.end()){
+/**
+ * Look for a cached path to the same goal that passes through
+ * <startBlock>; waypoints are stored goal-first, so everything
+ * before the waypoint in <startBlock> is the path from there on
+ */
+int CPathCache::FindPartialItem(int2 startBlock, int2 goalBlock, float goalRadius, int pathType, unsigned int* waypointIdx) const
+{
+	for (int itemIdx = lruHead; itemIdx != -1; itemIdx = items[itemIdx].lruNext) {
+		const CacheItem& ci = items[itemIdx];
+
+		if (ci.result != IPath::Ok)
+			continue;
+		if (ci.goalBlock.x != goalBlock.x || ci.goalBlock.y != goalBlock.y)
+			continue;
+		if (ci.goalRadius != goalRadius || ci.pathType != pathType)
+			continue;
+
+		// a path starting in the goal block itself is empty, skip index 0
+		for (unsigned int n = 1; n < ci.waypointBlocks.size(); n++) {
+			if (ci.waypointBlocks[n].x == startBlock.x && ci.waypointBlocks[n].y == startBlock.y) {
+				*waypointIdx = n;
+				return itemIdx;
+			}
+		}
+	}
+
+	return -1;
+}
+
+void CPathCache::AddPath(
+	const IPath::Path* path,
+	const std::vector<int2>& waypointBlocks,
+	const std::vector<float>& waypointCosts,
+	IPath::SearchResult result,
+	int2 startBlock,
+	int2 goalBlock,
+	float goalRadius,
+	int pathType
+) {
+	const unsigned int hash = GetHash(startBlock, goalBlock, goalRadius, pathType);
+
+	if (FindItem(startBlock, goalBlock, goalRadius, pathType, hash) != -1)
 		return;
+
+	if (freeItems.empty()) {
+		RemoveItem(lruTail);
+		++stats.numEvictions;
 	}
 
-	CacheItem* ci=new CacheItem;
-	ci->path=*path;
-	ci->result=result;
-	ci->startBlock=startBlock;
-	ci->goalBlock=goalBlock;
-	ci->goalRadius=goalRadius;
-	ci->pathType=pathType;
+	const int itemIdx = freeItems.back();
+	freeItems.pop_back();
 
-	cachedPaths[hash]=ci;
+	CacheItem& ci = items[itemIdx];
+	ci.path = *path;
+	ci.result = result;
+	ci.startBlock = startBlock;
+	ci.goalBlock = goalBlock;
+	ci.goalRadius = goalRadius;
+	ci.pathType = pathType;
+	ci.waypointBlocks = waypointBlocks;
+	ci.waypointCosts = waypointCosts;
+	ci.hash = hash;
+	ci.timeout = gs->frameNum + CACHE_ITEM_LIFETIME;
 
-	CacheQue cq;
-	cq.hash=hash;
-	cq.timeout=gs->frameNum+200;
+	int slot = hash & CACHE_TABLE_MASK;
+	while (table[slot] != -1)
+		slot = (slot + 1) & CACHE_TABLE_MASK;
 
-	cacheQue.push_back(cq);
+	table[slot] = itemIdx;
+	LinkLRU(itemIdx);
 }
 
-CPathCache::CacheItem* CPathCache::GetCachedPath(int2 startBlock,int2 goalBlock,float goalRadius,int pathType)
-{
-	unsigned int hash=(unsigned int)(((((goalBlock.y)*blocksX+goalBlock.x)*blocksZ+startBlock.y)*blocksX)+startBlock.x*(pathType+1)*max(1.0f,goalRadius));
+bool CPathCache::GetCachedPath(
+	int2 startBlock,
+	int2 goalBlock,
+	float goalRadius,
+	int pathType,
+	IPath::Path& path,
+	IPath::SearchResult& result
+) {
+	const unsigned int hash = GetHash(startBlock, goalBlock, goalRadius, pathType);
+	unsigned int waypointIdx = 0;
+	int itemIdx = FindItem(startBlock, goalBlock, goalRadius, pathType, hash);
+
+	if (itemIdx != -1) {
+		path = items[itemIdx].path;
+		result = items[itemIdx].result;
+
+		++stats.numHits;
+	} else if ((itemIdx = FindPartialItem(startBlock, goalBlock, goalRadius, pathType, &waypointIdx)) != -1) {
+		const CacheItem& ci = items[itemIdx];
 
-	std::map<unsigned int,CacheItem*>::iterator ci=cachedPaths.find(hash);
-	if(ci!=cachedPaths.end() && ci->second->startBlock.x==startBlock.x && ci->second->startBlock.y==startBlock.y && ci->second->goalBlock.x==goalBlock.x && ci->second->pathType==pathType){
-		++numCacheHits;
-		return ci->second;
+		path = ci.path;
+		path.path.resize(waypointIdx);
+		path.pathCost = ci.waypointCosts[waypointIdx];
+		result = ci.result;
+
+		++stats.numPartialHits;
+	} else {
+		++stats.numMisses;
+		return false;
 	}
-	++numCacheMisses;
-	return 0;
+
+	UnlinkLRU(itemIdx);
+	LinkLRU(itemIdx);
+	return true;
 }
 
 void CPathCache::Update(void)
 {
-	while(!cacheQue.empty() && cacheQue.front().timeout<gs->frameNum)
-		RemoveFrontQueItem();
+	for (int itemIdx = lruHead; itemIdx != -1; ) {
+		const int nextIdx = items[itemIdx].lruNext;
+
+		if (items[itemIdx].timeout < gs->frameNum)
+			RemoveItem(itemIdx);
+
+		itemIdx = nextIdx;
+	}
 }
 
-void CPathCache::RemoveFrontQueItem(void)
+void CPathCache::RemoveItem(int itemIdx)
 {
-	delete cachedPaths[cacheQue.front().hash];
-	cachedPaths.erase(cacheQue.front().hash);
-	cacheQue.pop_front();
+	int slot = items[itemIdx].hash & CACHE_TABLE_MASK;
+	while (table[slot] != itemIdx)
+		slot = (slot + 1) & CACHE_TABLE_MASK;
+
+	// backward-shift deletion, keeps probe sequences intact without tombstones
+	for (int next = (slot + 1) & CACHE_TABLE_MASK; table[next] != -1; next = (next + 1) & CACHE_TABLE_MASK) {
+		const int home = items[table[next]].hash & CACHE_TABLE_MASK;
+
+		// can the entry at <next> be moved into the hole at <slot>?
+		const bool movable = (slot <= next)?
+			(home <= slot || home > next):
+			(home <= slot && home > next);
+
+		if (movable) {
+			table[slot] = table[next];
+			slot = next;
+		}
+	}
+
+	table[slot] = -1;
+
+	UnlinkLRU(itemIdx);
+
+	CacheItem& ci = items[itemIdx];
+	ci.path.path.clear();
+	ci.path.squares.clear();
+	ci.waypointBlocks.clear();
+	ci.waypointCosts.clear();
+
+	freeItems.push_back(itemIdx);
+}
+
+void CPathCache::LinkLRU(int itemIdx)
+{
+	items[itemIdx].lruPrev = -1;
+	items[itemIdx].lruNext = lruHead;
+
+	if (lruHead != -1)
+		items[lruHead].lruPrev = itemIdx;
+	else
+		lruTail = itemIdx;
+
+	lruHead = itemIdx;
+}
+
+void CPathCache::UnlinkLRU(int itemIdx)
+{
+	const int prevIdx = items[itemIdx].lruPrev;
+	const int nextIdx = items[itemIdx].lruNext;
+
+	if (prevIdx != -1)
+		items[prevIdx].lruNext = nextIdx;
+	else
+		lruHead = nextIdx;
+
+	if (nextIdx != -1)
+		items[nextIdx].lruPrev = prevIdx;
+	else
+		lruTail = prevIdx;
 }
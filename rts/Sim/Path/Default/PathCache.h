@@ -3,12 +3,20 @@
 #ifndef PATHCACHE_H
 #define PATHCACHE_H
 
-#include <map>
-#include <list>
+#include <vector>
 
 #include "IPath.h"
 #include "Vec2.h"
 
+/**
+ * Bounded cache of low-resolution (estimator) paths.
+ *
+ * Items live in a fixed pool and are indexed by an open-addressed
+ * (linear probing) hash table; when the pool is full, the least
+ * recently used item is evicted. Paths toward the same goal are
+ * also shared: a request starting in a block that some cached path
+ * passes through gets the remainder of that path.
+ */
 class CPathCache
 {
 public:
@@ -22,26 +30,71 @@ public:
 		int2 goalBlock;
 		float goalRadius;
 		int pathType;
+
+		/// block of each waypoint in <path>, and the cost left to the goal from it
+		std::vector<int2> waypointBlocks;
+		std::vector<float> waypointCosts;
+
+		unsigned int hash;
+		int timeout;
+		int lruPrev;
+		int lruNext;
+	};
+
+	struct Stats {
+		Stats(): numHits(0), numPartialHits(0), numMisses(0), numEvictions(0) {}
+
+		unsigned int numHits;
+		unsigned int numPartialHits;
+		unsigned int numMisses;
+		unsigned int numEvictions;
 	};
 
-	void AddPath(IPath::Path* path, IPath::SearchResult result, int2 startBlock,int2 goalBlock,float goalRadius,int pathType);
-	CacheItem* GetCachedPath(int2 startBlock,int2 goalBlock,float goalRadius,int pathType);
+	void AddPath(
+		const IPath::Path* path,
+		const std::vector<int2>& waypointBlocks,
+		const std::vector<float>& waypointCosts,
+		IPath::SearchResult result,
+		int2 startBlock,
+		int2 goalBlock,
+		float goalRadius,
+		int pathType
+	);
+	bool GetCachedPath(
+		int2 startBlock,
+		int2 goalBlock,
+		float goalRadius,
+		int pathType,
+		IPath::Path& path,
+		IPath::SearchResult& result
+	);
 	void Update(void);
 
-	std::map<unsigned int,CacheItem*> cachedPaths;
+	const Stats& GetStats() const { return stats; }
 
-	struct CacheQue {
-		int timeout;
-		unsigned int hash;
-	};
-	std::list<CacheQue> cacheQue;
-	void RemoveFrontQueItem(void);
+private:
+	unsigned int GetHash(int2 startBlock, int2 goalBlock, float goalRadius, int pathType) const;
+	int FindItem(int2 startBlock, int2 goalBlock, float goalRadius, int pathType, unsigned int hash) const;
+	int FindPartialItem(int2 startBlock, int2 goalBlock, float goalRadius, int pathType, unsigned int* waypointIdx) const;
+	void RemoveItem(int itemIdx);
+
+	void LinkLRU(int itemIdx);
+	void UnlinkLRU(int itemIdx);
+
+	/// pool of cache items, <freeItems> holds the unused indices
+	std::vector<CacheItem> items;
+	std::vector<int> freeItems;
+	/// open-addressed table of item indices (-1 if empty)
+	std::vector<int> table;
+
+	/// most and least recently used items (-1 if none)
+	int lruHead;
+	int lruTail;
 
 	int blocksX;
 	int blocksZ;
 
-	int numCacheHits;
-	int numCacheMisses;
+	Stats stats;
 };
 
 #endif
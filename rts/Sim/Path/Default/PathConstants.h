@@ -21,10 +21,16 @@ const float MIN_ESTIMATE_DISTANCE = 40;
 const float DETAILED_DISTANCE     = 25;
 const float MIN_DETAILED_DISTANCE = 12;
 
-const unsigned int PATHESTIMATOR_VERSION = 46;
+const unsigned int PATHESTIMATOR_VERSION = 47;
 const unsigned int SQUARES_TO_UPDATE = 600;
 const unsigned int MAX_SEARCHED_NODES_ON_REFINE = 2000;
 
+// RequestPathDeferred searches are done in the PathManager update this many
+// frames after the request, at most MAX_DEFERRED_SEARCHES per frame (those
+// left over go first in the next frame)
+const int DEFERRED_SEARCH_DELAY = 1;
+const unsigned int MAX_DEFERRED_SEARCHES = 64;
+
 
 // PE-only flags
 const unsigned int PATHDIR_LEFT       = 0; // +x
@@ -3,7 +3,7 @@
 #ifndef PATH_DATATYPES_HDR
 #define PATH_DATATYPES_HDR
 
-#include <queue>
+#include <cassert>
 #include <vector>
 
 #include "PathConstants.h"
@@ -11,7 +11,7 @@
 
 // represents either a single square (PF) or a block of squares (PE)
 struct PathNode {
-	PathNode(): fCost(0.0f), gCost(0.0f), nodeNum(0), nodePos(0, 0) {
+	PathNode(): fCost(0.0f), gCost(0.0f), nodeNum(0), nodePos(0, 0), heapIdx(-1) {
 	}
 
 	float fCost; // f
@@ -20,13 +20,16 @@ struct PathNode {
 	int nodeNum;
 	int2 nodePos;
 
+	// position of this node in the PathPriorityQueue (-1 if not queued)
+	int heapIdx;
+
 	inline bool operator <  (const PathNode& pn) const { return (fCost < pn.fCost); }
 	inline bool operator >  (const PathNode& pn) const { return (fCost > pn.fCost); }
 	inline bool operator == (const PathNode& pn) const { return (nodeNum == pn.nodeNum); }
 };
 
 struct PathNodeState {
-	PathNodeState(): fCost(PATHCOST_INFINITY), gCost(PATHCOST_INFINITY), extraCostSynced(0.0f), extraCostUnsynced(0.0f), nodeMask(0) {
+	PathNodeState(): fCost(PATHCOST_INFINITY), gCost(PATHCOST_INFINITY), extraCostSynced(0.0f), extraCostUnsynced(0.0f), nodeMask(0), openNodeIdx(0) {
 		parentNodePos.x = -1;
 		parentNodePos.y = -1;
 	}
@@ -50,6 +53,10 @@ struct PathNodeState {
 	// combination of PATHOPT_{OPEN, ..., OBSOLETE} flags
 	unsigned int nodeMask;
 
+	// index of this node's entry in the PathNodeBuffer
+	// (only meaningful while PATHOPT_OPEN is set)
+	unsigned int openNodeIdx;
+
 	// needed for the PE to back-track path to goal
 	int2 parentNodePos;
 	// for the PE, each node (block) maintains the
@@ -60,15 +67,6 @@ struct PathNodeState {
 
 
 
-// functor to define node priority
-struct lessCost: public std::binary_function<PathNode*, PathNode*, bool> {
-	inline bool operator() (const PathNode* x, const PathNode* y) const {
-		return (x->fCost > y->fCost);
-	}
-};
-
-
-
 struct PathNodeBuffer {
 public:
 	PathNodeBuffer(): idx(0) {
@@ -188,70 +186,94 @@ private:
 
 
 
-// looks like a std::vector, but holds a fixed-size buffer
-// used as a backing array for the PathPriorityQueue dtype
-class PathVector {
+// indexed binary min-heap of PathNode*'s ordered by fCost
+//
+// every queued node knows its own position in the heap, so
+// a node that is reached again via a cheaper route can have
+// its key decreased in place (DecreaseKey) instead of being
+// pushed a second time and leaving an obsolete duplicate in
+// the queue
+class PathPriorityQueue {
 public:
-	typedef int size_type;
-	typedef PathNode* value_type;
-	typedef PathNode* reference;
-	typedef PathNode** iterator;
-	typedef const PathNode* const_reference;
-	typedef const PathNode* const* const_iterator;
-
-	// gcc 4.3 requires concepts, so provide them
-		value_type& operator [] (size_type idx) { return buf[idx]; }
-		const value_type& operator [] (size_type idx) const { return buf[idx]; }
-
-		typedef iterator pointer;
-		typedef const_iterator const_pointer;
-		typedef int difference_type;
-
-		typedef PathNode** reverse_iterator;
-		typedef const PathNode* const* const_reverse_iterator;
-
-		// FIXME: don't ever use these
-		reverse_iterator rbegin() { return 0; }
-		reverse_iterator rend() { return 0; }
-		const_reverse_iterator rbegin() const { return 0; }
-		const_reverse_iterator rend() const { return 0; }
-		PathVector(int, const value_type&) { abort(); }
-		PathVector(iterator, iterator) { abort(); }
-		void insert(iterator, const value_type&) { abort(); }
-		void insert(iterator, const size_type&, const value_type&) { abort(); }
-		void insert(iterator, iterator, iterator) { abort(); }
-		void erase(iterator, iterator) { abort(); }
-		void erase(iterator) { abort(); }
-		void erase(iterator, iterator, iterator) { abort(); }
-		void swap(PathVector&) { abort(); }
-	// end of concept hax
-
-	PathVector(): bufPos(-1) {}
-
-	inline void push_back(PathNode* os) { buf[++bufPos] = os; }
-	inline void pop_back() { --bufPos; }
-	inline PathNode* back() const { return buf[bufPos]; }
-	inline const value_type& front() const { return buf[0]; }
-	inline value_type& front() { return buf[0]; }
-	inline bool empty() const { return (bufPos < 0); }
-	inline size_type size() const { return bufPos + 1; }
-	inline size_type max_size() const { return (1 << 30); }
-	inline iterator begin() { return &buf[0]; }
-	inline iterator end() { return &buf[bufPos + 1]; }
-	inline const_iterator begin() const { return &buf[0]; }
-	inline const_iterator end() const { return &buf[bufPos + 1]; }
-	inline void clear() { bufPos = -1; }
+	PathPriorityQueue(): heapSize(0) {}
+
+	inline bool empty() const { return (heapSize == 0); }
+	inline unsigned int size() const { return heapSize; }
+	inline PathNode* top() const { return heap[0]; }
+
+	inline void push(PathNode* n) {
+		assert(heapSize < MAX_SEARCHED_NODES);
+
+		heap[heapSize] = n;
+		n->heapIdx = heapSize++;
+		SiftUp(n->heapIdx);
+	}
+
+	inline void pop() {
+		heap[0]->heapIdx = -1;
+
+		if ((--heapSize) > 0) {
+			heap[0] = heap[heapSize];
+			heap[0]->heapIdx = 0;
+			SiftDown(0);
+		}
+	}
+
+	// must be called after lowering the fCost of a queued node
+	inline void DecreaseKey(PathNode* n) {
+		assert(n->heapIdx >= 0 && (unsigned int) n->heapIdx < heapSize);
+		SiftUp(n->heapIdx);
+	}
+
+	// nodes left in the heap keep a stale heapIdx, but
+	// PathNodeBuffer entries are re-initialized before
+	// they are pushed again
+	void Clear() { heapSize = 0; }
 
 private:
-	int bufPos;
+	inline void SiftUp(unsigned int i) {
+		PathNode* n = heap[i];
 
-	PathNode* buf[MAX_SEARCHED_NODES];
-};
+		while (i > 0) {
+			const unsigned int p = (i - 1) >> 1;
 
-class PathPriorityQueue: public std::priority_queue<PathNode*, PathVector, lessCost> {
-public:
-	// faster than "while (!q.empty()) { q.pop(); }"
-	void Clear() { c.clear(); }
+			if (heap[p]->fCost <= n->fCost)
+				break;
+
+			heap[i] = heap[p];
+			heap[i]->heapIdx = i;
+			i = p;
+		}
+
+		heap[i] = n;
+		n->heapIdx = i;
+	}
+
+	inline void SiftDown(unsigned int i) {
+		PathNode* n = heap[i];
+
+		while (true) {
+			unsigned int c = (i << 1) + 1;
+
+			if (c >= heapSize)
+				break;
+			if ((c + 1) < heapSize && heap[c + 1]->fCost < heap[c]->fCost)
+				c += 1;
+			if (n->fCost <= heap[c]->fCost)
+				break;
+
+			heap[i] = heap[c];
+			heap[i]->heapIdx = i;
+			i = c;
+		}
+
+		heap[i] = n;
+		n->heapIdx = i;
+	}
+
+	unsigned int heapSize;
+
+	PathNode* heap[MAX_SEARCHED_NODES];
 };
 
 #endif
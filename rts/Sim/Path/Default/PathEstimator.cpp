@@ -11,7 +11,6 @@
 #include <boost/version.hpp>
 #include <boost/version.hpp>
 
-#include "lib/minizip/zip.h"
 #include "mmgr.h"
 
 #include "PathAllocator.h"
@@ -24,8 +23,9 @@
 #include "Sim/MoveTypes/MoveMath/MoveMath.h"
 #include "Sim/Units/Unit.h"
 #include "Sim/Units/UnitDef.h"
-#include "System/FileSystem/ArchiveZip.h"
+#include "System/FileSystem/CRC.h"
 #include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/FileView.h"
 #include "System/LogOutput.h"
 #include "System/ConfigHandler.h"
 #include "System/NetProtocol.h"
@@ -78,6 +78,7 @@ CPathEstimator::CPathEstimator(CPathFinder* pf, unsigned int BSIZE, const std::s
 	goalSqrOffset.y = BLOCK_SIZE / 2;
 
 	vertices.resize(moveinfo->moveData.size() * blockStates.GetSize() * PATH_DIRECTION_VERTICES, 0.0f);
+	obsoleteVertices.resize(vertices.size(), 0);
 
 	// load precalculated data if it exists
 	InitEstimator(cacheFileName, map);
@@ -162,6 +163,10 @@ void CPathEstimator::InitEstimator(const std::string& cacheFileName, const std::
 		WriteFile(cacheFileName, map);
 		loadscreen->SetLoadMessage("PathCosts: written", true);
 	}
+
+	// checksum the in-memory data, so clients with
+	// a non-writable cache directory get it as well
+	pathChecksum = CalcChecksum();
 }
 
 
@@ -344,41 +349,121 @@ void CPathEstimator::CalculateVertex(const MoveData& moveData, int parentBlockX,
 
 
 /**
- * Mark affected blocks as obsolete
+ * Queue a single vertex for recalculation (unless it already is)
+ */
+void CPathEstimator::MarkVertexObsolete(unsigned int vertexNbr) {
+	if (obsoleteVertices[vertexNbr] == 0) {
+		obsoleteVertices[vertexNbr] = 1;
+		needUpdateVertices.push_back(vertexNbr);
+	}
+}
+
+
+/**
+ * Queue all 8 vertices connected to a block, used when its offset moved
+ * (4 are stored with the block itself, 4 with the neighbors leading to it)
+ */
+void CPathEstimator::MarkBlockVerticesObsolete(const MoveData& moveData, int blockX, int blockZ) {
+	const int vertexBase = moveData.pathType * blockStates.GetSize() * PATH_DIRECTION_VERTICES;
+
+	for (int dir = 0; dir < PATH_DIRECTION_VERTICES; dir++) {
+		const int childBlockX = blockX + directionVector[dir].x;
+		const int childBlockZ = blockZ + directionVector[dir].y;
+		const int parentBlockX = blockX - directionVector[dir].x;
+		const int parentBlockZ = blockZ - directionVector[dir].y;
+
+		if (childBlockX >= 0 && childBlockZ >= 0 && childBlockX < nbrOfBlocksX && childBlockZ < nbrOfBlocksZ) {
+			MarkVertexObsolete(vertexBase + (blockZ * nbrOfBlocksX + blockX) * PATH_DIRECTION_VERTICES + dir);
+		}
+		if (parentBlockX >= 0 && parentBlockZ >= 0 && parentBlockX < nbrOfBlocksX && parentBlockZ < nbrOfBlocksZ) {
+			MarkVertexObsolete(vertexBase + (parentBlockZ * nbrOfBlocksX + parentBlockX) * PATH_DIRECTION_VERTICES + dir);
+		}
+	}
+}
+
+
+/**
+ * Queue every vertex whose search area (the circular constraint used by
+ * CalculateVertex, plus the footprint of <moveData>) overlaps the given
+ * rectangle of heightmap squares
+ */
+void CPathEstimator::MarkChangedVerticesObsolete(const MoveData& moveData, int minX, int minZ, int maxX, int maxZ) {
+	const int vertexBase = moveData.pathType * blockStates.GetSize() * PATH_DIRECTION_VERTICES;
+
+	// squares whose footprint reaches into the changed area
+	minX -= (moveData.xsize >> 1) + 1; maxX += (moveData.xsize >> 1) + 1;
+	minZ -= (moveData.zsize >> 1) + 1; maxZ += (moveData.zsize >> 1) + 1;
+
+	// the search area of a vertex never extends further
+	// than one block beyond the two blocks it connects
+	const int lowerX = std::max(0, minX / int(BLOCK_SIZE) - 2);
+	const int lowerZ = std::max(0, minZ / int(BLOCK_SIZE) - 2);
+	const int upperX = std::min(nbrOfBlocksX - 1, maxX / int(BLOCK_SIZE) + 1);
+	const int upperZ = std::min(nbrOfBlocksZ - 1, maxZ / int(BLOCK_SIZE) + 1);
+
+	for (int z = lowerZ; z <= upperZ; z++) {
+		for (int x = lowerX; x <= upperX; x++) {
+			const int parentBlocknr = z * nbrOfBlocksX + x;
+			const int2& parentSquare = blockStates[parentBlocknr].nodeOffsets[moveData.pathType];
+
+			for (int dir = 0; dir < PATH_DIRECTION_VERTICES; dir++) {
+				const int childBlockX = x + directionVector[dir].x;
+				const int childBlockZ = z + directionVector[dir].y;
+
+				if (childBlockX < 0 || childBlockZ < 0 || childBlockX >= nbrOfBlocksX || childBlockZ >= nbrOfBlocksZ)
+					continue;
+
+				const int2& childSquare = blockStates[childBlockZ * nbrOfBlocksX + childBlockX].nodeOffsets[moveData.pathType];
+
+				// see CRangedGoalWithCircularConstraint
+				const int halfWayX = (parentSquare.x + childSquare.x) >> 1;
+				const int halfWayZ = (parentSquare.y + childSquare.y) >> 1;
+				const int dx = parentSquare.x - halfWayX;
+				const int dz = parentSquare.y - halfWayZ;
+				const int radius = int(math::sqrt(float(dx * dx + dz * dz + 2))) + 2;
+
+				if ((halfWayX + radius) < minX || (halfWayX - radius) > maxX)
+					continue;
+				if ((halfWayZ + radius) < minZ || (halfWayZ - radius) > maxZ)
+					continue;
+
+				MarkVertexObsolete(vertexBase + parentBlocknr * PATH_DIRECTION_VERTICES + dir);
+			}
+		}
+	}
+}
+
+
+/**
+ * Mark affected blocks and vertices as obsolete
  */
 void CPathEstimator::MapChanged(unsigned int x1, unsigned int z1, unsigned int x2, unsigned z2) {
 	// find the upper and lower corner of the rectangular area
-	int lowerX, upperX, lowerZ, upperZ;
+	const int minX = std::min(x1, x2), maxX = std::max(x1, x2);
+	const int minZ = std::min(z1, z2), maxZ = std::max(z1, z2);
 
-	if (x1 < x2) {
-		lowerX = x1 / BLOCK_SIZE - 1;
-		upperX = x2 / BLOCK_SIZE;
-	} else {
-		lowerX = x2 / BLOCK_SIZE - 1;
-		upperX = x1 / BLOCK_SIZE;
-	}
-	if (z1 < z2) {
-		lowerZ = z1 / BLOCK_SIZE - 1;
-		upperZ = z2 / BLOCK_SIZE;
-	} else {
-		lowerZ = z2 / BLOCK_SIZE - 1;
-		upperZ = z1 / BLOCK_SIZE;
+	// the offset of a block depends on the squares inside
+	// it (and on the footprint of the MoveData at them)
+	int maxFootprint = 0;
+	vector<MoveData*>::iterator mi;
+
+	for (mi = moveinfo->moveData.begin(); mi < moveinfo->moveData.end(); ++mi) {
+		if ((*mi)->unitDefRefCount > 0) {
+			maxFootprint = std::max(maxFootprint, std::max((*mi)->xsize, (*mi)->zsize) >> 1);
+
+			MarkChangedVerticesObsolete(**mi, minX, minZ, maxX, maxZ);
+		}
 	}
 
-	// error-check
-	upperX = std::min(upperX, nbrOfBlocksX - 1);
-	upperZ = std::min(upperZ, nbrOfBlocksZ - 1);
-	if (lowerX < 0) lowerX = 0;
-	if (lowerZ < 0) lowerZ = 0;
+	const int lowerX = std::max(0, (minX - maxFootprint) / int(BLOCK_SIZE));
+	const int lowerZ = std::max(0, (minZ - maxFootprint) / int(BLOCK_SIZE));
+	const int upperX = std::min(nbrOfBlocksX - 1, (maxX + maxFootprint) / int(BLOCK_SIZE));
+	const int upperZ = std::min(nbrOfBlocksZ - 1, (maxZ + maxFootprint) / int(BLOCK_SIZE));
 
 	// mark the blocks inside the rectangle, enqueue them
-	// from upper to lower because of the placement of the
-	// bi-directional vertices
 	for (int z = upperZ; z >= lowerZ; z--) {
 		for (int x = upperX; x >= lowerX; x--) {
 			if (!(blockStates[z * nbrOfBlocksX + x].nodeMask & PATHOPT_OBSOLETE)) {
-				vector<MoveData*>::iterator mi;
-
 				for (mi = moveinfo->moveData.begin(); mi < moveinfo->moveData.end(); ++mi) {
 					if ((*mi)->unitDefRefCount > 0) {
 						SingleBlock sb;
@@ -396,12 +481,15 @@ void CPathEstimator::MapChanged(unsigned int x1, unsigned int z1, unsigned int x
 
 
 /**
- * Update some obsolete blocks using the FIFO-principle
+ * Update some obsolete block offsets and vertices using the FIFO-principle
  */
 void CPathEstimator::Update() {
 	pathCache->Update();
 
-	for (unsigned int n = 0; !needUpdate.empty() && n < BLOCKS_TO_UPDATE; ) {
+	// offsets first, since the vertices are calculated between them
+	// (finding an offset is far cheaper than a vertex search, which
+	// is why more of them are processed per frame)
+	for (unsigned int n = 0; !needUpdate.empty() && n < (BLOCKS_TO_UPDATE * PATH_DIRECTIONS); ) {
 		// copy the next block in line
 		const SingleBlock sb = needUpdate.front();
 
@@ -415,10 +503,16 @@ void CPathEstimator::Update() {
 		if (blockStates[blockN].nodeMask & PATHOPT_OBSOLETE) {
 			const MoveData* currBlockMD = sb.moveData;
 			const MoveData* nextBlockMD = (needUpdate.empty())? NULL: (needUpdate.front()).moveData;
+			const int2 oldOffset = blockStates[blockN].nodeOffsets[currBlockMD->pathType];
 
 			// no, update the block
 			FindOffset(*currBlockMD, blockX, blockZ);
-			CalculateVertices(*currBlockMD, blockX, blockZ);
+
+			const int2& newOffset = blockStates[blockN].nodeOffsets[currBlockMD->pathType];
+
+			if (newOffset.x != oldOffset.x || newOffset.y != oldOffset.y) {
+				MarkBlockVerticesObsolete(*currBlockMD, blockX, blockZ);
+			}
 
 			// each MapChanged() call adds AT MOST <moveData.size()> SingleBlock's
 			// in ascending pathType order per (x, z) PE-block, therefore when the
@@ -432,6 +526,30 @@ void CPathEstimator::Update() {
 			n++;
 		}
 	}
+
+	const unsigned int numBlocks = blockStates.GetSize();
+
+	for (unsigned int n = 0; !needUpdateVertices.empty() && n < (BLOCKS_TO_UPDATE * PATH_DIRECTION_VERTICES); n++) {
+		const unsigned int vertexNbr = needUpdateVertices.front();
+		needUpdateVertices.pop_front();
+
+		const unsigned int pathType = vertexNbr / (numBlocks * PATH_DIRECTION_VERTICES);
+		const unsigned int blockN = (vertexNbr / PATH_DIRECTION_VERTICES) % numBlocks;
+		const unsigned int dir = vertexNbr % PATH_DIRECTION_VERTICES;
+
+		const int blockX = blockN % nbrOfBlocksX;
+		const int blockZ = blockN / nbrOfBlocksX;
+		const int childN = (blockZ + directionVector[dir].y) * nbrOfBlocksX + (blockX + directionVector[dir].x);
+
+		// wait until the offsets at both ends are up-to-date
+		if ((blockStates[blockN].nodeMask | blockStates[childN].nodeMask) & PATHOPT_OBSOLETE) {
+			needUpdateVertices.push_back(vertexNbr);
+			continue;
+		}
+
+		obsoleteVertices[vertexNbr] = 0;
+		CalculateVertex(*moveinfo->moveData[pathType], blockX, blockZ, dir);
+	}
 }
 
 
@@ -463,11 +581,11 @@ IPath::SearchResult CPathEstimator::GetPath(
 	goalBlock.y = peDef.goalSquareZ / BLOCK_SIZE;
 
 	if (synced) {
-		CPathCache::CacheItem* ci = pathCache->GetCachedPath(startBlock, goalBlock, peDef.sqGoalRadius, moveData.pathType);
-		if (ci) {
+		IPath::SearchResult result;
+
+		if (pathCache->GetCachedPath(startBlock, goalBlock, peDef.sqGoalRadius, moveData.pathType, path, result)) {
 			// use a cached path if we have one (NOTE: only when in synced context)
-			path = ci->path;
-			return ci->result;
+			return result;
 		}
 	}
 
@@ -480,7 +598,11 @@ IPath::SearchResult CPathEstimator::GetPath(
 
 		if (synced && result == IPath::Ok) {
 			// add succesful paths to the cache (NOTE: only when in synced context)
-			pathCache->AddPath(&path, result, startBlock, goalBlock, peDef.sqGoalRadius, moveData.pathType);
+			std::vector<int2> waypointBlocks;
+			std::vector<float> waypointCosts;
+
+			GetWaypointCosts(path, waypointBlocks, waypointCosts);
+			pathCache->AddPath(&path, waypointBlocks, waypointCosts, result, startBlock, goalBlock, peDef.sqGoalRadius, moveData.pathType);
 		}
 
 		if (PATHDEBUG) {
@@ -532,6 +654,8 @@ IPath::SearchResult CPathEstimator::InitSearch(const MoveData& moveData, const C
 		ob->nodeNum = startBlocknr;
 	openBlocks.push(ob);
 
+	blockStates[startBlocknr].openNodeIdx = 0;
+
 	// mark starting point as best found position
 	goalBlock = startBlock;
 	goalHeuristic = peDef.Heuristic(xSquare, zSquare);
@@ -559,7 +683,7 @@ IPath::SearchResult CPathEstimator::DoSearch(const MoveData& moveData, const CPa
 
 	while (!openBlocks.empty() && (openBlockBuffer.GetSize() < maxBlocksToBeSearched)) {
 		// get the open block with lowest cost
-		PathNode* ob = const_cast<PathNode*>(openBlocks.top());
+		PathNode* ob = openBlocks.top();
 		openBlocks.pop();
 
 		// check if the block has been marked as unaccessible during its time in the queue
@@ -675,25 +799,34 @@ void CPathEstimator::TestBlock(
 		if (blockStates[blockIdx].fCost <= fCost)
 			return;
 
+		// found a cheaper route, move the queued node up
+		PathNode* ob = openBlockBuffer.GetNode(blockStates[blockIdx].openNodeIdx);
+			ob->fCost = fCost;
+			ob->gCost = gCost;
+		openBlocks.DecreaseKey(ob);
+
 		blockStates[blockIdx].nodeMask &= ~PATHOPT_DIRECTION;
-	}
+	} else {
+		// look for improvements
+		if (hCost < goalHeuristic) {
+			goalBlock = block;
+			goalHeuristic = hCost;
+		}
 
-	// look for improvements
-	if (hCost < goalHeuristic) {
-		goalBlock = block;
-		goalHeuristic = hCost;
-	}
+		// store this block as open.
+		openBlockBuffer.SetSize(openBlockBuffer.GetSize() + 1);
+		assert(openBlockBuffer.GetSize() < MAX_SEARCHED_NODES_PE);
 
-	// store this block as open.
-	openBlockBuffer.SetSize(openBlockBuffer.GetSize() + 1);
-	assert(openBlockBuffer.GetSize() < MAX_SEARCHED_NODES_PE);
+		PathNode* ob = openBlockBuffer.GetNode(openBlockBuffer.GetSize());
+			ob->fCost   = fCost;
+			ob->gCost   = gCost;
+			ob->nodePos = block;
+			ob->nodeNum = blockIdx;
+		openBlocks.push(ob);
 
-	PathNode* ob = openBlockBuffer.GetNode(openBlockBuffer.GetSize());
-		ob->fCost   = fCost;
-		ob->gCost   = gCost;
-		ob->nodePos = block;
-		ob->nodeNum = blockIdx;
-	openBlocks.push(ob);
+		blockStates[blockIdx].openNodeIdx = openBlockBuffer.GetSize();
+		dirtyBlocks.push_back(blockIdx);
+	}
 
 	blockStates.SetMaxFCost(std::max(blockStates.GetMaxFCost(), fCost));
 	blockStates.SetMaxGCost(std::max(blockStates.GetMaxGCost(), gCost));
@@ -703,8 +836,6 @@ void CPathEstimator::TestBlock(
 	blockStates[blockIdx].gCost = gCost;
 	blockStates[blockIdx].nodeMask |= (direction | PATHOPT_OPEN);
 	blockStates[blockIdx].parentNodePos = parentOpenBlock.nodePos;
-
-	dirtyBlocks.push_back(blockIdx);
 }
 
 
@@ -739,6 +870,28 @@ void CPathEstimator::FinishSearch(const MoveData& moveData, IPath::Path& foundPa
 }
 
 
+/**
+ * Collects the block of each waypoint of the path generated by
+ * FinishSearch() and the remaining cost to the goal from there,
+ * which lets the cache hand out parts of the path
+ */
+void CPathEstimator::GetWaypointCosts(const IPath::Path& path, std::vector<int2>& waypointBlocks, std::vector<float>& waypointCosts) const {
+	int2 block = goalBlock;
+
+	waypointBlocks.reserve(path.path.size());
+	waypointCosts.reserve(path.path.size());
+
+	while (block.x != startBlock.x || block.y != startBlock.y) {
+		const int blockIdx = block.y * nbrOfBlocksX + block.x;
+
+		waypointBlocks.push_back(block);
+		waypointCosts.push_back(path.pathCost - blockStates[blockIdx].gCost);
+
+		block = blockStates[blockIdx].parentNodePos;
+	}
+}
+
+
 /**
  * Clean lists from last search
  */
@@ -759,71 +912,98 @@ void CPathEstimator::ResetSearch() {
 }
 
 
+// cache files start with this, followed by the
+// checksum and the raw (uncompressed) estimator data
+static const unsigned int PATHESTIMATOR_CACHE_MAGIC = 0x45505053; // "SPPE"
+
+std::string CPathEstimator::GetCacheFileName(const std::string& cacheFileName, const std::string& map) const
+{
+	char hashString[64] = {0};
+	sprintf(hashString, "%u", Hash());
+
+	return (std::string(pathDir) + map + hashString + "." + cacheFileName + ".pcache");
+}
+
+
+/**
+ * Returns the CRC of the estimator data in the order it is stored on
+ * disk (hash, then block-center-offsets, then vertices)
+ */
+boost::uint32_t CPathEstimator::CalcChecksum() const
+{
+	const unsigned int hash = Hash();
+
+	CRC crc;
+	crc.Update(&hash, sizeof(hash));
+
+	for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++)
+		crc.Update(&blockStates[blocknr].nodeOffsets[0], moveinfo->moveData.size() * sizeof(int2));
+
+	crc.Update(&vertices[0], vertices.size() * sizeof(float));
+	return crc.GetDigest();
+}
+
+
 /**
  * Try to read offset and vertices data from file, return false on failure
- * TODO: Read-error-check.
+ *
+ * The data is stored uncompressed, so the file is mapped read-only and
+ * copied straight into place; the stored checksum is verified against
+ * the data to detect truncated or corrupted files.
  */
 bool CPathEstimator::ReadFile(const std::string& cacheFileName, const std::string& map)
 {
-	const unsigned int hash = Hash();
-	char hashString[50];
-	sprintf(hashString, "%u", hash);
+	const std::string filename = GetCacheFileName(cacheFileName, map);
 
-	std::string filename = std::string(pathDir) + map + hashString + "." + cacheFileName + ".zip";
 	if (!filesystem.FileExists(filename))
 		return false;
-	// open file for reading from a suitable location (where the file exists)
-	CArchiveZip* pfile = new CArchiveZip(filesystem.LocateFile(filename));
 
-	if (!pfile || !pfile->IsOpen()) {
-		delete pfile;
+	const CMappedFile file(filesystem.LocateFile(filename));
+
+	if (!file.IsOpen())
 		return false;
-	}
 
 	char calcMsg[512];
 	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
 	loadscreen->SetLoadMessage(calcMsg);
 
-	std::auto_ptr<CArchiveZip> auto_pfile(pfile);
-	CArchiveZip& file(*pfile);
-
-	const unsigned fid = file.FindFile("pathinfo");
+	const unsigned int blockSize = moveinfo->moveData.size() * sizeof(int2);
+	const unsigned int dataSize =
+		sizeof(unsigned int) +                   // hash
+		blockSize * blockStates.GetSize() +      // block-center-offsets
+		vertices.size() * sizeof(float);         // vertices
 
-	if (fid < file.NumFiles()) {
-		pathChecksum = file.GetCrc32(fid);
-
-		std::vector<boost::uint8_t> buffer;
-		file.GetFile(fid, buffer);
+	// too short, or trailing garbage
+	if (file.GetSize() != (2 * sizeof(unsigned int) + dataSize))
+		return false;
 
-		if (buffer.size() < 4)
-			return false;
+	const boost::uint8_t* buffer = file.GetData();
+	const unsigned int magic = *((const unsigned int*) &buffer[0]);
+	const unsigned int checksum = *((const unsigned int*) &buffer[sizeof(unsigned int)]);
+	unsigned int pos = 2 * sizeof(unsigned int);
 
-		unsigned filehash = *((unsigned*)&buffer[0]);
-		if (filehash != hash)
-			return false;
+	if (magic != PATHESTIMATOR_CACHE_MAGIC)
+		return false;
+	if (CRC().Update(&buffer[pos], dataSize).GetDigest() != checksum)
+		return false;
 
-		unsigned pos = sizeof(unsigned);
+	const unsigned int filehash = *((const unsigned int*) &buffer[pos]);
+	if (filehash != Hash())
+		return false;
 
-		// Read block-center-offset data.
-		const unsigned blockSize = moveinfo->moveData.size() * sizeof(int2);
-		if (buffer.size() < pos + blockSize * blockStates.GetSize())
-			return false;
+	pos += sizeof(unsigned int);
 
-		for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++) {
-			std::memcpy(&blockStates[blocknr].nodeOffsets[0], &buffer[pos], blockSize);
-			pos += blockSize;
-		}
+	// Read block-center-offset data.
+	for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++) {
+		std::memcpy(&blockStates[blocknr].nodeOffsets[0], &buffer[pos], blockSize);
+		pos += blockSize;
+	}
 
-		// Read vertices data.
-		if (buffer.size() < pos + vertices.size() * sizeof(float))
-			return false;
-		std::memcpy(&vertices[0], &buffer[pos], vertices.size() * sizeof(float));
+	// Read vertices data.
+	std::memcpy(&vertices[0], &buffer[pos], vertices.size() * sizeof(float));
 
-		// File read successful.
-		return true;
-	} else {
-		return false;
-	}
+	// File read successful.
+	return true;
 }
 
 
@@ -836,48 +1016,37 @@ void CPathEstimator::WriteFile(const std::string& cacheFileName, const std::stri
 	if (!filesystem.CreateDirectory(pathDir))
 		return;
 
-	const unsigned int hash = Hash();
-	char hashString[64] = {0};
-
-	sprintf(hashString, "%u", hash);
-
-	const std::string filename = std::string(pathDir) + map + hashString + "." + cacheFileName + ".zip";
-	zipFile file;
+	const std::string filename = GetCacheFileName(cacheFileName, map);
+	std::ofstream ofs(filesystem.LocateFile(filename, FileSystem::WRITE).c_str(), std::ios::out | std::ios::binary);
 
-	// open file for writing in a suitable location
-	file = zipOpen(filesystem.LocateFile(filename, FileSystem::WRITE).c_str(), APPEND_STATUS_CREATE);
-
-	if (file) {
-		zipOpenNewFileInZip(file, "pathinfo", NULL, NULL, 0, NULL, 0, NULL, Z_DEFLATED, Z_BEST_COMPRESSION);
-
-		// Write hash.
-		zipWriteInFileInZip(file, (void*) &hash, 4);
+	if (!ofs.is_open())
+		return;
 
-		// Write block-center-offsets.
-		for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++)
-			zipWriteInFileInZip(file, (void*) &blockStates[blocknr].nodeOffsets[0], moveinfo->moveData.size() * sizeof(int2));
+	const unsigned int magic = PATHESTIMATOR_CACHE_MAGIC;
+	const unsigned int checksum = CalcChecksum();
+	const unsigned int hash = Hash();
 
-		// Write vertices.
-		zipWriteInFileInZip(file, &vertices[0], vertices.size() * sizeof(float));
+	// Write header.
+	ofs.write((const char*) &magic, sizeof(magic));
+	ofs.write((const char*) &checksum, sizeof(checksum));
+	ofs.write((const char*) &hash, sizeof(hash));
 
-		zipCloseFileInZip(file);
-		zipClose(file, NULL);
+	// Write block-center-offsets.
+	for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++)
+		ofs.write((const char*) &blockStates[blocknr].nodeOffsets[0], moveinfo->moveData.size() * sizeof(int2));
 
+	// Write vertices.
+	ofs.write((const char*) &vertices[0], vertices.size() * sizeof(float));
 
-		// get the CRC over the written path data
-		CArchiveZip* pfile = new CArchiveZip(filesystem.LocateFile(filename));
+	if (!ofs)
+		return;
 
-		if (!pfile || !pfile->IsOpen()) {
-			delete pfile;
-			return;
-		}
+	// the zip archives of older versions are never read again
+	const std::string writeDir = filesystem.LocateDir(pathDir, FileSystem::WRITE);
+	const std::vector<std::string> oldFiles = filesystem.FindFiles(writeDir, map + "*." + cacheFileName + ".zip");
 
-		std::auto_ptr<CArchiveZip> auto_pfile(pfile);
-		CArchiveZip& file(*pfile);
-		
-		const unsigned fid = file.FindFile("pathinfo");
-		assert(fid < file.NumFiles());
-		pathChecksum = file.GetCrc32(fid);
+	for (std::vector<std::string>::const_iterator fi = oldFiles.begin(); fi != oldFiles.end(); ++fi) {
+		filesystem.Remove(*fi);
 	}
 }
 
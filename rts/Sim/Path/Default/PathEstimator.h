@@ -92,6 +92,8 @@ public:
 	 * Whenever the ground structure of the map changes (ex. at explosions and new buildings)
 	 * this function shall be called, with (x1, z1)-(x2, z2) defining the rectangular area
 	 * affected. The estimator will itself decided when update of the area is needed.
+	 * Only the block offsets and vertices whose search area overlaps the changed
+	 * rectangle are recalculated.
 	 */
 	void MapChanged(unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2);
 
@@ -109,6 +111,7 @@ public:
 	unsigned int GetNumBlocksZ() const { return nbrOfBlocksZ; }
 
 	PathNodeStateBuffer& GetNodeStateBuffer() { return blockStates; }
+	const CPathCache* GetPathCache() const { return pathCache; }
 
 private:
 	void InitEstimator(const std::string& cacheFileName, const std::string& map);
@@ -134,14 +137,21 @@ private:
 	void CalculateVertices(const MoveData&, int, int, int thread = 0);
 	void CalculateVertex(const MoveData&, int, int, unsigned int, int thread = 0);
 
+	void MarkVertexObsolete(unsigned int vertexNbr);
+	void MarkBlockVerticesObsolete(const MoveData&, int, int);
+	void MarkChangedVerticesObsolete(const MoveData&, int, int, int, int);
+
 	IPath::SearchResult InitSearch(const MoveData&, const CPathFinderDef&, bool);
 	IPath::SearchResult DoSearch(const MoveData&, const CPathFinderDef&, bool);
 	void TestBlock(const MoveData&, const CPathFinderDef&, PathNode&, unsigned int, bool);
 	void FinishSearch(const MoveData& moveData, IPath::Path& path);
+	void GetWaypointCosts(const IPath::Path& path, std::vector<int2>& waypointBlocks, std::vector<float>& waypointCosts) const;
 	void ResetSearch();
 
 	bool ReadFile(const std::string& cacheFileName, const std::string& map);
 	void WriteFile(const std::string& cacheFileName, const std::string& map);
+	std::string GetCacheFileName(const std::string& cacheFileName, const std::string& map) const;
+	boost::uint32_t CalcChecksum() const;
 	unsigned int Hash() const;
 
 	int nbrOfBlocksX, nbrOfBlocksZ;													// Number of blocks on map.
@@ -152,7 +162,9 @@ private:
 
 	std::vector<float> vertices;
 	std::list<int> dirtyBlocks;														// List of blocks changed in last search.
-	std::list<SingleBlock> needUpdate;												// Blocks that may need an update due to map changes.
+	std::list<SingleBlock> needUpdate;												// Blocks whose offset may need an update due to map changes.
+	std::list<unsigned int> needUpdateVertices;										// Vertices that need to be recalculated due to map changes.
+	std::vector<unsigned char> obsoleteVertices;									// Non-zero for every vertex in needUpdateVertices.
 
 	static const int PATH_DIRECTIONS = 8;
 	static const int PATH_DIRECTION_VERTICES = PATH_DIRECTIONS / 2;
@@ -175,7 +187,7 @@ private:
 	CPathFinder* pathFinder;
 	CPathCache* pathCache;
 
-	boost::uint32_t pathChecksum; ///< currently crc from the zip
+	boost::uint32_t pathChecksum; ///< CRC over the hash, block offsets and vertices
 
 	boost::mutex loadMsgMutex;
 	boost::barrier* pathBarrier;
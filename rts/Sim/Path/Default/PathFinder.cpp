@@ -169,6 +169,8 @@ IPath::SearchResult CPathFinder::InitSearch(const MoveData& moveData, const CPat
 		os->nodeNum   = startSquare;
 	openSquares.push(os);
 
+	squareStates[startSquare].openNodeIdx = 0;
+
 	// perform the search
 	IPath::SearchResult result = DoSearch(moveData, pfDef, ownerId, synced);
 
@@ -189,13 +191,9 @@ IPath::SearchResult CPathFinder::DoSearch(const MoveData& moveData, const CPathF
 
 	while (!openSquares.empty() && (openSquareBuffer.GetSize() < maxSquaresToBeSearched)) {
 		// Get the open square with lowest expected path-cost.
-		PathNode* os = const_cast<PathNode*>(openSquares.top());
+		PathNode* os = openSquares.top();
 		openSquares.pop();
 
-		// check if this PathNode has become obsolete
-		if (squareStates[os->nodeNum].fCost != os->fCost)
-			continue;
-
 		// Check if the goal is reached.
 		if (pfDef.IsGoal(os->nodePos.x, os->nodePos.y)) {
 			goalSquare = os->nodeNum;
@@ -323,30 +321,41 @@ bool CPathFinder::TestSquare(
 	const float fCost = gCost + hCost;                       // f
 
 
+	PathNode* os = NULL;
+
 	if (squareStates[sqrIdx].nodeMask & PATHOPT_OPEN) {
 		// already in the open set
 		if (squareStates[sqrIdx].fCost <= fCost)
 			return true;
 
+		// found a cheaper route, move the queued node up
+		os = openSquareBuffer.GetNode(squareStates[sqrIdx].openNodeIdx);
+		os->fCost = fCost;
+		os->gCost = gCost;
+		openSquares.DecreaseKey(os);
+
 		squareStates[sqrIdx].nodeMask &= ~PATHOPT_DIRECTION;
-	}
+	} else {
+		// Look for improvements.
+		if (!exactPath && hCost < goalHeuristic) {
+			goalSquare = sqrIdx;
+			goalHeuristic = hCost;
+		}
 
-	// Look for improvements.
-	if (!exactPath && hCost < goalHeuristic) {
-		goalSquare = sqrIdx;
-		goalHeuristic = hCost;
-	}
+		// Store this square as open.
+		openSquareBuffer.SetSize(openSquareBuffer.GetSize() + 1);
+		assert(openSquareBuffer.GetSize() < MAX_SEARCHED_NODES_PF);
 
-	// Store this square as open.
-	openSquareBuffer.SetSize(openSquareBuffer.GetSize() + 1);
-	assert(openSquareBuffer.GetSize() < MAX_SEARCHED_NODES_PF);
+		os = openSquareBuffer.GetNode(openSquareBuffer.GetSize());
+			os->fCost   = fCost;
+			os->gCost   = gCost;
+			os->nodePos = square;
+			os->nodeNum = sqrIdx;
+		openSquares.push(os);
 
-	PathNode* os = openSquareBuffer.GetNode(openSquareBuffer.GetSize());
-		os->fCost   = fCost;
-		os->gCost   = gCost;
-		os->nodePos = square;
-		os->nodeNum = sqrIdx;
-	openSquares.push(os);
+		squareStates[sqrIdx].openNodeIdx = openSquareBuffer.GetSize();
+		dirtySquares.push_back(sqrIdx);
+	}
 
 	squareStates.SetMaxFCost(std::max(squareStates.GetMaxFCost(), fCost));
 	squareStates.SetMaxGCost(std::max(squareStates.GetMaxGCost(), gCost));
@@ -355,7 +364,6 @@ bool CPathFinder::TestSquare(
 	squareStates[sqrIdx].fCost = os->fCost;
 	squareStates[sqrIdx].gCost = os->gCost;
 	squareStates[sqrIdx].nodeMask |= (PATHOPT_OPEN | enterDirection);
-	dirtySquares.push_back(sqrIdx);
 	return true;
 }
 
@@ -1,12 +1,14 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "mmgr.h"
 
 #include "PathManager.h"
 #include "PathConstants.h"
 #include "PathFinder.h"
 #include "PathEstimator.h"
+#include "PathCache.h"
 #include "Map/MapInfo.h"
 #include "Sim/Misc/GlobalSynced.h"
 #include "Sim/MoveTypes/MoveInfo.h"
@@ -41,6 +43,10 @@ CPathManager::CPathManager(): nextPathId(0)
 
 CPathManager::~CPathManager()
 {
+	for (std::map<unsigned int, PathRequest>::iterator ri = pathRequests.begin(); ri != pathRequests.end(); ++ri) {
+		delete ri->second.path;
+	}
+
 	delete lowResPE;
 	delete medResPE;
 	delete maxResPF;
@@ -81,23 +87,97 @@ unsigned int CPathManager::RequestPath(
 	CSolidObject* caller,
 	bool synced
 ) {
+	MultiPath* newPath = new MultiPath(startPos, pfDef, moveinfo->moveData[md->pathType]);
+	newPath->finalGoal = goalPos;
+	newPath->caller = caller;
+
+	if (ArrangePath(newPath, pfDef, synced)) {
+		return Store(newPath);
+	}
+
+	delete newPath;
+	return 0;
+}
+
+/*
+Queue a new multipath, its search is done by SearchDeferredPaths.
+*/
+unsigned int CPathManager::RequestPathDeferred(
+	const MoveData* md,
+	const float3& startPos,
+	const float3& goalPos,
+	float goalRadius,
+	CSolidObject* caller
+) {
+	float3 sp(startPos); sp.CheckInBounds();
+	float3 gp(goalPos); gp.CheckInBounds();
+
+	CRangedGoalWithCircularConstraint* pfDef = new CRangedGoalWithCircularConstraint(sp, gp, goalRadius, 3.0f, 2000);
+
+	PathRequest& request = pathRequests[++nextPathId];
+	request.searchFrame = gs->frameNum + DEFERRED_SEARCH_DELAY;
+	request.path = new MultiPath(sp, pfDef, moveinfo->moveData[md->pathType]);
+	request.path->finalGoal = gp;
+	request.path->caller = caller;
+	request.pfDef = pfDef;
+
+	curFrameStats.numDeferredRequests += 1;
+	return nextPathId;
+}
+
+/*
+Search all queued requests that are due, oldest first.
+*/
+void CPathManager::SearchDeferredPaths()
+{
+	unsigned int numSearches = 0;
+
+	while (!pathRequests.empty() && numSearches < MAX_DEFERRED_SEARCHES) {
+		const std::map<unsigned int, PathRequest>::iterator ri = pathRequests.begin();
+
+		if (ri->second.searchFrame > gs->frameNum) {
+			break;
+		}
+
+		const unsigned int pathId = ri->first;
+		const PathRequest request = ri->second;
+
+		pathRequests.erase(ri);
+
+		if (ArrangePath(request.path, request.pfDef, true)) {
+			pathMap[pathId] = request.path;
+		} else {
+			delete request.path;
+		}
+
+		++numSearches;
+	}
+}
+
+/*
+Do the searches for a new multipath, false if no path was found.
+*/
+bool CPathManager::ArrangePath(MultiPath* newPath, CPathFinderDef* pfDef, bool synced)
+{
 	SCOPED_TIMER("PFS");
 
-	MoveData* moveData = moveinfo->moveData[md->pathType];
+	const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+	const float3& startPos = newPath->start;
+	const float3& goalPos = newPath->finalGoal;
+	CSolidObject* caller = newPath->caller;
+
+	MoveData* moveData = moveinfo->moveData[newPath->moveData->pathType];
 	moveData->tempOwner = caller;
 
-	// Creates a new multipath.
 	IPath::SearchResult result = IPath::Error;
-	MultiPath* newPath = new MultiPath(startPos, pfDef, moveData);
-	newPath->finalGoal = goalPos;
-	newPath->caller = caller;
 
 	if (caller) {
 		caller->UnBlock();
 	}
 
 	const int ownerId = caller? caller->id: 0;
-	unsigned int pathID = 0;
+	bool found = false;
 
 	// choose the PF or the PE depending on the projected 2D goal-distance
 	// NOTE: this distance can be far smaller than the actual path length!
@@ -150,9 +230,7 @@ unsigned int CPathManager::RequestPath(
 		MedRes2MaxRes(*newPath, startPos, ownerId, synced);
 
 		newPath->searchResult = result;
-		pathID = Store(newPath);
-	} else {
-		delete newPath;
+		found = true;
 	}
 
 	if (caller) {
@@ -160,7 +238,11 @@ unsigned int CPathManager::RequestPath(
 	}
 
 	moveData->tempOwner = NULL;
-	return pathID;
+
+	curFrameStats.numRequests += 1;
+	curFrameStats.numFailedRequests += (!found);
+	curFrameStats.searchTime += (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds();
+	return found;
 }
 
 
@@ -305,6 +387,8 @@ float3 CPathManager::NextWaypoint(
 		(multiPath->medResPath.path.back().SqDistance2D(callerPos) < Square(MIN_DETAILED_DISTANCE * SQUARE_SIZE) ||
 		multiPath->maxResPath.path.size() <= 2)) {
 
+		const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
 		if (!multiPath->lowResPath.path.empty() &&  // if so, check if estimated path also needs bettering
 			(multiPath->lowResPath.path.back().SqDistance2D(callerPos) < Square(MIN_ESTIMATE_DISTANCE * SQUARE_SIZE) ||
 			multiPath->medResPath.path.size() <= 2)) {
@@ -321,6 +405,9 @@ float3 CPathManager::NextWaypoint(
 		if (multiPath->caller) {
 			multiPath->caller->Block();
 		}
+
+		curFrameStats.numRefines += 1;
+		curFrameStats.searchTime += (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds();
 	}
 
 	float3 waypoint;
@@ -357,8 +444,17 @@ void CPathManager::DeletePath(unsigned int pathId) {
 		return;
 
 	const std::map<unsigned int, MultiPath*>::iterator pi = pathMap.find(pathId);
-	if (pi == pathMap.end())
+
+	if (pi == pathMap.end()) {
+		// the caller may give up before a deferred search was done
+		const std::map<unsigned int, PathRequest>::iterator ri = pathRequests.find(pathId);
+
+		if (ri != pathRequests.end()) {
+			delete ri->second.path;
+			pathRequests.erase(ri);
+		}
 		return;
+	}
 
 	const MultiPath* multiPath = pi->second;
 
@@ -367,6 +463,17 @@ void CPathManager::DeletePath(unsigned int pathId) {
 }
 
 
+IPathManager::PathState CPathManager::GetPathState(unsigned int pathId) const
+{
+	if (pathMap.find(pathId) != pathMap.end())
+		return PATH_READY;
+	if (pathRequests.find(pathId) != pathRequests.end())
+		return PATH_PENDING;
+
+	return PATH_NONE;
+}
+
+
 
 // Tells estimators about changes in or on the map.
 void CPathManager::TerrainChange(unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2) {
@@ -382,6 +489,53 @@ void CPathManager::Update()
 	maxResPF->UpdateHeatMap();
 	medResPE->Update();
 	lowResPE->Update();
+
+	// the searches done below belong to the frame that starts here
+	curFrameStats.numQueued = pathRequests.size();
+	lastFrameStats = curFrameStats;
+	curFrameStats = FrameStats();
+
+	peakFrameStats.numRequests         = std::max(peakFrameStats.numRequests,         lastFrameStats.numRequests);
+	peakFrameStats.numFailedRequests   = std::max(peakFrameStats.numFailedRequests,   lastFrameStats.numFailedRequests);
+	peakFrameStats.numDeferredRequests = std::max(peakFrameStats.numDeferredRequests, lastFrameStats.numDeferredRequests);
+	peakFrameStats.numRefines          = std::max(peakFrameStats.numRefines,          lastFrameStats.numRefines);
+	peakFrameStats.numQueued           = std::max(peakFrameStats.numQueued,           lastFrameStats.numQueued);
+	peakFrameStats.searchTime          = std::max(peakFrameStats.searchTime,          lastFrameStats.searchTime);
+
+	SearchDeferredPaths();
+}
+
+void CPathManager::PrintDebugInfo() const
+{
+	LogObject() << "[CPathManager] path-requests per frame (last / peak):";
+	LogObject() << "  requests:        " << lastFrameStats.numRequests       << " / " << peakFrameStats.numRequests;
+	LogObject() << "  failed requests: " << lastFrameStats.numFailedRequests << " / " << peakFrameStats.numFailedRequests;
+	LogObject() << "  deferred:        " << lastFrameStats.numDeferredRequests << " / " << peakFrameStats.numDeferredRequests;
+	LogObject() << "  queued:          " << lastFrameStats.numQueued         << " / " << peakFrameStats.numQueued;
+	LogObject() << "  refinements:     " << lastFrameStats.numRefines        << " / " << peakFrameStats.numRefines;
+	LogObject() << "  search time:     " << (lastFrameStats.searchTime * 0.001f) << " / " << (peakFrameStats.searchTime * 0.001f) << " ms";
+	LogObject() << "  stored paths:    " << pathMap.size();
+
+	unsigned int numHits, numPartialHits, numMisses, numEvictions;
+	GetPathCacheStats(&numHits, &numPartialHits, &numMisses, &numEvictions);
+
+	LogObject() << "[CPathManager] path-cache (hits / partial hits / misses / evictions):";
+	LogObject() << "  " << numHits << " / " << numPartialHits << " / " << numMisses << " / " << numEvictions;
+}
+
+void CPathManager::GetPathCacheStats(
+	unsigned int* numHits,
+	unsigned int* numPartialHits,
+	unsigned int* numMisses,
+	unsigned int* numEvictions
+) const {
+	const CPathCache::Stats& medResStats = medResPE->GetPathCache()->GetStats();
+	const CPathCache::Stats& lowResStats = lowResPE->GetPathCache()->GetStats();
+
+	*numHits        = medResStats.numHits        + lowResStats.numHits;
+	*numPartialHits = medResStats.numPartialHits + lowResStats.numPartialHits;
+	*numMisses      = medResStats.numMisses      + lowResStats.numMisses;
+	*numEvictions   = medResStats.numEvictions   + lowResStats.numEvictions;
 }
 
 // used to deposit heat on the heat-map as a unit moves along its path
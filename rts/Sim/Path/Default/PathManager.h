@@ -26,6 +26,13 @@ public:
 
 	void Update();
 	void UpdatePath(const CSolidObject*, unsigned int);
+	void PrintDebugInfo() const;
+	void GetPathCacheStats(
+		unsigned int* numHits,
+		unsigned int* numPartialHits,
+		unsigned int* numMisses,
+		unsigned int* numEvictions
+	) const;
 
 	void DeletePath(unsigned int pathId);
 
@@ -48,6 +55,16 @@ public:
 		bool synced = true
 	);
 
+	unsigned int RequestPathDeferred(
+		const MoveData* moveData,
+		const float3& startPos,
+		const float3& goalPos,
+		float goalRadius = 8.0f,
+		CSolidObject* caller = 0
+	);
+
+	PathState GetPathState(unsigned int pathId) const;
+
 	/**
 	 * Returns current detail path waypoints. For the full path, @see GetEstimatedPath.
 	 * @param pathId
@@ -119,6 +136,30 @@ private:
 		CSolidObject* caller;
 	};
 
+	/// a RequestPathDeferred call waiting for its search
+	struct PathRequest {
+		PathRequest(): searchFrame(0), path(NULL), pfDef(NULL) {}
+
+		int searchFrame;
+		MultiPath* path;
+		CPathFinderDef* pfDef; ///< path->peDef
+	};
+
+	/// path-search load generated within a single sim frame
+	struct FrameStats {
+		FrameStats(): numRequests(0), numFailedRequests(0), numDeferredRequests(0), numRefines(0), numQueued(0), searchTime(0) {}
+
+		unsigned int numRequests;         ///< searches for new paths, direct and deferred
+		unsigned int numFailedRequests;   ///< searches for new paths that found none
+		unsigned int numDeferredRequests; ///< RequestPathDeferred calls
+		unsigned int numRefines;          ///< low/med-res path refinements done by NextWaypoint
+		unsigned int numQueued;           ///< deferred requests left waiting at the end of the frame
+		unsigned int searchTime;          ///< microseconds spent searching new paths and in NextWaypoint
+	};
+
+	bool ArrangePath(MultiPath* newPath, CPathFinderDef* pfDef, bool synced);
+	void SearchDeferredPaths();
+
 	unsigned int Store(MultiPath* path);
 	void LowRes2MedRes(MultiPath& path, const float3& startPos, int ownerId, bool synced) const;
 	void MedRes2MaxRes(MultiPath& path, const float3& startPos, int ownerId, bool synced) const;
@@ -128,7 +169,14 @@ private:
 	CPathEstimator* lowResPE;
 
 	std::map<unsigned int, MultiPath*> pathMap;
+	/// searched in the order of their ids, which is the order of the requests
+	std::map<unsigned int, PathRequest> pathRequests;
 	unsigned int nextPathId;
+
+	// NextWaypoint is const but refines paths on demand
+	mutable FrameStats curFrameStats;
+	FrameStats lastFrameStats;
+	FrameStats peakFrameStats;
 };
 
 #endif
@@ -11,6 +11,12 @@ class CSolidObject;
 
 class IPathManager {
 public:
+	enum PathState {
+		PATH_NONE,    ///< unknown id, or the search found no path
+		PATH_PENDING, ///< deferred request still waiting for its search
+		PATH_READY    ///< NextWaypoint can be used
+	};
+
 	static IPathManager* GetInstance();
 
 	virtual ~IPathManager() {}
@@ -20,6 +26,22 @@ public:
 	virtual void Update() {}
 	virtual void UpdatePath(const CSolidObject* owner, unsigned int pathId) {}
 
+	/// prints per-frame path request statistics to the infolog
+	virtual void PrintDebugInfo() const {}
+
+	/**
+	 * Returns the counters of the low-resolution path caches (summed
+	 * over all estimators); all four are zero if there is no cache.
+	 */
+	virtual void GetPathCacheStats(
+		unsigned int* numHits,
+		unsigned int* numPartialHits,
+		unsigned int* numMisses,
+		unsigned int* numEvictions
+	) const {
+		*numHits = *numPartialHits = *numMisses = *numEvictions = 0;
+	}
+
 	/**
 	 * When a path is no longer used, call this function to release it from
 	 * memory.
@@ -115,6 +137,25 @@ public:
 		bool synced = true
 	) { return 0; }
 
+	/**
+	 * Same as a synced RequestPath, but the search is queued and done by a
+	 * later Update() at a fixed frame delay, so mass requests made within a
+	 * frame are spread out. The returned id is valid right away: it is in
+	 * state PATH_PENDING until the search is done and then in PATH_READY,
+	 * or in PATH_NONE if no path was found.
+	 * Every client searches the queued requests in the same frames and in
+	 * the order they were made.
+	 */
+	virtual unsigned int RequestPathDeferred(
+		const MoveData* moveData,
+		const float3& startPos,
+		const float3& goalPos,
+		float goalRadius = 8.0f,
+		CSolidObject* caller = 0
+	) { return RequestPath(moveData, startPos, goalPos, goalRadius, caller, true); }
+
+	virtual PathState GetPathState(unsigned int pathId) const { return ((pathId != 0)? PATH_READY: PATH_NONE); }
+
 	/**
 	 * Whenever there are any changes in the terrain
 	 * (examples: explosions, new buildings, etc.)
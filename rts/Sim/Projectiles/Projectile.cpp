@@ -17,6 +17,9 @@
 #include "System/GlobalUnsynced.h"
 
 CR_BIND_DERIVED(CProjectile, CExpGenSpawnable, );
+#if !defined(USE_MMGR)
+CR_BIND_ALLOCATOR(CProjectile)
+#endif
 
 CR_REG_METADATA(CProjectile,
 (
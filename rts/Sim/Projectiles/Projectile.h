@@ -12,6 +12,7 @@
 #include "ExplosionGenerator.h"
 #include "Sim/Units/UnitHandler.h"
 #include "System/float3.h"
+#include "System/MemPool.h"
 
 class CUnit;
 class CFeature;
@@ -31,6 +32,15 @@ public:
 	virtual void Collision(CUnit* unit);
 	virtual void Collision(CFeature* feature);
 	virtual ~CProjectile();
+
+	#if !defined(USE_MMGR)
+	inline void* operator new(size_t size) { return mempool.Alloc(size); }
+	inline void operator delete(void* p, size_t size) { mempool.Free(p, size); }
+	// the above hide the placement forms, which creg needs
+	inline void* operator new(size_t size, void* p) { return p; }
+	inline void operator delete(void* p, void* q) {}
+	#endif
+
 	virtual void Update();
 	virtual void Init(const float3& pos, CUnit* owner);
 
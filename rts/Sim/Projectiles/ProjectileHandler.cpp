@@ -327,6 +327,31 @@ void CProjectileHandler::AddProjectile(CProjectile* p)
 
 
 
+/**
+ * Conservative early-out for CCollisionHandler::DetectHit: returns false
+ * only if the segment [p0, p1] misses a sphere around <pos> that contains
+ * the collision volume (whose center lies within <relMidPos> and the volume
+ * offsets of <pos>, whichever way the object is rotated). DetectHit itself
+ * builds and inverts the object's transform for every continuous test.
+ */
+static inline bool SegmentNearVolume(
+	const float3& p0,
+	const float3& p1,
+	const float3& pos,
+	const float3& relMidPos,
+	const CollisionVolume* v)
+{
+	const float radius = v->GetBoundingRadius() + relMidPos.Length() + v->GetOffsets().Length() + 1.0f;
+	const float3 dir = p1 - p0;
+	const float3 rel = pos - p0;
+	const float dirSq = dir.SqLength();
+
+	float t = (dirSq > 0.0f)? (rel.dot(dir) / dirSq): 0.0f;
+	t = std::max(0.0f, std::min(1.0f, t));
+
+	return ((rel - dir * t).SqLength() <= (radius * radius));
+}
+
 void CProjectileHandler::CheckUnitCollisions(
 	CProjectile* p,
 	std::vector<CUnit*>& tempUnits,
@@ -353,6 +378,11 @@ void CProjectileHandler::CheckUnitCollisions(
 			if (unit->IsNeutral()) { continue; }
 		}
 
+		// piece volumes are not bounded by the unit's volume
+		if (!unit->unitDef->usePieceCollisionVolumes) {
+			if (!SegmentNearVolume(ppos0, ppos1, unit->pos, unit->relMidPos, unit->collisionVolume)) { continue; }
+		}
+
 		if (CCollisionHandler::DetectHit(unit, ppos0, ppos1, &q)) {
 			if (q.lmp != NULL) {
 				unit->SetLastAttackedPiece(q.lmp, gs->frameNum);
@@ -405,6 +435,10 @@ void CProjectileHandler::CheckFeatureCollisions(
 			(feature->collisionVolume &&
 			feature->collisionVolume->GetTestType() == CollisionVolume::COLVOL_HITTEST_CONT);
 
+		if (!SegmentNearVolume(ppos0, ppos1, feature->pos, feature->midPos - feature->pos, feature->collisionVolume)) {
+			continue;
+		}
+
 		if (CCollisionHandler::DetectHit(feature, ppos0, ppos1, &q)) {
 			const float3 pimpp =
 				(q.b0 && q.b1)? (q.p0 + q.p1) * 0.5f:
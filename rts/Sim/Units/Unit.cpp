@@ -579,6 +579,7 @@ void CUnit::ForcedMove(const float3& newPos)
 	}
 
 	qf->MovedUnit(this);
+	uh->collisionGrid.MovedUnit(this);
 	loshandler->MoveUnit(this, false);
 	radarhandler->MoveUnit(this);
 }
@@ -798,6 +799,10 @@ void CUnit::SetLosStatus(int at, unsigned short newStatus)
 
 	// remove from the state after running the callins
 	losStatus[at] &= newStatus;
+
+	if (diffBits) {
+		helper->InvalidateTargetCache(this);
+	}
 }
 
 
@@ -1853,6 +1858,8 @@ void CUnit::KillUnit(bool selfDestruct, bool reclaimed, CUnit* attacker, bool sh
 	isDead = true;
 	deathSpeed = speed;
 
+	helper->InvalidateTargetCache(this);
+
 	eventHandler.UnitDestroyed(this, attacker);
 	eoh->UnitDestroyed(*this, attacker);
 	// Will be called in the destructor again, but this can not hurt
@@ -2214,6 +2221,9 @@ void CUnit::DeleteDeathDependence(CObject* o, DependenceType dep) {
 
 
 CR_BIND_DERIVED(CUnit, CSolidObject, );
+#if !defined(USE_MMGR)
+CR_BIND_ALLOCATOR(CUnit)
+#endif
 // Member bindings
 CR_REG_METADATA(CUnit, (
 	// CR_MEMBER(unitDef),
@@ -2281,7 +2291,7 @@ CR_REG_METADATA(CUnit, (
 	CR_MEMBER(seismicRadius),
 	CR_MEMBER(seismicSignature),
 	CR_MEMBER(hasRadarCapacity),
-	CR_MEMBER(radarSquares),
+	CR_MEMBER(radarSpans),
 	CR_MEMBER(oldRadarPos.x),
 	CR_MEMBER(oldRadarPos.y),
 	CR_MEMBER(hasRadarPos),
@@ -13,6 +13,7 @@
 #include "Lua/LuaUnitMaterial.h"
 #include "Sim/Objects/SolidObject.h"
 #include "Matrix44f.h"
+#include "MemPool.h"
 #include "Vec2.h"
 
 class CPlayer;
@@ -71,6 +72,14 @@ public:
 	CUnit();
 	virtual ~CUnit();
 
+	#if !defined(USE_MMGR)
+	inline void* operator new(size_t size) { return mempool.Alloc(size); }
+	inline void operator delete(void* p, size_t size) { mempool.Free(p, size); }
+	// the above hide the placement forms, which creg needs
+	inline void* operator new(size_t size, void* p) { return p; }
+	inline void operator delete(void* p, void* q) {}
+	#endif
+
 	virtual void PreInit(const UnitDef* def, int team, int facing, const float3& position, bool build);
 	virtual void PostInit(const CUnit* builder);
 
@@ -301,7 +310,7 @@ public:
 	int seismicRadius;
 	float seismicSignature;
 	bool hasRadarCapacity;
-	std::vector<int> radarSquares;
+	std::vector<int> radarSpans;
 	int2 oldRadarPos;
 	bool hasRadarPos;
 	bool stealth;
@@ -154,6 +154,9 @@ bool CUnitHandler::AddUnit(CUnit *unit)
 	unitsByDefs[unit->team][unit->unitDef->id].insert(unit);
 
 	maxUnitRadius = max(unit->radius, maxUnitRadius);
+
+	// created during the movetype update phase
+	collisionGrid.MovedUnit(unit);
 	return true;
 }
 
@@ -236,52 +239,75 @@ void CUnitHandler::Update()
 
 	GML_UPDATE_TICKS();
 
-	{
-		SCOPED_TIMER("Unit::MoveType::Update");
-		std::list<CUnit*>::iterator usi;
-		for (usi = activeUnits.begin(); usi != activeUnits.end(); ++usi) {
-			CUnit* unit = *usi;
-			AMoveType* moveType = unit->moveType;
-
-			if (moveType->Update()) {
-				eventHandler.UnitMoved(unit);
-			}
+	UpdateMoveTypes();
+	UpdateUnits();
+	SlowUpdateUnits();
+}
+
+
+void CUnitHandler::UpdateMoveTypes()
+{
+	SCOPED_TIMER("Unit::MoveType::Update");
+
+	// the parallel stage needs random access; units created
+	// during the phase are picked up by MovedUnit() instead
+	updateUnits.assign(activeUnits.begin(), activeUnits.end());
+	collisionGrid.Build(updateUnits, workerPool);
+
+	std::list<CUnit*>::iterator usi;
+	for (usi = activeUnits.begin(); usi != activeUnits.end(); ++usi) {
+		CUnit* unit = *usi;
+		AMoveType* moveType = unit->moveType;
 
-			GML_GET_TICKS(unit->lastUnitUpdate);
+		if (moveType->Update()) {
+			eventHandler.UnitMoved(unit);
 		}
+
+		collisionGrid.MovedUnit(unit);
+
+		GML_GET_TICKS(unit->lastUnitUpdate);
 	}
 
-	{
-		SCOPED_TIMER("Unit::Update");
-		std::list<CUnit*>::iterator usi;
-		for (usi = activeUnits.begin(); usi != activeUnits.end(); ++usi) {
-			CUnit* unit = *usi;
-
-			if (unit->deathScriptFinished) {
-				// there are many ways to fiddle with "deathScriptFinished", so a unit may
-				// arrive here without having been properly killed (and isDead still false),
-				// which can result in MT deadlocking -- FIXME verify this
-				// (KU returns early if isDead)
-				unit->KillUnit(false, true, NULL);
-
-				DeleteUnit(unit);
-			} else {
-				unit->Update();
-			}
+	collisionGrid.ResolveCollisions();
+	collisionGrid.Clear();
+}
+
+
+void CUnitHandler::UpdateUnits()
+{
+	SCOPED_TIMER("Unit::Update");
+
+	std::list<CUnit*>::iterator usi;
+	for (usi = activeUnits.begin(); usi != activeUnits.end(); ++usi) {
+		CUnit* unit = *usi;
+
+		if (unit->deathScriptFinished) {
+			// there are many ways to fiddle with "deathScriptFinished", so a unit may
+			// arrive here without having been properly killed (and isDead still false),
+			// which can result in MT deadlocking -- FIXME verify this
+			// (KU returns early if isDead)
+			unit->KillUnit(false, true, NULL);
+
+			DeleteUnit(unit);
+		} else {
+			unit->Update();
 		}
 	}
+}
 
-	{
-		SCOPED_TIMER("Unit::SlowUpdate");
-		if (!(gs->frameNum & (UNIT_SLOWUPDATE_RATE - 1))) {
-			slowUpdateIterator = activeUnits.begin();
-		}
 
-		int n = (activeUnits.size() / UNIT_SLOWUPDATE_RATE) + 1;
-		for (; slowUpdateIterator != activeUnits.end() && n != 0; ++ slowUpdateIterator) {
-			(*slowUpdateIterator)->SlowUpdate(); n--;
-		}
-	} // for timer destruction
+void CUnitHandler::SlowUpdateUnits()
+{
+	SCOPED_TIMER("Unit::SlowUpdate");
+
+	if (!(gs->frameNum & (UNIT_SLOWUPDATE_RATE - 1))) {
+		slowUpdateIterator = activeUnits.begin();
+	}
+
+	int n = (activeUnits.size() / UNIT_SLOWUPDATE_RATE) + 1;
+	for (; slowUpdateIterator != activeUnits.end() && n != 0; ++ slowUpdateIterator) {
+		(*slowUpdateIterator)->SlowUpdate(); n--;
+	}
 }
 
 
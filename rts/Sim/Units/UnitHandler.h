@@ -12,6 +12,8 @@
 #include "UnitDef.h"
 #include "UnitSet.h"
 #include "CommandAI/Command.h"
+#include "Sim/Misc/SimWorkerPool.h"
+#include "Sim/MoveTypes/MoveCollisionGrid.h"
 
 class CUnit;
 class CBuilderCAI;
@@ -75,14 +77,23 @@ public:
 	std::vector<CUnit*> units;                        ///< used to get units from IDs (0 if not created)
 	std::list<CBuilderCAI*> builderCAIs;
 
+	CMoveCollisionGrid collisionGrid; ///< only built while the movetypes are updated
+
 	float maxUnitRadius; ///< largest radius seen so far
 	bool morphUnitToFeature;
 
 private:
+	void UpdateMoveTypes();
+	void UpdateUnits();
+	void SlowUpdateUnits();
+
 	std::list<unsigned int> freeUnitIDs;
 	std::vector<CUnit*> unitsToBeRemoved;            ///< units that will be removed at start of next update
 	std::list<CUnit*>::iterator slowUpdateIterator;
 
+	std::vector<CUnit*> updateUnits;                 ///< contiguous copy of activeUnits for the parallel stages
+	CSimWorkerPool workerPool;
+
 	unsigned int maxUnits;
 	unsigned int maxUnitsPerTeam;
 };
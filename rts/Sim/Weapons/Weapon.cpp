@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
 #include "mmgr.h"
 #include "creg/STL_List.h"
 #include "WeaponDefHandler.h"
@@ -697,17 +698,25 @@ void CWeapon::SlowUpdate(bool noAutoTargetOverride)
 	if (!noAutoTargetOverride && AllowWeaponTargetCheck()) {
 		lastTargetRetry = gs->frameNum;
 
-		std::multimap<float, CUnit*> targets;
-		std::multimap<float, CUnit*>::const_iterator nextTargetIt;
-		std::multimap<float, CUnit*>::const_iterator lastTargetIt;
+		// reused by all weapons, SlowUpdate never runs concurrently
+		static std::vector<CGameHelper::WeaponTarget> targets;
 
 		helper->GenerateWeaponTargets(this, targetUnit, targets);
 
-		if (!targets.empty())
-			lastTargetIt = --targets.end();
+		// usually one of the best few targets is taken,
+		// so the others are only sorted when they are needed
+		const size_t numTargets = targets.size();
+		size_t numSorted = std::min(numTargets, size_t(8));
 
-		for (nextTargetIt = targets.begin(); nextTargetIt != targets.end(); ++nextTargetIt) {
-			CUnit* nextTargetUnit = nextTargetIt->second;
+		std::partial_sort(targets.begin(), targets.begin() + numSorted, targets.end());
+
+		for (size_t t = 0; t < numTargets; ++t) {
+			if (t == numSorted) {
+				std::sort(targets.begin() + numSorted, targets.end());
+				numSorted = numTargets;
+			}
+
+			CUnit* nextTargetUnit = targets[t].unit;
 
 			if (nextTargetUnit->neutral && (owner->fireState <= FIRESTATE_FIREATWILL)) {
 				continue;
@@ -717,7 +726,7 @@ void CWeapon::SlowUpdate(bool noAutoTargetOverride)
 			// and we want to attack whether it is in our bad target category or not
 			// (if only bad targets are available and this is the last, just pick it)
 			if (nextTargetUnit != targetUnit && (nextTargetUnit->category & badTargetCategory)) {
-				if (nextTargetIt != lastTargetIt) {
+				if (t != numTargets - 1) {
 					continue;
 				}
 			}
@@ -42,13 +42,22 @@ bool CArchiveBase::HasLowReadingCost(unsigned fid) const
 unsigned CArchiveBase::GetCrc32(unsigned fid)
 {
 	CRC crc;
-	std::vector<boost::uint8_t> buffer;
-	if (GetFile(fid, buffer))
-		crc.Update(&buffer[0], buffer.size());
+	const FileViewPtr view = GetFileView(fid);
+	if (view && view->GetSize() > 0)
+		crc.Update(view->GetData(), view->GetSize());
 
 	return crc.GetDigest();
 }
 
+FileViewPtr CArchiveBase::GetFileView(unsigned fid)
+{
+	std::vector<boost::uint8_t> buffer;
+	if (!GetFile(fid, buffer))
+		return FileViewPtr();
+
+	return FileViewPtr(new CBufferFileView(buffer));
+}
+
 bool CArchiveBase::GetFile(const std::string& name, std::vector<boost::uint8_t>& buffer)
 {
 	unsigned fid = FindFile(name);
@@ -60,3 +69,12 @@ bool CArchiveBase::GetFile(const std::string& name, std::vector<boost::uint8_t>&
 	else
 		return false;
 }
+
+FileViewPtr CArchiveBase::GetFileView(const std::string& name)
+{
+	unsigned fid = FindFile(name);
+	if (fid < NumFiles())
+		return GetFileView(fid);
+	else
+		return FileViewPtr();
+}
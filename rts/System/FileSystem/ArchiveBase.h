@@ -10,6 +10,8 @@
 #include <map>
 #include <boost/cstdint.hpp>
 
+#include "FileView.h"
+
 /**
 @brief Abstraction of different archive types
 
@@ -44,6 +46,14 @@ public:
 	 */
 	unsigned FindFile(const std::string& filePath) const;
 	virtual bool GetFile(unsigned fid, std::vector<boost::uint8_t>& buffer) = 0;
+	/**
+	 * Returns a read-only view of the contents of a file, which avoids
+	 * copying the data where the archive type allows it (see FileView.h).
+	 * May be called from multiple threads at once.
+	 * The default implementation reads the file through GetFile().
+	 * @return an empty pointer if the file could not be read
+	 */
+	virtual FileViewPtr GetFileView(unsigned fid);
 	virtual void FileInfo(unsigned fid, std::string& name, int& size) const = 0;
 	/**
 	 * Returns true if the cost of reading the file is in qualitatively relative
@@ -61,6 +71,7 @@ public:
 
 	/// for convenience
 	bool GetFile(const std::string& name, std::vector<boost::uint8_t>& buffer);
+	FileViewPtr GetFileView(const std::string& name);
 
 protected:
 	std::map<std::string, unsigned> lcNameIndex; ///< must be populated by the subclass
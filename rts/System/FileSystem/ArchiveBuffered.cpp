@@ -5,7 +5,11 @@
 #include "ArchiveBuffered.h"
 
 
-CArchiveBuffered::CArchiveBuffered(const std::string& name) : CArchiveBase(name)
+const size_t CArchiveBuffered::CACHE_BUDGET = 32 * 1024 * 1024;
+const size_t CArchiveBuffered::CACHE_MAX_FILE_SIZE = CACHE_BUDGET / 4;
+
+
+CArchiveBuffered::CArchiveBuffered(const std::string& name) : CArchiveBase(name), cacheSize(0)
 {
 }
 
@@ -15,18 +19,67 @@ CArchiveBuffered::~CArchiveBuffered(void)
 
 bool CArchiveBuffered::GetFile(unsigned fid, std::vector<boost::uint8_t>& buffer)
 {
-	boost::mutex::scoped_lock lck(archiveLock);
+	const FileViewPtr view = GetFileView(fid);
+	if (!view)
+		return false;
+
+	buffer.assign(view->GetData(), view->GetData() + view->GetSize());
+	return true;
+}
+
+FileViewPtr CArchiveBuffered::GetFileView(unsigned fid)
+{
 	assert(fid >= 0 && fid < NumFiles());
 
-	if (fid >= cache.size())
-		cache.resize(fid+1);
-	
-	if (!cache[fid].populated)
-	{
-		cache[fid].exists = GetFileImpl(fid, cache[fid].data);
-		cache[fid].populated = true;
+	FileViewPtr view = GetCachedFile(fid);
+	if (view)
+		return view;
+
+	// uncompress without holding the lock, so other
+	// threads can read from this archive meanwhile
+	std::vector<boost::uint8_t> buffer;
+	if (!GetFileImpl(fid, buffer))
+		return FileViewPtr();
+
+	view.reset(new CBufferFileView(buffer));
+	CacheFile(fid, view);
+	return view;
+}
+
+FileViewPtr CArchiveBuffered::GetCachedFile(unsigned fid)
+{
+	boost::mutex::scoped_lock lck(cacheLock);
+
+	std::map<unsigned, CachedFile>::iterator it = cache.find(fid);
+	if (it == cache.end())
+		return FileViewPtr();
+
+	lru.splice(lru.begin(), lru, it->second.lruPos);
+	return it->second.view;
+}
+
+void CArchiveBuffered::CacheFile(unsigned fid, const FileViewPtr& view)
+{
+	if (view->GetSize() > CACHE_MAX_FILE_SIZE)
+		return;
+
+	boost::mutex::scoped_lock lck(cacheLock);
+
+	// another thread may have read the same file meanwhile
+	if (cache.find(fid) != cache.end())
+		return;
+
+	while (!lru.empty() && (cacheSize + view->GetSize() > CACHE_BUDGET)) {
+		std::map<unsigned, CachedFile>::iterator it = cache.find(lru.back());
+		// views handed out before stay valid, this only drops our reference
+		cacheSize -= it->second.view->GetSize();
+		cache.erase(it);
+		lru.pop_back();
 	}
 
-	buffer = cache[fid].data;
-	return cache[fid].exists;
+	lru.push_front(fid);
+	CachedFile& cf = cache[fid];
+	cf.view = view;
+	cf.lruPos = lru.begin();
+	cacheSize += view->GetSize();
 }
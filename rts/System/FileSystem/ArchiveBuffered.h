@@ -4,12 +4,16 @@
 #define __ARCHIVE_BUFFERED_H
 
 #include <map>
+#include <list>
 #include <boost/thread/mutex.hpp>
 
 #include "ArchiveBase.h"
 
-// Provides a helper implementation for archive types that can only uncompress one file to
-// memory at a time
+/**
+ * Provides a helper implementation for archive types that have to uncompress
+ * a file to memory before it can be used.
+ * The most recently used files are kept in memory, up to a fixed budget.
+ */
 class CArchiveBuffered : public CArchiveBase
 {
 public:
@@ -17,19 +21,34 @@ public:
 	virtual ~CArchiveBuffered(void);
 
 	virtual bool GetFile(unsigned fid, std::vector<boost::uint8_t>& buffer);
+	virtual FileViewPtr GetFileView(unsigned fid);
 
 protected:
+	/**
+	 * Reads a file into buffer.
+	 * This is called without any lock held, so it has to be thread-safe.
+	 */
 	virtual bool GetFileImpl(unsigned fid, std::vector<boost::uint8_t>& buffer) = 0;
 
-	boost::mutex archiveLock; // neither 7zip nor zlib are threadsafe
-	struct FileBuffer
+private:
+	FileViewPtr GetCachedFile(unsigned fid);
+	void CacheFile(unsigned fid, const FileViewPtr& view);
+
+	/// maximum amount of file data kept in memory per archive
+	static const size_t CACHE_BUDGET;
+	/// larger files are not kept at all, they would evict everything else
+	static const size_t CACHE_MAX_FILE_SIZE;
+
+	struct CachedFile
 	{
-		FileBuffer() : populated(false), exists(false) {};
-		bool populated; // cause a file may be 0 bytes big
-		bool exists;
-		std::vector<boost::uint8_t> data;
+		FileViewPtr view;
+		std::list<unsigned>::iterator lruPos;
 	};
-	std::vector<FileBuffer> cache; // cache[fileId]
+
+	boost::mutex cacheLock;
+	std::map<unsigned, CachedFile> cache; // cache[fileId]
+	std::list<unsigned> lru; ///< fileIds, most recently used first
+	size_t cacheSize;
 };
 
 #endif
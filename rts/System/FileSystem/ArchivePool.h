@@ -70,6 +70,7 @@ public:
 	virtual unsigned GetCrc32(unsigned fid);
 
 protected:
+	/// every call opens its own gzip stream, so no locking is needed
 	virtual bool GetFileImpl(unsigned fid, std::vector<boost::uint8_t>& buffer);
 
 	struct FileData {
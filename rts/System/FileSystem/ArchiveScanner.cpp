@@ -5,8 +5,13 @@
 #include <list>
 #include <algorithm>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "mmgr.h"
 
@@ -39,7 +44,7 @@ CLogSubsystem LOG_ARCHIVESCANNER("ArchiveScanner");
  * but mapping them all, every time to make the list is)
  */
 
-const int INTERNAL_VER = 9;
+const int INTERNAL_VER = 11;
 CArchiveScanner* archiveScanner = NULL;
 
 
@@ -124,10 +129,8 @@ CArchiveScanner::ArchiveData::ArchiveData(const LuaTable& archiveTable)
 	//! so they can uniquely identify different versions of the same mod.
 	//! (at time of this writing they use name only)
 
-	//! NOTE when changing this, this function is used both by the code that
-	//! reads ArchiveCache.lua and the code that reads modinfo.lua from the mod.
-	//! so make sure it doesn't keep adding stuff to the name everytime
-	//! Spring/unitsync is loaded.
+	//! NOTE the archive cache stores the name as modified here, so
+	//! this is only applied when modinfo.lua is read from the mod.
 
 	const std::string& name = GetName();
 	const std::string& version = GetVersion();
@@ -332,7 +335,7 @@ CArchiveScanner::CArchiveScanner()
 {
 	std::ostringstream file;
 	// the "cache" dir is created in DataDirLocater
-	file << "cache" << (char)FileSystemHandler::GetNativePathSeparator() << "ArchiveCache.lua";
+	file << "cache" << (char)FileSystemHandler::GetNativePathSeparator() << "ArchiveCache.bin";
 	cachefile = file.str();
 	FileSystemHandler& fsh = FileSystemHandler::GetInstance();
 	ReadCacheData(fsh.GetWriteDir() + GetFilename());
@@ -365,25 +368,64 @@ const std::string& CArchiveScanner::GetFilename() const
 }
 
 
+static float SecondsSince(const boost::posix_time::ptime& start)
+{
+	const boost::posix_time::time_duration d = boost::posix_time::microsec_clock::universal_time() - start;
+	return (d.total_microseconds() * 0.000001f);
+}
+
 void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs, bool doChecksum)
 {
-	// add the archives
+	const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+	// rebuilt below from the replace lists of the archives found now
+	replacedArchives.clear();
+
+	// find the archives, and those of them which have to be opened
+	std::vector<ScanJob> jobs;
+	unsigned int numArchives = 0;
+
 	std::vector<std::string>::const_iterator dir;
 	for (dir = scanDirs.begin(); dir != scanDirs.end(); ++dir) {
 		if (FileSystemHandler::DirExists(*dir)) {
 			logOutput.Print("Scanning: %s\n", dir->c_str());
-			Scan(*dir, doChecksum);
+			numArchives += Scan(*dir, doChecksum, jobs);
 		}
 	}
+
+	const float findTime = SecondsSince(startTime);
+	const boost::posix_time::ptime jobsStartTime = boost::posix_time::microsec_clock::universal_time();
+	const unsigned int numThreads = RunScanJobs(jobs);
+	const float jobsTime = SecondsSince(jobsStartTime);
+
+	// in the order they were found, so the last one of a name wins
+	for (std::vector<ScanJob>::iterator job = jobs.begin(); job != jobs.end(); ++job) {
+		FinishScanJob(*job);
+	}
+
+	// Now we'll have to parse the replaces-stuff found in the mods
+	for (std::map<std::string, ArchiveInfo>::const_iterator aii = archiveInfo.begin(); aii != archiveInfo.end(); ++aii) {
+		for (std::vector<std::string>::const_iterator i = aii->second.archiveData.GetReplaces().begin(); i != aii->second.archiveData.GetReplaces().end(); ++i) {
+			const std::string lcname = StringToLower(*i);
+
+			if (lcname != aii->first) {
+				replacedArchives[lcname] = aii->first;
+			}
+		}
+	}
+
+	logOutput.Print("Scanned %u archives in %.2fs (%.2fs listing, %.2fs opening "_STPF_" new or changed ones on %u threads)",
+			numArchives, SecondsSince(startTime), findTime, jobsTime, jobs.size(), numThreads);
 }
 
 
-void CArchiveScanner::Scan(const std::string& curPath, bool doChecksum)
+unsigned int CArchiveScanner::Scan(const std::string& curPath, bool doChecksum, std::vector<ScanJob>& jobs)
 {
 	isDirty = true;
 
 	const int flags = (FileSystem::INCLUDE_DIRS | FileSystem::RECURSE);
 	const std::vector<std::string> &found = filesystem.FindFiles(curPath, "*", flags);
+	unsigned int numArchives = 0;
 
 	for (std::vector<std::string>::const_iterator it = found.begin(); it != found.end(); ++it) {
 		std::string fullName = *it;
@@ -410,34 +452,12 @@ void CArchiveScanner::Scan(const std::string& curPath, bool doChecksum)
 
 		// Is this an archive we should look into?
 		if (CArchiveFactory::IsScanArchive(fullName)) {
-			ScanArchive(fullName, doChecksum);
+			ScanArchive(fullName, doChecksum, jobs);
+			++numArchives;
 		}
 	}
 
-	// Now we'll have to parse the replaces-stuff found in the mods
-	for (std::map<std::string, ArchiveInfo>::iterator aii = archiveInfo.begin(); aii != archiveInfo.end(); ++aii) {
-		for (std::vector<std::string>::const_iterator i = aii->second.archiveData.GetReplaces().begin(); i != aii->second.archiveData.GetReplaces().end(); ++i) {
-
-			const std::string lcname = StringToLower(*i);
-			std::map<std::string, ArchiveInfo>::iterator ar = archiveInfo.find(lcname);
-
-			// If it's not there, we will create a new entry
-			if (ar == archiveInfo.end()) {
-				ArchiveInfo tmp;
-				archiveInfo[lcname] = tmp;
-				ar = archiveInfo.find(lcname);
-			}
-
-			// Overwrite the info for this archive with a replaced pointer
-			ar->second.path = "";
-			ar->second.origName = lcname;
-			ar->second.modified = 1;
-			ArchiveData empty;
-			ar->second.archiveData = empty;
-			ar->second.updated = true;
-			ar->second.replaced = aii->first;
-		}
-	}
+	return numArchives;
 }
 
 static void AddDependency(std::vector<std::string>& deps, const std::string& dependency)
@@ -451,19 +471,33 @@ static void AddDependency(std::vector<std::string>& deps, const std::string& dep
 	deps.push_back(dependency);
 }
 
-void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
+void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum, std::vector<ScanJob>& jobs)
 {
 	struct stat info;
 	stat(fullName.c_str(), &info);
 
+	FileStamp stamp;
+	stamp.modified = info.st_mtime;
+	stamp.size = info.st_size;
+	stamp.inode = info.st_ino;
+
 	const std::string fn    = filesystem.GetFilename(fullName);
 	const std::string fpath = filesystem.GetDirectory(fullName);
 	const std::string lcfn  = StringToLower(fn);
 
+	//! The archive namespace is global, drop an earlier
+	//! queued archive of the same name in favour of this one
+	for (std::vector<ScanJob>::iterator job = jobs.begin(); job != jobs.end(); ++job) {
+		if (job->lcfn == lcfn) {
+			jobs.erase(job);
+			break;
+		}
+	}
+
 	//! Determine whether this archive has earlier be found to be broken
 	std::map<std::string, BrokenArchive>::iterator bai = brokenArchives.find(lcfn);
 	if (bai != brokenArchives.end()) {
-		if ((unsigned)info.st_mtime == bai->second.modified && fpath == bai->second.path) {
+		if (stamp == bai->second.stamp && fpath == bai->second.path) {
 			bai->second.updated = true;
 			return;
 		}
@@ -475,12 +509,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	std::map<std::string, ArchiveInfo>::iterator aii = archiveInfo.find(lcfn);
 	if (aii != archiveInfo.end()) {
 
-		//! This archive may have been obsoleted, do not process it if so
-		if (aii->second.replaced.length() > 0) {
-			return;
-		}
-
-		if ((unsigned)info.st_mtime == aii->second.modified && fpath == aii->second.path) {
+		if (stamp == aii->second.stamp && fpath == aii->second.path) {
 			cached = true;
 			aii->second.updated = true;
 		}
@@ -493,132 +522,237 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		}
 	}
 
-	//! Time to parse the info we are interested in
-	if (cached) {
-		//! If cached is true, aii will point to the archive
-		if (doChecksum && (aii->second.checksum == 0))
-			aii->second.checksum = GetCRC(fullName);
-	} else {
-		CArchiveBase* ar = CArchiveFactory::OpenArchive(fullName);
-		if (!ar || !ar->IsOpen()) {
-			logOutput.Print("Unable to open archive: %s", fullName.c_str());
-			return;
-		}
+	//! If cached is true, aii will point to the archive
+	if (cached && !(doChecksum && (aii->second.checksum == 0))) {
+		return;
+	}
 
-		ArchiveInfo ai;
-		std::string error = "";
-
-		std::string mapfile;
-		bool hasModinfo = ar->FileExists("modinfo.lua");
-		bool hasMapinfo = ar->FileExists("mapinfo.lua");
-		
-		//! check for smf/sm3 and if the uncompression of important files is too costy
-		for (unsigned fid = 0; fid != ar->NumFiles(); ++fid)
+	//! Time to parse the info we are interested in,
+	//! which is done in RunScanJobs and FinishScanJob
+	ScanJob job;
+	job.fullName = fullName;
+	job.fpath = fpath;
+	job.lcfn = lcfn;
+	job.stamp = stamp;
+	job.doChecksum = doChecksum;
+	job.checksumOnly = cached;
+	job.opened = false;
+	job.isMap = false;
+	job.checksum = 0;
+	jobs.push_back(job);
+}
+
+
+unsigned int CArchiveScanner::RunScanJobs(std::vector<ScanJob>& jobs)
+{
+	if (jobs.empty()) {
+		return 0;
+	}
+
+	unsigned int numThreads = std::max(1u, boost::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, (unsigned int) jobs.size());
+
+	size_t nextJob = 0;
+	boost::mutex jobMutex;
+	boost::thread_group threads;
+
+	for (unsigned int i = 1; i < numThreads; ++i) {
+		threads.create_thread(boost::bind(&CArchiveScanner::ScanJobsThread, boost::ref(jobs), boost::ref(nextJob), boost::ref(jobMutex)));
+	}
+
+	// use the current thread as thread zero
+	ScanJobsThread(jobs, nextJob, jobMutex);
+	threads.join_all();
+
+	return numThreads;
+}
+
+void CArchiveScanner::ScanJobsThread(std::vector<ScanJob>& jobs, size_t& nextJob, boost::mutex& jobMutex)
+{
+	while (true) {
+		size_t jobIdx;
 		{
-			std::string name;
-			int size;
-			ar->FileInfo(fid, name, size);
-			const std::string lowerName = StringToLower(name);
-			const std::string ext = filesystem.GetExtension(lowerName);
-
-			if ((ext == "smf") || (ext == "sm3")) {
-				mapfile = name;
+			boost::mutex::scoped_lock lock(jobMutex);
+			if (nextJob >= jobs.size()) {
+				return;
 			}
+			jobIdx = nextJob++;
+		}
+
+		ProcessScanJob(jobs[jobIdx]);
+	}
+}
 
-			const unsigned char metaFileClass = GetMetaFileClass(lowerName);
-			if ((metaFileClass != 0) && !(ar->HasLowReadingCost(fid))) {
-				//! is a meta-file and not cheap to read
-				if (metaFileClass == 1) {
-					//! 1st class
-					error = "Unpacking/reading cost for meta file " + name
-							+ " is too high, please repack the archive (make sure to use a non-solid algorithm, if applicable)";
-					break;
-				} else if (metaFileClass == 2) {
-					//! 2nd class
-					logOutput.Print(LOG_ARCHIVESCANNER,
-							"Warning: Archive %s: The cost for reading a 2nd class meta-file is too high: %s",
-							fullName.c_str(), name.c_str());
+
+/**
+ * The archive constructors may log errors, and logOutput is
+ * not thread-safe outside of GML builds, so only one archive
+ * is being opened at a time.
+ */
+static boost::mutex openArchiveMutex;
+
+void CArchiveScanner::ProcessScanJob(ScanJob& job)
+{
+	CArchiveBase* ar = NULL;
+	{
+		boost::mutex::scoped_lock lock(openArchiveMutex);
+		ar = CArchiveFactory::OpenArchive(job.fullName);
+	}
+	if (!ar || !ar->IsOpen()) {
+		delete ar;
+		return;
+	}
+
+	job.opened = true;
+
+	try {
+		if (!job.checksumOnly) {
+			bool hasModinfo = ar->FileExists("modinfo.lua");
+			bool hasMapinfo = ar->FileExists("mapinfo.lua");
+
+			//! check for smf/sm3 and if the uncompression of important files is too costy
+			for (unsigned fid = 0; fid != ar->NumFiles(); ++fid)
+			{
+				std::string name;
+				int size;
+				ar->FileInfo(fid, name, size);
+				const std::string lowerName = StringToLower(name);
+				const std::string ext = filesystem.GetExtension(lowerName);
+
+				if ((ext == "smf") || (ext == "sm3")) {
+					job.mapfile = name;
+				}
+
+				const unsigned char metaFileClass = GetMetaFileClass(lowerName);
+				if ((metaFileClass != 0) && !(ar->HasLowReadingCost(fid))) {
+					//! is a meta-file and not cheap to read
+					if (metaFileClass == 1) {
+						//! 1st class
+						job.error = "Unpacking/reading cost for meta file " + name
+								+ " is too high, please repack the archive (make sure to use a non-solid algorithm, if applicable)";
+						break;
+					} else if (metaFileClass == 2) {
+						//! 2nd class
+						job.warnings.push_back("The cost for reading a 2nd class meta-file is too high: " + name);
+					}
 				}
 			}
-		}
 
-		if (!error.empty()) {
-			//! we already have an error, no further evaluation required
-		} if (hasMapinfo || !mapfile.empty()) {
-			//! it is a map
-			if (hasMapinfo) {
-				ScanArchiveLua(ar, "mapinfo.lua", ai, error);
+			if (!job.error.empty()) {
+				//! we already have an error, no further evaluation required
+			} else if (hasMapinfo || !job.mapfile.empty()) {
+				//! it is a map, modinfo.lua is allowed for backwards-compatibility
+				job.isMap = true;
+				if (hasMapinfo) {
+					job.infoFile = "mapinfo.lua";
+				} else if (hasModinfo) {
+					job.infoFile = "modinfo.lua";
+				}
 			} else if (hasModinfo) {
-				//! backwards-compat for modinfo.lua in maps
-				ScanArchiveLua(ar, "modinfo.lua", ai, error);
+				//! it is a mod
+				job.infoFile = "modinfo.lua";
+			} else {
+				//! neither a map nor a mod: error
+				job.error = "missing modinfo.lua/mapinfo.lua";
 			}
-			if (ai.archiveData.GetName().empty()) {
-				//! FIXME The name will never be empty, if version is set (see HACK in ArchiveData)
-				ai.archiveData.SetInfoItemValueString("name", filesystem.GetBasename(mapfile));
-			}
-			if (ai.archiveData.GetMapFile().empty()) {
-				ai.archiveData.SetInfoItemValueString("mapfile", mapfile);
-			}
-			AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
-			ai.archiveData.SetInfoItemValueInteger("modType", modtype::map);
-
-			logOutput.Print(LOG_ARCHIVESCANNER, "Found new map: %s", ai.archiveData.GetName().c_str());
-		} else if (hasModinfo) {
-			//! it is a mod
-			ScanArchiveLua(ar, "modinfo.lua", ai, error);
-			if (ai.archiveData.GetModType() == modtype::primary) {
-				AddDependency(ai.archiveData.GetDependencies(), "Spring content v1");
+
+			if (!job.infoFile.empty() && !ar->GetFile(job.infoFile, job.infoBuf)) {
+				job.infoFile.clear();
 			}
+		}
 
-			logOutput.Print(LOG_ARCHIVESCANNER, "Found new game: %s", ai.archiveData.GetName().c_str());
-		} else {
-			//! neither a map nor a mod: error
-			error = "missing modinfo.lua/mapinfo.lua";
+		//! Optionally calculate a checksum for the file
+		if (job.doChecksum && job.error.empty()) {
+			job.checksum = GetCRC(ar);
 		}
+	} catch (const std::exception& e) {
+		job.error = e.what();
+	}
 
-		delete ar;
+	delete ar;
+}
 
-		if (!error.empty()) {
-			//! for some reason, the archive is marked as broken
-			logOutput.Print("Failed to scan %s (%s)", fullName.c_str(), error.c_str());
-
-			//! record it as broken, so we don't need to look inside everytime
-			BrokenArchive ba;
-			ba.path = fpath;
-			ba.modified = info.st_mtime;
-			ba.updated = true;
-			ba.problem = error;
-			brokenArchives[lcfn] = ba;
-			return;
+void CArchiveScanner::FinishScanJob(ScanJob& job)
+{
+	if (!job.opened) {
+		logOutput.Print("Unable to open archive: %s", job.fullName.c_str());
+		return;
+	}
+
+	for (std::vector<std::string>::const_iterator w = job.warnings.begin(); w != job.warnings.end(); ++w) {
+		logOutput.Print(LOG_ARCHIVESCANNER, "Warning: Archive %s: %s", job.fullName.c_str(), w->c_str());
+	}
+
+	if (job.checksumOnly) {
+		std::map<std::string, ArchiveInfo>::iterator aii = archiveInfo.find(job.lcfn);
+		if (aii != archiveInfo.end()) {
+			aii->second.checksum = job.checksum;
 		}
+		return;
+	}
 
-		ai.path = fpath;
-		ai.modified = info.st_mtime;
-		ai.origName = fn;
-		ai.updated = true;
+	ArchiveInfo ai;
+	std::string error = job.error;
 
-		//! Optionally calculate a checksum for the file
-		//! To prevent reading all files in all directory (.sdd) archives
-		//! every time this function is called, directory archive checksums
-		//! are calculated on the fly.
-		if (doChecksum) {
-			ai.checksum = GetCRC(fullName);
-		} else {
-			ai.checksum = 0;
+	if (!error.empty()) {
+		//! we already have an error, no further evaluation required
+	} else if (job.isMap) {
+		if (!job.infoFile.empty()) {
+			ScanArchiveLua(job.infoBuf, job.infoFile, ai, error);
+		}
+		if (ai.archiveData.GetName().empty()) {
+			//! FIXME The name will never be empty, if version is set (see HACK in ArchiveData)
+			ai.archiveData.SetInfoItemValueString("name", filesystem.GetBasename(job.mapfile));
+		}
+		if (ai.archiveData.GetMapFile().empty()) {
+			ai.archiveData.SetInfoItemValueString("mapfile", job.mapfile);
 		}
+		AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
+		ai.archiveData.SetInfoItemValueInteger("modType", modtype::map);
 
-		archiveInfo[lcfn] = ai;
+		logOutput.Print(LOG_ARCHIVESCANNER, "Found new map: %s", ai.archiveData.GetName().c_str());
+	} else {
+		//! it is a mod
+		if (!job.infoFile.empty()) {
+			ScanArchiveLua(job.infoBuf, job.infoFile, ai, error);
+		}
+		if (ai.archiveData.GetModType() == modtype::primary) {
+			AddDependency(ai.archiveData.GetDependencies(), "Spring content v1");
+		}
+
+		logOutput.Print(LOG_ARCHIVESCANNER, "Found new game: %s", ai.archiveData.GetName().c_str());
 	}
-}
 
-bool CArchiveScanner::ScanArchiveLua(CArchiveBase* ar, const std::string& fileName, ArchiveInfo& ai,  std::string& err)
-{
-	std::vector<boost::uint8_t> buf;
-	if (!ar->GetFile(fileName, buf)) {
-		return false;
+	if (!error.empty()) {
+		//! for some reason, the archive is marked as broken
+		logOutput.Print("Failed to scan %s (%s)", job.fullName.c_str(), error.c_str());
+
+		//! record it as broken, so we don't need to look inside everytime
+		BrokenArchive ba;
+		ba.path = job.fpath;
+		ba.stamp = job.stamp;
+		ba.updated = true;
+		ba.problem = error;
+		brokenArchives[job.lcfn] = ba;
+		return;
 	}
 
-	const std::string cleanbuf((char*)(&buf[0]), buf.size());
+	ai.path = job.fpath;
+	ai.stamp = job.stamp;
+	ai.origName = filesystem.GetFilename(job.fullName);
+	ai.updated = true;
+
+	//! To prevent reading all files in all directory (.sdd) archives
+	//! every time this function is called, directory archive checksums
+	//! are calculated on the fly.
+	ai.checksum = job.checksum;
+
+	archiveInfo[job.lcfn] = ai;
+}
+
+bool CArchiveScanner::ScanArchiveLua(const std::vector<boost::uint8_t>& buf, const std::string& fileName, ArchiveInfo& ai, std::string& err)
+{
+	const std::string cleanbuf(buf.begin(), buf.end());
 	LuaParser p(cleanbuf, SPRING_VFS_MOD);
 	if (!p.Execute()) {
 		err = "Error in " + fileName + ": " + p.GetErrorLog();
@@ -651,20 +785,13 @@ IFileFilter* CArchiveScanner::CreateIgnoreFilter(CArchiveBase* ar)
 
 /**
  * Get CRC of the data in the specified archive.
- * Returns 0 if file could not be opened.
+ * Never returns 0, which is used to indicate "no checksum".
  */
-unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
+unsigned int CArchiveScanner::GetCRC(CArchiveBase* ar)
 {
 	CRC crc;
-	CArchiveBase* ar;
 	std::list<std::string> files;
 
-	//! Try to open an archive
-	ar = CArchiveFactory::OpenArchive(arcName);
-	if (!ar) {
-		return 0; // It wasn't an archive
-	}
-
 	//! Load ignore list.
 	IFileFilter* ignore = CreateIgnoreFilter(ar);
 
@@ -693,7 +820,6 @@ unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
 	}
 
 	delete ignore;
-	delete ar;
 
 	unsigned int digest = crc.GetDigest();
 
@@ -706,94 +832,185 @@ unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
 	}
 }
 
-void CArchiveScanner::ReadCacheData(const std::string& filename)
+
+/*
+ * The cache is a flat binary file in native byte order (it never leaves the
+ * machine it was written on), starting with CACHE_MAGIC and INTERNAL_VER.
+ * Strings are stored as a 32-bit length followed by the characters.
+ */
+static const boost::uint32_t CACHE_MAGIC = 0x43415053; // "SPAC"
+
+static void WriteUInt32(FILE* out, boost::uint32_t value)
 {
-	LuaParser p(filename, SPRING_VFS_RAW, SPRING_VFS_BASE);
+	fwrite(&value, sizeof(value), 1, out);
+}
 
-	if (!p.Execute()) {
-		logOutput.Print("Warning: Failed to read archive cache: " + p.GetErrorLog());
+static void WriteUInt64(FILE* out, boost::uint64_t value)
+{
+	fwrite(&value, sizeof(value), 1, out);
+}
+
+static void WriteString(FILE* out, const std::string& str)
+{
+	WriteUInt32(out, str.size());
+	fwrite(str.data(), 1, str.size(), out);
+}
+
+static void WriteStrings(FILE* out, const std::vector<std::string>& strs)
+{
+	WriteUInt32(out, strs.size());
+	for (std::vector<std::string>::const_iterator s = strs.begin(); s != strs.end(); ++s) {
+		WriteString(out, *s);
+	}
+}
+
+/// Bounds checked reading from the cache file contents
+class CacheReader
+{
+public:
+	CacheReader(const std::vector<boost::uint8_t>& buf): buf(buf), pos(0), good(true) {}
+
+	bool IsGood() const { return good; }
+
+	boost::uint32_t ReadUInt32() {
+		boost::uint32_t value = 0;
+		Read(&value, sizeof(value));
+		return value;
+	}
+	boost::uint64_t ReadUInt64() {
+		boost::uint64_t value = 0;
+		Read(&value, sizeof(value));
+		return value;
+	}
+	std::string ReadString() {
+		const boost::uint32_t size = ReadUInt32();
+		if (!good || (size > (buf.size() - pos))) {
+			good = false;
+			return "";
+		}
+		const std::string str((const char*) &buf[pos], size);
+		pos += size;
+		return str;
+	}
+	void ReadStrings(std::vector<std::string>& strs) {
+		const boost::uint32_t count = ReadUInt32();
+		for (boost::uint32_t i = 0; (i < count) && good; ++i) {
+			strs.push_back(ReadString());
+		}
+	}
+
+private:
+	void Read(void* dst, size_t size) {
+		if (!good || (size > (buf.size() - pos))) {
+			good = false;
+			return;
+		}
+		memcpy(dst, &buf[pos], size);
+		pos += size;
+	}
+
+	const std::vector<boost::uint8_t>& buf;
+	size_t pos;
+	bool good;
+};
+
+void CArchiveScanner::ReadCacheData(const std::string& filename)
+{
+	FILE* in = fopen(filename.c_str(), "rb");
+	if (!in) {
+		logOutput.Print("Warning: Failed to read archive cache: " + filename);
 		return;
 	}
-	const LuaTable archiveCache = p.GetRoot();
-	const LuaTable archives = archiveCache.SubTable("archives");
+
+	std::vector<boost::uint8_t> buf;
+	fseek(in, 0, SEEK_END);
+	const long size = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	if (size > 0) {
+		buf.resize(size);
+		if (fread(&buf[0], size, 1, in) != 1) {
+			buf.clear();
+		}
+	}
+	fclose(in);
+
+	CacheReader reader(buf);
 
 	// Do not load old version caches
-	const int ver = archiveCache.GetInt("internalVer", (INTERNAL_VER + 1));
-	if (ver != INTERNAL_VER) {
+	if ((reader.ReadUInt32() != CACHE_MAGIC) || (reader.ReadUInt32() != (boost::uint32_t) INTERNAL_VER)) {
 		return;
 	}
 
-	for (int i = 1; archives.KeyExists(i); ++i) {
-		const LuaTable curArchive = archives.SubTable(i);
-		const LuaTable archived = curArchive.SubTable("archivedata");
-		ArchiveInfo ai;
+	std::map<std::string, ArchiveInfo> archives;
+	std::map<std::string, BrokenArchive> broken;
 
-		ai.origName = curArchive.GetString("name", "");
-		ai.path     = curArchive.GetString("path", "");
+	const boost::uint32_t numArchives = reader.ReadUInt32();
+	for (boost::uint32_t a = 0; (a < numArchives) && reader.IsGood(); ++a) {
+		ArchiveInfo ai;
 
-		// do not use LuaTable.GetInt() for 32-bit integers, the Spring lua
-		// library uses 32-bit floats to represent numbers, which can only
-		// represent 2^24 consecutive integers
-		ai.modified = strtoul(curArchive.GetString("modified", "0").c_str(), 0, 10);
-		ai.checksum = strtoul(curArchive.GetString("checksum", "0").c_str(), 0, 10);
+		ai.origName       = reader.ReadString();
+		ai.path           = reader.ReadString();
+		ai.stamp.modified = reader.ReadUInt32();
+		ai.stamp.size     = reader.ReadUInt64();
+		ai.stamp.inode    = reader.ReadUInt64();
+		ai.checksum       = reader.ReadUInt32();
 		ai.updated = false;
 
-		ai.archiveData = CArchiveScanner::ArchiveData(archived);
-		if (ai.archiveData.GetModType() == modtype::map) {
-			AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
-		} else if (ai.archiveData.GetModType() == modtype::primary) {
-			AddDependency(ai.archiveData.GetDependencies(), "Spring content v1");
+		const boost::uint32_t numItems = reader.ReadUInt32();
+		for (boost::uint32_t i = 0; (i < numItems) && reader.IsGood(); ++i) {
+			const std::string key = reader.ReadString();
+			const boost::uint32_t valueType = reader.ReadUInt32();
+			const boost::uint32_t value = (valueType != INFO_VALUE_TYPE_STRING)? reader.ReadUInt32(): 0;
+
+			switch (valueType) {
+				case INFO_VALUE_TYPE_STRING: {
+					ai.archiveData.SetInfoItemValueString(key, reader.ReadString());
+				} break;
+				case INFO_VALUE_TYPE_INTEGER: {
+					ai.archiveData.SetInfoItemValueInteger(key, (int) value);
+				} break;
+				case INFO_VALUE_TYPE_FLOAT: {
+					float f;
+					memcpy(&f, &value, sizeof(f));
+					ai.archiveData.SetInfoItemValueFloat(key, f);
+				} break;
+				case INFO_VALUE_TYPE_BOOL: {
+					ai.archiveData.SetInfoItemValueBool(key, (value != 0));
+				} break;
+			}
 		}
 
-		std::string lcname = StringToLower(ai.origName);
-		archiveInfo[lcname] = ai;
-	}
+		reader.ReadStrings(ai.archiveData.GetDependencies());
+		reader.ReadStrings(ai.archiveData.GetReplaces());
 
-	const LuaTable brokenArchives = archiveCache.SubTable("brokenArchives");
+		archives[StringToLower(ai.origName)] = ai;
+	}
 
-	for (int i = 1; brokenArchives.KeyExists(i); ++i) {
-		const LuaTable curArchive = brokenArchives.SubTable(i);
+	const boost::uint32_t numBroken = reader.ReadUInt32();
+	for (boost::uint32_t b = 0; (b < numBroken) && reader.IsGood(); ++b) {
 		BrokenArchive ba;
-		std::string name = curArchive.GetString("name", "");
+		const std::string name = reader.ReadString();
 
-		ba.path = curArchive.GetString("path", "");
-		ba.modified = strtoul(curArchive.GetString("modified", "0").c_str(), 0, 10);
+		ba.path           = reader.ReadString();
+		ba.problem        = reader.ReadString();
+		ba.stamp.modified = reader.ReadUInt32();
+		ba.stamp.size     = reader.ReadUInt64();
+		ba.stamp.inode    = reader.ReadUInt64();
 		ba.updated = false;
-		ba.problem = curArchive.GetString("problem", "unknown");
 
-		StringToLowerInPlace(name);
-		this->brokenArchives[name] = ba;
+		broken[StringToLower(name)] = ba;
 	}
 
-	isDirty = false;
-}
-
-static inline void SafeStr(FILE* out, const char* prefix, const std::string& str)
-{
-	if (str.empty()) {
+	if (!reader.IsGood()) {
+		logOutput.Print("Warning: Archive cache %s is corrupt, rescanning all archives", filename.c_str());
 		return;
 	}
-	if (str.find_first_of("\\\"") == std::string::npos) {
-		fprintf(out, "%s\"%s\",\n", prefix, str.c_str());
-	} else {
-		fprintf(out, "%s[[%s]],\n", prefix, str.c_str());
-	}
-}
 
-void FilterDep(std::vector<std::string>& deps, const std::string& exclude)
-{
-	bool clean = true;
-	do {
-		clean = true;
-		for (std::vector<std::string>::iterator it = deps.begin(); it != deps.end(); ++it) {
-			if (*it == exclude) {
-				deps.erase(it);
-				clean = false;
-				break;
-			}
-		}
-	} while (!clean);
-};
+	archiveInfo.swap(archives);
+	brokenArchives.swap(broken);
+
+	isDirty = false;
+}
 
 void CArchiveScanner::WriteCacheData(const std::string& filename)
 {
@@ -801,7 +1018,7 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 		return;
 	}
 
-	FILE* out = fopen(filename.c_str(), "wt");
+	FILE* out = fopen(filename.c_str(), "wb");
 	if (!out) {
 		return;
 	}
@@ -823,86 +1040,68 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 		}
 	}
 
-	fprintf(out, "local archiveCache = {\n\n");
-	fprintf(out, "\tinternalver = %i,\n\n", INTERNAL_VER);
-	fprintf(out, "\tarchives = {  -- count = "_STPF_"\n", archiveInfo.size());
+	WriteUInt32(out, CACHE_MAGIC);
+	WriteUInt32(out, INTERNAL_VER);
+	WriteUInt32(out, archiveInfo.size());
 
 	std::map<std::string, ArchiveInfo>::const_iterator arcIt;
 	for (arcIt = archiveInfo.begin(); arcIt != archiveInfo.end(); ++arcIt) {
 		const ArchiveInfo& arcInfo = arcIt->second;
 
-		fprintf(out, "\t\t{\n");
-		SafeStr(out, "\t\t\tname = ",              arcInfo.origName);
-		SafeStr(out, "\t\t\tpath = ",              arcInfo.path);
-		fprintf(out, "\t\t\tmodified = \"%u\",\n", arcInfo.modified);
-		fprintf(out, "\t\t\tchecksum = \"%u\",\n", arcInfo.checksum);
-		SafeStr(out, "\t\t\treplaced = ",          arcInfo.replaced);
-
-		// mod info?
-		const ArchiveData& archData = arcInfo.archiveData;
-		if (!archData.GetName().empty()) {
-			fprintf(out, "\t\t\tarchivedata = {\n");
-
-			const std::map<std::string, InfoItem>& info = archData.GetInfo();
-			std::map<std::string, InfoItem>::const_iterator ii;
-			for (ii = info.begin(); ii != info.end(); ++ii) {
-				switch (ii->second.valueType) {
-					case INFO_VALUE_TYPE_STRING: {
-						SafeStr(out, std::string("\t\t\t\t" + ii->first + " = ").c_str(), ii->second.valueTypeString);
-					} break;
-					case INFO_VALUE_TYPE_INTEGER: {
-						fprintf(out, "\t\t\t\t%s = %d,\n", ii->first.c_str(), ii->second.value.typeInteger);
-					} break;
-					case INFO_VALUE_TYPE_FLOAT: {
-						fprintf(out, "\t\t\t\t%s = %f,\n", ii->first.c_str(), ii->second.value.typeFloat);
-					} break;
-					case INFO_VALUE_TYPE_BOOL: {
-						fprintf(out, "\t\t\t\t%s = %d,\n", ii->first.c_str(), (int)ii->second.value.typeBool);
-					} break;
-				}
-			}
+		WriteString(out, arcInfo.origName);
+		WriteString(out, arcInfo.path);
+		WriteUInt32(out, arcInfo.stamp.modified);
+		WriteUInt64(out, arcInfo.stamp.size);
+		WriteUInt64(out, arcInfo.stamp.inode);
+		WriteUInt32(out, arcInfo.checksum);
 
-			std::vector<std::string> deps = archData.GetDependencies();
-			if (archData.GetModType() == modtype::map) {
-				FilterDep(deps, "Map Helper v1");
-			} else if (archData.GetModType() == modtype::primary) {
-				FilterDep(deps, "Spring content v1");
-			}
-			
-			if (!deps.empty()) {
-				fprintf(out, "\t\t\t\tdepend = {\n");
-				for (unsigned d = 0; d < deps.size(); d++) {
-					SafeStr(out, "\t\t\t\t\t", deps[d]);
-				}
-				fprintf(out, "\t\t\t\t},\n");
+		const std::map<std::string, InfoItem>& info = arcInfo.archiveData.GetInfo();
+		WriteUInt32(out, info.size());
+
+		std::map<std::string, InfoItem>::const_iterator ii;
+		for (ii = info.begin(); ii != info.end(); ++ii) {
+			WriteString(out, ii->second.key);
+			WriteUInt32(out, ii->second.valueType);
+
+			switch (ii->second.valueType) {
+				case INFO_VALUE_TYPE_STRING: {
+					WriteString(out, ii->second.valueTypeString);
+				} break;
+				case INFO_VALUE_TYPE_INTEGER: {
+					WriteUInt32(out, ii->second.value.typeInteger);
+				} break;
+				case INFO_VALUE_TYPE_FLOAT: {
+					boost::uint32_t value;
+					memcpy(&value, &ii->second.value.typeFloat, sizeof(value));
+					WriteUInt32(out, value);
+				} break;
+				case INFO_VALUE_TYPE_BOOL: {
+					WriteUInt32(out, ii->second.value.typeBool);
+				} break;
 			}
-			fprintf(out, "\t\t\t},\n");
 		}
 
-		fprintf(out, "\t\t},\n");
+		WriteStrings(out, arcInfo.archiveData.GetDependencies());
+		WriteStrings(out, arcInfo.archiveData.GetReplaces());
 	}
 
-	fprintf(out, "\t},\n\n"); // close 'archives'
-
-	fprintf(out, "\tbrokenArchives = {  -- count = "_STPF_"\n", brokenArchives.size());
+	WriteUInt32(out, brokenArchives.size());
 
 	std::map<std::string, BrokenArchive>::const_iterator bai;
 	for (bai = brokenArchives.begin(); bai != brokenArchives.end(); ++bai) {
 		const BrokenArchive& ba = bai->second;
 
-		fprintf(out, "\t\t{\n");
-		SafeStr(out, "\t\t\tname = ", bai->first);
-		SafeStr(out, "\t\t\tpath = ", ba.path);
-		fprintf(out, "\t\t\tmodified = \"%u\",\n", ba.modified);
-		SafeStr(out, "\t\t\tproblem = ", ba.problem);
-		fprintf(out, "\t\t},\n");
+		WriteString(out, bai->first);
+		WriteString(out, ba.path);
+		WriteString(out, ba.problem);
+		WriteUInt32(out, ba.stamp.modified);
+		WriteUInt64(out, ba.stamp.size);
+		WriteUInt64(out, ba.stamp.inode);
 	}
 
-	fprintf(out, "\t},\n"); // close 'brokenArchives'
-
-	fprintf(out, "}\n\n"); // close 'archiveCache'
-	fprintf(out, "return archiveCache\n");
-
+	if (ferror(out)) {
+		logOutput.Print("Warning: Failed to write archive cache: " + filename);
+	}
 	fclose(out);
 
 	isDirty = false;
@@ -923,7 +1122,7 @@ std::vector<CArchiveScanner::ArchiveData> CArchiveScanner::GetPrimaryMods() cons
 	std::vector<ArchiveData> ret;
 
 	for (std::map<std::string, ArchiveInfo>::const_iterator i = archiveInfo.begin(); i != archiveInfo.end(); ++i) {
-		if (!(i->second.archiveData.GetName().empty()) && (i->second.archiveData.GetModType() == modtype::primary)) {
+		if (!(i->second.archiveData.GetName().empty()) && (i->second.archiveData.GetModType() == modtype::primary) && !IsReplaced(i->first)) {
 			// Add the archive the mod is in as the first dependency
 			ArchiveData md = i->second.archiveData;
 			md.GetDependencies().insert(md.GetDependencies().begin(), i->second.origName);
@@ -942,7 +1141,7 @@ std::vector<CArchiveScanner::ArchiveData> CArchiveScanner::GetAllMods() const
 	std::vector<ArchiveData> ret;
 
 	for (std::map<std::string, ArchiveInfo>::const_iterator i = archiveInfo.begin(); i != archiveInfo.end(); ++i) {
-		if (!(i->second.archiveData.GetName().empty()) && ((i->second.archiveData.GetModType() == modtype::primary) || (i->second.archiveData.GetModType() == modtype::hidden))) {
+		if (!(i->second.archiveData.GetName().empty()) && ((i->second.archiveData.GetModType() == modtype::primary) || (i->second.archiveData.GetModType() == modtype::hidden)) && !IsReplaced(i->first)) {
 			// Add the archive the mod is in as the first dependency
 			ArchiveData md = i->second.archiveData;
 			md.GetDependencies().insert(md.GetDependencies().begin(), i->second.origName);
@@ -967,6 +1166,16 @@ std::vector<std::string> CArchiveScanner::GetArchives(const std::string& root, i
 
 	std::vector<std::string> ret;
 	std::string lcname = StringToLower(ArchiveFromName(root));
+
+	//! Check if this archive has been replaced
+	std::map<std::string, std::string>::const_iterator ri;
+	for (size_t n = 0; (ri = replacedArchives.find(lcname)) != replacedArchives.end(); ++n) {
+		if (n >= replacedArchives.size()) {
+			throw content_error("Circular archive replacements");
+		}
+		lcname = ri->second;
+	}
+
 	std::map<std::string, ArchiveInfo>::const_iterator aii = archiveInfo.find(lcname);
 	if (aii == archiveInfo.end()) {
 		//! unresolved dep
@@ -977,14 +1186,6 @@ std::vector<std::string> CArchiveScanner::GetArchives(const std::string& root, i
 		return ret;
 	}
 
-	//! Check if this archive has been replaced
-	while (aii->second.replaced.length() > 0) {
-		aii = archiveInfo.find(aii->second.replaced);
-		if (aii == archiveInfo.end()) {
-			throw content_error("Unknown error parsing archive replacements");
-		}
-	}
-
 	ret.push_back(aii->second.path + aii->second.origName);
 
 	//! add depth-first
@@ -994,7 +1195,7 @@ std::vector<std::string> CArchiveScanner::GetArchives(const std::string& root, i
 		for (std::vector<std::string>::const_iterator j = dep.begin(); j != dep.end(); ++j) {
 			if (std::find(ret.begin(), ret.end(), *j) == ret.end()) {
 				//! add only if this dependency is not already somewhere
-				//! in the chain (which can happen if ArchiveCache.lua has
+				//! in the chain (which can happen if ArchiveCache.bin has
 				//! not been written yet) so its checksum is not XOR'ed
 				//! with the running one multiple times (Get*Checksum())
 				ret.push_back(*j);
@@ -1011,7 +1212,7 @@ std::vector<std::string> CArchiveScanner::GetMaps() const
 	std::vector<std::string> ret;
 
 	for (std::map<std::string, ArchiveInfo>::const_iterator aii = archiveInfo.begin(); aii != archiveInfo.end(); ++aii) {
-		if (!(aii->second.archiveData.GetName().empty()) && aii->second.archiveData.GetModType() == modtype::map) {
+		if (!(aii->second.archiveData.GetName().empty()) && aii->second.archiveData.GetModType() == modtype::map && !IsReplaced(aii->first)) {
 			ret.push_back(aii->second.archiveData.GetName());
 		}
 	}
@@ -1023,7 +1224,7 @@ std::string CArchiveScanner::MapNameToMapFile(const std::string& s) const
 {
 	// Convert map name to map archive
 	for (std::map<std::string, ArchiveInfo>::const_iterator aii = archiveInfo.begin(); aii != archiveInfo.end(); ++aii) {
-		if (s == aii->second.archiveData.GetName()) {
+		if (s == aii->second.archiveData.GetName() && !IsReplaced(aii->first)) {
 			return aii->second.archiveData.GetMapFile();
 		}
 	}
@@ -1088,10 +1289,15 @@ std::string CArchiveScanner::GetArchivePath(const std::string& name) const
 	return aii->second.path;
 }
 
+bool CArchiveScanner::IsReplaced(const std::string& lcname) const
+{
+	return (replacedArchives.find(lcname) != replacedArchives.end());
+}
+
 std::string CArchiveScanner::ArchiveFromName(const std::string& name) const
 {
 	for (std::map<std::string, ArchiveInfo>::const_iterator it = archiveInfo.begin(); it != archiveInfo.end(); ++it) {
-		if (it->second.archiveData.GetName() == name) {
+		if (it->second.archiveData.GetName() == name && !IsReplaced(it->first)) {
 			return it->second.origName;
 		}
 	}
@@ -1114,7 +1320,7 @@ CArchiveScanner::ArchiveData CArchiveScanner::GetArchiveData(const std::string&
 {
 	for (std::map<std::string, ArchiveInfo>::const_iterator it = archiveInfo.begin(); it != archiveInfo.end(); ++it) {
 		const ArchiveData& md = it->second.archiveData;
-		if (md.GetName() == name) {
+		if (md.GetName() == name && !IsReplaced(it->first)) {
 			return md;
 		}
 	}
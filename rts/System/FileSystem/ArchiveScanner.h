@@ -6,11 +6,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <boost/cstdint.hpp>
 #include "System/Info.h"
 
 class CArchiveBase;
 class IFileFilter;
 class LuaTable;
+namespace boost {
+	class mutex;
+};
 
 /*
  * This class searches through a given directory and its sub-directories looking
@@ -22,6 +26,10 @@ class LuaTable;
  *
  * The archive namespace is global, so it is not allowed to have an archive with
  * the same name in more than one folder.
+ *
+ * Archives that are new or changed (by modification time, size or inode) are
+ * opened and checksummed by a pool of worker threads; only the parsing of the
+ * mapinfo.lua/modinfo.lua files is done on the calling thread.
  */
 
 namespace modtype
@@ -139,42 +147,93 @@ public:
 	static unsigned char GetMetaFileClass(const std::string& filePath);
 
 private:
+	/// what the cache entry of an archive is keyed on, besides its name and path
+	struct FileStamp
+	{
+		FileStamp(): modified(0), size(0), inode(0) {}
+		bool operator == (const FileStamp& s) const {
+			return (modified == s.modified) && (size == s.size) && (inode == s.inode);
+		}
+
+		unsigned int modified;
+		boost::uint64_t size;
+		boost::uint64_t inode;    ///< always 0 on windows
+	};
 	struct ArchiveInfo
 	{
 		std::string path;
 		std::string origName;     ///< Could be useful to have the non-lowercased name around
-		unsigned int modified;
+		FileStamp stamp;
 		ArchiveData archiveData;
 		unsigned int checksum;
 		bool updated;
-		std::string replaced;     ///< If not empty, use that archive instead
 	};
 	struct BrokenArchive
 	{
 		std::string path;
-		unsigned int modified;
+		FileStamp stamp;
 		bool updated;
 		std::string problem;
 	};
 
-	void ScanDirs(const std::vector<std::string>& dirs, bool checksum = false);
-	void Scan(const std::string& curPath, bool doChecksum);
+	/// an archive that needs to be opened, filled in by a worker thread
+	struct ScanJob
+	{
+		std::string fullName;
+		std::string fpath;
+		std::string lcfn;
+		FileStamp stamp;
+		bool doChecksum;
+		bool checksumOnly;        ///< cached archive that only lacks its checksum
+
+		// results
+		bool opened;
+		bool isMap;
+		std::string mapfile;
+		std::string infoFile;     ///< "mapinfo.lua" or "modinfo.lua", if any
+		std::vector<boost::uint8_t> infoBuf;
+		std::string error;
+		std::vector<std::string> warnings;
+		unsigned int checksum;
+	};
 
-	void ScanArchive(const std::string& fullName, bool checksum = false);
+	void ScanDirs(const std::vector<std::string>& dirs, bool checksum = false);
+	/// returns the number of archives found
+	unsigned int Scan(const std::string& curPath, bool doChecksum, std::vector<ScanJob>& jobs);
+
+	/// decides from the cache whether the archive has to be (re)opened
+	void ScanArchive(const std::string& fullName, bool checksum, std::vector<ScanJob>& jobs);
+	/// run the jobs on up to one thread per core, returns the number of threads used
+	unsigned int RunScanJobs(std::vector<ScanJob>& jobs);
+	static void ScanJobsThread(std::vector<ScanJob>& jobs, size_t& nextJob, boost::mutex& jobMutex);
+	/// thread-safe part of a job: open the archive, check meta-files, checksum
+	static void ProcessScanJob(ScanJob& job);
+	/// store the results of a job, parses its info file
+	void FinishScanJob(ScanJob& job);
 	/// scan mapinfo / modinfo lua files
-	bool ScanArchiveLua(CArchiveBase* ar, const std::string& fileName, ArchiveInfo& ai, std::string& err);
+	bool ScanArchiveLua(const std::vector<boost::uint8_t>& buf, const std::string& fileName, ArchiveInfo& ai, std::string& err);
 
 	void ReadCacheData(const std::string& filename);
 	void WriteCacheData(const std::string& filename);
 
+	/// true if another archive lists this one (lower case name) in its replace table
+	bool IsReplaced(const std::string& lcname) const;
+
 	std::map<std::string, ArchiveInfo> archiveInfo;
 	std::map<std::string, BrokenArchive> brokenArchives;
-	IFileFilter* CreateIgnoreFilter(CArchiveBase* ar);
+	/**
+	 * Lower case name of a replaced archive -> lower case name of the
+	 * archive replacing it. Not cached, every ScanDirs rebuilds it from
+	 * the replace tables, so the replaced archives keep their own
+	 * (cached) info and become visible again once the replacement is gone.
+	 */
+	std::map<std::string, std::string> replacedArchives;
+	static IFileFilter* CreateIgnoreFilter(CArchiveBase* ar);
 	/**
 	 * Get CRC of the data in the specified archive.
-	 * Returns 0 if file could not be opened.
+	 * Never returns 0, which is used to indicate "no checksum".
 	 */
-	unsigned int GetCRC(const std::string& filename);
+	static unsigned int GetCRC(CArchiveBase* ar);
 	bool isDirty;
 	std::string cachefile;
 };
@@ -12,21 +12,42 @@
 #include "LogOutput.h"
 
 
-CArchiveZip::CArchiveZip(const std::string& name) : CArchiveBuffered(name)
+const unsigned CArchiveZip::MAX_HANDLES = 4;
+
+
+static unzFile OpenZip(const std::string& name)
 {
 #ifdef USEWIN32IOAPI
 	zlib_filefunc_def ffunc;
 	fill_win32_filefunc(&ffunc);
-	zip = unzOpen2(name.c_str(),&ffunc);
+	return unzOpen2(name.c_str(),&ffunc);
 #else
-	zip = unzOpen(name.c_str());
+	return unzOpen(name.c_str());
 #endif
+}
+
+static unsigned int ReadLE16(const boost::uint8_t* p)
+{
+	return (p[0] | (p[1] << 8));
+}
+
+static unsigned int ReadLE32(const boost::uint8_t* p)
+{
+	return (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+}
+
+
+CArchiveZip::CArchiveZip(const std::string& name) : CArchiveBuffered(name), numHandles(0)
+{
+	zip = OpenZip(name);
 	if (!zip)
 	{
 		LogObject() << "Error opening " << name;
 		return;
 	}
 
+	bool hasStoredFiles = false;
+
 	// We need to map file positions to speed up opening later
 	for (int ret = unzGoToFirstFile(zip); ret == UNZ_OK; ret = unzGoToNextFile(zip))
 	{
@@ -50,15 +71,27 @@ CArchiveZip::CArchiveZip(const std::string& name) : CArchiveBuffered(name)
 		fd.size = info.uncompressed_size;
 		fd.origName = fname;
 		fd.crc = info.crc;
+		fd.stored = (info.compression_method == 0) && ((info.flag & 1) == 0) && (info.compressed_size == info.uncompressed_size);
+		fd.centralDirPos = unzGetOffset(zip);
 		fileData.push_back(fd);
 		lcNameIndex[name] = fileData.size()-1;
+
+		hasStoredFiles = hasStoredFiles || (fd.stored && (fd.size > 0));
+	}
+
+	freeHandles.push_back(zip);
+	numHandles = 1;
+
+	if (hasStoredFiles) {
+		mappedFile.reset(new CMappedFile(name));
 	}
 }
 
 CArchiveZip::~CArchiveZip(void)
 {
-	if (zip)
-		unzClose(zip);
+	// all borrowed handles are back by now
+	for (std::vector<unzFile>::iterator h = freeHandles.begin(); h != freeHandles.end(); ++h)
+		unzClose(*h);
 }
 
 bool CArchiveZip::IsOpen()
@@ -86,6 +119,75 @@ unsigned CArchiveZip::GetCrc32(unsigned fid)
 	return fileData[fid].crc;
 }
 
+FileViewPtr CArchiveZip::GetFileView(unsigned fid)
+{
+	assert(fid >= 0 && fid < NumFiles());
+
+	const size_t offset = GetStoredDataOffset(fid);
+	if (offset == 0)
+		return CArchiveBuffered::GetFileView(fid);
+
+	return FileViewPtr(new CMappedFileView(mappedFile, offset, fileData[fid].size));
+}
+
+size_t CArchiveZip::GetStoredDataOffset(unsigned fid) const
+{
+	const FileData& fd = fileData[fid];
+
+	if (!fd.stored || (fd.size <= 0) || !mappedFile || !mappedFile->IsOpen())
+		return 0;
+	// rewritten since it was mapped, do not touch the mapping anymore
+	if (!mappedFile->IsUnchanged())
+		return 0;
+
+	// the central directory entry (46 bytes) points to the local header (30 bytes),
+	// which is followed by the file name, the extra field and then the data
+	const boost::uint8_t* data = mappedFile->GetData();
+	const size_t size = mappedFile->GetSize();
+
+	if ((fd.centralDirPos + 46 > size) || (ReadLE32(data + fd.centralDirPos) != 0x02014b50))
+		return 0; // eg. self extracting archives, where positions are relative
+
+	const size_t localHeaderPos = ReadLE32(data + fd.centralDirPos + 42);
+	if ((localHeaderPos + 30 > size) || (ReadLE32(data + localHeaderPos) != 0x04034b50))
+		return 0;
+
+	const size_t offset = localHeaderPos + 30 + ReadLE16(data + localHeaderPos + 26) + ReadLE16(data + localHeaderPos + 28);
+	if (offset + fd.size > size)
+		return 0;
+
+	return offset;
+}
+
+unzFile CArchiveZip::AcquireHandle()
+{
+	boost::mutex::scoped_lock lck(handleLock);
+
+	while (freeHandles.empty()) {
+		if (numHandles < MAX_HANDLES) {
+			unzFile handle = OpenZip(GetArchiveName());
+			if (handle) {
+				++numHandles;
+				return handle;
+			}
+		}
+		handleReleased.wait(lck);
+	}
+
+	unzFile handle = freeHandles.back();
+	freeHandles.pop_back();
+	return handle;
+}
+
+void CArchiveZip::ReleaseHandle(unzFile handle)
+{
+	{
+		boost::mutex::scoped_lock lck(handleLock);
+		freeHandles.push_back(handle);
+	}
+	handleReleased.notify_one();
+}
+
 // To simplify things, files are always read completely into memory from the zipfile, since zlib does not
 // provide any way of reading more than one file at a time
 bool CArchiveZip::GetFileImpl(unsigned fid, std::vector<boost::uint8_t>& buffer)
@@ -95,19 +197,32 @@ bool CArchiveZip::GetFileImpl(unsigned fid, std::vector<boost::uint8_t>& buffer)
 		return false;
 	assert(fid >= 0 && fid < NumFiles());
 
-	unzGoToFilePos(zip, &fileData[fid].fp);
+	unzFile handle = AcquireHandle();
+	bool ret = false;
 
-	unz_file_info fi;
-	unzGetCurrentFileInfo(zip, &fi, NULL, 0, NULL, 0, NULL, 0);
+	try {
+		unzGoToFilePos(handle, &fileData[fid].fp);
 
-	if (unzOpenCurrentFile(zip) != UNZ_OK)
-		return false;
+		unz_file_info fi;
+		unzGetCurrentFileInfo(handle, &fi, NULL, 0, NULL, 0, NULL, 0);
 
-	buffer.resize(fi.uncompressed_size);
-	if (unzReadCurrentFile(zip, &buffer[0], buffer.size()) < 0 || unzCloseCurrentFile(zip) == UNZ_CRCERROR)
-	{
-		buffer.clear();
-		return false;
+		if (unzOpenCurrentFile(handle) == UNZ_OK) {
+			buffer.resize(fi.uncompressed_size);
+
+			// unzReadCurrentFile can not handle a NULL buffer
+			const int bytesRead = buffer.empty()? 0: unzReadCurrentFile(handle, &buffer[0], buffer.size());
+			ret = (bytesRead >= 0);
+
+			if (unzCloseCurrentFile(handle) == UNZ_CRCERROR)
+				ret = false;
+			if (!ret)
+				buffer.clear();
+		}
+	} catch (...) {
+		ReleaseHandle(handle);
+		throw;
 	}
-	return true;
+
+	ReleaseHandle(handle);
+	return ret;
 }
@@ -3,6 +3,10 @@
 #ifndef __ARCHIVE_ZIP
 #define __ARCHIVE_ZIP
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include "ArchiveBuffered.h"
 #include "lib/minizip/unzip.h"
 
@@ -24,8 +28,11 @@ public:
 	virtual unsigned NumFiles() const;
 	virtual void FileInfo(unsigned fid, std::string& name, int& size) const;
 	virtual unsigned GetCrc32(unsigned fid);
+	/// stored (uncompressed) files are served from a mapping of the zip file
+	virtual FileViewPtr GetFileView(unsigned fid);
 
 protected:
+	/// the handle the archive was opened with, also part of the handle pool
 	unzFile zip;
 
 	struct FileData {
@@ -33,10 +40,36 @@ protected:
 		int size;
 		std::string origName;
 		unsigned crc;
+		/// stored without compression (and not encrypted)
+		bool stored;
+		/// position of the file in the central directory
+		unsigned long centralDirPos;
 	};
 	std::vector<FileData> fileData;
 	
 	virtual bool GetFileImpl(unsigned fid, std::vector<boost::uint8_t>& buffer);
+
+private:
+	/// offset of the data of a stored file in the mapping, 0 if unknown
+	size_t GetStoredDataOffset(unsigned fid) const;
+
+	/// borrow an unzFile handle for reading, blocks if MAX_HANDLES are in use
+	unzFile AcquireHandle();
+	void ReleaseHandle(unzFile handle);
+
+	/**
+	 * A minizip handle can only read one file at a time, so up to this many
+	 * are opened on the same zip file to let several threads inflate at once.
+	 */
+	static const unsigned MAX_HANDLES;
+
+	boost::mutex handleLock;
+	boost::condition_variable handleReleased;
+	std::vector<unzFile> freeHandles;
+	unsigned numHandles;
+
+	/// only mapped if there are stored files
+	boost::shared_ptr<const CMappedFile> mappedFile;
 };
 
 #endif
@@ -7,16 +7,59 @@ extern "C" {
 };
 
 
-static bool crcTableInitialized;
+/*
+ * CRC-32 (zip polynomial) using the slicing-by-8 algorithm, which consumes
+ * eight bytes per step through eight 256-entry tables. This gives the same
+ * digests as the byte-wise 7z CrcUpdate() at several times its throughput.
+ *
+ * Hardware crc32 instructions (SSE4.2) compute CRC-32C, a different
+ * polynomial, so they can not be used without changing every archive
+ * checksum.
+ */
+static unsigned int crcTables[8][256];
+static bool crcTablesInitialized = false;
+
+static void InitCrcTables()
+{
+	for (unsigned int i = 0; i < 256; i++) {
+		unsigned int r = i;
+		for (int j = 0; j < 8; j++) {
+			r = (r >> 1) ^ (0xEDB88320 & ~((r & 1) - 1));
+		}
+		crcTables[0][i] = r;
+	}
+	for (unsigned int i = 0; i < 256; i++) {
+		for (int t = 1; t < 8; t++) {
+			const unsigned int prev = crcTables[t - 1][i];
+			crcTables[t][i] = (prev >> 8) ^ crcTables[0][prev & 0xFF];
+		}
+	}
+
+	// the 7z library uses its own table
+	CrcGenerateTable();
+
+	crcTablesInitialized = true;
+}
+
+/**
+ * Build the tables during static initialization, before any
+ * thread (e.g. of the archive scanner) can construct a CRC.
+ */
+static struct CrcTablesInit {
+	CrcTablesInit() {
+		if (!crcTablesInitialized) {
+			InitCrcTables();
+		}
+	}
+} crcTablesInit;
 
 
 /** @brief Construct a new CRC object. */
 CRC::CRC()
 {
 	crc = CRC_INIT_VAL;
-	if (!crcTableInitialized) {
-		crcTableInitialized = true;
-		CrcGenerateTable();
+	if (!crcTablesInitialized) {
+		InitCrcTables();
 	}
 }
 
@@ -33,7 +76,28 @@ unsigned int CRC::GetDigest() const
 /** @brief Update CRC over the data. */
 CRC& CRC::Update(const void* data, unsigned int size)
 {
-	crc = CrcUpdate(crc, data, size);
+	const unsigned char* p = (const unsigned char*) data;
+	unsigned int c = crc;
+
+	// assemble the words byte by byte, this is endian independent
+	for (; size >= 8; size -= 8, p += 8) {
+		const unsigned int lo = c ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+		const unsigned int hi =      p[4] | (p[5] << 8) | (p[6] << 16) | ((unsigned int) p[7] << 24);
+
+		c = crcTables[7][ lo        & 0xFF] ^
+		    crcTables[6][(lo >>  8) & 0xFF] ^
+		    crcTables[5][(lo >> 16) & 0xFF] ^
+		    crcTables[4][ lo >> 24        ] ^
+		    crcTables[3][ hi        & 0xFF] ^
+		    crcTables[2][(hi >>  8) & 0xFF] ^
+		    crcTables[1][(hi >> 16) & 0xFF] ^
+		    crcTables[0][ hi >> 24        ];
+	}
+	for (; size > 0; --size, ++p) {
+		c = crcTables[0][(c ^ *p) & 0xFF] ^ (c >> 8);
+	}
+
+	crc = c;
 	return *this;
 }
 
@@ -41,6 +105,5 @@ CRC& CRC::Update(const void* data, unsigned int size)
 /** @brief Update CRC over the 4 bytes of data. */
 CRC& CRC::Update(unsigned int data)
 {
-	crc = CrcUpdate(crc, &data, sizeof(unsigned));
-	return *this;
+	return Update(&data, sizeof(unsigned));
 }
@@ -29,8 +29,7 @@ using std::string;
 CFileHandler::CFileHandler(const char* fileName, const char* modes)
 	: ifs(NULL), filePos(0), fileSize(-1)
 {
-	GML_RECMUTEX_LOCK(file); // CFileHandler
-
+	// no lock, archives can be read from by multiple threads at once
 	TryReadContent(fileName, modes);
 }
 
@@ -38,8 +37,7 @@ CFileHandler::CFileHandler(const char* fileName, const char* modes)
 CFileHandler::CFileHandler(const string& fileName, const string& modes)
 	: ifs(NULL), filePos(0), fileSize(-1)
 {
-	GML_RECMUTEX_LOCK(file); // CFileHandler
-
+	// no lock, archives can be read from by multiple threads at once
 	TryReadContent(fileName, modes);
 }
 
@@ -77,12 +75,9 @@ bool CFileHandler::TryReadFromModFS(const string& fileName)
 	}
 
 	const string file = StringToLower(fileName);
-	if (vfsHandler->LoadFile(file, fileBuffer)) {
-		//! did we allocated more mem than needed
-		//! (e.g. because of incorrect usage of std::vector)?
-		assert(fileBuffer.size() == fileBuffer.capacity()); 
-
-		fileSize = fileBuffer.size();
+	fileView = vfsHandler->LoadFileView(file);
+	if (fileView) {
+		fileSize = fileView->GetSize();
 		return true;
 	}
 	else
@@ -132,13 +127,13 @@ int CFileHandler::Read(void* buf, int length)
 		ifs->read((char*)buf, length);
 		return ifs->gcount ();
 	}
-	else if (!fileBuffer.empty()) {
+	else if (fileView) {
 		if ((length + filePos) > fileSize) {
 			length = fileSize - filePos;
 		}
 		if (length > 0) {
-			assert(fileBuffer.size() >= (filePos + length));
-			memcpy(buf, &fileBuffer[filePos], length);
+			assert(fileView->GetSize() >= (filePos + length));
+			memcpy(buf, fileView->GetData() + filePos, length);
 			filePos += length;
 		}
 		return length;
@@ -159,7 +154,7 @@ void CFileHandler::Seek(int length, std::ios_base::seekdir where)
 		ifs->clear();
 		ifs->seekg(length, where);
 	}
-	else if (!fileBuffer.empty())
+	else if (fileView)
 	{
 		if (where == std::ios_base::beg)
 		{
@@ -184,9 +179,9 @@ int CFileHandler::Peek() const
 	if (ifs) {
 		return ifs->peek();
 	}
-	else if (!fileBuffer.empty()) {
+	else if (fileView) {
 		if (filePos < fileSize) {
-			return fileBuffer.at(filePos);
+			return fileView->GetData()[filePos];
 		} else {
 			return EOF;
 		}
@@ -202,7 +197,7 @@ bool CFileHandler::Eof() const
 	if (ifs) {
 		return ifs->eof();
 	}
-	if (!fileBuffer.empty()) {
+	if (fileView) {
 		return (filePos >= fileSize);
 	}
 	return true;
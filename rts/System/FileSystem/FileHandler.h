@@ -10,6 +10,7 @@
 #include <boost/cstdint.hpp>
 
 #include "VFSModes.h"
+#include "FileView.h"
 
 /**
  * This is for direct VFS file content access.
@@ -69,7 +70,8 @@ private:
 
 	std::string fileName;
 	std::ifstream* ifs;
-	std::vector<boost::uint8_t> fileBuffer;
+	/// contents of a file from the VFS, shared with the archive
+	FileViewPtr fileView;
 	int filePos;
 	int fileSize;
 };
@@ -0,0 +1,120 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StdAfx.h"
+
+#include "FileView.h"
+
+#include <assert.h>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "mmgr.h"
+
+
+CBufferFileView::CBufferFileView(std::vector<boost::uint8_t>& buf)
+{
+	buffer.swap(buf);
+	data = buffer.empty()? NULL: &buffer[0];
+	size = buffer.size();
+}
+
+
+CMappedFile::CMappedFile(const std::string& fileName)
+	: data(NULL)
+	, size(0)
+#ifndef _WIN32
+	, fileName(fileName)
+	, modified(0)
+#endif
+{
+#ifdef _WIN32
+	mapping = NULL;
+
+	HANDLE file = CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0) && ((ULONGLONG) fileSize.QuadPart <= (size_t) -1)) {
+		mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL) {
+			data = (boost::uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (data != NULL) {
+				size = fileSize.QuadPart;
+			} else {
+				CloseHandle(mapping);
+				mapping = NULL;
+			}
+		}
+	}
+
+	// the mapping keeps its own reference to the file
+	CloseHandle(file);
+#else
+	const int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat info;
+	if ((fstat(fd, &info) == 0) && (info.st_size > 0) && ((boost::uint64_t) info.st_size <= (size_t) -1)) {
+		// private: later writes to the file do not show up in the mapping
+		// (truncating it does though, see IsUnchanged)
+		void* p = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			data = (boost::uint8_t*) p;
+			size = info.st_size;
+			modified = info.st_mtime;
+		}
+	}
+
+	// the mapping stays valid after closing the descriptor
+	close(fd);
+#endif
+}
+
+bool CMappedFile::IsUnchanged() const
+{
+#ifdef _WIN32
+	// a file with a mapped view can not be truncated or replaced
+	return true;
+#else
+	struct stat info;
+	if (stat(fileName.c_str(), &info) != 0) {
+		return false;
+	}
+
+	return (((size_t) info.st_size == size) && (info.st_mtime == modified));
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+	if (data == NULL) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+#else
+	munmap(data, size);
+#endif
+}
+
+
+CMappedFileView::CMappedFileView(const boost::shared_ptr<const CMappedFile>& mappedFile, size_t offset, size_t length)
+	: file(mappedFile)
+{
+	assert(file->IsOpen() && (offset + length <= file->GetSize()));
+
+	data = file->GetData() + offset;
+	size = length;
+}
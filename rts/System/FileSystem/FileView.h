@@ -0,0 +1,92 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _FILE_VIEW_H
+#define _FILE_VIEW_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * @brief Read-only view of the contents of a file.
+ *
+ * The data stays valid for as long as the view exists, even after the
+ * archive it came from was closed. Views are never modified, so they can
+ * be shared between threads without locking.
+ */
+class CFileView
+{
+public:
+	virtual ~CFileView() {}
+
+	const boost::uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+protected:
+	CFileView() : data(NULL), size(0) {}
+
+	const boost::uint8_t* data;
+	size_t size;
+};
+
+typedef boost::shared_ptr<const CFileView> FileViewPtr;
+
+
+/// View of a file that was read (or uncompressed) into memory
+class CBufferFileView : public CFileView
+{
+public:
+	/// takes over the contents of <buffer>, leaving it empty
+	CBufferFileView(std::vector<boost::uint8_t>& buffer);
+
+private:
+	std::vector<boost::uint8_t> buffer;
+};
+
+
+/**
+ * Read-only memory mapping of a whole file on disk.
+ *
+ * Touching a mapped page after the file was truncated in place raises
+ * SIGBUS, so only map files that are replaced as a whole (by writing a new
+ * file and renaming it over the old one) rather than rewritten, and check
+ * IsUnchanged() before handing out new views.
+ */
+class CMappedFile
+{
+public:
+	CMappedFile(const std::string& fileName);
+	~CMappedFile();
+
+	/// false if the file could not be mapped, e.g. because it is empty
+	bool IsOpen() const { return (data != NULL); }
+	/// false if the file on disk no longer has the size and mtime it was mapped with
+	bool IsUnchanged() const;
+
+	const boost::uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	boost::uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	void* mapping;
+#else
+	std::string fileName;
+	boost::int64_t modified;
+#endif
+};
+
+
+/// View of (a part of) a mapped file, keeps the mapping alive
+class CMappedFileView : public CFileView
+{
+public:
+	CMappedFileView(const boost::shared_ptr<const CMappedFile>& mappedFile, size_t offset, size_t length);
+
+private:
+	boost::shared_ptr<const CMappedFile> file;
+};
+
+#endif // _FILE_VIEW_H
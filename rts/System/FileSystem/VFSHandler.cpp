@@ -6,7 +6,6 @@
 #include "VFSHandler.h"
 
 #include <algorithm>
-#include <set>
 #include <cstring>
 
 #include "ArchiveFactory.h"
@@ -26,9 +25,94 @@ static CLogSubsystem LOG_VFS_DETAIL("VFS-detail");
 CVFSHandler* vfsHandler = NULL;
 
 
+/*
+ * Paths are hashed and compared as if they were normalized (lower-case, with
+ * forward slashes), so looking up a raw path needs no temporary strings.
+ */
+static inline char NormalizePathChar(char c)
+{
+	return (c == '\\')? '/': (char) tolower(c);
+}
+
+static unsigned int HashPath(const std::string& rawPath)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (std::string::const_iterator c = rawPath.begin(); c != rawPath.end(); ++c) {
+		hash = (hash ^ (unsigned char) NormalizePathChar(*c)) * 16777619u;
+	}
+	return hash;
+}
+
+static bool PathEquals(const std::string& normalizedPath, const std::string& rawPath)
+{
+	if (normalizedPath.size() != rawPath.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < rawPath.size(); ++i) {
+		if (normalizedPath[i] != NormalizePathChar(rawPath[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+template<typename T>
+int CVFSHandler::PathTable::Find(const std::vector<T>& items, const std::string& rawPath, unsigned int hash) const
+{
+	if (table.empty()) {
+		return -1;
+	}
+
+	const unsigned int mask = table.size() - 1;
+	for (unsigned int slot = hash & mask; table[slot] != -1; slot = (slot + 1) & mask) {
+		const T& item = items[table[slot]];
+		if ((item.hash == hash) && PathEquals(item.path, rawPath)) {
+			return table[slot];
+		}
+	}
+
+	return -1;
+}
+
+template<typename T>
+void CVFSHandler::PathTable::Insert(const std::vector<T>& items, int idx)
+{
+	// grow when half full, to keep the probe sequences short
+	if ((numItems + 1) * 2 > table.size()) {
+		std::vector<int> oldTable;
+		oldTable.swap(table);
+		table.resize(std::max((size_t) 256, oldTable.size() * 2), -1);
+
+		for (std::vector<int>::const_iterator it = oldTable.begin(); it != oldTable.end(); ++it) {
+			if (*it != -1) {
+				Place(items[*it].hash, *it);
+			}
+		}
+	}
+
+	Place(items[idx].hash, idx);
+	++numItems;
+}
+
+void CVFSHandler::PathTable::Place(unsigned int hash, int idx)
+{
+	const unsigned int mask = table.size() - 1;
+	unsigned int slot = hash & mask;
+	while (table[slot] != -1) {
+		slot = (slot + 1) & mask;
+	}
+	table[slot] = idx;
+}
+
+
+
 CVFSHandler::CVFSHandler()
 {
 	logOutput.Print(LOG_VFS, "CVFSHandler::CVFSHandler()");
+
+	RebuildIndex();
 }
 
 
@@ -53,25 +137,85 @@ bool CVFSHandler::AddArchive(const std::string& archiveName, bool override, cons
 		int size;
 		ar->FileInfo(fid, name, size);
 		StringToLowerInPlace(name);
+		filesystem.ForwardSlashes(name);
 
+		AddFile(name, ar, fid, size, override);
+	}
+	return true;
+}
+
+void CVFSHandler::AddFile(const std::string& name, CArchiveBase* ar, unsigned fid, int size, bool override)
+{
+	const unsigned int hash = HashPath(name);
+	int fileIdx = fileTable.Find(files, name, hash);
+
+	if (fileIdx != -1) {
 		if (!override) {
-			if (files.find(name) != files.end()) {
-				logOutput.Print(LOG_VFS_DETAIL, "%s (skipping, exists)", name.c_str());
-				continue;
-			}
-			else
-				logOutput.Print(LOG_VFS_DETAIL, "%s (adding, doesn't exist)", name.c_str());
+			logOutput.Print(LOG_VFS_DETAIL, "%s (skipping, exists)", name.c_str());
+			return;
+		}
+		logOutput.Print(LOG_VFS_DETAIL, "%s (overriding)", name.c_str());
+	} else {
+		logOutput.Print(LOG_VFS_DETAIL, "%s (adding, doesn't exist)", name.c_str());
+
+		fileIdx = files.size();
+		files.push_back(FileData());
+		files[fileIdx].path = name;
+		files[fileIdx].hash = hash;
+		fileTable.Insert(files, fileIdx);
+
+		const std::string::size_type slash = name.rfind('/');
+		const int dirIdx = AddDir((slash == std::string::npos)? "": name.substr(0, slash + 1));
+		dirs[dirIdx].files.push_back(fileIdx);
+	}
+
+	FileData& d = files[fileIdx];
+	d.ar = ar;
+	d.fid = fid;
+	d.size = size;
+	d.dynamic = !!dynamic_cast<CArchiveDir*>(ar);
+}
+
+int CVFSHandler::AddDir(const std::string& dir)
+{
+	const unsigned int hash = HashPath(dir);
+	int dirIdx = dirTable.Find(dirs, dir, hash);
+	if (dirIdx != -1) {
+		return dirIdx;
+	}
+
+	// the root always exists, so <dir> has a parent
+	const std::string::size_type slash = dir.rfind('/', dir.length() - 2);
+	const int parentIdx = AddDir((slash == std::string::npos)? "": dir.substr(0, slash + 1));
+
+	dirIdx = dirs.size();
+	dirs.push_back(DirData());
+	dirs[dirIdx].path = dir;
+	dirs[dirIdx].hash = hash;
+	dirTable.Insert(dirs, dirIdx);
+	dirs[parentIdx].subDirs.push_back(dirIdx);
+
+	return dirIdx;
+}
+
+void CVFSHandler::RebuildIndex()
+{
+	std::vector<FileData> oldFiles;
+	oldFiles.swap(files);
+
+	fileTable.Clear();
+	dirTable.Clear();
+	dirs.clear();
+
+	dirs.push_back(DirData());
+	dirs[0].hash = HashPath("");
+	dirTable.Insert(dirs, 0);
+
+	for (std::vector<FileData>::const_iterator f = oldFiles.begin(); f != oldFiles.end(); ++f) {
+		if (f->ar != NULL) {
+			AddFile(f->path, f->ar, f->fid, f->size, false);
 		}
-		else
-			logOutput.Print(LOG_VFS_DETAIL, "%s (overriding)", name.c_str());
-
-		FileData d;
-		d.ar = ar;
-		d.size = size;
-		d.dynamic = !!dynamic_cast<CArchiveDir*>(ar);
-		files[name] = d;
 	}
-	return true;
 }
 
 bool CVFSHandler::AddArchiveWithDeps(const std::string& archiveName, bool override, const std::string& type)
@@ -99,14 +243,14 @@ bool CVFSHandler::RemoveArchive(const std::string& archiveName)
 	}
 	
 	// remove the files loaded from the archive to remove
-	for (std::map<std::string, FileData>::iterator f = files.begin(); f != files.end();) {
-		if (f->second.ar == ar) {
-			logOutput.Print(LOG_VFS_DETAIL, "%s (removing)", f->first.c_str());
-			f = set_erase(files, f);
+	for (std::vector<FileData>::iterator f = files.begin(); f != files.end(); ++f) {
+		if (f->ar == ar) {
+			logOutput.Print(LOG_VFS_DETAIL, "%s (removing)", f->path.c_str());
+			f->ar = NULL;
 		}
-		else
-			 ++f;
 	}
+	RebuildIndex();
+
 	delete ar;
 	archives.erase(archiveName);
 
@@ -122,38 +266,39 @@ CVFSHandler::~CVFSHandler()
 	}
 }
 
-std::string CVFSHandler::GetNormalizedPath(const std::string& rawPath)
+std::string CVFSHandler::GetNormalizedDirPath(const std::string& rawPath)
 {
 	std::string path = StringToLower(rawPath);
 	filesystem.ForwardSlashes(path);
+
+	// Non-empty directories to look in should have a trailing slash
+	if (!path.empty() && (path[path.length() - 1] != '/')) {
+		path += '/';
+	}
 	return path;
 }
 
-const CVFSHandler::FileData* CVFSHandler::GetFileData(const std::string& normalizedFilePath)
+const CVFSHandler::FileData* CVFSHandler::GetFileData(const std::string& filePath)
 {
-	const FileData* fileData = NULL;
-
-	const std::map<std::string, FileData>::const_iterator fi = files.find(normalizedFilePath);
-	if (fi != files.end()) {
-		fileData = &(fi->second);
+	const int fileIdx = fileTable.Find(files, filePath, HashPath(filePath));
+	if (fileIdx == -1) {
+		return NULL;
 	}
 
-	return fileData;
+	return &files[fileIdx];
 }
 
 bool CVFSHandler::LoadFile(const std::string& filePath, std::vector<boost::uint8_t>& buffer)
 {
 	logOutput.Print(LOG_VFS, "LoadFile(filePath = \"%s\", )", filePath.c_str());
 
-	const std::string normalizedPath = GetNormalizedPath(filePath);
-
-	const FileData* fileData = GetFileData(normalizedPath);
+	const FileData* fileData = GetFileData(filePath);
 	if (fileData == NULL) {
 		logOutput.Print(LOG_VFS, "LoadFile: File '%s' does not exist in VFS.", filePath.c_str());
 		return false;
 	}
 
-	if (!fileData->ar->GetFile(normalizedPath, buffer))
+	if (!fileData->ar->GetFile(fileData->fid, buffer))
 	{
 		logOutput.Print(LOG_VFS, "LoadFile: File '%s' does not exist in archive.", filePath.c_str());
 		return false;
@@ -161,24 +306,29 @@ bool CVFSHandler::LoadFile(const std::string& filePath, std::vector<boost::uint8
 	return true;
 }
 
-bool CVFSHandler::FileExists(const std::string& filePath)
+FileViewPtr CVFSHandler::LoadFileView(const std::string& filePath)
 {
-	logOutput.Print(LOG_VFS, "FileExists(filePath = \"%s\", )", filePath.c_str());
-
-	const std::string normalizedPath = GetNormalizedPath(filePath);
+	logOutput.Print(LOG_VFS, "LoadFileView(filePath = \"%s\", )", filePath.c_str());
 
-	const FileData* fileData = GetFileData(normalizedPath);
+	const FileData* fileData = GetFileData(filePath);
 	if (fileData == NULL) {
-		// the file does not exist in the VFS
-		return false;
+		logOutput.Print(LOG_VFS, "LoadFileView: File '%s' does not exist in VFS.", filePath.c_str());
+		return FileViewPtr();
 	}
 
-	if (fileData->ar->FileExists(normalizedPath)) {
-		// the file does not exist in the archive
-		return false;
+	const FileViewPtr view = fileData->ar->GetFileView(fileData->fid);
+	if (!view) {
+		logOutput.Print(LOG_VFS, "LoadFileView: File '%s' does not exist in archive.", filePath.c_str());
 	}
+	return view;
+}
 
-	return true;
+bool CVFSHandler::FileExists(const std::string& filePath)
+{
+	logOutput.Print(LOG_VFS, "FileExists(filePath = \"%s\", )", filePath.c_str());
+
+	// every file in the index exists in its archive
+	return (GetFileData(filePath) != NULL);
 }
 
 std::vector<std::string> CVFSHandler::GetFilesInDir(const std::string& rawDir)
@@ -186,42 +336,25 @@ std::vector<std::string> CVFSHandler::GetFilesInDir(const std::string& rawDir)
 	logOutput.Print(LOG_VFS, "GetFilesInDir(rawDir = \"%s\")", rawDir.c_str());
 
 	std::vector<std::string> ret;
-	std::string dir = GetNormalizedPath(rawDir);
-
-	std::map<std::string, FileData>::const_iterator filesStart = files.begin();
-	std::map<std::string, FileData>::const_iterator filesEnd   = files.end();
+	const std::string dir = GetNormalizedDirPath(rawDir);
 
-	// Non-empty directories to look in should have a trailing backslash
-	if (!dir.empty()) {
-		std::string::size_type dirLast = (dir.length() - 1);
-		if (dir[dirLast] != '/') {
-			dir += "/";
-			dirLast++;
-		}
-		// limit the iterator range
-		std::string dirEnd = dir;
-		dirEnd[dirLast] = dirEnd[dirLast] + 1;
-		filesStart = files.lower_bound(dir);
-		filesEnd   = files.upper_bound(dirEnd);
+	const int dirIdx = dirTable.Find(dirs, dir, HashPath(dir));
+	if (dirIdx == -1) {
+		return ret;
 	}
 
-	while (filesStart != filesEnd) {
-		const std::string path = filesystem.GetDirectory(filesStart->first);
+	const std::vector<int>& dirFiles = dirs[dirIdx].files;
+	ret.reserve(dirFiles.size());
 
-		// Test to see if this file start with the dir path
-		if (path.compare(0, dir.length(), dir) == 0) {
+	for (std::vector<int>::const_iterator f = dirFiles.begin(); f != dirFiles.end(); ++f) {
+		// Strip pathname
+		ret.push_back(files[*f].path.substr(dir.length()));
+	}
 
-			// Strip pathname
-			const std::string name = filesStart->first.substr(dir.length());
+	std::sort(ret.begin(), ret.end());
 
-			// Do not return files in subfolders
-			if ((name.find('/') == std::string::npos) &&
-			    (name.find('\\') == std::string::npos)) {
-				ret.push_back(name);
-				logOutput.Print(LOG_VFS_DETAIL, "%s", name.c_str());
-			}
-		}
-		++filesStart;
+	for (std::vector<std::string>::const_iterator it = ret.begin(); it != ret.end(); ++it) {
+		logOutput.Print(LOG_VFS_DETAIL, "%s", it->c_str());
 	}
 
 	return ret;
@@ -233,43 +366,24 @@ std::vector<std::string> CVFSHandler::GetDirsInDir(const std::string& rawDir)
 	logOutput.Print(LOG_VFS, "GetDirsInDir(rawDir = \"%s\")", rawDir.c_str());
 
 	std::vector<std::string> ret;
-	std::string dir = GetNormalizedPath(rawDir);
-
-	std::map<std::string, FileData>::const_iterator filesStart = files.begin();
-	std::map<std::string, FileData>::const_iterator filesEnd   = files.end();
+	const std::string dir = GetNormalizedDirPath(rawDir);
 
-	// Non-empty directories to look in should have a trailing backslash
-	if (!dir.empty()) {
-		std::string::size_type dirLast = (dir.length() - 1);
-		if (dir[dirLast] != '/') {
-			dir += "/";
-			++dirLast;
-		}
-		// limit the iterator range
-		std::string dirEnd = dir;
-		dirEnd[dirLast] = dirEnd[dirLast] + 1;
-		filesStart = files.lower_bound(dir);
-		filesEnd   = files.upper_bound(dirEnd);
+	const int dirIdx = dirTable.Find(dirs, dir, HashPath(dir));
+	if (dirIdx == -1) {
+		return ret;
 	}
 
-	std::set<std::string> dirs;
-
-	while (filesStart != filesEnd) {
-		const std::string path = filesystem.GetDirectory(filesStart->first);
-		// Test to see if this file start with the dir path
-		if (path.compare(0, dir.length(), dir) == 0) {
-			// Strip pathname
-			const std::string name = filesStart->first.substr(dir.length());
-			const std::string::size_type slash = name.find_first_of("/\\");
-			if (slash != std::string::npos) {
-				dirs.insert(name.substr(0, slash + 1));
-			}
-		}
-		++filesStart;
+	const std::vector<int>& subDirs = dirs[dirIdx].subDirs;
+	ret.reserve(subDirs.size());
+
+	for (std::vector<int>::const_iterator d = subDirs.begin(); d != subDirs.end(); ++d) {
+		// Strip pathname, keeps the trailing slash
+		ret.push_back(dirs[*d].path.substr(dir.length()));
 	}
 
-	for (std::set<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
-		ret.push_back(*it);
+	std::sort(ret.begin(), ret.end());
+
+	for (std::vector<std::string>::const_iterator it = ret.begin(); it != ret.end(); ++it) {
 		logOutput.Print(LOG_VFS_DETAIL, "%s", it->c_str());
 	}
 
@@ -8,6 +8,8 @@
 #include <vector>
 #include <boost/cstdint.hpp>
 
+#include "FileView.h"
+
 class CArchiveBase;
 
 class CVFSHandler
@@ -32,6 +34,17 @@ public:
 	 * @return true if the file exists in the VFS and was successfully read
 	 */
 	bool LoadFile(const std::string& filePath, std::vector<boost::uint8_t>& buffer);
+	/**
+	 * Returns a read-only view of the contents of a file within the VFS,
+	 * which avoids copying the data where the archive allows it.
+	 * Archives can be read from multiple threads at once, as long as no
+	 * archives are added or removed meanwhile.
+	 * @param filePath raw file path, for example "maps/myMap.smf",
+	 *   case-insensitive
+	 * @return an empty pointer if the file does not exist in the VFS or
+	 *   could not be read
+	 */
+	FileViewPtr LoadFileView(const std::string& filePath);
 
 	/**
 	 * Returns all the files in the given (virtual) directory without the
@@ -69,17 +82,61 @@ public:
 	bool RemoveArchive(const std::string& archiveName);
 
 protected:
+	/// a file in the VFS, <path> is lower-case with forward slashes
 	struct FileData {
-		CArchiveBase *ar;
+		std::string path;
+		unsigned int hash;
+		CArchiveBase* ar;
+		unsigned fid;
 		int size;
 		bool dynamic;
 	};
-	std::map<std::string, FileData> files; 
+	/// a directory in the VFS, <path> has a trailing slash ("" is the root)
+	struct DirData {
+		std::string path;
+		unsigned int hash;
+		std::vector<int> files;   ///< indices into <files>
+		std::vector<int> subDirs; ///< indices into <dirs>
+	};
+
+	/**
+	 * Open addressing (linear probing) hash table of indices into a
+	 * vector of FileData or DirData, keyed on their normalized path.
+	 * Items are never removed, the whole index is rebuilt instead.
+	 */
+	class PathTable {
+	public:
+		PathTable() : numItems(0) {}
+
+		void Clear() { table.clear(); numItems = 0; }
+		/// @param rawPath is normalized on the fly, so it may be any case and use backslashes
+		template<typename T> int Find(const std::vector<T>& items, const std::string& rawPath, unsigned int hash) const;
+		template<typename T> void Insert(const std::vector<T>& items, int idx);
+
+	private:
+		void Place(unsigned int hash, int idx);
+
+		std::vector<int> table; ///< -1 if empty
+		unsigned int numItems;
+	};
+
+	std::vector<FileData> files;
+	std::vector<DirData> dirs;
+	PathTable fileTable;
+	PathTable dirTable;
+
 	std::map<std::string, CArchiveBase*> archives;
 
 private:
-	std::string GetNormalizedPath(const std::string& rawPath);
-	const FileData* GetFileData(const std::string& normalizedFilePath);
+	/// lower-case, forward slashes and a trailing slash, unless it is the root
+	std::string GetNormalizedDirPath(const std::string& rawPath);
+	const FileData* GetFileData(const std::string& filePath);
+
+	void AddFile(const std::string& normalizedFilePath, CArchiveBase* ar, unsigned fid, int size, bool override);
+	/// returns the index of the directory in <dirs>, creates it and its parents if needed
+	int AddDir(const std::string& normalizedDirPath);
+	/// rebuild <fileTable> and <dirs> from scratch, after files were removed
+	void RebuildIndex();
 };
 
 extern CVFSHandler* vfsHandler;
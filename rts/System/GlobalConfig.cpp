@@ -16,6 +16,7 @@ GlobalConfig::GlobalConfig() {
 	READ_CONFIG(reconnectTimeout, "ReconnectTimeout", 15, 0)
 	READ_CONFIG(mtu, "MaximumTransmissionUnit", 1400, 300)
 	teamHighlight = configHandler->Get("TeamHighlight", 1);
+	networkCompression = !!configHandler->Get("NetworkCompression", 0);
 
 	READ_CONFIG(linkOutgoingBandwidth, "LinkOutgoingBandwidth", 64 * 1024, 0)
 	READ_CONFIG(linkIncomingSustainedBandwidth, "LinkIncomingSustainedBandwidth", 2 * 1024, 0)
@@ -40,6 +40,14 @@ public:
 	 */
 	unsigned mtu;
 
+	/**
+	 * @brief networkCompression
+	 *
+	 * Whether to zlib-compress the data we send over UDP connections
+	 * (only once the other side announced that it can decompress)
+	 */
+	bool networkCompression;
+
 	/**
 	 * @brief teamHighlight
 	 *
@@ -2,6 +2,12 @@
 
 #include "StdAfx.h"
 #include <fstream>
+#include <sstream>
+#include <zlib.h>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "mmgr.h"
 
 #include "ExternalAI/EngineOutHandler.h"
@@ -31,14 +37,23 @@
 #include "Game/GameServer.h"
 #include "Game/InMapDrawModel.h"
 #include "GlobalUnsynced.h"
+#include "ConfigHandler.h"
 #include "Exceptions.h"
 
+/// writes the last save game to disk, if it is not done yet
+static boost::thread* saveThread = NULL;
+/// the file saveThread writes to, and whether it succeeded
+static std::string savePath;
+static bool saveWritten = false;
+
 CCregLoadSaveHandler::CCregLoadSaveHandler()
 	: ifs(NULL)
 {}
 
 CCregLoadSaveHandler::~CCregLoadSaveHandler()
-{}
+{
+	delete ifs;
+}
 
 class CGameStateCollector
 {
@@ -120,30 +135,110 @@ static void PrintSize(const char* txt, int size)
 	}
 }
 
+/// runs in saveThread, the file is opened by SaveGame(file) already
+static void WriteSaveFile(gzFile gz, boost::shared_ptr<std::ofstream> ofs, boost::shared_ptr<std::stringstream> state)
+{
+	bool written = true;
+
+	// streamed out of the serialized state, it is not copied again
+	if (gz != NULL) {
+		char buf[65536];
+		std::streamsize size;
+		while (written && (size = state->rdbuf()->sgetn(buf, sizeof(buf))) > 0) {
+			written = (gzwrite(gz, buf, size) == size);
+		}
+		written = (gzclose(gz) == Z_OK) && written;
+	} else {
+		*ofs << state->rdbuf();
+		ofs->close();
+		written = ofs->good();
+	}
+
+	// logOutput is not used from this thread, the result
+	// is reported by FinishSave() once the thread is joined
+	saveWritten = written;
+}
+
+/// reads compressed and uncompressed save games
+static bool ReadSaveFile(const std::string& path, std::string& data)
+{
+	gzFile file = gzopen(path.c_str(), "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	char buf[65536];
+	int read;
+	while ((read = gzread(file, buf, sizeof(buf))) > 0) {
+		data.append(buf, read);
+	}
+	gzclose(file);
+
+	return (read == 0);
+}
+
+/// saveThread has to be joined already
+static void FinishSave()
+{
+	delete saveThread;
+	saveThread = NULL;
+
+	if (!saveWritten) {
+		logOutput.Print("Save failed: unable to write \"%s\"", savePath.c_str());
+	}
+}
+
+void CCregLoadSaveHandler::WaitForSave()
+{
+	if (saveThread != NULL) {
+		saveThread->join();
+		FinishSave();
+	}
+}
+
+void CCregLoadSaveHandler::CheckSaveDone()
+{
+	if (saveThread != NULL && saveThread->timed_join(boost::posix_time::seconds(0))) {
+		FinishSave();
+	}
+}
+
 void CCregLoadSaveHandler::SaveGame(const std::string& file)
 {
 	logOutput.Print("Saving game");
 	try {
-		std::ofstream ofs(filesystem.LocateFile(file, FileSystem::WRITE).c_str(), std::ios::out|std::ios::binary);
-		if (ofs.bad() || !ofs.is_open()) {
-			throw content_error("Unable to save game to file \"" + file + "\"");
-		}
+		WaitForSave();
 
-		std::string scriptText = gameSetup->gameSetupText;
+		// the game state is serialized to memory here, on the sim thread:
+		// the game objects can not be snapshotted without serializing them.
+		// compressing and writing it to disk is done in the background
+		boost::shared_ptr<std::stringstream> state(new std::stringstream(std::ios::in|std::ios::out|std::ios::binary));
+		SaveGame(*state);
 
-		WriteString(ofs, scriptText);
+		const std::string path = filesystem.LocateFile(file, FileSystem::WRITE);
+		const bool compress = !!configHandler->Get("CompressSaveGames", 1);
 
-		WriteString(ofs, modName);
-		WriteString(ofs, mapName);
+		// open the file here, so a bad path is reported right away
+		gzFile gz = NULL;
+		boost::shared_ptr<std::ofstream> ofs;
 
-		CGameStateCollector* gsc = new CGameStateCollector();
+		if (compress) {
+			gz = gzopen(path.c_str(), "wb");
+			if (gz == NULL) {
+				logOutput.Print("Save failed: unable to write \"%s\"", path.c_str());
+				return;
+			}
+		} else {
+			ofs.reset(new std::ofstream(path.c_str(), std::ios::out|std::ios::binary));
+			if (!ofs->is_open()) {
+				logOutput.Print("Save failed: unable to write \"%s\"", path.c_str());
+				return;
+			}
+		}
 
-		creg::COutputStreamSerializer os;
-		os.SavePackage(&ofs, gsc, gsc->GetClass());
-		PrintSize("Game",ofs.tellp());
-		int aistart = ofs.tellp();
-		eoh->Save(&ofs);
-		PrintSize("AIs", ((int)ofs.tellp())-aistart);
+		savePath = path;
+		saveWritten = false;
+		saveThread = new boost::thread(boost::bind(&WriteSaveFile, gz, ofs, state));
 	} catch (content_error& e) {
 		logOutput.Print("Save failed(content error): %s", e.what());
 	} catch (std::exception& e) {
@@ -155,11 +250,39 @@ void CCregLoadSaveHandler::SaveGame(const std::string& file)
 	}
 }
 
+void CCregLoadSaveHandler::SaveGame(std::ostream& ofs)
+{
+	std::string scriptText = gameSetup->gameSetupText;
+
+	WriteString(ofs, scriptText);
+
+	WriteString(ofs, modName);
+	WriteString(ofs, mapName);
+
+	CGameStateCollector* gsc = new CGameStateCollector();
+
+	creg::COutputStreamSerializer os;
+	os.SavePackage(&ofs, gsc, gsc->GetClass());
+	PrintSize("Game",ofs.tellp());
+	int aistart = ofs.tellp();
+	eoh->Save(&ofs);
+	PrintSize("AIs", ((int)ofs.tellp())-aistart);
+}
+
 /// this just loads the mapname and some other early stuff
 void CCregLoadSaveHandler::LoadGameStartInfo(const std::string& file)
 {
 	const std::string file2 = FindSaveFile(file);
-	ifs = new std::ifstream (filesystem.LocateFile(file2).c_str(), std::ios::in|std::ios::binary);
+
+	// might still be written by SaveGame()
+	WaitForSave();
+
+	std::string data;
+	if (!ReadSaveFile(filesystem.LocateFile(file2), data)) {
+		throw content_error("Unable to load game from file \"" + file2 + "\"");
+	}
+	delete ifs;
+	ifs = new std::istringstream(data, std::ios::in|std::ios::binary);
 
 	// in case these contained values alredy
 	// (this is the case when loading a game through the spring menu eg),
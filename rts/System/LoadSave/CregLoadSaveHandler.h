@@ -4,7 +4,7 @@
 #define CREG_LOAD_SAVE_HANDLER_H
 
 #include <string>
-#include <fstream>
+#include <istream>
 #include "LoadSaveHandler.h"
 
 class CLoadInterface;
@@ -14,13 +14,21 @@ class CCregLoadSaveHandler : public ILoadSaveHandler
 public:
 	CCregLoadSaveHandler();
 	~CCregLoadSaveHandler();
+	/// the file is written in the background, see WaitForSave()
 	void SaveGame(const std::string& file);
+	/// write the savestate to a stream, throws on failure
+	void SaveGame(std::ostream& ofs);
 	/// load things such as map and mod, needed to fire up the engine
 	void LoadGameStartInfo(const std::string& file);
 	void LoadGame(); 
 
+	/// blocks until the file of the last SaveGame(file) is written
+	static void WaitForSave();
+	/// reports the result of the last SaveGame(file) if it is written, does not block
+	static void CheckSaveDone();
+
 protected:
-	std::ifstream* ifs;
+	std::istream* ifs;
 };
 
 #endif // CREG_LOAD_SAVE_HANDLER_H
@@ -4,14 +4,19 @@
 #include "DemoReader.h"
 
 #include <limits.h>
+#include <stddef.h>
+#include <algorithm>
 #include <stdexcept>
 #include <assert.h>
+#include <zlib.h>
 #include "mmgr.h"
 
 #include "Net/RawPacket.h"
 #include "Game/GameVersion.h"
 
 CDemoReader::CDemoReader(const std::string& filename, float curTime)
+	: streamBlockPos(0)
+	, haveBlockIndex(false)
 {
 	playbackDemo.open(filename.c_str(), std::ios::binary);
 
@@ -20,12 +25,27 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
 		throw std::runtime_error(std::string("Demofile not found: ")+filename);
 	}
 
-	playbackDemo.read((char*)&fileHeader, sizeof(fileHeader));
+	// legacy headers end before indexSize, so read
+	// the version first to know how much to read
+	const int headerPrefixSize = sizeof(fileHeader.magic) + sizeof(fileHeader.version) + sizeof(fileHeader.headerSize);
+	const int legacyHeaderSize = offsetof(DemoFileHeader, indexSize);
+
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	playbackDemo.read((char*)&fileHeader, headerPrefixSize);
+
+	const int version = swabdword(fileHeader.version);
+	const int headerSize = swabdword(fileHeader.headerSize);
+	const bool knownHeader =
+		(version == DEMOFILE_VERSION && headerSize == sizeof(fileHeader)) ||
+		(version == DEMOFILE_VERSION_LEGACY && headerSize == legacyHeaderSize);
+
+	if (knownHeader) {
+		playbackDemo.read(((char*)&fileHeader) + headerPrefixSize, headerSize - headerPrefixSize);
+	}
 	fileHeader.swab();
 
 	if (memcmp(fileHeader.magic, DEMOFILE_MAGIC, sizeof(fileHeader.magic))
-		|| fileHeader.version != DEMOFILE_VERSION
-		|| fileHeader.headerSize != sizeof(fileHeader)
+		|| !knownHeader
 		|| fileHeader.playerStatElemSize != sizeof(PlayerStatistics)
 		|| fileHeader.teamStatElemSize != sizeof(TeamStatistics)
 		// Don't compare spring version in debug mode: we don't want to make
@@ -45,11 +65,7 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
 		delete[] buf;
 	}
 
-	playbackDemo.read((char*)&chunkHeader, sizeof(chunkHeader));
-	chunkHeader.swab();
-
-	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
-	nextDemoReadTime = curTime - 0.01f;
+	streamStart = playbackDemo.tellg();
 
 	if (fileHeader.demoStreamSize != 0) {
 		bytesRemaining = fileHeader.demoStreamSize;
@@ -64,6 +80,17 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
  		bytesRemaining = (long) playbackDemo.tellg() - curPos;
  		playbackDemo.seekg(curPos);
 	}
+	streamSize = bytesRemaining;
+
+	if (fileHeader.version != DEMOFILE_VERSION_LEGACY) {
+		ReadStreamBlock();
+	}
+
+	ReadStream(&chunkHeader, sizeof(chunkHeader));
+	chunkHeader.swab();
+
+	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
+	nextDemoReadTime = curTime - 0.01f;
 }
 
 netcode::RawPacket* CDemoReader::GetData(float readTime)
@@ -76,15 +103,13 @@ netcode::RawPacket* CDemoReader::GetData(float readTime)
 	// check needed
 	if (readTime > nextDemoReadTime) {
 		netcode::RawPacket* buf = new netcode::RawPacket(chunkHeader.length);
-		playbackDemo.read((char*)(buf->data), chunkHeader.length);
-		bytesRemaining -= chunkHeader.length;
+		ReadStream(buf->data, chunkHeader.length);
 
 		if (!ReachedEnd()) {
 			// read next chunk header
-			playbackDemo.read((char*)&chunkHeader, sizeof(chunkHeader));
+			ReadStream(&chunkHeader, sizeof(chunkHeader));
 			chunkHeader.swab();
 			nextDemoReadTime = chunkHeader.modGameTime + demoTimeOffset;
-			bytesRemaining -= sizeof(chunkHeader);
 		}
 
 		return buf;
@@ -95,6 +120,9 @@ netcode::RawPacket* CDemoReader::GetData(float readTime)
 
 bool CDemoReader::ReachedEnd() const
 {
+	if (fileHeader.version != DEMOFILE_VERSION_LEGACY)
+		return (streamBlockPos >= streamBlock.size());
+
 	if (bytesRemaining <= 0 || playbackDemo.eof())
 		return true;
 	else
@@ -102,6 +130,192 @@ bool CDemoReader::ReachedEnd() const
 }
 
 
+void CDemoReader::ReadStream(void* data, unsigned length)
+{
+	if (fileHeader.version == DEMOFILE_VERSION_LEGACY) {
+		playbackDemo.read((char*) data, length);
+		bytesRemaining -= length;
+		return;
+	}
+
+	unsigned char* dest = (unsigned char*) data;
+
+	while (length > 0) {
+		if (streamBlockPos >= streamBlock.size() && !ReadStreamBlock()) {
+			memset(dest, 0, length);
+			return;
+		}
+
+		const unsigned copyLength = std::min(length, unsigned(streamBlock.size() - streamBlockPos));
+		memcpy(dest, &streamBlock[streamBlockPos], copyLength);
+		streamBlockPos += copyLength;
+		dest += copyLength;
+		length -= copyLength;
+	}
+
+	// load ahead so ReachedEnd() knows if there is more
+	if (streamBlockPos >= streamBlock.size()) {
+		ReadStreamBlock();
+	}
+}
+
+bool CDemoReader::ReadStreamBlock()
+{
+	streamBlock.clear();
+	streamBlockPos = 0;
+
+	while (bytesRemaining >= (int) sizeof(DemoStreamBlockHeader)) {
+		DemoStreamBlockHeader blockHeader;
+		playbackDemo.read((char*) &blockHeader, sizeof(blockHeader));
+		blockHeader.swab();
+		bytesRemaining -= sizeof(blockHeader);
+
+		// a crashed recording may end in a partial block
+		if (!playbackDemo.good() || (int) blockHeader.packedSize > bytesRemaining)
+			break;
+
+		bytesRemaining -= blockHeader.packedSize;
+
+		if (blockHeader.type != DEMO_BLOCK_STREAM) {
+			playbackDemo.seekg(blockHeader.packedSize, std::ios::cur);
+			continue;
+		}
+
+		if (!ReadBlockData(blockHeader, streamBlock))
+			break;
+
+		return true;
+	}
+
+	streamBlock.clear();
+	bytesRemaining = 0;
+	return false;
+}
+
+bool CDemoReader::ReadBlockData(const DemoStreamBlockHeader& blockHeader, std::vector<unsigned char>& data)
+{
+	if (blockHeader.packedSize == 0 || blockHeader.rawSize == 0)
+		return false;
+
+	std::vector<Bytef> packed(blockHeader.packedSize);
+	playbackDemo.read((char*) &packed[0], blockHeader.packedSize);
+
+	uLongf rawSize = blockHeader.rawSize;
+	data.resize(rawSize);
+
+	if (uncompress(&data[0], &rawSize, &packed[0], blockHeader.packedSize) != Z_OK || rawSize != blockHeader.rawSize) {
+		data.clear();
+		return false;
+	}
+
+	return true;
+}
+
+
+const std::vector<DemoStreamIndexEntry>& CDemoReader::GetBlockIndex()
+{
+	if (!haveBlockIndex) {
+		LoadBlockIndex();
+	}
+
+	return blockIndex;
+}
+
+void CDemoReader::LoadBlockIndex()
+{
+	haveBlockIndex = true;
+	blockIndex.clear();
+
+	if (fileHeader.version == DEMOFILE_VERSION_LEGACY)
+		return;
+
+	const int curPos = playbackDemo.tellg();
+
+	if (fileHeader.demoStreamSize != 0 && fileHeader.indexSize != 0) {
+		playbackDemo.seekg(fileHeader.headerSize + fileHeader.scriptSize + fileHeader.demoStreamSize +
+			fileHeader.winningAllyTeamsSize + fileHeader.playerStatSize + fileHeader.teamStatSize);
+
+		blockIndex.resize(fileHeader.indexSize / sizeof(DemoStreamIndexEntry));
+
+		for (std::vector<DemoStreamIndexEntry>::iterator it = blockIndex.begin(); it != blockIndex.end(); ++it) {
+			playbackDemo.read((char*) &(*it), sizeof(DemoStreamIndexEntry));
+			it->swab();
+		}
+	} else {
+		// recording was not finished, walk the block headers instead
+		int offset = 0;
+
+		while (offset + (int) sizeof(DemoStreamBlockHeader) <= streamSize) {
+			DemoStreamBlockHeader blockHeader;
+			playbackDemo.seekg(streamStart + offset);
+			playbackDemo.read((char*) &blockHeader, sizeof(blockHeader));
+			blockHeader.swab();
+
+			const int blockSize = sizeof(blockHeader) + blockHeader.packedSize;
+
+			if (!playbackDemo.good() || offset + blockSize > streamSize)
+				break;
+
+			DemoStreamIndexEntry entry;
+			entry.modGameTime = blockHeader.modGameTime;
+			entry.type = blockHeader.type;
+			entry.offset = offset;
+			blockIndex.push_back(entry);
+
+			offset += blockSize;
+		}
+	}
+
+	playbackDemo.clear();
+	playbackDemo.seekg(curPos);
+}
+
+float CDemoReader::SeekToKeyframe(float modGameTime, float curTime, std::string& state)
+{
+	const std::vector<DemoStreamIndexEntry>& index = GetBlockIndex();
+	const DemoStreamIndexEntry* keyframe = NULL;
+
+	for (std::vector<DemoStreamIndexEntry>::const_iterator it = index.begin(); it != index.end() && it->modGameTime <= modGameTime; ++it) {
+		if (it->type == DEMO_BLOCK_KEYFRAME)
+			keyframe = &(*it);
+	}
+
+	if (keyframe == NULL)
+		return -1.0f;
+
+	const int curPos = playbackDemo.tellg();
+
+	DemoStreamBlockHeader blockHeader;
+	std::vector<unsigned char> data;
+
+	playbackDemo.seekg(streamStart + keyframe->offset);
+	playbackDemo.read((char*) &blockHeader, sizeof(blockHeader));
+	blockHeader.swab();
+
+	if (!playbackDemo.good() || !ReadBlockData(blockHeader, data)) {
+		playbackDemo.clear();
+		playbackDemo.seekg(curPos);
+		return -1.0f;
+	}
+
+	state.assign(data.begin(), data.end());
+
+	// the stream continues right behind the keyframe
+	bytesRemaining = streamSize - (keyframe->offset + sizeof(blockHeader) + blockHeader.packedSize);
+	ReadStreamBlock();
+
+	if (!ReachedEnd()) {
+		ReadStream(&chunkHeader, sizeof(chunkHeader));
+		chunkHeader.swab();
+	}
+
+	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
+	nextDemoReadTime = curTime - 0.01f;
+
+	return keyframe->modGameTime;
+}
+
+
 void CDemoReader::LoadStats()
 {
 	// Stats are not available if Spring crashed while writing the demo.
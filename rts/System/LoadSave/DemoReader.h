@@ -53,13 +53,45 @@ public:
 	/// Not needed for normal demo watching
 	void LoadStats();
 
+	/**
+	@brief blocks of the demo stream, in stream order
+	Read from the file, or rebuilt by walking the stream if the recording
+	was not finished. Always empty for DEMOFILE_VERSION_LEGACY demos.
+	*/
+	const std::vector<DemoStreamIndexEntry>& GetBlockIndex();
+
+	/**
+	@brief continue playback at the last keyframe at or before modGameTime
+	@param state receives the savestate stored in the keyframe
+	@return the time of the keyframe, or -1 if there is none
+	*/
+	float SeekToKeyframe(float modGameTime, float curTime, std::string& state);
+
 private:
+	/// read from the (decompressed) demo stream
+	void ReadStream(void* data, unsigned length);
+	/// load the next stream block, skipping keyframes
+	bool ReadStreamBlock();
+	bool ReadBlockData(const DemoStreamBlockHeader& blockHeader, std::vector<unsigned char>& data);
+	void LoadBlockIndex();
+
 	std::ifstream playbackDemo;
 
 	float demoTimeOffset;
 	float nextDemoReadTime;
 	int bytesRemaining;
 
+	/// file offset and size of the demo stream
+	int streamStart;
+	int streamSize;
+
+	/// current stream block (not used for DEMOFILE_VERSION_LEGACY demos)
+	std::vector<unsigned char> streamBlock;
+	unsigned streamBlockPos;
+
+	std::vector<DemoStreamIndexEntry> blockIndex;
+	bool haveBlockIndex;
+
 	DemoStreamChunkHeader chunkHeader;
 
 	std::string setupScript;	// the original, unaltered version from script
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <zlib.h>
 
 #include "mmgr.h"
 
@@ -18,6 +19,7 @@
 #include "LogOutput.h"
 
 CDemoRecorder::CDemoRecorder()
+	: streamBlockTime(0.0f)
 {
 	// We want this folder to exist
 	if (!filesystem.CreateDirectory("demos"))
@@ -50,9 +52,12 @@ CDemoRecorder::CDemoRecorder()
 
 CDemoRecorder::~CDemoRecorder()
 {
+	FlushStreamBlock();
+
 	WriteWinnerList();
 	WritePlayerStats();
 	WriteTeamStats();
+	WriteIndex();
 	WriteFileHeader();
 
 	recordDemo.close();
@@ -89,9 +94,60 @@ void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length,
 	chunkHeader.modGameTime = modGameTime;
 	chunkHeader.length = length;
 	chunkHeader.swab();
-	recordDemo.write((char*) &chunkHeader, sizeof(chunkHeader));
-	recordDemo.write((char*) buf, length);
-	fileHeader.demoStreamSize += length + sizeof(chunkHeader);
+
+	if (streamBlock.empty())
+		streamBlockTime = modGameTime;
+
+	const unsigned char* header = (const unsigned char*) &chunkHeader;
+	streamBlock.insert(streamBlock.end(), header, header + sizeof(chunkHeader));
+	streamBlock.insert(streamBlock.end(), buf, buf + length);
+
+	if (streamBlock.size() >= DEMO_BLOCK_MAX_SIZE || (modGameTime - streamBlockTime) >= DEMO_BLOCK_MAX_TIME)
+		FlushStreamBlock();
+}
+
+void CDemoRecorder::SaveKeyframe(const std::string& state, const float modGameTime)
+{
+	// everything recorded so far precedes the keyframe
+	FlushStreamBlock();
+	WriteBlock(DEMO_BLOCK_KEYFRAME, (const unsigned char*) state.data(), state.size(), modGameTime);
+}
+
+void CDemoRecorder::FlushStreamBlock()
+{
+	if (streamBlock.empty())
+		return;
+
+	WriteBlock(DEMO_BLOCK_STREAM, &streamBlock[0], streamBlock.size(), streamBlockTime);
+	streamBlock.clear();
+}
+
+/** @brief Compress a block and append it to the demo stream */
+void CDemoRecorder::WriteBlock(unsigned type, const unsigned char* data, unsigned length, float modGameTime)
+{
+	uLongf packedSize = compressBound(length);
+	std::vector<Bytef> packed(packedSize);
+
+	if (compress2(&packed[0], &packedSize, data, length, Z_BEST_COMPRESSION) != Z_OK) {
+		LogObject() << "Could not compress demo block, " << length << " bytes lost\n";
+		return;
+	}
+
+	DemoStreamIndexEntry entry;
+	entry.modGameTime = modGameTime;
+	entry.type = type;
+	entry.offset = fileHeader.demoStreamSize;
+	blockIndex.push_back(entry);
+
+	DemoStreamBlockHeader blockHeader;
+	blockHeader.modGameTime = modGameTime;
+	blockHeader.type = type;
+	blockHeader.rawSize = length;
+	blockHeader.packedSize = packedSize;
+	blockHeader.swab();
+	recordDemo.write((char*) &blockHeader, sizeof(blockHeader));
+	recordDemo.write((char*) &packed[0], packedSize);
+	fileHeader.demoStreamSize += sizeof(blockHeader) + packedSize;
 	recordDemo.flush();
 }
 
@@ -227,6 +283,21 @@ void CDemoRecorder::WriteWinnerList()
 	fileHeader.winningAllyTeamsSize = int(recordDemo.tellp()) - pos;
 }
 
+/** @brief Write the block index at the current position in the file. */
+void CDemoRecorder::WriteIndex()
+{
+	const int pos = recordDemo.tellp();
+
+	for (std::vector<DemoStreamIndexEntry>::iterator it = blockIndex.begin(); it != blockIndex.end(); ++it) {
+		DemoStreamIndexEntry entry = *it;
+		entry.swab();
+		recordDemo.write((char*) &entry, sizeof(DemoStreamIndexEntry));
+	}
+	blockIndex.clear();
+
+	fileHeader.indexSize = (int)recordDemo.tellp() - pos;
+}
+
 /** @brief Write the TeamStatistics at the current position in the file. */
 void CDemoRecorder::WriteTeamStats()
 {
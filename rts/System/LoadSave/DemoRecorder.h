@@ -22,6 +22,8 @@ public:
 
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf,const unsigned length, const float modGameTime);
+	/// store a savestate of the game after modGameTime as a keyframe block
+	void SaveKeyframe(const std::string& state, const float modGameTime);
 	
 	/**
 	@brief assign a map name for the demo file
@@ -45,8 +47,16 @@ private:
 	void WritePlayerStats();
 	void WriteTeamStats();
 	void WriteWinnerList();
+	void WriteIndex();
+
+	void FlushStreamBlock();
+	void WriteBlock(unsigned type, const unsigned char* data, unsigned length, float modGameTime);
 
 	std::ofstream recordDemo;
+	/// chunks of the stream block under construction, and the time of the first
+	std::vector<unsigned char> streamBlock;
+	float streamBlockTime;
+	std::vector<DemoStreamIndexEntry> blockIndex;
 	std::string wantedName;
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
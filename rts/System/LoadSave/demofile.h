@@ -19,7 +19,20 @@
 
 /** The current demofile version. Only change on major modifications for which
 appending stuff to DemoFileHeader is not sufficient. */
-#define DEMOFILE_VERSION 4
+#define DEMOFILE_VERSION 5
+
+/** The last version with an uncompressed, unindexed demo stream.
+Readers still accept it, its header ends before DemoFileHeader::indexSize. */
+#define DEMOFILE_VERSION_LEGACY 4
+
+/** Demo stream block types, see DemoStreamBlockHeader. */
+#define DEMO_BLOCK_STREAM   0 ///< Sequence of DemoStreamChunkHeader + data.
+#define DEMO_BLOCK_KEYFRAME 1 ///< creg savestate of the game after modGameTime.
+
+/** Recorders close a stream block once it holds this many bytes or spans this
+many seconds of game time; the latter also bounds the seek granularity. */
+#define DEMO_BLOCK_MAX_SIZE (64 * 1024)
+#define DEMO_BLOCK_MAX_TIME 10.0f
 
 #pragma pack(push, 1)
 
@@ -38,6 +51,8 @@ Demo file layout is like this:
 			  CTeam::Statistics for each team.
 			- Array of all CTeam::Statistics (total number of items is the
 			  sum of the elements in the array of dwords).
+		- Block index, one DemoStreamIndexEntry for each block in the
+		  demo stream (indexSize)
 
 The header is designed to be extensible: it contains a version field and a
 headerSize field to support this. The version field is a major version number
@@ -46,7 +61,8 @@ It is not supposed to change often (if at all). The headerSize field is a
 minor version number, which happens to be equal to sizeof(DemoFileHeader).
 
 If Spring didn't cleanup properly (crashed), the demoStreamSize is 0 and it
-can be assumed the demo stream continues until the end of the file.
+can be assumed the demo stream continues until the end of the file. There is
+no block index then, but it can be rebuilt by walking the block headers.
 */
 struct DemoFileHeader
 {
@@ -68,6 +84,7 @@ struct DemoFileHeader
 	int teamStatElemSize;   ///< sizeof(CTeam::Statistics)
 	int teamStatPeriod;     ///< Interval (in seconds) between team stats.
 	int winningAllyTeamsSize;    ///< The size of the vector of the winning ally teams
+	int indexSize;          ///< Size of the block index chunk (not in DEMOFILE_VERSION_LEGACY).
 
 
 	/// Change structure from host endian to little endian or vice versa.
@@ -87,13 +104,66 @@ struct DemoFileHeader
 		teamStatElemSize = swabdword(teamStatElemSize);
 		teamStatPeriod = swabdword(teamStatPeriod);
 		winningAllyTeamsSize = swabdword(winningAllyTeamsSize);
+		indexSize = swabdword(indexSize);
+	}
+};
+
+/**
+@brief Spring demo stream block header
+
+Since DEMOFILE_VERSION 5 the demo stream is a sequence of zlib compressed
+blocks:
+
+	- DemoStreamBlockHeader
+	- packedSize bytes compressed block data
+	- DemoStreamBlockHeader
+	- packedSize bytes compressed block data
+	- ...
+
+Stream blocks decompress to a run of DemoStreamChunkHeader + data (in
+DEMOFILE_VERSION_LEGACY this run was the whole, uncompressed demo stream).
+Keyframe blocks hold a savestate; the chunks following it in the stream are
+the ones needed to continue the game from that state.
+*/
+struct DemoStreamBlockHeader
+{
+	float modGameTime;          ///< Gametime of the first chunk in the block, or of the keyframe.
+	boost::uint32_t type;       ///< DEMO_BLOCK_STREAM or DEMO_BLOCK_KEYFRAME.
+	boost::uint32_t rawSize;    ///< Size of the block data after decompression.
+	boost::uint32_t packedSize; ///< Size of the compressed block data following this header.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		modGameTime = swabfloat(modGameTime);
+		type = swabdword(type);
+		rawSize = swabdword(rawSize);
+		packedSize = swabdword(packedSize);
+	}
+};
+
+/**
+@brief Spring demo stream block index entry
+
+One for each DemoStreamBlockHeader in the demo stream, in stream order.
+*/
+struct DemoStreamIndexEntry
+{
+	float modGameTime;      ///< DemoStreamBlockHeader::modGameTime of the block.
+	boost::uint32_t type;   ///< DemoStreamBlockHeader::type of the block.
+	boost::uint32_t offset; ///< Offset of the block header from the start of the demo stream.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		modGameTime = swabfloat(modGameTime);
+		type = swabdword(type);
+		offset = swabdword(offset);
 	}
 };
 
 /**
 @brief Spring demo stream chunk header
 
-The demo stream layout is as follows:
+The layout of a decompressed stream block is as follows:
 
 	- DemoStreamChunkHeader
 	- length bytes raw data from network stream
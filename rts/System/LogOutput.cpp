@@ -59,6 +59,15 @@ namespace
 	};
 }
 
+// guards the log file and the subscriber list; threaded loading stages
+// log from worker threads, so not only GML builds need this
+// (wrapped in a function for the same reason as preInitLog below)
+static boost::recursive_mutex& logMutex()
+{
+	static boost::recursive_mutex mutex;
+	return mutex;
+}
+
 // wrapped in a function to prevent order of initialization problems
 // when logOutput is used before main() is entered.
 static vector<PreInitLogEntry>& preInitLog()
@@ -126,14 +135,14 @@ CLogOutput::~CLogOutput()
 
 void CLogOutput::End()
 {
-	GML_STDMUTEX_LOCK_NOPROF(log); // End
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	SafeDelete(filelog);
 }
 
 void CLogOutput::Flush()
 {
-	GML_STDMUTEX_LOCK_NOPROF(log); // Flush
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	if (filelog != NULL) {
 		filelog->flush();
@@ -151,7 +160,7 @@ const std::string& CLogOutput::GetFilePath() const
 }
 void CLogOutput::SetFileName(std::string fname)
 {
-	GML_STDMUTEX_LOCK_NOPROF(log); // SetFileName
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	assert(!initialized);
 	fileName = fname;
@@ -201,6 +210,8 @@ void CLogOutput::RotateLogFile() const
 
 void CLogOutput::Initialize()
 {
+	boost::recursive_mutex::scoped_lock lock(logMutex());
+
 	if (initialized) return;
 
 	filePath = CreateFilePath(fileName);
@@ -307,7 +318,7 @@ void CLogOutput::InitializeSubsystems()
 
 void CLogOutput::Output(const CLogSubsystem& subsystem, const std::string& str)
 {
-	GML_STDMUTEX_LOCK(log); // Output
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	std::string msg;
 
@@ -331,7 +342,6 @@ void CLogOutput::Output(const CLogSubsystem& subsystem, const std::string& str)
 	if (!subsystem.enabled) return;
 
 	// Output to subscribers
-	//FIXME make threadsafe!!!
 	if (subscribersEnabled) {
 		for (vector<ILogSubscriber*>::iterator lsi = subscribers.begin(); lsi != subscribers.end(); ++lsi) {
 			(*lsi)->NotifyLogMsg(subsystem, str);
@@ -354,7 +364,7 @@ void CLogOutput::Output(const CLogSubsystem& subsystem, const std::string& str)
 
 void CLogOutput::SetLastMsgPos(const float3& pos)
 {
-	GML_STDMUTEX_LOCK(log); // SetLastMsgPos
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	if (subscribersEnabled) {
 		for (vector<ILogSubscriber*>::iterator lsi = subscribers.begin(); lsi != subscribers.end(); ++lsi) {
@@ -367,14 +377,14 @@ void CLogOutput::SetLastMsgPos(const float3& pos)
 
 void CLogOutput::AddSubscriber(ILogSubscriber* ls)
 {
-	GML_STDMUTEX_LOCK(log); // AddSubscriber
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	subscribers.push_back(ls);
 }
 
 void CLogOutput::RemoveSubscriber(ILogSubscriber *ls)
 {
-	GML_STDMUTEX_LOCK(log); // RemoveSubscriber
+	boost::recursive_mutex::scoped_lock lock(logMutex());
 
 	subscribers.erase(std::find(subscribers.begin(), subscribers.end(), ls));
 }
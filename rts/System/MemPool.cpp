@@ -1,50 +1,199 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "StdAfx.h"
+#include <algorithm>
 #include "MemPool.h"
+#include "LogOutput.h"
 //#include "mmgr.h"
 
+#ifdef DEBUG
+	#define MEMPOOL_POISON_ALLOC(pnt, numBytes) memset((pnt), 0xCD, (numBytes))
+	#define MEMPOOL_POISON_FREE(pnt, numBytes) memset((pnt), 0xDD, (numBytes))
+#else
+	#define MEMPOOL_POISON_ALLOC(pnt, numBytes)
+	#define MEMPOOL_POISON_FREE(pnt, numBytes)
+#endif
+
+/// bytes a full magazine holds, at least 4 and at most 64 blocks
+static const size_t MAGAZINE_BYTES = 16384;
+/// largest block of blocks the depot reserves at once
+static const size_t MAX_CHUNK_BYTES = 1 << 20;
+
 CMemPool mempool;
 
 CMemPool::CMemPool()
+	: reservedBytes(0)
+	, retiredExternalBytes(0)
+	, threadCache(&CMemPool::ReleaseThreadCache)
+{
+	for (size_t a = 0; a < NUM_MEM_SIZE_CLASSES; a++) {
+		sizeClasses[a].nextFree = NULL;
+		sizeClasses[a].numFree = 0;
+		sizeClasses[a].poolSize = 10;
+		sizeClasses[a].numOut = 0;
+		sizeClasses[a].numPeak = 0;
+		sizeClasses[a].numReserved = 0;
+		sizeClasses[a].numRetired = 0;
+	}
+}
+
+CMemPool::~CMemPool()
+{
+}
+
+
+CMemPool::ThreadCache* CMemPool::GetThreadCache()
 {
-	for (size_t a = 0; a < (MAX_MEM_SIZE + 1); a++) {
-		nextFree[a] = NULL;
-		poolSize[a] = 10;
+	ThreadCache* cache = threadCache.get();
+
+	if (cache == NULL) {
+		cache = new ThreadCache();
+		cache->pool = this;
+		cache->externalBytes = 0;
+
+		for (size_t a = 0; a < NUM_MEM_SIZE_CLASSES; a++) {
+			Magazine& mag = cache->magazines[a];
+
+			mag.head = NULL;
+			mag.count = 0;
+			mag.capacity = std::max(4, std::min(64, int(MAGAZINE_BYTES / GetBlockSize(a))));
+			mag.numLive = 0;
+		}
+
+		threadCache.reset(cache);
+
+		boost::mutex::scoped_lock lock(depotMutex);
+		threadCaches.push_back(cache);
 	}
+
+	return cache;
 }
 
-void* CMemPool::Alloc(size_t numBytes)
+// called by boost when a thread that used the pool exits
+void CMemPool::ReleaseThreadCache(ThreadCache* cache)
 {
+	CMemPool* pool = cache->pool;
+
+	{
+		boost::mutex::scoped_lock lock(pool->depotMutex);
+
+		for (size_t a = 0; a < NUM_MEM_SIZE_CLASSES; a++) {
+			pool->sizeClasses[a].numRetired += cache->magazines[a].numLive;
+		}
+
+		pool->retiredExternalBytes += cache->externalBytes;
+		pool->threadCaches.erase(std::find(pool->threadCaches.begin(), pool->threadCaches.end(), cache));
+	}
+
+	for (size_t a = 0; a < NUM_MEM_SIZE_CLASSES; a++) {
+		Magazine& mag = cache->magazines[a];
+
+		if (mag.count > 0) {
+			pool->DrainMagazine(a, mag, mag.count);
+		}
+	}
+
+	delete cache;
+}
+
+
+void CMemPool::RefillMagazine(size_t sizeClassIdx, Magazine& mag)
+{
+	boost::mutex::scoped_lock lock(depotMutex);
+
+	SizeClass& sc = sizeClasses[sizeClassIdx];
+	const size_t blockSize = GetBlockSize(sizeClassIdx);
+	const int numBlocks = std::max(1, mag.capacity / 2);
+
+	if (sc.numFree < numBlocks) {
+		const int numNew = std::max(numBlocks, std::min(sc.poolSize, int(MAX_CHUNK_BYTES / blockSize)));
+
+		#ifdef USE_MMGR
+		char* newBlock = new char[blockSize * numNew];
+		#else
+		char* newBlock = (char*) ::operator new(blockSize * numNew);
+		#endif
+
+		for (int i = 0; i < (numNew - 1); ++i) {
+			*(void**)&newBlock[i * blockSize] = (void*)&newBlock[(i + 1) * blockSize];
+		}
+
+		*(void**)&newBlock[(numNew - 1) * blockSize] = sc.nextFree;
+
+		sc.nextFree = newBlock;
+		sc.numFree += numNew;
+		sc.numReserved += numNew;
+		sc.poolSize *= 2;
+		reservedBytes += blockSize * numNew;
+	}
+
+	for (int i = 0; i < numBlocks; ++i) {
+		void* pnt = sc.nextFree;
+
+		sc.nextFree = (*(void**)pnt);
+		(*(void**)pnt) = mag.head;
+		mag.head = pnt;
+	}
+
+	mag.count += numBlocks;
+	sc.numFree -= numBlocks;
+	sc.numOut += numBlocks;
+	sc.numPeak = std::max(sc.numPeak, sc.numOut);
+}
+
+void CMemPool::DrainMagazine(size_t sizeClassIdx, Magazine& mag, int numBlocks)
+{
+	boost::mutex::scoped_lock lock(depotMutex);
+
+	SizeClass& sc = sizeClasses[sizeClassIdx];
+
+	for (int i = 0; i < numBlocks; ++i) {
+		void* pnt = mag.head;
+
+		mag.head = (*(void**)pnt);
+		(*(void**)pnt) = sc.nextFree;
+		sc.nextFree = pnt;
+	}
+
+	mag.count -= numBlocks;
+	sc.numFree += numBlocks;
+	sc.numOut -= numBlocks;
+}
+
+
+void* CMemPool::Alloc(size_t numBytes, bool zeroFill)
+{
+	ThreadCache* cache = GetThreadCache();
+	void* pnt = NULL;
+
 	if (UseExternalMemory(numBytes)) {
-#ifdef USE_MMGR
-		return (void*)new char[numBytes];
-#else
-		return ::operator new(numBytes);
-#endif
+		cache->externalBytes += numBytes;
+		#ifdef USE_MMGR
+		pnt = (void*)new char[numBytes];
+		#else
+		pnt = ::operator new(numBytes);
+		#endif
 	} else {
-		void* pnt = nextFree[numBytes];
-
-		if (pnt) {
-			nextFree[numBytes] = (*(void**)pnt);
-		} else {
-			#ifdef USE_MMGR
-			void* newBlock = (void*)new char[numBytes * poolSize[numBytes]];
-			#else
-			void* newBlock = ::operator new(numBytes * poolSize[numBytes]);
-			#endif
-			for (int i = 0; i < (poolSize[numBytes] - 1); ++i) {
-				*(void**)&((char*)newBlock)[(i) * numBytes] = (void*)&((char*)newBlock)[(i + 1) * numBytes];
-			}
-
-			*(void**)&((char*)newBlock)[(poolSize[numBytes] - 1) * numBytes] = 0;
-
-			pnt = newBlock;
-			nextFree[numBytes] = (*(void**)pnt);
-			poolSize[numBytes] *= 2;
+		const size_t sizeClassIdx = GetSizeClass(numBytes);
+		Magazine& mag = cache->magazines[sizeClassIdx];
+
+		if (mag.count == 0) {
+			RefillMagazine(sizeClassIdx, mag);
 		}
-		return pnt;
+
+		pnt = mag.head;
+		mag.head = (*(void**)pnt);
+		mag.count -= 1;
+		mag.numLive += 1;
+
+		MEMPOOL_POISON_ALLOC(pnt, GetBlockSize(sizeClassIdx));
 	}
+
+	if (zeroFill) {
+		memset(pnt, 0, numBytes);
+	}
+
+	return pnt;
 }
 
 void CMemPool::Free(void* pnt, size_t numBytes)
@@ -53,18 +202,72 @@ void CMemPool::Free(void* pnt, size_t numBytes)
 		return;
 	}
 
+	ThreadCache* cache = GetThreadCache();
+
 	if (UseExternalMemory(numBytes)) {
+		cache->externalBytes -= numBytes;
 		#ifdef USE_MMGR
 		delete[] (char*)pnt;
 		#else
 		::operator delete(pnt);
 		#endif
 	} else {
-		*(void**)pnt = nextFree[numBytes];
-		nextFree[numBytes] = pnt;
+		const size_t sizeClassIdx = GetSizeClass(numBytes);
+		Magazine& mag = cache->magazines[sizeClassIdx];
+
+		MEMPOOL_POISON_FREE(pnt, GetBlockSize(sizeClassIdx));
+
+		(*(void**)pnt) = mag.head;
+		mag.head = pnt;
+		mag.count += 1;
+		mag.numLive -= 1;
+
+		// keep half, so alternating Alloc/Free does not hit the depot
+		if (mag.count >= mag.capacity) {
+			DrainMagazine(sizeClassIdx, mag, mag.count / 2);
+		}
 	}
 }
 
-CMemPool::~CMemPool()
+
+void CMemPool::PrintDebugInfo() const
 {
+	boost::mutex::scoped_lock lock(depotMutex);
+
+	// the counters of other threads are read while they may change,
+	// good enough for a debug print
+	size_t liveBytes = 0;
+	size_t peakBytes = 0;
+	long externalBytes = retiredExternalBytes;
+
+	for (std::vector<ThreadCache*>::const_iterator ci = threadCaches.begin(); ci != threadCaches.end(); ++ci) {
+		externalBytes += (*ci)->externalBytes;
+	}
+
+	LogObject() << "[CMemPool] size classes (live / peak out of depot / reserved / cached in " << threadCaches.size() << " threads):";
+
+	for (size_t a = 0; a < NUM_MEM_SIZE_CLASSES; a++) {
+		const SizeClass& sc = sizeClasses[a];
+
+		if (sc.numReserved == 0)
+			continue;
+
+		int numLive = sc.numRetired;
+		int numCached = 0;
+
+		for (std::vector<ThreadCache*>::const_iterator ci = threadCaches.begin(); ci != threadCaches.end(); ++ci) {
+			numLive += (*ci)->magazines[a].numLive;
+			numCached += (*ci)->magazines[a].count;
+		}
+
+		liveBytes += numLive * GetBlockSize(a);
+		peakBytes += sc.numPeak * GetBlockSize(a);
+
+		LogObject() << "  " << GetBlockSize(a) << " bytes: "
+			<< numLive << " / " << sc.numPeak << " / " << sc.numReserved << " / " << numCached;
+	}
+
+	LogObject() << "[CMemPool] pooled bytes (live / sum of class peaks / reserved): "
+		<< liveBytes << " / " << peakBytes << " / " << reservedBytes;
+	LogObject() << "[CMemPool] external bytes (live): " << externalBytes;
 }
@@ -4,17 +4,34 @@
 #define _MEM_POOL_H_
 
 #include <new>
+#include <vector>
 #include <cstring> // for size_t
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 
-static const size_t MAX_MEM_SIZE = 200;
+static const size_t SMALL_MEM_SIZE = 512;
+static const size_t SMALL_MEM_SIZE_GRANULARITY = 8;
+static const size_t MAX_MEM_SIZE = 4096;
+static const size_t LARGE_MEM_SIZE_GRANULARITY = 64;
+static const size_t NUM_SMALL_MEM_SIZE_CLASSES = SMALL_MEM_SIZE / SMALL_MEM_SIZE_GRANULARITY;
+static const size_t NUM_MEM_SIZE_CLASSES = NUM_SMALL_MEM_SIZE_CLASSES + (MAX_MEM_SIZE - SMALL_MEM_SIZE) / LARGE_MEM_SIZE_GRANULARITY;
 
 /**
  * Speeds-up for memory-allocation of often allocated/deallocated structs
  * or classes, or other memory blocks of equal size.
  * You may think of this as something like a very primitive garbage collector.
  * Instead of actually freeing memory, it is kept allocated, and is just
- * reassigned next time an alloc of the same size is performed.
- * The maximum memory held by this class is approximately MAX_MEM_SIZE^2 bytes.
+ * reassigned next time an alloc of the same size class is performed.
+ * Requests are rounded up to a multiple of 8 bytes up to SMALL_MEM_SIZE and
+ * of 64 bytes up to MAX_MEM_SIZE; larger blocks come straight from the
+ * system allocator.
+ *
+ * Every thread keeps a magazine of free blocks per size class, Alloc and
+ * Free only lock when a magazine runs empty or full and blocks are moved
+ * from or to the shared depot. A block may be freed by another thread than
+ * the one that allocated it.
+ * In debug builds allocated blocks are filled with 0xCD and freed ones with
+ * 0xDD, to make use of uninitialized or freed memory stand out.
  */
 class CMemPool
 {
@@ -22,19 +39,73 @@ public:
 	CMemPool();
 	~CMemPool();
 
-	void* Alloc(size_t numBytes);
+	/// zeroFill clears the first numBytes of the block
+	void* Alloc(size_t numBytes, bool zeroFill = false);
 	void Free(void* pnt, size_t numBytes);
 
+	/// prints live/peak memory and per-size-class counts to the infolog
+	void PrintDebugInfo() const;
+
 private:
 	static bool UseExternalMemory(size_t numBytes) {
-		return (numBytes > MAX_MEM_SIZE) || (numBytes < 4);
+		return (numBytes > MAX_MEM_SIZE) || (numBytes == 0);
+	}
+	static size_t GetSizeClass(size_t numBytes) {
+		if (numBytes <= SMALL_MEM_SIZE)
+			return ((numBytes - 1) / SMALL_MEM_SIZE_GRANULARITY);
+
+		return (NUM_SMALL_MEM_SIZE_CLASSES + (numBytes - SMALL_MEM_SIZE - 1) / LARGE_MEM_SIZE_GRANULARITY);
 	}
+	static size_t GetBlockSize(size_t sizeClass) {
+		if (sizeClass < NUM_SMALL_MEM_SIZE_CLASSES)
+			return ((sizeClass + 1) * SMALL_MEM_SIZE_GRANULARITY);
+
+		return (SMALL_MEM_SIZE + (sizeClass + 1 - NUM_SMALL_MEM_SIZE_CLASSES) * LARGE_MEM_SIZE_GRANULARITY);
+	}
+
+	/// free blocks of one size class owned by one thread
+	struct Magazine {
+		void* head;
+		int count;
+		int capacity;
+		int numLive; ///< allocs minus frees by this thread, may be negative
+	};
+
+	struct ThreadCache {
+		CMemPool* pool;
+		Magazine magazines[NUM_MEM_SIZE_CLASSES];
+		long externalBytes;
+	};
 
-	void* nextFree[MAX_MEM_SIZE + 1];
-	int poolSize[MAX_MEM_SIZE + 1];
+	/// depot of one size class, guarded by depotMutex
+	struct SizeClass {
+		void* nextFree;
+		int numFree;
+		int poolSize;
+
+		int numOut;      ///< blocks in use or in a magazine
+		int numPeak;     ///< peak of numOut
+		int numReserved;
+		int numRetired;  ///< numLive of the caches of finished threads
+	};
+
+	ThreadCache* GetThreadCache();
+	void RefillMagazine(size_t sizeClass, Magazine& mag);
+	void DrainMagazine(size_t sizeClass, Magazine& mag, int numBlocks);
+	static void ReleaseThreadCache(ThreadCache* cache);
+
+	mutable boost::mutex depotMutex;
+
+	SizeClass sizeClasses[NUM_MEM_SIZE_CLASSES];
+	std::vector<ThreadCache*> threadCaches;
+
+	size_t reservedBytes;
+	long retiredExternalBytes;
+
+	/// last, so that the cache of the main thread is released first
+	boost::thread_specific_ptr<ThreadCache> threadCache;
 };
 
 extern CMemPool mempool;
 
 #endif // _MEM_POOL_H_
-
@@ -11,6 +11,8 @@
 
 #include <boost/format.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <zlib.h>
 #include <boost/cstdint.hpp>
 
 #include "mmgr.h"
@@ -28,6 +30,14 @@ using namespace boost::asio;
 static const unsigned UDPMaxPacketSize = 4096;
 static const int MaxChunkSize = 254;
 static const int ChunksPerSec = 30;
+/**
+ * starts the first chunk of a side that can inflate (no valid message ID);
+ * peers without compression support discard it as an invalid packet and
+ * log that when the first chunk arrives
+ */
+static const unsigned char CompressionOffer = 0xFE;
+/// starts the deflated part of a stream (no valid message ID)
+static const unsigned char CompressionMarker = 0xFF;
 
 
 class Unpacker
@@ -47,9 +57,11 @@ public:
 		pos += sizeof(t);
 	}
 
-	void Unpack(std::vector<uint8_t>& t, unsigned unpackLength) {
-		std::copy(data + pos, data + pos + unpackLength, std::back_inserter(t));
-		pos += unpackLength;
+	const unsigned char* Current() const {
+		return data + pos;
+	}
+	void Skip(unsigned skipLength) {
+		pos += skipLength;
 	}
 
 	unsigned Remaining() const {
@@ -61,28 +73,14 @@ private:
 	unsigned pos;
 };
 
-class Packer
+Chunk::Chunk(int32_t number, const uint8_t* payload, uint8_t size)
+	: chunkNumber(number)
+	, chunkSize(size)
 {
-public:
-	Packer(std::vector<uint8_t>& data) : data(data)
-	{
-		assert(data.empty());
-	}
-
-	template<typename T>
-	void Pack(T& t) {
-		const size_t pos = data.size();
-		data.resize(pos + sizeof(T));
-		*reinterpret_cast<T*>(&data[pos]) = t;
-	}
-
-	void Pack(std::vector<uint8_t>& _data) {
-		std::copy(_data.begin(), _data.end(), std::back_inserter(data));
-	}
-
-private:
-	std::vector<uint8_t>& data;
-};
+	memcpy(&buffer[0], &chunkNumber, sizeof(chunkNumber));
+	memcpy(&buffer[sizeof(chunkNumber)], &chunkSize, sizeof(chunkSize));
+	memcpy(&buffer[headerSize], payload, size);
+}
 
 Packet::Packet(const unsigned char* data, unsigned length)
 {
@@ -105,12 +103,13 @@ Packet::Packet(const unsigned char* data, unsigned length)
 	}
 
 	while (buf.Remaining() > Chunk::headerSize) {
-		ChunkPtr temp(new Chunk);
-		buf.Unpack(temp->chunkNumber);
-		buf.Unpack(temp->chunkSize);
-		if (buf.Remaining() >= temp->chunkSize) {
-			buf.Unpack(temp->data, temp->chunkSize);
-			chunks.push_back(temp);
+		int32_t chunkNumber;
+		uint8_t chunkSize;
+		buf.Unpack(chunkNumber);
+		buf.Unpack(chunkSize);
+		if (buf.Remaining() >= chunkSize) {
+			chunks.push_back(boost::make_shared<Chunk>(chunkNumber, buf.Current(), chunkSize));
+			buf.Skip(chunkSize);
 		} else {
 			// defective, ignore
 			break;
@@ -124,18 +123,18 @@ Packet::Packet(int _lastContinuous, int _nak)
 {
 }
 
-void Packet::Serialize(std::vector<uint8_t>& data)
+void Packet::Serialize(std::vector<boost::asio::const_buffer>& buffers)
 {
-	data.reserve(GetSize());
-	Packer buf(data);
-	buf.Pack(lastContinuous);
-	buf.Pack(nakType);
-	buf.Pack(naks);
-	for (std::list<ChunkPtr>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+	memcpy(&header[0], &lastContinuous, sizeof(lastContinuous));
+	memcpy(&header[sizeof(lastContinuous)], &nakType, sizeof(nakType));
+
+	buffers.push_back(boost::asio::const_buffer(header, headerSize));
+	if (!naks.empty()) {
+		buffers.push_back(boost::asio::const_buffer(&naks[0], naks.size()));
+	}
+	for (std::vector<ChunkPtr>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
 	{
-		buf.Pack((*it)->chunkNumber);
-		buf.Pack((*it)->chunkSize);
-		buf.Pack((*it)->data);
+		buffers.push_back((*it)->GetBuffer());
 	}
 }
 
@@ -143,12 +142,16 @@ UDPConnection::UDPConnection(boost::shared_ptr<boost::asio::ip::udp::socket> net
 	: addr(myAddr)
 	, sharedSocket(true)
 	, mySocket(netSocket)
+	, deflateStream(NULL)
+	, inflateStream(NULL)
 {
 	Init();
 }
 
 UDPConnection::UDPConnection(int sourceport, const std::string& address, const unsigned port)
 	: sharedSocket(false)
+	, deflateStream(NULL)
+	, inflateStream(NULL)
 {
 	addr = ResolveAddr(address, port);
 	if (addr.address().is_v6()) {
@@ -163,6 +166,8 @@ UDPConnection::UDPConnection(int sourceport, const std::string& address, const u
 
 UDPConnection::UDPConnection(CConnection& conn)
 	: sharedSocket(true)
+	, deflateStream(NULL)
+	, inflateStream(NULL)
 {
 	ReconnectTo(conn);
 	Init();
@@ -179,6 +184,9 @@ void UDPConnection::CopyConnection(UDPConnection &conn) {
 void UDPConnection::InitConnection(boost::asio::ip::udp::endpoint address, boost::shared_ptr<ip::udp::socket> socket) {
 	addr = address;
 	mySocket = socket;
+
+	// the other end is a new peer, so its compression state is unknown
+	InitCompression();
 }
 
 UDPConnection::~UDPConnection()
@@ -186,6 +194,8 @@ UDPConnection::~UDPConnection()
 	delete fragmentBuffer;
 	fragmentBuffer = NULL;
 	Flush(true);
+
+	FreeCompression();
 }
 
 void UDPConnection::SendData(boost::shared_ptr<const RawPacket> data)
@@ -260,6 +270,11 @@ void UDPConnection::Update()
 
 void UDPConnection::ProcessRawPacket(Packet& incoming)
 {
+	if (inflateFailed) {
+		// the stream is lost for good; let the connection time out
+		return;
+	}
+
 	lastReceiveTime = spring_gettime();
 	dataRecv += incoming.GetSize();
 	recvOverhead += Packet::headerSize;
@@ -282,14 +297,14 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 			}
 		}
 	}
-	for (std::list<ChunkPtr>::const_iterator it = incoming.chunks.begin(); it != incoming.chunks.end(); ++it)
+	for (std::vector<ChunkPtr>::const_iterator it = incoming.chunks.begin(); it != incoming.chunks.end(); ++it)
 	{
 		if (lastInOrder >= (*it)->chunkNumber || waitingPackets.find((*it)->chunkNumber) != waitingPackets.end())
 		{
 			++droppedChunks;
 			continue;
 		}
-		waitingPackets.insert((*it)->chunkNumber, new RawPacket(&(*it)->data[0], (*it)->data.size()));
+		waitingPackets.insert((*it)->chunkNumber, new RawPacket((*it)->GetData(), (*it)->chunkSize));
 	}
 
 	packetMap::iterator wpi;
@@ -305,9 +320,13 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 		}
 
 		lastInOrder++;
-		std::copy(wpi->second->data, wpi->second->data+wpi->second->length, std::back_inserter(buf));
+		ReadChunk(wpi->second->data, wpi->second->length, buf);
 		waitingPackets.erase(wpi);
 
+		if (inflateFailed) {
+			return;
+		}
+
 		for (unsigned pos = 0; pos < buf.size(); ) {
 			unsigned char* bufp = &buf[pos];
 			unsigned msglength = buf.size() - pos;
@@ -349,6 +368,17 @@ void UDPConnection::Flush(const bool forced)
 	if (forced || (!waitMore && outgoingLength > requiredLength)) {
 		boost::uint8_t buffer[UDPMaxPacketSize];
 		unsigned pos = 0;
+
+		// a batch always starts at a message boundary,
+		// so this is where compression can be switched on
+		if (deflateStream && peerCanInflate && !compressing) {
+			compressing = true;
+			sendCompressionMarker = true;
+		}
+		if (sendCompressionOffer && !compressing && !outgoingData.empty()) {
+			buffer[pos++] = CompressionOffer;
+			sendCompressionOffer = false;
+		}
 		// Manually fragment packets to respect configured UDP_MTU.
 		// This is an attempt to fix the bug where players drop out of the game if
 		// someone in the game gives a large order.
@@ -378,7 +408,11 @@ void UDPConnection::Flush(const bool forced)
 				}
 			}
 			if (pos > 0 && (outgoingData.empty() || pos == MaxChunkSize || !sendMore)) {
-				CreateChunk(buffer, pos, currentNum++);
+				if (compressing) {
+					CreateCompressedChunks(buffer, pos);
+				} else {
+					CreateChunk(buffer, pos, currentNum++);
+				}
 				pos = 0;
 			}
 		} while (!outgoingData.empty() && sendMore);
@@ -428,6 +462,12 @@ std::string UDPConnection::Statistics() const
 	msg += str( boost::format("Sent: %1% bytes in %2% packets (%3% bytes/package)\n") %dataSent %sentPackets %((float)dataSent / (float)sentPackets));
 	msg += str( boost::format("Relative protocol overhead: %1% up, %2% down\n") %((float)sentOverhead / (float)dataSent) %((float)recvOverhead / (float)dataRecv) );
 	msg += str( boost::format("%1% incoming chunks had been dropped, %2% outgoing chunks had to be resent\n") %droppedChunks %resentChunks);
+	if (compressing) {
+		msg += str( boost::format("Compressed %1% bytes to %2% bytes (%3%) up\n") %uncompressedSent %compressedSent %((float)compressedSent / (float)uncompressedSent));
+	}
+	if (inflateStream) {
+		msg += str( boost::format("Decompressed %1% bytes to %2% bytes (%3%) down\n") %compressedRecv %uncompressedRecv %((float)compressedRecv / (float)uncompressedRecv));
+	}
 	return msg;
 }
 
@@ -467,19 +507,154 @@ void UDPConnection::Init()
 	mtu = gc->mtu;
 	reconnectTime = gc->reconnectTimeout;
 	lastChunkCreated = spring_gettime();
+
+	compressedSent = uncompressedSent = 0;
+	compressedRecv = uncompressedRecv = 0;
+
+	InitCompression();
+}
+
+void UDPConnection::InitCompression()
+{
+	FreeCompression();
+
+	sendCompressionOffer = true;
+	sendCompressionMarker = false;
+	peerCanInflate = false;
+	compressing = false;
+	inflateFailed = false;
+
+	if (gc->networkCompression) {
+		deflateStream = new z_stream;
+		deflateStream->zalloc = Z_NULL;
+		deflateStream->zfree = Z_NULL;
+		deflateStream->opaque = Z_NULL;
+
+		if (deflateInit(deflateStream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+			logOutput.Print("ERROR: could not initialize network compression");
+			delete deflateStream;
+			deflateStream = NULL;
+		}
+	}
+}
+
+void UDPConnection::FreeCompression()
+{
+	if (deflateStream) {
+		deflateEnd(deflateStream);
+		delete deflateStream;
+		deflateStream = NULL;
+	}
+	if (inflateStream) {
+		inflateEnd(inflateStream);
+		delete inflateStream;
+		inflateStream = NULL;
+	}
 }
 
 void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
 {
 	assert(length > 0 && length < 255);
-	ChunkPtr buf(new Chunk);
-	buf->chunkNumber = packetNum;
-	buf->chunkSize = length;
-	std::copy(data, data+length, std::back_inserter(buf->data));
-	newChunks.push_back(buf);
+	newChunks.push_back(boost::make_shared<Chunk>(packetNum, data, length));
 	lastChunkCreated = spring_gettime();
 }
 
+void UDPConnection::CreateCompressedChunks(const unsigned char* data, const unsigned length)
+{
+	// deflate output for one chunk of input is far below this
+	boost::uint8_t buffer[UDPMaxPacketSize];
+	unsigned pos = 0;
+
+	if (sendCompressionOffer) {
+		buffer[pos++] = CompressionOffer;
+		sendCompressionOffer = false;
+	}
+	if (sendCompressionMarker) {
+		buffer[pos++] = CompressionMarker;
+		sendCompressionMarker = false;
+	}
+
+	deflateStream->next_in = const_cast<Bytef*>(data);
+	deflateStream->avail_in = length;
+	deflateStream->next_out = buffer + pos;
+	deflateStream->avail_out = UDPMaxPacketSize - pos;
+
+	// sync flush: the other side can decode everything sent so far
+	deflate(deflateStream, Z_SYNC_FLUSH);
+	assert(deflateStream->avail_in == 0);
+
+	const unsigned compressedLength = UDPMaxPacketSize - deflateStream->avail_out;
+
+	uncompressedSent += length;
+	compressedSent += compressedLength;
+
+	for (pos = 0; pos < compressedLength; pos += MaxChunkSize) {
+		CreateChunk(buffer + pos, std::min((unsigned)MaxChunkSize, compressedLength - pos), currentNum++);
+	}
+}
+
+void UDPConnection::ReadChunk(const unsigned char* data, unsigned length, std::vector<uint8_t>& buf)
+{
+	// handshake bytes only ever start a chunk that starts a message
+	// (buf then holds no fragment), where they cannot be message data
+	if (!inflateStream && buf.empty()) {
+		if (length > 0 && data[0] == CompressionOffer) {
+			peerCanInflate = true;
+			++data;
+			--length;
+		}
+
+		if (length > 0 && data[0] == CompressionMarker) {
+			inflateStream = new z_stream;
+			inflateStream->zalloc = Z_NULL;
+			inflateStream->zfree = Z_NULL;
+			inflateStream->opaque = Z_NULL;
+			inflateStream->next_in = Z_NULL;
+			inflateStream->avail_in = 0;
+
+			if (inflateInit(inflateStream) != Z_OK) {
+				logOutput.Print("ERROR: could not initialize network decompression");
+				delete inflateStream;
+				inflateStream = NULL;
+				inflateFailed = true;
+				return;
+			}
+
+			++data;
+			--length;
+		}
+	}
+
+	if (!inflateStream) {
+		std::copy(data, data + length, std::back_inserter(buf));
+		return;
+	}
+
+	boost::uint8_t buffer[UDPMaxPacketSize];
+
+	inflateStream->next_in = const_cast<Bytef*>(data);
+	inflateStream->avail_in = length;
+	compressedRecv += length;
+
+	do {
+		inflateStream->next_out = buffer;
+		inflateStream->avail_out = UDPMaxPacketSize;
+
+		const int ret = inflate(inflateStream, Z_SYNC_FLUSH);
+
+		if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			// everything after this depends on the lost dictionary state
+			logOutput.Print("ERROR: Incoming compressed stream is undecodable (%d), dropping connection", ret);
+			inflateFailed = true;
+			return;
+		}
+
+		const unsigned inflatedLength = UDPMaxPacketSize - inflateStream->avail_out;
+		std::copy(buffer, buffer + inflatedLength, std::back_inserter(buf));
+		uncompressedRecv += inflatedLength;
+	} while (inflateStream->avail_out == 0);
+}
+
 void UDPConnection::SendIfNecessary(bool flushed)
 {
 	const spring_time curTime = spring_gettime();
@@ -567,19 +742,22 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 void UDPConnection::SendPacket(Packet& pkt)
 {
-	std::vector<uint8_t> data;
-	pkt.Serialize(data);
+	const unsigned size = pkt.GetSize();
+
+	sendBuffers.clear();
+	pkt.Serialize(sendBuffers);
 
-	outgoing.DataSent(data.size());
+	outgoing.DataSent(size);
 	lastSendTime = spring_gettime();
 	boost::asio::ip::udp::socket::message_flags flags = 0;
 	boost::system::error_code err;
-	mySocket->send_to(buffer(data), addr, flags, err);
+	// gathered by the socket layer, no intermediate copy
+	mySocket->send_to(sendBuffers, addr, flags, err);
 	if (CheckErrorCode(err)) {
 		return;
 	}
 
-	dataSent += data.size();
+	dataSent += size;
 	++sentPackets;
 }
 
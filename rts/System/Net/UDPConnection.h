@@ -5,26 +5,46 @@
 
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <deque>
 #include <list>
+#include <vector>
 
 #include "Connection.h"
 #include "System/myTime.h"
 
+struct z_stream_s;
+
 namespace netcode {
 
+/**
+ * A chunk keeps its header and payload in one inline buffer, laid out
+ * exactly as on the wire, so packets can be sent straight from it
+ * (see Packet::Serialize) and creating one takes a single allocation.
+ */
 class Chunk
 {
 public:
-	unsigned GetSize() const {
-		return data.size() + headerSize;
-	}
 	static const unsigned maxSize = 254;
 	static const unsigned headerSize = 5;
+
+	Chunk(int32_t number, const uint8_t* payload, uint8_t size);
+
+	unsigned GetSize() const {
+		return chunkSize + headerSize;
+	}
+	const uint8_t* GetData() const { return &buffer[headerSize]; }
+	boost::asio::const_buffer GetBuffer() const {
+		return boost::asio::const_buffer(buffer, GetSize());
+	}
+
 	int32_t chunkNumber;
 	uint8_t chunkSize;
-	std::vector<uint8_t> data;
+
+private:
+	/// chunkNumber, chunkSize, payload
+	uint8_t buffer[headerSize + maxSize];
 };
 typedef boost::shared_ptr<Chunk> ChunkPtr;
 
@@ -37,20 +57,28 @@ public:
 
 	unsigned GetSize() const {
 		unsigned size = headerSize + naks.size();
-		std::list<ChunkPtr>::const_iterator chk;
+		std::vector<ChunkPtr>::const_iterator chk;
 		for (chk = chunks.begin(); chk != chunks.end(); ++chk) {
 			size += (*chk)->GetSize();
 		}
 		return size;
 	}
 
-	void Serialize(std::vector<uint8_t>& data);
+	/**
+	 * Appends the wire representation of this packet to <buffers>.
+	 * The buffers point into this packet and its chunks (nothing is
+	 * copied), so they are only valid as long as the packet is.
+	 */
+	void Serialize(std::vector<boost::asio::const_buffer>& buffers);
 
 	int32_t lastContinuous;
 	/// if < 0, we lost -x packets since lastContinuous, if >0, x = size of naks
 	int8_t nakType;
 	std::vector<uint8_t> naks;
-	std::list<ChunkPtr> chunks;
+	std::vector<ChunkPtr> chunks;
+
+private:
+	uint8_t header[headerSize];
 };
 
 /*
@@ -133,12 +161,22 @@ private:
 	/// add header to data and send it
 	void CreateChunk(const unsigned char* data, const unsigned length,
 			const int packetNum);
+	/// compress data and split the result into chunks
+	void CreateCompressedChunks(const unsigned char* data, const unsigned length);
+	/// (re)start the compression handshake, see deflateStream
+	void InitCompression();
+	void FreeCompression();
+	/// append the payload of the next in-order chunk to buf
+	void ReadChunk(const unsigned char* data, unsigned length, std::vector<uint8_t>& buf);
 	void SendIfNecessary(bool flushed);
 	void AckChunks(int lastAck);
 
 	void RequestResend(ChunkPtr);
 	void SendPacket(Packet& pkt);
 
+	/// scatter-gather list for SendPacket, kept to avoid reallocating it
+	std::vector<boost::asio::const_buffer> sendBuffers;
+
 	spring_time lastChunkCreated;
 	spring_time lastReceiveTime;
 	spring_time lastSendTime;
@@ -179,6 +217,30 @@ private:
 
 	RawPacket* fragmentBuffer;
 
+	/**
+	 * Optional compression of the chunk payloads (gc->networkCompression).
+	 * Each side announces that it can inflate by starting its first chunk
+	 * with CompressionOffer. A side that wants to compress waits for that
+	 * offer, then starts the deflated part of its stream with
+	 * CompressionMarker. Both bytes are invalid message IDs and are only
+	 * sent at message boundaries, so older peers skip them (and never
+	 * offer, so they are never sent compressed data).
+	 * The stream of payloads is deflated with a sync flush per chunk batch,
+	 * so the dictionary carries over between chunks. NULL if unused.
+	 */
+	z_stream_s* deflateStream;
+	z_stream_s* inflateStream;
+
+	bool sendCompressionOffer;
+	bool sendCompressionMarker;
+	bool peerCanInflate;
+	bool compressing;
+	/// the incoming stream could not be inflated, all further data is ignored
+	bool inflateFailed;
+
+	unsigned compressedSent, uncompressedSent;
+	unsigned compressedRecv, uncompressedRecv;
+
 	// Traffic statistics and stuff
 
 	/// packets that are resent
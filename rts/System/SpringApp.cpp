@@ -802,6 +802,7 @@ void SpringApp::ParseCmdLine()
 	cmdline->AddString('C', "config",             "Configuration file");
 	cmdline->AddSwitch(0,   "list-ai-interfaces", "Dump a list of available AI Interfaces to stdout");
 	cmdline->AddSwitch(0,   "list-skirmish-ais",  "Dump a list of available Skirmish AIs to stdout");
+	cmdline->AddSwitch(0,   "fast-replay",        "Replay the given demo as fast as possible, write stats and quit");
 
 	try {
 		cmdline->Parse();
@@ -928,7 +929,7 @@ void SpringApp::Startup()
 #endif
 
 		pregame = new CPreGame(startsetup);
-		pregame->LoadDemo(demoFileName);
+		pregame->LoadDemo(demoFileName, cmdline->IsSet("fast-replay"));
 	}
 	else if (inputFile.rfind("ssf") == inputFile.size() - 3)
 	{
@@ -7,6 +7,7 @@
 
 #include "creg_cond.h"
 #include "Serializer.h"
+#include "VarTypes.h"
 
 #include <fstream>
 #include <assert.h>
@@ -68,25 +69,6 @@ COMPILE_TIME_ASSERT(sizeof(PackageObject) == 3, test_size);
 
 #pragma pack(pop)
 
-static string ReadZStr(std::istream& f)
-{
-	std::string s;
-	char c;
-	while(!f.eof ()) {
-		f >> c;
-		if (!c) break;
-		s += c;
-	}
-	return s;
-}
-
-static void WriteZStr(std::ostream& f, const string& s)
-{
-	int c;
-	c = s.length ();
-	f.write (s.c_str(),c+1);
-}
-
 static int MakeStrHash(const char *str)
 {
 	int result = 0xDA38E7AB;
@@ -100,43 +82,107 @@ static int MakeStrHash(const char *str)
 	return result;
 }
 
-void WriteVarSizeUInt(std::ostream *stream, unsigned int val)
+//-------------------------------------------------------------------------
+// Class layouts
+//-------------------------------------------------------------------------
+
+/*
+ * Members whose serialized form is their in-memory representation (ints,
+ * floats, chars and static arrays of those) are stored as they are.
+ * Consecutive ones of those are grouped into runs that are copied as one
+ * block, instead of being serialized member by member.
+ * The package format does not change, a run is just a faster way of
+ * writing the same bytes, so this is only done when ints are stored in
+ * native byte order.
+ */
+static const bool bulkCopy = (swabdword(1) == 1 && swabword(1) == 1);
+
+namespace {
+	struct MemberRun {
+		MemberRun(int first, unsigned int offset, int size) : first(first), count(1), offset(offset), size(size) {}
+
+		int first; ///< index of the first member
+		int count;
+		unsigned int offset;
+		int size; ///< 0 for a single member that has to be serialized by its type
+	};
+
+	struct ClassLayout {
+		std::vector<MemberRun> runs;
+		std::vector<int> plainSizes; ///< serialized size of each plain member, 0 for the others
+	};
+}
+
+/// returns the size of a member that is serialized as it is in memory, 0 otherwise
+static int GetPlainSize(IType *type)
 {
-	if (val<0x80) {
-		unsigned char a = val;
-		stream->write ((char*)&a, sizeof(char));
-	} else if (val<0x4000) {
-		unsigned char a = (val & 0x7F) | 0x80;
-		unsigned char b = val>>7;
-		stream->write ((char*)&a, sizeof(char));
-		stream->write ((char*)&b, sizeof(char));
-	} else if (val<0x40000000) {
-		unsigned char a = (val & 0x7F) | 0x80;
-		unsigned char b = ((val>>7) & 0x7F) | 0x80;
-		unsigned short c = swabword(val>>14);
-		stream->write ((char*)&a, sizeof(char));
-		stream->write ((char*)&b, sizeof(char));
-		stream->write ((char*)&c, sizeof(short));
-	} else throw "Cannot save varible-size int";
+	if (BasicType *bt = dynamic_cast<BasicType*>(type)) {
+		switch (bt->id) {
+			case crInt:
+			case crUInt:
+			case crFloat:
+				return 4;
+			case crShort:
+			case crUShort:
+				return 2;
+			case crChar:
+			case crUChar:
+				return 1;
+			case crDouble:
+				return 8;
+			case crBool:
+				// stored as a 0/1 byte
+				return (sizeof(bool) == 1) ? 1 : 0;
+			default:
+				return 0;
+		}
+	}
+	if (StaticArrayBaseType *at = dynamic_cast<StaticArrayBaseType*>(type)) {
+		const int elemSize = GetPlainSize(at->elemType.get());
+		// padded elements are not contiguous
+		if (elemSize > 0 && elemSize == at->elemSize)
+			return elemSize * at->size;
+	}
+	return 0;
 }
 
-void ReadVarSizeUInt(std::istream *stream, unsigned int *buf)
+/// layouts are created on first use, (de)serialization only happens on one thread
+static const ClassLayout& GetClassLayout(Class *c)
 {
-	unsigned char a;
-	stream->read ((char*)&a, sizeof(char));
-	if (a&0x80) {
-		unsigned char b;
-		stream->read ((char*)&b, sizeof(char));
-		if (b&0x80) {
-			unsigned short c;
-			stream->read ((char*)&c, sizeof(short));
-			*buf = (a&0x7F) | ((b&0x7F)<<7) | (c<<14);
+	static std::map<Class*, ClassLayout> layouts;
+
+	std::map<Class*, ClassLayout>::iterator li = layouts.find(c);
+	if (li != layouts.end())
+		return li->second;
+
+	ClassLayout& layout = layouts[c];
+	layout.plainSizes.resize(c->members.size(), 0);
+
+	bool inRun = false;
+	for (uint a=0;a<c->members.size();a++)
+	{
+		creg::Class::Member* m = c->members [a];
+		if (m->flags & CM_NoSerialize) {
+			inRun = false;
+			continue;
+		}
+
+		const int size = GetPlainSize(m->type.get());
+		layout.plainSizes[a] = size;
+
+		if (size == 0 || !bulkCopy) {
+			layout.runs.push_back(MemberRun(a, m->offset, 0));
+			inRun = false;
+		} else if (inRun && (layout.runs.back().offset + layout.runs.back().size) == m->offset) {
+			layout.runs.back().count++;
+			layout.runs.back().size += size;
 		} else {
-			*buf = (a&0x7F) | ((b&0x7F)<<7);
+			layout.runs.push_back(MemberRun(a, m->offset, size));
+			inRun = true;
 		}
-	} else {
-		*buf = a&0x7F;
 	}
+
+	return layout;
 }
 
 //-------------------------------------------------------------------------
@@ -144,7 +190,33 @@ void ReadVarSizeUInt(std::istream *stream, unsigned int *buf)
 //-------------------------------------------------------------------------
 COutputStreamSerializer::COutputStreamSerializer ()
 {
-	stream = 0;
+	streamStart = 0;
+	nextPendingObject = 0;
+}
+
+void COutputStreamSerializer::WriteVarSizeUInt(unsigned int val)
+{
+	if (val<0x80) {
+		unsigned char a = val;
+		Write (&a, sizeof(char));
+	} else if (val<0x4000) {
+		unsigned char a = (val & 0x7F) | 0x80;
+		unsigned char b = val>>7;
+		Write (&a, sizeof(char));
+		Write (&b, sizeof(char));
+	} else if (val<0x40000000) {
+		unsigned char a = (val & 0x7F) | 0x80;
+		unsigned char b = ((val>>7) & 0x7F) | 0x80;
+		unsigned short c = swabword(val>>14);
+		Write (&a, sizeof(char));
+		Write (&b, sizeof(char));
+		Write (&c, sizeof(short));
+	} else throw "Cannot save varible-size int";
+}
+
+void COutputStreamSerializer::WriteZStr(const string& s)
+{
+	Write (s.c_str(), s.length()+1);
 }
 
 bool COutputStreamSerializer::IsWriting ()
@@ -169,21 +241,34 @@ void COutputStreamSerializer::SerializeObject (Class *c, void *ptr, ObjectRef *o
 
 	ObjectMemberGroup omg;
 	omg.membersClass = c;
+	omg.size = 0;
 
-	for (uint a=0;a<c->members.size();a++)
+	const ClassLayout& layout = GetClassLayout(c);
+	omg.members.reserve(c->members.size() + 1);
+
+	for (std::vector<MemberRun>::const_iterator r=layout.runs.begin();r!=layout.runs.end();++r)
 	{
-		creg::Class::Member* m = c->members [a];
-		if (m->flags & CM_NoSerialize)
+		ObjectMember om;
+
+		if (r->size > 0) {
+			Write (((char*)ptr) + r->offset, r->size);
+			for (int a=r->first;a<r->first+r->count;a++) {
+				om.member = c->members [a];
+				om.memberId = a;
+				om.size = layout.plainSizes [a];
+				omg.members.push_back(om);
+			}
+			omg.size+=r->size;
 			continue;
+		}
 
-		ObjectMember om;
+		creg::Class::Member* m = c->members [r->first];
 		om.member = m;
-		om.memberId = a;
+		om.memberId = r->first;
 		void *memberAddr = ((char*)ptr) + m->offset;
-		unsigned mstart = stream->tellp();
+		unsigned mstart = buffer.size();
 		m->type->Serialize (this, memberAddr);
-		unsigned mend = stream->tellp();
-		om.size = mend-mstart;
+		om.size = buffer.size()-mstart;
 		omg.members.push_back(om);
 		omg.size+=om.size;
 	}
@@ -193,11 +278,10 @@ void COutputStreamSerializer::SerializeObject (Class *c, void *ptr, ObjectRef *o
 		ObjectMember om;
 		om.member = NULL;
 		om.memberId = -1;
-		unsigned mstart = stream->tellp();
+		unsigned mstart = buffer.size();
 		_DummyStruct *obj = (_DummyStruct*)ptr;
 		(obj->*(c->serializeProc))(*this);
-		unsigned mend = stream->tellp();
-		om.size = mend-mstart;
+		om.size = buffer.size()-mstart;
 		omg.members.push_back(om);
 		omg.size+=om.size;
 	}
@@ -216,20 +300,20 @@ void COutputStreamSerializer::SerializeObjectInstance (void *inst, creg::Class *
 		throw "Reserialization of embedded object";
 	else {
 		std::vector<ObjectRef*>::iterator pos;
-		for (pos=pendingObjects.begin();pos!=pendingObjects.end() && (*pos)!=obj;++pos) ;
+		for (pos=pendingObjects.begin()+nextPendingObject;pos!=pendingObjects.end() && (*pos)!=obj;++pos) ;
 		if (pos==pendingObjects.end())
 			throw "Object pointer was serialized";
 		else {
-			pendingObjects.erase(pos);
+			*pos = NULL;
 		}
 	}
 	obj->class_ = objClass;
 	obj->isEmbedded = true;
 
-//	printf ("writepos of %s (%d): %d\n", objClass->name.c_str(), obj->id,(int)stream->tellp());
+//	printf ("writepos of %s (%d): %d\n", objClass->name.c_str(), obj->id,(int)Tell());
 
 	// write an object ID
-	WriteVarSizeUInt(stream,obj->id);
+	WriteVarSizeUInt(obj->id);
 
 	// write the object
 	SerializeObject(objClass, inst, obj);
@@ -250,17 +334,17 @@ void COutputStreamSerializer::SerializeObjectPtr (void **ptr, creg::Class *objCl
 			id = obj->id;
 
 //		*stream << (char)1;
-		WriteVarSizeUInt(stream,id);
+		WriteVarSizeUInt(id);
 	} else {
 		// null pointer, write a zero
-		WriteVarSizeUInt(stream,0);
+		WriteVarSizeUInt(0);
 //		*stream << (char)0;
 	}
 }
 
 void COutputStreamSerializer::Serialize (void *data, int byteSize)
 {
-	stream->write ((char*)data, byteSize);
+	Write (data, byteSize);
 }
 
 void COutputStreamSerializer::SerializeInt (void *data, int byteSize)
@@ -276,12 +360,12 @@ void COutputStreamSerializer::SerializeInt (void *data, int byteSize)
 			break;
 		}
 		case 4:{
-			*(long *)buf = swabdword(*(long *) data);
+			*(int *)buf = swabdword(*(int *) data);
 			break;
 		}
 		default: throw "Unknown int type";
 	}
-	stream->write ((char*)data, byteSize);
+	Write (buf, byteSize);
 }
 
 
@@ -295,11 +379,12 @@ void COutputStreamSerializer::SavePackage (std::ostream *s, void *rootObj, Class
 {
 	PackageHeader ph;
 
-	stream = s;
-	unsigned startOffset = stream->tellp();
+	const std::streamoff startOffset = s->tellp();
+	streamStart = (startOffset > 0) ? (unsigned int)startOffset : 0;
 
-	stream->seekp (startOffset + sizeof (PackageHeader));
-	ph.objDataOffset = (int)stream->tellp();
+	// room for the header, it is filled in at the end
+	buffer.assign (sizeof (PackageHeader), 0);
+	ph.objDataOffset = (int)Tell();
 
 	// Insert dummy object with id 0
 	ObjectRef *obj = &*objects.insert(objects.end(),ObjectRef(0,0,true,0));
@@ -311,21 +396,20 @@ void COutputStreamSerializer::SavePackage (std::ostream *s, void *rootObj, Class
 	pendingObjects.push_back (obj);
 
 	map<creg::Class *,int> classSizes;
-	// Save until all the referenced objects have been stored
-	while (!pendingObjects.empty ())
+	// Save until all the referenced objects have been stored,
+	// in the order they were referenced (which is the order of their ids)
+	for (nextPendingObject=0;nextPendingObject<pendingObjects.size();)
 	{
-		const std::vector <ObjectRef*> &po = pendingObjects;
-		pendingObjects.clear ();
-
-		for (std::vector <ObjectRef*> ::const_iterator i=po.begin();i!=po.end();++i)
-		{
-			ObjectRef* obj = *i;
-			unsigned objstart = stream->tellp();
-			SerializeObject(obj->class_, obj->ptr, obj);
-			unsigned objend = stream->tellp();
-			int sz = objend-objstart;
-			classSizes[obj->class_]+=sz;
-		}
+		ObjectRef* obj = pendingObjects[nextPendingObject++];
+
+		// saved as embedded object
+		if (obj == NULL)
+			continue;
+
+		unsigned objstart = buffer.size();
+		SerializeObject(obj->class_, obj->ptr, obj);
+		int sz = buffer.size()-objstart;
+		classSizes[obj->class_]+=sz;
 	}
 
 	// Collect a set of all used classes
@@ -365,54 +449,54 @@ void COutputStreamSerializer::SavePackage (std::ostream *s, void *rootObj, Class
 
 	// Write the class references
 	ph.numObjClassRefs = classRefs.size();
-	ph.objClassRefOffset = (int)stream->tellp();
+	ph.objClassRefOffset = (int)Tell();
 	for (uint a=0;a<classRefs.size();a++) {
-		WriteZStr (*stream, classRefs[a]->class_->name);
+		WriteZStr (classRefs[a]->class_->name);
 		// write a checksum (unused atm)
 //		int checksum = swabdword(0);
 //		stream->write ((char*)&checksum, sizeof(int));
 		int cnt = classRefs[a]->class_->members.size();
-		WriteVarSizeUInt(stream,cnt);
+		WriteVarSizeUInt(cnt);
 		for (int b=0;b<cnt;b++) {
 			creg::Class::Member* m = classRefs[a]->class_->members [b];
 			int namehash = swabdword(MakeStrHash(m->name));
 			std::string typeName = m->type->GetName();
 			int typehash1 = MakeStrHash(typeName.c_str());
 			char typehash2 = ((typehash1>>0)&0xFF) ^ ((typehash1>>8)&0xFF) ^ ((typehash1>>16)&0xFF) ^ ((typehash1>>24)&0xFF);
-			stream->write ((char*)&namehash, sizeof(int));
-			stream->write ((char*)&typehash2, sizeof(char));
+			Write (&namehash, sizeof(int));
+			Write (&typehash2, sizeof(char));
 		}
 	}
 
 	// Write object info
-	ph.objTableOffset = (int)stream->tellp();
+	ph.objTableOffset = (int)Tell();
 	ph.numObjects = objects.size();
 	for (std::list <ObjectRef>::iterator i=objects.begin();i!=objects.end();++i) {
 		int classRefIndex = i->classIndex;
 		char isEmbedded = i->isEmbedded ? 1 : 0;
-		WriteVarSizeUInt(stream,classRefIndex);
-		stream->write ((char*)&isEmbedded, sizeof(char));
+		WriteVarSizeUInt(classRefIndex);
+		Write (&isEmbedded, sizeof(char));
 		char mgcnt = i->memberGroups.size();
-		WriteVarSizeUInt(stream,mgcnt);
+		WriteVarSizeUInt(mgcnt);
 		for (std::vector<COutputStreamSerializer::ObjectMemberGroup>::iterator j=i->memberGroups.begin();j!=i->memberGroups.end();++j) {
 			map<creg::Class*,ClassRef>::iterator cr = classMap.find(j->membersClass);
 			if (cr == classMap.end()) throw "Cannot find member class ref";
 			int cid = cr->second.index;
-			WriteVarSizeUInt(stream,cid);
+			WriteVarSizeUInt(cid);
 			unsigned int mcnt = j->members.size();
-			WriteVarSizeUInt(stream,mcnt);
+			WriteVarSizeUInt(mcnt);
 			bool hasSerializerMember = false;
 			char groupFlags = 0;
 			if (!j->members.empty() && j->members.back().memberId==-1) {
 				groupFlags|=0x01;
 				hasSerializerMember = true;
 			}
-			stream->write ((char*)&groupFlags, sizeof(char));
+			Write (&groupFlags, sizeof(char));
 			int midx=0;
 			for (std::vector<COutputStreamSerializer::ObjectMember>::iterator k=j->members.begin();k!=j->members.end();++k,++midx) {
 				if (k->memberId!=midx && (!hasSerializerMember || k!=j->members.end()-1))
 					throw "Invalid member id";
-				WriteVarSizeUInt(stream,k->size);
+				WriteVarSizeUInt(k->size);
 			}
 		}
 	}
@@ -426,17 +510,17 @@ void COutputStreamSerializer::SavePackage (std::ostream *s, void *rootObj, Class
 	}
 //	printf("Checksum: %d\n", ph.metadataChecksum);
 
-	int endOffset = stream->tellp();
-	stream->seekp (startOffset);
 	memcpy(ph.magic, CREG_PACKAGE_FILE_ID, 4);
 	ph.SwapBytes ();
-	stream->write ((const char *)&ph, sizeof(PackageHeader));
+	memcpy(&buffer[0], &ph, sizeof(PackageHeader));
 
 //	logOutput.Print("Number of objects saved: %d\nNumber of classes involved: %d\n", objects.size(), classRefs.size());
 
-	stream->seekp (endOffset);
+	s->write (buffer.data(), buffer.size());
+	std::string().swap(buffer);
 	ptrToId.clear();
 	pendingObjects.clear();
+	nextPendingObject = 0;
 	objects.clear();
 }
 
@@ -446,7 +530,8 @@ void COutputStreamSerializer::SavePackage (std::ostream *s, void *rootObj, Class
 
 CInputStreamSerializer::CInputStreamSerializer()
 {
-	stream = 0;
+	streamStart = 0;
+	readPos = 0;
 }
 CInputStreamSerializer::~CInputStreamSerializer()
 {}
@@ -456,17 +541,68 @@ bool CInputStreamSerializer::IsWriting ()
 	return false;
 }
 
+void CInputStreamSerializer::Read (void *data, unsigned int size)
+{
+	if (size > buffer.size() - readPos)
+		throw std::runtime_error ("Unexpected end of package");
+	memcpy (data, &buffer[readPos], size);
+	readPos += size;
+}
+
+void CInputStreamSerializer::ReadVarSizeUInt(unsigned int *buf)
+{
+	unsigned char a;
+	Read (&a, sizeof(char));
+	if (a&0x80) {
+		unsigned char b;
+		Read (&b, sizeof(char));
+		if (b&0x80) {
+			unsigned short c;
+			Read (&c, sizeof(short));
+			c = swabword(c);
+			*buf = (a&0x7F) | ((b&0x7F)<<7) | (c<<14);
+		} else {
+			*buf = (a&0x7F) | ((b&0x7F)<<7);
+		}
+	} else {
+		*buf = a&0x7F;
+	}
+}
+
+string CInputStreamSerializer::ReadZStr()
+{
+	const char* str = buffer.empty() ? NULL : &buffer[readPos];
+	const void* end = (str == NULL) ? NULL : memchr(str, 0, buffer.size() - readPos);
+	if (end == NULL)
+		throw std::runtime_error ("Unexpected end of package");
+
+	const unsigned int len = (const char*)end - str;
+	readPos += len + 1;
+	return string(str, len);
+}
+
+void CInputStreamSerializer::Seek (unsigned int pos)
+{
+	if (pos < streamStart || pos - streamStart > buffer.size())
+		throw std::runtime_error ("Invalid offset in package");
+	readPos = pos - streamStart;
+}
+
 void CInputStreamSerializer::SerializeObject (Class *c, void *ptr)
 {
 	if (c->base)
 		SerializeObject(c->base, ptr);
 
-	for (uint a=0;a<c->members.size();a++)
+	const ClassLayout& layout = GetClassLayout(c);
+
+	for (std::vector<MemberRun>::const_iterator r=layout.runs.begin();r!=layout.runs.end();++r)
 	{
-		creg::Class::Member* m = c->members [a];
-		if (m->flags & CM_NoSerialize)
+		if (r->size > 0) {
+			Read (((char*)ptr) + r->offset, r->size);
 			continue;
+		}
 
+		creg::Class::Member* m = c->members [r->first];
 		void *memberAddr = ((char*)ptr) + m->offset;
 		m->type->Serialize (this, memberAddr);
 	}
@@ -479,19 +615,19 @@ void CInputStreamSerializer::SerializeObject (Class *c, void *ptr)
 
 void CInputStreamSerializer::Serialize (void *data, int byteSize)
 {
-	stream->read ((char*)data, byteSize);
+	Read (data, byteSize);
 }
 
 void CInputStreamSerializer::SerializeInt (void *data, int byteSize)
 {
-	stream->read ((char*)data, byteSize);
+	Read (data, byteSize);
 	switch (byteSize) {
 		case 2:{
 			*(short *) data = swabword(*(short *) data);
 			break;
 		}
 		case 4:{
-			*(long *) data = swabdword(*(long *) data);
+			*(int *) data = swabdword(*(int *) data);
 			break;
 		}
 		default: throw "Unknown int type";
@@ -501,11 +637,13 @@ void CInputStreamSerializer::SerializeInt (void *data, int byteSize)
 void CInputStreamSerializer::SerializeObjectPtr (void **ptr, creg::Class *cls)
 {
 //	char v;
-//	printf ("reading ptr %s* at %d\n", cls->name.c_str(), (int)stream->tellg());
+//	printf ("reading ptr %s* at %d\n", cls->name.c_str(), (int)(streamStart + readPos));
 //	*stream >> v;
 	unsigned int id;
-	ReadVarSizeUInt(stream, &id);
+	ReadVarSizeUInt(&id);
 	if (id) {
+		if (id >= objects.size())
+			throw std::runtime_error ("Invalid object reference in package");
 		StoredObject &o = objects [id];
 		if (o.obj) *ptr = o.obj;
 		else {
@@ -524,12 +662,14 @@ void CInputStreamSerializer::SerializeObjectPtr (void **ptr, creg::Class *cls)
 void CInputStreamSerializer::SerializeObjectInstance (void *inst, creg::Class *cls)
 {
 	unsigned int id;
-	ReadVarSizeUInt(stream, &id);
+	ReadVarSizeUInt(&id);
 
 	if (id==0)
 		return; // this is old save game and it has not this object - skip it
 
-//	printf ("readpos of embedded %s (%d): %d\n", cls->name.c_str(), id, ((int)stream->tellg())-4);
+//	printf ("readpos of embedded %s (%d): %d\n", cls->name.c_str(), id, ((int)(streamStart + readPos))-4);
+	if (id >= objects.size())
+		throw std::runtime_error ("Invalid object reference in package");
 	StoredObject& o = objects[id];
 	assert (!o.obj);
 	assert (o.isEmbedded);
@@ -552,28 +692,43 @@ void CInputStreamSerializer::LoadPackage (std::istream *s, void*& root, creg::Cl
 {
 	PackageHeader ph;
 
-	stream = s;
-	s->read((char *)&ph, sizeof(PackageHeader));
+	// read everything from the package on, the objects are parsed from memory
+	const std::streamoff startOffset = s->tellg();
+	s->seekg (0, std::ios::end);
+	const std::streamoff endOfStream = s->tellg();
+	if (startOffset < 0 || endOfStream < startOffset + (std::streamoff)sizeof(PackageHeader))
+		throw std::runtime_error ("Incomplete object package");
+
+	streamStart = startOffset;
+	buffer.resize (endOfStream - startOffset);
+	readPos = 0;
+	s->seekg (startOffset);
+	s->read (&buffer[0], buffer.size());
+	if (s->gcount() != (std::streamsize)buffer.size())
+		throw std::runtime_error ("Could not read object package");
+
+	Read (&ph, sizeof(PackageHeader));
+	ph.SwapBytes ();
 
 	if (memcmp (ph.magic, CREG_PACKAGE_FILE_ID, 4))
 		throw std::runtime_error ("Incorrect object package file ID");
 
 	// Load references
 	classRefs.resize (ph.numObjClassRefs);
-	s->seekg (ph.objClassRefOffset);
+	Seek (ph.objClassRefOffset);
 	for (int a=0;a<ph.numObjClassRefs;a++)
 	{
-		string className = ReadZStr (*s);
+		string className = ReadZStr ();
 		creg::Class *class_ = System::GetClass (className);
 		if (!class_)
 			throw std::runtime_error ("Package file contains reference to unknown class " + className);
 		unsigned int cnt;
-		ReadVarSizeUInt(stream, &cnt);
+		ReadVarSizeUInt(&cnt);
 		for (unsigned int b=0;b<cnt;b++) {
 			int namehash;
-			stream->read ((char*)&namehash, sizeof(int));
+			Read (&namehash, sizeof(int));
 			char typehash;
-			stream->read ((char*)&typehash, sizeof(char));
+			Read (&typehash, sizeof(char));
 		}
 
 		classRefs[a] = class_;
@@ -587,25 +742,27 @@ void CInputStreamSerializer::LoadPackage (std::istream *s, void*& root, creg::Cl
 		throw std::runtime_error ("Metadata checksum error: Package file was saved with a different version");
 
 	// Create all non-embedded objects
-	s->seekg (ph.objTableOffset);
+	Seek (ph.objTableOffset);
 	objects.resize (ph.numObjects);
 	for (int a=0;a<ph.numObjects;a++)
 	{
 		unsigned int classRefIndex;
 		char isEmbedded;
-		ReadVarSizeUInt(stream,&classRefIndex);
-		stream->read ((char*)&isEmbedded, sizeof(char));
+		ReadVarSizeUInt(&classRefIndex);
+		Read (&isEmbedded, sizeof(char));
+		if (classRefIndex >= classRefs.size())
+			throw std::runtime_error ("Invalid class reference in package");
 		unsigned int mgcnt;
-		ReadVarSizeUInt(stream,&mgcnt);
+		ReadVarSizeUInt(&mgcnt);
 		for (unsigned int b=0;b<mgcnt;b++) {
 			unsigned int cid,mcnt;
 			char groupFlags;
-			ReadVarSizeUInt(stream,&cid);
-			ReadVarSizeUInt(stream,&mcnt);
-			stream->read ((char*)&groupFlags, sizeof(char));
+			ReadVarSizeUInt(&cid);
+			ReadVarSizeUInt(&mcnt);
+			Read (&groupFlags, sizeof(char));
 			for (unsigned int c=0;c<mcnt;c++) {
 				unsigned int size;
-				ReadVarSizeUInt(stream,&size);
+				ReadVarSizeUInt(&size);
 			}
 		}
 
@@ -619,12 +776,12 @@ void CInputStreamSerializer::LoadPackage (std::istream *s, void*& root, creg::Cl
 		objects [a].classRef = classRefIndex;
 	}
 
-	int endOffset = s->tellg();
+	const unsigned int endOffset = streamStart + readPos;
 
-//	printf ("Loading %d objects (at %d)\n", objects.size(), (int)stream->tellg());
+//	printf ("Loading %d objects (at %d)\n", objects.size(), (int)(streamStart + readPos));
 
 	// Read the object data using serialization
-	s->seekg (ph.objDataOffset);
+	Seek (ph.objDataOffset);
 	for (uint a=0;a<objects.size();a++)
 	{
 		if (!objects[a].isEmbedded) {
@@ -669,7 +826,9 @@ void CInputStreamSerializer::LoadPackage (std::istream *s, void*& root, creg::Cl
 	root = objects[1].obj;
 	rootCls = classRefs[objects[1].classRef];
 
+	s->clear ();
 	s->seekg (endOffset);
+	std::vector<char>().swap(buffer);
 	unfixedPointers.clear();
 	objects.clear();
 }
@@ -5,6 +5,7 @@
 
 #include "ISerializer.h"
 #include <map>
+#include <string>
 #include <vector>
 #include <list>
 
@@ -75,10 +76,19 @@ namespace creg {
 		// Temporary class reference
 		struct ClassRef;
 
-		std::ostream *stream;
+		std::string buffer; ///< package data, written to the stream at once
+		unsigned int streamStart; ///< stream position of the package
+
+		/// the stream position buffer.size() will end up at
+		unsigned int Tell() const { return streamStart + buffer.size(); }
+		void Write(const void *data, int size) { buffer.append((const char*)data, size); }
+		void WriteVarSizeUInt(unsigned int val);
+		void WriteZStr(const std::string& s);
+
 		std::map <void*,std::vector<ObjectRef*> > ptrToId;
 		std::list <ObjectRef> objects;
-		std::vector <ObjectRef*> pendingObjects; // these objects still have to be saved
+		std::vector <ObjectRef*> pendingObjects; // objects that are only referenced by pointer, in the order they have to be saved
+		unsigned int nextPendingObject; // pendingObjects before this one have been saved
 
 		// Serialize all class names
 		void WriteObjectInfo ();
@@ -92,7 +102,8 @@ namespace creg {
 	public:
 		COutputStreamSerializer ();
 
-		/** Create a package of the given root object and all the objects that it references
+		/** Create a package of the given root object and all the objects that it references.
+		 * The package is built in memory and written to the stream in one go.
 		 * @param s stream to serialize the data to
 		 * @param rootObj the rootObj: the starting point for finding all the objects to save
 		 * @param cls the class of the root object
@@ -126,7 +137,17 @@ namespace creg {
 	class CInputStreamSerializer : public ISerializer
 	{
 	protected:
-		std::istream* stream;
+		std::vector<char> buffer; ///< the package, read from the stream at once
+		unsigned int streamStart; ///< stream position of the package
+		unsigned int readPos; ///< read position in buffer
+
+		/// throws std::runtime_error when reading past the end of the package
+		void Read(void *data, unsigned int size);
+		void ReadVarSizeUInt(unsigned int *buf);
+		std::string ReadZStr();
+		/// move to a stream position, as stored in the package header
+		void Seek(unsigned int pos);
+
 		std::vector <creg::Class *> classRefs;
 
 		struct UnfixedPtr {
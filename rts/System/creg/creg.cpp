@@ -45,6 +45,8 @@ ClassBinder::ClassBinder (const char *className, unsigned int cf, ClassBinder* b
 	memberRegistrator = mreg;
 	constructor = constructorProc;
 	destructor = destructorProc;
+	allocator = 0;
+	deallocator = 0;
 	base = baseClsBinder;
 	size = instanceSize;
 	flags = (ClassFlags)cf;
@@ -203,9 +205,19 @@ void Class::SetMemberFlag (const char *name, ClassMemberFlag f)
 		}
 }
 
+// the binder of the closest class (this or a base) with an allocator
+static const ClassBinder* GetAllocatorBinder(const ClassBinder* binder)
+{
+	while (binder && !binder->allocator)
+		binder = binder->base;
+
+	return binder;
+}
+
 void* Class::CreateInstance()
 {
-	void *inst = operator_new(binder->size);
+	const ClassBinder* allocBinder = GetAllocatorBinder(binder);
+	void *inst = allocBinder? allocBinder->allocator(binder->size): operator_new(binder->size);
 
 	if (binder->constructor) binder->constructor (inst);
 	return inst;
@@ -215,7 +227,13 @@ void Class::DeleteInstance (void *inst)
 {
 	if (binder->destructor) binder->destructor(inst);
 
-	operator_delete(inst);
+	const ClassBinder* allocBinder = GetAllocatorBinder(binder);
+
+	if (allocBinder) {
+		allocBinder->deallocator(inst, binder->size);
+	} else {
+		operator_delete(inst);
+	}
 }
 
 static void StringHash(const std::string &str, unsigned int hash)
@@ -91,6 +91,8 @@ namespace creg {
 		int size; // size of an instance in bytes
 		void (*constructor)(void *instance);
 		void (*destructor)(void *instance); // needed for classes without virtual destructor (classes/structs declared with CR_DECLARE_STRUCT)
+		void* (*allocator)(size_t size); // set by CR_BIND_ALLOCATOR, also used for derived classes
+		void (*deallocator)(void *instance, size_t size);
 
 		ClassBinder* nextBinder;
 	};
@@ -346,6 +348,22 @@ namespace creg {
 	creg::Class* TCls::GetClass() { return binder.class_; } \
 	creg::ClassBinder TCls::binder(#TCls, (unsigned int)creg::CF_Abstract, 0, &TCls::memberRegistrator, sizeof(TCls), 0, 0);
 
+/** @def CR_BIND_ALLOCATOR
+ * Makes creg allocate and free instances of TCls, and of all classes derived
+ * from it, with the operator new and delete of TCls
+ * should be used in the source file, after binding TCls
+ * @param TCls class that defines operator new(size_t) and delete(void*, size_t)
+ */
+#define CR_BIND_ALLOCATOR(TCls) \
+	static void* TCls##_AllocInstance(size_t size) { return TCls::operator new(size); } \
+	static void TCls##_FreeInstance(void *d, size_t size) { TCls::operator delete(d, size); } \
+	static struct TCls##AllocatorBinder { \
+		TCls##AllocatorBinder() { \
+			TCls::binder.allocator = TCls##_AllocInstance; \
+			TCls::binder.deallocator = TCls##_FreeInstance; \
+		} \
+	} TCls##allocbinder;
+
 /** @def CR_REG_METADATA
  * Binds the class metadata to the class itself
  * should be used in the source file
@@ -2,6 +2,10 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <stddef.h>
+#include <zlib.h>
 #include <boost/program_options.hpp>
 
 #include "StringSerializer.h"
@@ -26,6 +30,7 @@ no console output (you still could use this.exe > z.tzt though).
 
 void TrafficDump(CDemoReader& reader, bool trafficStats);
 void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string& file);
+bool ConvertDemo(const std::string& inFile, const std::string& outFile);
 
 int main (int argc, char* argv[])
 {
@@ -44,6 +49,7 @@ int main (int argc, char* argv[])
 	all.add_options()("teamstats,t", "Print teamstats");
 	all.add_options()("team", po::value<unsigned>(), "Select team");
 	all.add_options()("teamsstatcsv", po::value<std::string>(), "Write teamstats in a csv file");
+	all.add_options()("convert,c", po::value<std::string>(), "Convert between the legacy and the compressed demo format, write to this file");
 
 	po::store(po::command_line_parser(argc, argv).options(all).positional(p).run(), vm);
 	po::notify(vm);
@@ -66,6 +72,12 @@ int main (int argc, char* argv[])
 		return 1;
 	}
 
+	if (vm.count("convert"))
+	{
+		// no CDemoReader here, it rejects demos of other Spring versions
+		return ConvertDemo(filename, vm["convert"].as<std::string>()) ? 0 : 1;
+	}
+
 	const bool printStats = vm.count("stats");
 	CDemoReader reader(filename, 0.0f);
 	reader.LoadStats();
@@ -347,3 +359,184 @@ void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string&
 		exit(1);
 	}
 };
+
+
+static void WriteBlock(std::ofstream& out, std::vector<DemoStreamIndexEntry>& index, int& streamSize,
+		unsigned type, const std::vector<unsigned char>& data, float modGameTime)
+{
+	uLongf packedSize = compressBound(data.size());
+	std::vector<Bytef> packed(packedSize);
+	compress2(&packed[0], &packedSize, &data[0], data.size(), Z_BEST_COMPRESSION);
+
+	DemoStreamIndexEntry entry;
+	entry.modGameTime = modGameTime;
+	entry.type = type;
+	entry.offset = streamSize;
+	index.push_back(entry);
+
+	DemoStreamBlockHeader blockHeader;
+	blockHeader.modGameTime = modGameTime;
+	blockHeader.type = type;
+	blockHeader.rawSize = data.size();
+	blockHeader.packedSize = packedSize;
+	blockHeader.swab();
+	out.write((char*) &blockHeader, sizeof(blockHeader));
+	out.write((char*) &packed[0], packedSize);
+	streamSize += sizeof(blockHeader) + packedSize;
+}
+
+/// DEMOFILE_VERSION_LEGACY stream -> compressed blocks, same policy as CDemoRecorder
+static int CompressStream(const std::vector<char>& stream, std::ofstream& out, std::vector<DemoStreamIndexEntry>& index)
+{
+	std::vector<unsigned char> block;
+	float blockTime = 0.0f;
+	int streamSize = 0;
+
+	for (size_t pos = 0; pos + sizeof(DemoStreamChunkHeader) <= stream.size(); ) {
+		DemoStreamChunkHeader chunkHeader;
+		memcpy(&chunkHeader, &stream[pos], sizeof(chunkHeader));
+		chunkHeader.swab();
+
+		const size_t chunkSize = sizeof(chunkHeader) + chunkHeader.length;
+		if (pos + chunkSize > stream.size())
+			break; // crashed recording, incomplete chunk
+
+		if (block.empty())
+			blockTime = chunkHeader.modGameTime;
+		block.insert(block.end(), stream.begin() + pos, stream.begin() + pos + chunkSize);
+		pos += chunkSize;
+
+		if (block.size() >= DEMO_BLOCK_MAX_SIZE || (chunkHeader.modGameTime - blockTime) >= DEMO_BLOCK_MAX_TIME) {
+			WriteBlock(out, index, streamSize, DEMO_BLOCK_STREAM, block, blockTime);
+			block.clear();
+		}
+	}
+
+	if (!block.empty())
+		WriteBlock(out, index, streamSize, DEMO_BLOCK_STREAM, block, blockTime);
+
+	return streamSize;
+}
+
+/// compressed blocks -> DEMOFILE_VERSION_LEGACY stream, keyframes are dropped
+static int DecompressStream(const std::vector<char>& stream, std::ofstream& out)
+{
+	int streamSize = 0;
+
+	for (size_t pos = 0; pos + sizeof(DemoStreamBlockHeader) <= stream.size(); ) {
+		DemoStreamBlockHeader blockHeader;
+		memcpy(&blockHeader, &stream[pos], sizeof(blockHeader));
+		blockHeader.swab();
+		pos += sizeof(blockHeader);
+
+		if (pos + blockHeader.packedSize > stream.size())
+			break; // crashed recording, incomplete block
+
+		if (blockHeader.type == DEMO_BLOCK_STREAM && blockHeader.rawSize > 0) {
+			std::vector<Bytef> raw(blockHeader.rawSize);
+			uLongf rawSize = blockHeader.rawSize;
+
+			if (uncompress(&raw[0], &rawSize, (const Bytef*) &stream[pos], blockHeader.packedSize) != Z_OK) {
+				std::cout << "Corrupt block at stream offset " << (pos - sizeof(blockHeader)) << ", stopping" << std::endl;
+				break;
+			}
+			out.write((char*) &raw[0], rawSize);
+			streamSize += rawSize;
+		}
+		pos += blockHeader.packedSize;
+	}
+
+	return streamSize;
+}
+
+bool ConvertDemo(const std::string& inFile, const std::string& outFile)
+{
+	std::ifstream in(inFile.c_str(), std::ios::binary);
+	if (!in.is_open())
+	{
+		std::cout << "Cannot open " << inFile << std::endl;
+		return false;
+	}
+
+	DemoFileHeader header;
+	const int headerPrefixSize = sizeof(header.magic) + sizeof(header.version) + sizeof(header.headerSize);
+	const int legacyHeaderSize = offsetof(DemoFileHeader, indexSize);
+
+	memset(&header, 0, sizeof(header));
+	in.read((char*) &header, headerPrefixSize);
+
+	const int version = swabdword(header.version);
+	const int headerSize = swabdword(header.headerSize);
+	const bool legacy = (version == DEMOFILE_VERSION_LEGACY && headerSize == legacyHeaderSize);
+
+	if (memcmp(header.magic, DEMOFILE_MAGIC, sizeof(header.magic)) ||
+		!(legacy || (version == DEMOFILE_VERSION && headerSize == sizeof(header))))
+	{
+		std::cout << inFile << " is no demo or has an unknown format version" << std::endl;
+		return false;
+	}
+	in.read(((char*) &header) + headerPrefixSize, headerSize - headerPrefixSize);
+	header.swab();
+
+	std::vector<char> script(header.scriptSize);
+	if (!script.empty())
+		in.read(&script[0], script.size());
+
+	// an unfinished recording has no stats, its stream runs until EOF
+	const bool finished = (header.demoStreamSize != 0);
+	const long streamStart = in.tellg();
+	in.seekg(0, std::ios::end);
+	const long fileEnd = in.tellg();
+	in.seekg(streamStart);
+
+	std::vector<char> stream(finished ? header.demoStreamSize : (fileEnd - streamStart));
+	std::vector<char> stats(finished ? (header.winningAllyTeamsSize + header.playerStatSize + header.teamStatSize) : 0);
+	if (!stream.empty())
+		in.read(&stream[0], stream.size());
+	if (!stats.empty())
+		in.read(&stats[0], stats.size());
+
+	std::ofstream out(outFile.c_str(), std::ios::binary);
+	if (!out.is_open())
+	{
+		std::cout << "Cannot write " << outFile << std::endl;
+		return false;
+	}
+
+	DemoFileHeader outHeader = header;
+	outHeader.version = legacy ? DEMOFILE_VERSION : DEMOFILE_VERSION_LEGACY;
+	outHeader.headerSize = legacy ? sizeof(DemoFileHeader) : legacyHeaderSize;
+	outHeader.indexSize = 0;
+	if (!finished)
+	{
+		outHeader.numPlayers = outHeader.numTeams = 0;
+		outHeader.winningAllyTeamsSize = outHeader.playerStatSize = outHeader.teamStatSize = 0;
+	}
+
+	out.seekp(outHeader.headerSize);
+	if (!script.empty())
+		out.write(&script[0], script.size());
+
+	std::vector<DemoStreamIndexEntry> index;
+	outHeader.demoStreamSize = legacy ? CompressStream(stream, out, index) : DecompressStream(stream, out);
+
+	if (!stats.empty())
+		out.write(&stats[0], stats.size());
+
+	for (std::vector<DemoStreamIndexEntry>::iterator it = index.begin(); it != index.end(); ++it)
+	{
+		DemoStreamIndexEntry entry = *it;
+		entry.swab();
+		out.write((char*) &entry, sizeof(entry));
+		outHeader.indexSize += sizeof(entry);
+	}
+
+	const long outSize = out.tellp();
+	out.seekp(0);
+	outHeader.swab();
+	out.write((char*) &outHeader, swabdword(outHeader.headerSize));
+
+	std::cout << "Converted " << inFile << " (" << fileEnd << " bytes, version " << version << ") to "
+	          << outFile << " (" << outSize << " bytes, version " << swabdword(outHeader.version) << ")" << std::endl;
+	return true;
+}